@@ -0,0 +1,156 @@
+// offline texture baker: PNGs in, one container of BC1/BC3 blocks with their mip chains out (see TextureContainer.h)
+//
+//   bake <output.vwtx> [--mips | --no-mips] [--auto | --bc1 | --bc3] [--size WxH | --size 0] file.png ...
+//
+// options apply to the files after them. --auto (the default) picks BC3 for images with some transparency
+// and BC1 for the others. --size resamples the files to that size (see resampleImage in ImageCache.h), for the
+// layers of a texture array that come in different sizes; 0 (the default) keeps their own. The blocks are
+// encoded on every core, the tool prints its throughput and the error of every texture.
+
+#include "ImageCache.h"
+#include "TextureContainer.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+struct BakeInput {
+    std::string file;
+    bool mipmaps;
+    int format; ///< 0 for automatic
+    int width, height; ///< 0 for the size of the file
+};
+
+static double psnr(const std::vector<unsigned char> &a, const std::vector<unsigned char> &b, bool alpha) {
+    double error = 0.0;
+    size_t count = 0;
+    for (size_t k = 0; k < a.size(); ++k) {
+        if (!alpha && k % 4 == 3) continue;
+        double d = (double)a[k] - b[k];
+        error += d * d;
+        ++count;
+    }
+    if (error == 0.0) return 99.0;
+    return 10.0 * std::log10(255.0 * 255.0 * count / error);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "usage: bake <output.vwtx> [--mips | --no-mips] [--auto | --bc1 | --bc3] [--size WxH | --size 0] "
+                     "file.png ..." << std::endl;
+        return 2;
+    }
+    std::string output = argv[1];
+    std::vector<BakeInput> inputs;
+    bool mipmaps = true;
+    int format = 0, width = 0, height = 0;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--mips") mipmaps = true;
+        else if (arg == "--no-mips") mipmaps = false;
+        else if (arg == "--auto") format = 0;
+        else if (arg == "--bc1") format = BLOCK_BC1;
+        else if (arg == "--bc3") format = BLOCK_BC3;
+        else if (arg == "--size" && i + 1 < argc) {
+            std::string size = argv[++i];
+            width = height = 0;
+            if (size != "0" && (sscanf(size.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)) {
+                std::cerr << "bad size " << size << std::endl;
+                return 2;
+            }
+        } else inputs.push_back(BakeInput{ arg, mipmaps, format, width, height });
+    }
+
+    ThreadPool pool;
+    std::vector<ContainerEntry> entries;
+    std::vector<std::vector<unsigned char>> blobs;
+    double encodeSeconds = 0.0;
+    size_t encodedPixels = 0, rgbaBytes = 0, blockBytesTotal = 0;
+
+    for (const BakeInput &input : inputs) {
+        TextureImage image;
+        // no cache, the baker always starts from the PNG
+        if (!decodeImage(input.file, input.mipmaps, image)) return 1;
+        if (input.width && (input.width != image.width || input.height != image.height)) {
+            TextureImage resized;
+            resampleImage(image.pixels, image.width, image.height, input.width, input.height, input.mipmaps, resized);
+            resized.file = image.file;
+            image = std::move(resized);
+        }
+
+        BlockFormat blockFormat = input.format ? (BlockFormat)input.format
+                                               : chooseBlockFormat(image.pixels, (size_t)image.width * image.height);
+        ContainerEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        std::string name = containerName(input.file);
+        if (name.size() >= sizeof(entry.name)) {
+            std::cerr << "name too long: " << name << std::endl;
+            return 1;
+        }
+        memcpy(entry.name, name.c_str(), name.size());
+        entry.format = blockFormat;
+        entry.width = image.width;
+        entry.height = image.height;
+        entry.levels = image.levels;
+        entry.bytes = containerLevelOffset(entry, entry.levels);
+
+        std::vector<unsigned char> blob(entry.bytes);
+        auto start = std::chrono::steady_clock::now();
+        for (int l = 0; l < image.levels; ++l) {
+            compressImage(image.pixels + image.levelOffset(l), image.levelWidth(l), image.levelHeight(l), blockFormat,
+                          &blob[containerLevelOffset(entry, l)], &pool);
+            encodedPixels += (size_t)image.levelWidth(l) * image.levelHeight(l);
+        }
+        encodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // error of level 0
+        std::vector<unsigned char> original(image.pixels, image.pixels + 4 * (size_t)image.width * image.height);
+        std::vector<unsigned char> decoded(original.size());
+        decompressImage(blob.data(), image.width, image.height, blockFormat, decoded.data());
+        printf("%-20s %5dx%-5d %2d levels  %s  %8.2f MB -> %6.2f MB  PSNR %.2f dB\n", name.c_str(), image.width,
+               image.height, image.levels, blockFormat == BLOCK_BC1 ? "BC1" : "BC3", image.bytes / 1048576.0,
+               blob.size() / 1048576.0, psnr(original, decoded, blockFormat == BLOCK_BC3));
+
+        rgbaBytes += image.bytes;
+        blockBytesTotal += blob.size();
+        entries.push_back(entry);
+        blobs.push_back(std::move(blob));
+    }
+
+    ContainerHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "VWTX", 4);
+    header.version = containerVersion;
+    header.count = (uint32_t)entries.size();
+    uint64_t offset = sizeof(ContainerHeader) + entries.size() * sizeof(ContainerEntry);
+    for (ContainerEntry &entry : entries) {
+        offset = (offset + 63) & ~(uint64_t)63;
+        entry.offset = offset;
+        offset += entry.bytes;
+    }
+
+    FILE *f = fopen(output.c_str(), "wb");
+    if (!f) {
+        std::cerr << "cannot write " << output << std::endl;
+        return 1;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    if (!entries.empty()) ok = ok && fwrite(entries.data(), sizeof(ContainerEntry), entries.size(), f) == entries.size();
+    long position = (long)(sizeof(ContainerHeader) + entries.size() * sizeof(ContainerEntry));
+    static const unsigned char zeros[64] = { 0 };
+    for (size_t i = 0; i < entries.size(); ++i) {
+        ok = ok && fwrite(zeros, 1, entries[i].offset - position, f) == entries[i].offset - position;
+        ok = ok && fwrite(blobs[i].data(), 1, blobs[i].size(), f) == blobs[i].size();
+        position = (long)(entries[i].offset + entries[i].bytes);
+    }
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        std::cerr << "error writing " << output << std::endl;
+        return 1;
+    }
+
+    printf("%d textures, %.2f MB RGBA8 -> %.2f MB, encoded %.1f Mpixels/s on %u threads\n", (int)entries.size(),
+           rgbaBytes / 1048576.0, blockBytesTotal / 1048576.0, encodedPixels / 1e6 / std::max(encodeSeconds, 1e-9), pool.size());
+    return 0;
+}
@@ -0,0 +1,120 @@
+// offline terrain baker: erodes a region of a world and builds its chunks on every core and writes them to a tile
+// store (see TileStore.h), so that the world and the headless harness map them instead of generating them
+//
+//   prebake <store dir> [--seed N] [--center X Y] [--radius R] [--force] [--erosion on|off] [--horizons on|off]
+//
+// every level of the quadtree is baked over the square of half side R (30 by default, the view radius of the
+// terrain) around the centre (the origin by default), with the chunk grid of Terrain. The erosion tiles under all of
+// it are made first, one per task (see Erosion.h), then the chunks with their horizon maps (see Horizon.h). Chunks
+// that are already in the store are kept unless --force is given, and get a horizon map if they have none or an
+// outdated one; eroded tiles are always kept, the directory of the store names everything they depend on.
+// The tool prints its throughput.
+
+#include "ChunkData.h"
+#include "Erosion.h"
+#include "Horizon.h"
+#include "TerrainLOD.h"
+#include "ThreadPool.h"
+#include "TileStore.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: prebake <store dir> [--seed N] [--center X Y] [--radius R] [--force] [--erosion on|off] "
+                     "[--horizons on|off]" << std::endl;
+        return 2;
+    }
+    std::string dir = argv[1];
+    HeightfieldParams params;
+    ErosionParams erosionParams;
+    HorizonParams horizonParams;
+    LODSettings lod; // the grid of Terrain
+    float centerX = 0.0f, centerY = 0.0f, radius = lod.viewRadius;
+    bool force = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) params.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--radius" && i + 1 < argc) radius = (float)std::atof(argv[++i]);
+        else if (arg == "--center" && i + 2 < argc) {
+            centerX = (float)std::atof(argv[++i]);
+            centerY = (float)std::atof(argv[++i]);
+        } else if (arg == "--force") force = true;
+        else if (arg == "--erosion" && i + 1 < argc) erosionParams.enabled = std::string(argv[++i]) != "off";
+        else if (arg == "--horizons" && i + 1 < argc) horizonParams.enabled = std::string(argv[++i]) != "off";
+        else {
+            std::cerr << "unknown option " << arg << std::endl;
+            return 2;
+        }
+    }
+
+    std::vector<ChunkKey> keys;
+    float regionX0 = centerX, regionY0 = centerY, regionX1 = centerX, regionY1 = centerY; ///< what the chunks cover
+    for (int level = 0; level <= lod.maxLevel; ++level) {
+        float size = chunkSizeAt(lod, level);
+        int x0 = (int)std::floor((centerX - radius) / size), x1 = (int)std::floor((centerX + radius) / size);
+        int y0 = (int)std::floor((centerY - radius) / size), y1 = (int)std::floor((centerY + radius) / size);
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) keys.push_back(ChunkKey{ level, x, y });
+        }
+        // with the ring of samples around the chunks that their normals need
+        float ring = levelSpacing(lod.spacing, level);
+        regionX0 = std::min(regionX0, x0 * size - ring);
+        regionY0 = std::min(regionY0, y0 * size - ring);
+        regionX1 = std::max(regionX1, (x1 + 1) * size + ring);
+        regionY1 = std::max(regionY1, (y1 + 1) * size + ring);
+    }
+
+    auto store = std::make_shared<TileStore>(dir, params, lod.quads, lod.spacing, erosionKey(erosionParams));
+    HeightfieldGenerator generator(nullptr, params);
+    ThreadPool pool;
+    std::atomic<int> kept(0), baked(0);
+
+    // the erosion tiles first, so the chunks do not wait for each other's tiles
+    std::unique_ptr<ErosionField> erosion;
+    double erosionSeconds = 0.0;
+    if (erosionParams.enabled) {
+        erosion = std::unique_ptr<ErosionField>(new ErosionField(params, erosionParams, lod.spacing, store));
+        erosion->maxTiles = std::numeric_limits<size_t>::max(); // the chunks need all of them
+        auto start = std::chrono::steady_clock::now();
+        erosion->prepare(regionX0, regionY0, regionX1, regionY1, &pool);
+        erosionSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // one chunk per task, the writes go to the background thread of the store
+    auto start = std::chrono::steady_clock::now();
+    pool.parallelFor(0, (int)keys.size(), 1, [&](int begin, int end) {
+        for (int k = begin; k < end; ++k) {
+            ChunkData chunk;
+            bool fromStore = !force && store->read(keys[k], chunk);
+            if (fromStore) kept++;
+            else if (erosion) buildChunk(generator, *erosion, keys[k], lod.quads, lod.spacing, chunk);
+            else buildChunk(generator, keys[k], lod.quads, lod.spacing, chunk);
+            bool bake = horizonParams.enabled && chunk.horizonKey != horizonKey(horizonParams);
+            if (bake) {
+                bakeHorizons(generator, erosion.get(), horizonParams, lod.quads, lod.spacing, chunk);
+                baked++;
+            }
+            if (!fromStore || bake) store->write(chunk);
+        }
+    });
+    store->flush();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int built = (int)keys.size() - kept;
+    if (erosion) {
+        int eroded = erosion->stats.tilesEroded.load();
+        printf("erosion: %d tiles, %d eroded and %d already there, %.2f s, %.1f tiles/s\n", (int)erosion->residentTiles(),
+               eroded, erosion->stats.tilesFromStore.load(), erosionSeconds, eroded / std::max(erosionSeconds, 1e-9));
+    }
+    printf("%s: %d chunks over %d levels, %d built and %d already there, %d horizon maps baked, %d write failures\n",
+           store->directory.c_str(), (int)keys.size(), lod.maxLevel + 1, built, kept.load(), baked.load(),
+           store->stats.writeFailures.load());
+    printf("%.2f s on %d threads, %.1f chunks/s, %.1f MB written\n", seconds, pool.size() + 1,
+           built / std::max(seconds, 1e-9), store->stats.bytesWritten.load() / 1048576.0);
+    return store->stats.writeFailures.load() ? 1 : 0;
+}
@@ -0,0 +1,58 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <OpenGP/types.h>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Matrices.h"
+
+// a tiny registry so that every bench_*.cpp file can add its own benchmarks
+// run `bench` for all of them or `bench <substring>` to select some by name
+struct Benchmark {
+    std::string name;
+    std::function<void()> run;
+};
+
+inline std::vector<Benchmark> &benchmarks() {
+    static std::vector<Benchmark> registry;
+    return registry;
+}
+
+struct BenchmarkRegistrar {
+    BenchmarkRegistrar(const char *name, std::function<void()> run) {
+        benchmarks().push_back(Benchmark{ name, run });
+    }
+};
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static BenchmarkRegistrar name##_registrar(#name, name); \
+    static void name()
+
+inline double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// results are printed as "benchmark/case: value unit" so they are easy to grep and diff between runs
+inline void report(const std::string &name, double value, const char *unit) {
+    std::cout << name << ": " << value << " " << unit << std::endl;
+}
+
+// benchmarks that check what they measure report their failures with this, and bench exits with 1 when any of
+// them is not 0. The checks that do not need the timings are in tests/, run by ctest
+inline int &benchmarkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline void reportFailures(const std::string &name, int failures, const char *unit) {
+    report(name, failures, unit);
+    benchmarkFailures() += failures;
+}
+
+#endif
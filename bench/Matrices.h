@@ -0,0 +1,33 @@
+#ifndef MATRICES_H
+#define MATRICES_H
+
+#include <OpenGP/types.h>
+#include <cmath>
+
+// the same matrices as OpenGP::perspective and OpenGP::lookAt, written out so this runs without GL headers
+inline OpenGP::Mat4x4 perspectiveMatrix(float fovy, float aspect, float near, float far) {
+    float f = 1.0f / std::tan(fovy * (float)M_PI / 360.0f);
+    OpenGP::Mat4x4 m = OpenGP::Mat4x4::Zero();
+    m(0, 0) = f / aspect;
+    m(1, 1) = f;
+    m(2, 2) = (far + near) / (near - far);
+    m(2, 3) = 2.0f * far * near / (near - far);
+    m(3, 2) = -1.0f;
+    return m;
+}
+
+inline OpenGP::Mat4x4 lookAtMatrix(const OpenGP::Vec3 &eye, const OpenGP::Vec3 &center, const OpenGP::Vec3 &up) {
+    OpenGP::Vec3 f = (center - eye).normalized();
+    OpenGP::Vec3 s = f.cross(up).normalized();
+    OpenGP::Vec3 u = s.cross(f);
+    OpenGP::Mat4x4 m = OpenGP::Mat4x4::Identity();
+    m.block<1, 3>(0, 0) = s.transpose();
+    m.block<1, 3>(1, 0) = u.transpose();
+    m.block<1, 3>(2, 0) = -f.transpose();
+    m(0, 3) = -s.dot(eye);
+    m(1, 3) = -u.dot(eye);
+    m(2, 3) = f.dot(eye);
+    return m;
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef RAYS_H
+#define RAYS_H
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "HeightPyramid.h"
+
+// the rays of the raycast benchmarks and of tests/test_raycast.cpp, and the brute force march they are compared with
+
+// the spacing of the level 0 grid of the terrain, size_grid_x / 1024
+const float raySpacing = 20.0f / 1024.0f;
+
+// what the pyramid replaces: fixed steps along the ray, each one a height query, then a bisection of the step
+// where the ray went under the surface
+inline RayHit marchRay(const HeightPyramid &pyramid, const Ray &ray, float step) {
+    RayHit result;
+    OpenGP::Vec3 d = ray.direction.normalized();
+    float previous = 0.0f;
+    for (float t = 0.0f; t <= ray.maxDistance; t += step) {
+        OpenGP::Vec3 p = ray.origin + t * d;
+        if (p.z() > pyramid.height(p.x(), p.y())) {
+            previous = t;
+            continue;
+        }
+        float a = previous, b = t;
+        for (int k = 0; k < 20; ++k) {
+            float m = 0.5f * (a + b);
+            OpenGP::Vec3 q = ray.origin + m * d;
+            if (q.z() > pyramid.height(q.x(), q.y())) a = m;
+            else b = m;
+        }
+        result.hit = true;
+        result.distance = b;
+        result.position = ray.origin + b * d;
+        return result;
+    }
+    return result;
+}
+
+// rays like the ones of picking: the views of 16 cameras around the island, a little above the ground and
+// looking mostly down, out to where the fog hides everything (LODSettings::viewRadius)
+inline std::vector<Ray> cameraRays(const HeightPyramid &pyramid, int count, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> above(0.3f, 3.0f), yaw(-0.7f, 0.7f), pitch(-0.6f, 0.05f);
+    std::vector<Ray> rays(count);
+    for (int k = 0; k < count; ++k) {
+        int camera = k * 16 / count;
+        float angle = camera * 6.2831853f / 16.0f;
+        float x = 6.0f * std::sin(angle), y = -6.0f * std::cos(angle);
+        // towards the centre, like the scripted camera of the headless harness
+        float a = angle + 3.1415927f + yaw(rng), b = pitch(rng);
+        Ray &ray = rays[k];
+        ray.origin = OpenGP::Vec3(x, y, pyramid.height(x, y) + above(rng));
+        ray.direction = OpenGP::Vec3(std::sin(a) * std::cos(b), std::cos(a) * std::cos(b), std::sin(b));
+        ray.maxDistance = 30.0f;
+    }
+    return rays;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#include "Bench.h"
+
+#include <random>
+
+#include "Camera.h"
+
+// the view and projection matrices of Camera for scripted angles, positions and fields of view, the work of every
+// frame and of every reflection pass (tests/test_camera.cpp checks them against the written out ones)
+BENCHMARK(camera_matrices) {
+    const int count = 1 << 16;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<CameraState> states(count);
+    for (CameraState &state : states) {
+        state.position = OpenGP::Vec3(100.0f * unit(random) - 50.0f, 100.0f * unit(random) - 50.0f, 4.0f * unit(random));
+        state.yaw = 2.0f * (float)M_PI * unit(random);
+        state.pitch = 2.8f * unit(random) - 1.4f;
+        state.fov = 40.0f + 60.0f * unit(random);
+    }
+
+    Camera camera(1920, 1080);
+    OpenGP::Mat4x4 sum = OpenGP::Mat4x4::Zero();
+    auto start = std::chrono::steady_clock::now();
+    for (const CameraState &state : states) {
+        camera.setState(state);
+        sum += camera.projectionMatrix() * camera.viewMatrix();
+    }
+    double seconds = secondsSince(start);
+    static volatile float sink;
+    sink = sum(0, 0);
+
+    report("camera_matrices/per_second", count / seconds, "view and projection pairs/s");
+}
@@ -0,0 +1,95 @@
+#include "Bench.h"
+
+#include <climits>
+
+#include "ChunkData.h"
+#include "TerrainLOD.h"
+
+// CPU cost of one streamed terrain chunk (heights, normals and bounds), what a worker thread pays per tile
+BENCHMARK(chunk_build) {
+    HeightfieldGenerator generator;
+    const int quads = 64;
+    const float spacing = 20.0f / 1024.0f;
+    const int count = 64;
+
+    ChunkData chunk;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        ChunkKey key = { 0, i % 8, i / 8 };
+        buildChunk(generator, key, quads, spacing, chunk);
+    }
+    double seconds = secondsSince(start);
+    report("chunk_build/per_chunk", 1000.0 * seconds / count, "ms");
+    report("chunk_build/per_core", count / seconds, "chunks/s");
+
+    start = std::chrono::steady_clock::now();
+    std::vector<unsigned int> indices = gridStripIndices(quads, UINT_MAX);
+    report("chunk_build/strip_indices", 1000.0 * secondsSince(start), "ms");
+    report("chunk_build/strip_indices_count", (double)indices.size(), "indices");
+}
+
+// the 6 byte TerrainVertex against the Vec3 position and Vec3 normal the chunks used to upload, with the 16 bit
+// indices against 32 bit ones: the bytes of one chunk and of everything resident around a camera, and how far the
+// quantized heights and normals are from the generator (tests/test_chunks.cpp checks that the edges of neighbouring
+// chunks still meet)
+BENCHMARK(chunk_layout) {
+    HeightfieldGenerator generator;
+    LODSettings settings; // the ones of Terrain
+    settings.quads = 64;
+    settings.spacing = 20.0f / 1024.0f;
+    settings.maxLevel = 4;
+    settings.viewRadius = 30.0f;
+    const int quads = settings.quads, cols = quads + 1;
+
+    int clamped = 0, chunks = 0;
+    float heightError = 0.0f, normalError = 0.0f, span = 0.0f;
+    std::vector<float> heights(cols * cols), normals(3 * cols * cols);
+    for (int level = 0; level <= settings.maxLevel; ++level) {
+        float spacing = levelSpacing(settings.spacing, level);
+        for (int y = -2; y < 2; ++y) {
+            for (int x = -2; x < 2; ++x) {
+                ChunkData chunk;
+                buildChunk(generator, ChunkKey{ level, x, y }, quads, settings.spacing, chunk);
+                generator.generateGrid(x * quads, y * quads, cols, cols, spacing, heights.data(), normals.data());
+                ++chunks;
+                clamped += chunk.clampedHeights;
+                span = std::max(span, chunk.maxHeight - chunk.minHeight);
+                for (int k = 0; k < cols * cols; ++k) {
+                    const TerrainVertex &v = chunk.vertices[k];
+                    float h = decodeHeight(chunk.heightBase, v.height);
+                    heightError = std::max(heightError, std::abs(h - heights[k]));
+                    OpenGP::Vec3 n(normals[3 * k], normals[3 * k + 1], normals[3 * k + 2]);
+                    float cosine = std::min(1.0f, decodeNormal(v.normal).dot(n.normalized()));
+                    normalError = std::max(normalError, std::acos(cosine) * 180.0f / (float)M_PI);
+                }
+            }
+        }
+    }
+    report("chunk_layout/checked_chunks", chunks, "chunks");
+    report("chunk_layout/max_height_error", heightError, "units");
+    report("chunk_layout/max_normal_error", normalError, "degrees");
+    report("chunk_layout/max_chunk_span", span, "units");
+    report("chunk_layout/clamped_heights", clamped, "vertices");
+
+    size_t oldVertex = 2 * sizeof(OpenGP::Vec3), newVertex = sizeof(TerrainVertex);
+    size_t indices = 0;
+    for (int mask = 0; mask < numStitchMasks; ++mask) indices += stitchedStripIndices(quads, mask, 0xFFFF).size();
+    report("chunk_layout/vertex_bytes_vec3", (double)oldVertex, "bytes");
+    report("chunk_layout/vertex_bytes_packed", (double)newVertex, "bytes");
+    report("chunk_layout/chunk_bytes_vec3", (double)(oldVertex * cols * cols), "bytes");
+    report("chunk_layout/chunk_bytes_packed", (double)(newVertex * cols * cols), "bytes");
+    report("chunk_layout/index_bytes_32", (double)(indices * sizeof(unsigned int)), "bytes");
+    report("chunk_layout/index_bytes_16", (double)(indices * sizeof(uint16_t)), "bytes");
+
+    // what is resident once the camera has streamed in its surroundings
+    std::vector<ChunkKey> wanted;
+    std::vector<SelectedChunk> selected;
+    selectChunks(settings, OpenGP::Vec3(3.7f, -12.2f, 1.5f), [](const ChunkKey&) { return true; }, wanted, selected);
+    size_t vertices = selected.size() * cols * cols;
+    double before = (double)(vertices * oldVertex + indices * sizeof(unsigned int));
+    double after = (double)(vertices * newVertex + indices * sizeof(uint16_t));
+    report("chunk_layout/view_chunks", (double)selected.size(), "chunks");
+    report("chunk_layout/view_bytes_vec3", before, "bytes");
+    report("chunk_layout/view_bytes_packed", after, "bytes");
+    report("chunk_layout/view_reduction", before / after, "x");
+}
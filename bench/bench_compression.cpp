@@ -0,0 +1,53 @@
+#include "Bench.h"
+
+#include "BlockCompression.h"
+#include "ImageCache.h"
+#include "TextureContainer.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+
+static double compressionPsnr(const unsigned char *a, const unsigned char *b, size_t pixels, bool alpha) {
+    double error = 0.0;
+    size_t count = 0;
+    for (size_t k = 0; k < 4 * pixels; ++k) {
+        if (!alpha && k % 4 == 3) continue;
+        double d = (double)a[k] - b[k];
+        error += d * d;
+        ++count;
+    }
+    return error == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 * count / error);
+}
+
+// what the baker does per level: encode throughput on one thread and on the pool, and the error on real textures
+BENCHMARK(texture_compression) {
+    ThreadPool pool;
+    const char *files[] = { "grass.png", "snow.png", "miramar_up.png" };
+    for (const char *name : files) {
+        TextureImage image;
+        if (!decodeImage(std::string(VIRTUALWORLD_TEXTURE_DIR) + "/" + name, false, image)) {
+            report(std::string("texture_compression/") + name + "/missing", 1, "");
+            continue;
+        }
+        size_t pixels = (size_t)image.width * image.height;
+        std::vector<unsigned char> decoded(4 * pixels);
+        for (BlockFormat format : { BLOCK_BC1, BLOCK_BC3 }) {
+            std::string prefix = std::string("texture_compression/") + name + (format == BLOCK_BC1 ? "/bc1" : "/bc3");
+            std::vector<unsigned char> blocks(compressedSize(format, image.width, image.height));
+
+            auto start = std::chrono::steady_clock::now();
+            compressImage(image.pixels, image.width, image.height, format, blocks.data());
+            report(prefix + "/serial", pixels / 1e6 / secondsSince(start), "Mpixels/s");
+
+            start = std::chrono::steady_clock::now();
+            compressImage(image.pixels, image.width, image.height, format, blocks.data(), &pool);
+            report(prefix + "/pool", pixels / 1e6 / secondsSince(start), "Mpixels/s");
+
+            decompressImage(blocks.data(), image.width, image.height, format, decoded.data());
+            report(prefix + "/psnr", compressionPsnr(image.pixels, decoded.data(), pixels, format == BLOCK_BC3), "dB");
+        }
+        report(std::string("texture_compression/") + name + "/ratio",
+               (double)(4 * pixels) / compressedSize(BLOCK_BC1, image.width, image.height), "x");
+    }
+    report("texture_compression/threads", pool.size(), "threads");
+}
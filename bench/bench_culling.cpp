@@ -0,0 +1,32 @@
+#include "Bench.h"
+
+#include "Frustum.h"
+#include "TerrainLOD.h"
+
+// what share of the LOD selection each pass keeps for a camera looking along the ground
+BENCHMARK(culling_selection) {
+    LODSettings settings;
+    settings.viewRadius = 30.0f;
+    auto everything = [](const ChunkKey&) { return true; };
+    std::vector<ChunkKey> wanted;
+    std::vector<SelectedChunk> selected;
+    OpenGP::Vec3 eye(3.7f, -12.2f, 1.5f);
+    selectChunks(settings, eye, everything, wanted, selected);
+
+    OpenGP::Mat4x4 projection = perspectiveMatrix(45.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+    Frustum frustum(projection * lookAtMatrix(eye, eye + OpenGP::Vec3(1, 0.3f, -0.2f), OpenGP::Vec3(0, 0, 1)));
+
+    auto start = std::chrono::steady_clock::now();
+    int drawn = 0;
+    for (const SelectedChunk &s : selected) {
+        OpenGP::Vec3 lo, hi;
+        // a flat guess for the heights, the real ones come from the built chunk
+        chunkBox(settings, s.key, -1.0f, 1.0f, lo, hi);
+        if (frustum.intersects(lo, hi)) ++drawn;
+    }
+    double seconds = secondsSince(start);
+
+    report("culling_selection/chunks", (double)selected.size(), "chunks");
+    report("culling_selection/drawn", drawn, "chunks");
+    report("culling_selection/cull_time", 1e6 * seconds, "us");
+}
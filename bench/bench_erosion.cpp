@@ -0,0 +1,76 @@
+#include "Bench.h"
+
+#include <memory>
+#include <thread>
+
+#include "Erosion.h"
+#include "TerrainLOD.h"
+
+// the tiles of a region eroded on one core, then over every core: droplet steps are the iterations of the erosion.
+// Also how much it changes the terrain, the change has to stay within maxChange
+BENCHMARK(erosion_rate) {
+    LODSettings lod; // the ones of Terrain
+    HeightfieldParams params;
+    ErosionParams erosion;
+    HeightfieldGenerator generator(nullptr, params);
+    float spacing = lod.spacing * erosion.spacingFactor;
+
+    const int tiles = 4;
+    ErosionStats stats;
+    std::vector<ErosionTile> eroded(tiles);
+    auto start = std::chrono::steady_clock::now();
+    for (int k = 0; k < tiles; ++k) erodeTile(generator, erosion, spacing, k % 2, k / 2, eroded[k], &stats);
+    double seconds = secondsSince(start);
+
+    report("erosion_rate/tiles_per_core", tiles / seconds, "tiles/s");
+    report("erosion_rate/droplets_per_core", stats.droplets / seconds, "droplets/s");
+    report("erosion_rate/steps_per_core", stats.steps / seconds, "steps/s");
+    report("erosion_rate/steps_per_droplet", (double)stats.steps / stats.droplets, "steps");
+
+    // one tile per task, the tiles do not share anything
+    ThreadPool pool;
+    int parallelTiles = 4 * (pool.size() + 1);
+    std::vector<ErosionTile> parallel(parallelTiles);
+    start = std::chrono::steady_clock::now();
+    pool.parallelFor(0, parallelTiles, 1, [&](int begin, int end) {
+        for (int k = begin; k < end; ++k) erodeTile(generator, erosion, spacing, k % 4, k / 4, parallel[k]);
+    });
+    double parallelSeconds = secondsSince(start);
+    report("erosion_rate/tiles_all_cores", parallelTiles / parallelSeconds, "tiles/s");
+    report("erosion_rate/threads", pool.size() + 1, "threads");
+
+    float maxChange = 0.0f;
+    double sumChange = 0.0, sumWetness = 0.0;
+    size_t samples = 0;
+    for (const ErosionTile &tile : eroded) {
+        for (size_t k = 0; k < tile.delta.size(); ++k) {
+            maxChange = std::max(maxChange, std::abs(tile.delta[k]));
+            sumChange += std::abs(tile.delta[k]);
+            sumWetness += tile.wetness[k];
+        }
+        samples += tile.delta.size();
+    }
+    report("erosion_rate/max_change", maxChange, "units");
+    report("erosion_rate/mean_change", sumChange / samples, "units");
+    report("erosion_rate/mean_wetness", sumWetness / samples, "");
+}
+
+// what making the eroded world around the camera costs on 1, 4 and every thread (the caller and pools of 0, 3 and
+// N - 1 workers); tests/test_erosion.cpp checks that they all make the same world
+BENCHMARK(erosion_prepare_threads) {
+    LODSettings lod;
+    HeightfieldParams params;
+    ErosionParams erosion;
+    unsigned int hardware = std::max(2u, std::thread::hardware_concurrency());
+    unsigned int workers[3] = { 0, 3, hardware - 1 };
+    const char *names[3] = { "1_thread", "4_threads", "all_threads" };
+    const int x0 = -300, y0 = -300, cols = 600; // level 0 samples, a few tiles each way
+    for (int run = 0; run < 3; ++run) {
+        ErosionField field(params, erosion, lod.spacing);
+        std::unique_ptr<ThreadPool> pool(workers[run] ? new ThreadPool(workers[run]) : nullptr);
+        auto start = std::chrono::steady_clock::now();
+        field.prepare(x0 * lod.spacing, y0 * lod.spacing, (x0 + cols) * lod.spacing, (y0 + cols) * lod.spacing, pool.get());
+        report(std::string("erosion_prepare_threads/") + names[run], 1000.0 * secondsSince(start), "ms");
+    }
+    report("erosion_prepare_threads/threads", hardware, "threads");
+}
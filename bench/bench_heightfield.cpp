@@ -0,0 +1,52 @@
+#include "Bench.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "HeightfieldGenerator.h"
+
+BENCHMARK(heightfield_single_thread) {
+    HeightfieldGenerator generator;
+    const int side = 512;
+    std::vector<float> heights(side * side);
+
+    // scalar reference first, then the vectorized kernel on the same grid
+    std::vector<float> xs(side), ys(side);
+    for (int i = 0; i < side; ++i) xs[i] = (float)i * (20.0f / 1024.0f);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int j = 0; j < side; ++j) {
+        std::fill(ys.begin(), ys.end(), (float)j * (20.0f / 1024.0f));
+        generator.heightsScalar(xs.data(), ys.data(), &heights[j * side], side);
+    }
+    report("heightfield_single_thread/scalar", side * side / secondsSince(start), "samples/s");
+
+    start = std::chrono::steady_clock::now();
+    generator.generateGrid(0, 0, side, side, 20.0f / 1024.0f, heights.data());
+    report(std::string("heightfield_single_thread/") + HeightfieldGenerator::kernelName(), side * side / secondsSince(start), "samples/s");
+}
+
+// a full 1024x1024 grid, the size of the mesh Terrain builds, with heights and normals
+BENCHMARK(heightfield_grid_threads) {
+    const int side = 1024;
+    std::vector<float> heights(side * side), normals(3 * side * side);
+
+    unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threadCounts = { 1, 2, 4, hardware };
+    std::sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+    for (unsigned int threads : threadCounts) {
+        if (threads > hardware) continue;
+        // the calling thread helps in parallelFor, so threads - 1 workers give threads cores
+        ThreadPool pool(std::max(1u, threads - 1));
+        HeightfieldGenerator generator(threads > 1 ? &pool : nullptr);
+
+        auto start = std::chrono::steady_clock::now();
+        generator.generateGrid(-side / 2, -side / 2, side, side, 20.0f / 1024.0f, heights.data(), normals.data());
+        double seconds = secondsSince(start);
+
+        std::string name = "heightfield_grid_threads/" + std::to_string(threads);
+        report(name + "/time", 1000.0 * seconds, "ms");
+        report(name + "/per_core", side * side / seconds / threads, "samples/s");
+    }
+}
@@ -0,0 +1,66 @@
+#include "Bench.h"
+
+#include "ChunkData.h"
+#include "Erosion.h"
+#include "Horizon.h"
+#include "TerrainLOD.h"
+
+namespace {
+
+// the chunks the benchmarks bake: levels 0 and 1 around the origin, the ones near the camera
+std::vector<ChunkKey> horizonChunks() {
+    std::vector<ChunkKey> keys;
+    for (int y = -2; y < 2; ++y) {
+        for (int x = -2; x < 2; ++x) keys.push_back(ChunkKey{ 0, x, y });
+    }
+    for (int y = -1; y < 1; ++y) {
+        for (int x = -1; x < 1; ++x) keys.push_back(ChunkKey{ 1, x, y });
+    }
+    return keys;
+}
+
+} // namespace
+
+// the horizon maps of the chunks of the eroded world baked on one core with 4, 8 and 16 directions, against the
+// time it takes to build the chunks they belong to, then 8 directions over every core (one chunk per task). The
+// erosion tiles under all of it are made first, they are not part of either
+BENCHMARK(horizon_bake) {
+    LODSettings lod; // the ones of Terrain
+    HeightfieldParams params;
+    HeightfieldGenerator generator(nullptr, params);
+    ErosionField erosion(params, ErosionParams(), lod.spacing);
+    erosion.prepare(-6.0f, -6.0f, 6.0f, 6.0f); // as far as the 16 directions look
+    std::vector<ChunkKey> keys = horizonChunks();
+    std::vector<ChunkData> chunks(keys.size());
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t k = 0; k < keys.size(); ++k) buildChunk(generator, erosion, keys[k], lod.quads, lod.spacing, chunks[k]);
+    report("horizon_bake/build_chunk", 1000.0 * secondsSince(start) / keys.size(), "ms/tile");
+
+    const int directionCounts[3] = { 4, 8, 16 };
+    for (int directions : directionCounts) {
+        HorizonParams horizons;
+        horizons.directions = directions;
+        start = std::chrono::steady_clock::now();
+        for (ChunkData &chunk : chunks) bakeHorizons(generator, &erosion, horizons, lod.quads, lod.spacing, chunk);
+        double seconds = secondsSince(start);
+        std::string name = "horizon_bake/directions_" + std::to_string(directions);
+        report(name, 1000.0 * seconds / keys.size(), "ms/tile");
+        report(name + "_bytes", (double)chunks[0].horizons.size(), "bytes/tile");
+    }
+
+    HorizonParams horizons;
+    ThreadPool pool;
+    int tasks = 4 * (pool.size() + 1);
+    start = std::chrono::steady_clock::now();
+    pool.parallelFor(0, tasks, 1, [&](int begin, int end) {
+        for (int k = begin; k < end; ++k) {
+            ChunkData chunk;
+            chunk.key = keys[k % keys.size()];
+            bakeHorizons(generator, &erosion, horizons, lod.quads, lod.spacing, chunk);
+        }
+    });
+    report("horizon_bake/all_cores", tasks / secondsSince(start), "tiles/s");
+    report("horizon_bake/threads", pool.size() + 1, "threads");
+    report("horizon_bake/kernel", 0.0, HeightfieldGenerator::kernelName());
+}
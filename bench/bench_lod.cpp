@@ -0,0 +1,39 @@
+#include "Bench.h"
+
+#include <climits>
+
+#include "TerrainLOD.h"
+
+// how the submitted triangles grow with the view distance (tests/test_lod.cpp checks that the seams are watertight)
+BENCHMARK(lod_selection) {
+    LODSettings settings;
+    auto everything = [](const ChunkKey&) { return true; };
+    std::vector<ChunkKey> wanted;
+    std::vector<SelectedChunk> selected;
+
+    int triangles[numStitchMasks];
+    for (int mask = 0; mask < numStitchMasks; ++mask) {
+        triangles[mask] = countStripTriangles(stitchedStripIndices(settings.quads, mask, UINT_MAX), UINT_MAX);
+    }
+
+    for (float radius : { 10.0f, 20.0f, 40.0f, 80.0f }) {
+        settings.viewRadius = radius;
+        settings.maxLevel = 6;
+        OpenGP::Vec3 camera(3.7f, -12.2f, 3.0f);
+
+        auto start = std::chrono::steady_clock::now();
+        selectChunks(settings, camera, everything, wanted, selected);
+        double seconds = secondsSince(start);
+
+        long long submitted = 0;
+        for (auto &chunk : selected) submitted += triangles[chunk.stitchMask];
+        // what a uniform level 0 grid over the same disc would cost
+        double uniform = M_PI * radius * radius / (settings.spacing * settings.spacing) * 2.0;
+
+        std::string name = "lod_selection/radius_" + std::to_string((int)radius);
+        report(name + "/chunks", (double)selected.size(), "chunks");
+        report(name + "/triangles", (double)submitted, "triangles");
+        report(name + "/uniform_triangles", uniform, "triangles");
+        report(name + "/select_time", 1e6 * seconds, "us");
+    }
+}
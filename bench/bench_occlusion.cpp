@@ -0,0 +1,145 @@
+#include "Bench.h"
+
+#include <climits>
+#include <limits>
+#include <unordered_map>
+
+#include "ChunkData.h"
+#include "Frustum.h"
+#include "Occlusion.h"
+#include "TerrainLOD.h"
+
+namespace {
+
+// the triangles of a built chunk as it is drawn: decoded heights and the strips of its stitch variant
+void forEachChunkTriangle(const LODSettings &settings, const ChunkData &chunk, int stitchMask,
+                          const std::function<void(const OpenGP::Vec3&, const OpenGP::Vec3&, const OpenGP::Vec3&)> &emit) {
+    int quads = settings.quads, cols = quads + 1;
+    float spacing = levelSpacing(settings.spacing, chunk.key.level);
+    auto vertex = [&](unsigned int k) {
+        int i = k % cols, j = k / cols;
+        return OpenGP::Vec3((chunk.key.x * quads + i) * spacing, (chunk.key.y * quads + j) * spacing,
+                            decodeHeight(chunk.heightBase, chunk.vertices[k].height));
+    };
+    std::vector<unsigned int> indices = stitchedStripIndices(quads, stitchMask, UINT_MAX);
+    forEachStripTriangle(indices, UINT_MAX, [&](unsigned int a, unsigned int b, unsigned int c) {
+        emit(vertex(a), vertex(b), vertex(c));
+    });
+}
+
+} // namespace
+
+// the terrain occluding itself for cameras low over the ground and higher up: the share of the chunks in the
+// frustum that the main pass would skip, what the buffer costs, and whether any skipped chunk would have shown.
+// The check rasterizes the chunks as they are drawn into a 640 x 360 depth buffer, a skipped chunk that is the
+// nearest at any pixel is a failure. The occluder grids also have to stay under the vertices of their chunk
+BENCHMARK(occlusion_terrain) {
+    HeightfieldGenerator generator;
+    LODSettings settings; // the ones of Terrain
+    settings.quads = 64;
+    settings.spacing = 20.0f / 1024.0f;
+    settings.maxLevel = 4;
+    settings.viewRadius = 30.0f;
+    const int quads = settings.quads, cols = quads + 1;
+
+    std::unordered_map<ChunkKey, ChunkData, ChunkKeyHash> built;
+    auto everything = [](const ChunkKey&) { return true; };
+    int failures = 0, aboveSurface = 0, frustumChunks = 0, culledChunks = 0, cameras = 0;
+    double occlusionSeconds = 0.0;
+
+    for (int view = 0; view < 8; ++view) {
+        // around the centre like the headless camera, every other one just over the ground
+        float angle = 0.8f * view;
+        OpenGP::Vec3 eye(6.0f * std::sin(angle), -6.0f * std::cos(angle), 0.0f);
+        float ground;
+        generator.generateGrid((int)std::floor(eye.x() / settings.spacing), (int)std::floor(eye.y() / settings.spacing),
+                               1, 1, settings.spacing, &ground);
+        eye.z() = ground + ((view & 1) ? 0.25f : 1.2f);
+        float yaw = angle + (float)M_PI, pitch = (view & 1) ? -0.05f : -0.25f;
+        OpenGP::Vec3 front(std::sin(yaw) * std::cos(pitch), std::cos(yaw) * std::cos(pitch), std::sin(pitch));
+        // the projection of Camera
+        OpenGP::Mat4x4 projectionView = perspectiveMatrix(80.0f, 16.0f / 9.0f, 0.1f, 60.0f) *
+                                        lookAtMatrix(eye, eye + front, OpenGP::Vec3(0, 0, 1));
+        ++cameras;
+
+        std::vector<ChunkKey> wanted;
+        std::vector<SelectedChunk> selected;
+        selectChunks(settings, eye, everything, wanted, selected);
+        Frustum frustum(projectionView);
+        std::vector<const SelectedChunk*> inFrustum;
+        for (const SelectedChunk &s : selected) {
+            if (!built.count(s.key)) buildChunk(generator, s.key, quads, settings.spacing, built[s.key]);
+            const ChunkData &chunk = built[s.key];
+            OpenGP::Vec3 lo, hi;
+            chunkBox(settings, s.key, chunk.minHeight, chunk.maxHeight, lo, hi);
+            if (frustum.intersects(lo, hi)) inFrustum.push_back(&s);
+        }
+        frustumChunks += (int)inFrustum.size();
+
+        // what Terrain::draw does for the main pass
+        OcclusionBuffer occlusion;
+        std::vector<const SelectedChunk*> culled;
+        auto start = std::chrono::steady_clock::now();
+        occlusion.begin(projectionView);
+        for (const SelectedChunk *s : inFrustum) {
+            float size = chunkSizeAt(settings, s->key.level);
+            occlusion.addHeightGrid(s->key.x * size, s->key.y * size, size / chunkOccluderCells, chunkOccluderCells,
+                                    built[s->key].occluderHeights.data());
+        }
+        occlusion.finish();
+        for (const SelectedChunk *s : inFrustum) {
+            const ChunkData &chunk = built[s->key];
+            OpenGP::Vec3 lo, hi;
+            chunkBox(settings, s->key, chunk.minHeight, chunk.maxHeight, lo, hi);
+            if (occlusion.occluded(lo, hi)) culled.push_back(s);
+        }
+        occlusionSeconds += secondsSince(start);
+        culledChunks += (int)culled.size();
+
+        // the depth of what is drawn, then every skipped chunk on its own against it
+        OcclusionBuffer reference(640, 360), single(640, 360);
+        reference.begin(projectionView);
+        for (const SelectedChunk *s : inFrustum) {
+            forEachChunkTriangle(settings, built[s->key], s->stitchMask,
+                [&](const OpenGP::Vec3 &a, const OpenGP::Vec3 &b, const OpenGP::Vec3 &c) { reference.addTriangle(a, b, c); });
+        }
+        for (const SelectedChunk *s : culled) {
+            single.begin(projectionView);
+            forEachChunkTriangle(settings, built[s->key], s->stitchMask,
+                [&](const OpenGP::Vec3 &a, const OpenGP::Vec3 &b, const OpenGP::Vec3 &c) { single.addTriangle(a, b, c); });
+            bool shows = false;
+            for (int y = 0; y < 360 && !shows; ++y) {
+                for (int x = 0; x < 640 && !shows; ++x) {
+                    float d = single.depthAt(x, y);
+                    shows = std::isfinite(d) && d <= reference.depthAt(x, y) * (1.0f + 1e-5f);
+                }
+            }
+            if (shows) ++failures;
+        }
+    }
+
+    // the corners of the grid interpolated at every vertex, with the diagonal OcclusionBuffer::addHeightGrid uses
+    int size = quads / chunkOccluderCells, occluderCols = chunkOccluderCells + 1;
+    for (auto &entry : built) {
+        const ChunkData &chunk = entry.second;
+        for (int j = 0; j < cols; ++j) {
+            for (int i = 0; i < cols; ++i) {
+                int ci = std::min(i / size, chunkOccluderCells - 1), cj = std::min(j / size, chunkOccluderCells - 1);
+                float u = (float)(i - ci * size) / size, v = (float)(j - cj * size) / size;
+                const std::vector<float> &h = chunk.occluderHeights;
+                float h00 = h[index(ci, cj, occluderCols)], h10 = h[index(ci + 1, cj, occluderCols)];
+                float h01 = h[index(ci, cj + 1, occluderCols)], h11 = h[index(ci + 1, cj + 1, occluderCols)];
+                float under = u + v <= 1.0f ? h00 + u * (h10 - h00) + v * (h01 - h00)
+                                            : h11 + (1.0f - u) * (h01 - h11) + (1.0f - v) * (h10 - h11);
+                if (under > decodeHeight(chunk.heightBase, chunk.vertices[index(i, j, cols)].height)) ++aboveSurface;
+            }
+        }
+    }
+
+    report("occlusion_terrain/chunks_in_frustum", (double)frustumChunks / cameras, "chunks/view");
+    report("occlusion_terrain/chunks_occluded", (double)culledChunks / cameras, "chunks/view");
+    report("occlusion_terrain/occluded_share", frustumChunks ? 100.0 * culledChunks / frustumChunks : 0.0, "%");
+    report("occlusion_terrain/time", 1000.0 * occlusionSeconds / cameras, "ms/view");
+    report("occlusion_terrain/grid_above_surface", aboveSurface, "vertices");
+    reportFailures("occlusion_terrain/failures", failures + aboveSurface, "chunks");
+}
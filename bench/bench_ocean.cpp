@@ -0,0 +1,35 @@
+#include "Bench.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "OceanSimulation.h"
+
+// what a step costs the workers at every size of the maps, the render thread only uploads the result
+BENCHMARK(ocean_step_threads) {
+    unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threadCounts = { 1, 2, 4, hardware };
+    std::sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+    for (int size : { 64, 128, 256, 512 }) {
+        OceanParams params;
+        params.size = size;
+        std::vector<float> displacement(3 * size * size);
+        std::vector<unsigned char> normals(4 * size * size);
+        for (unsigned int threads : threadCounts) {
+            if (threads > hardware) continue;
+            // the calling thread helps in parallelFor, so threads - 1 workers give threads cores
+            ThreadPool pool(std::max(1u, threads - 1));
+            OceanSimulation simulation(params, threads > 1 ? &pool : nullptr);
+            simulation.step(0.0f, displacement.data(), normals.data());
+
+            int steps = std::max(4, (1 << 20) / (size * size) * 4);
+            auto start = std::chrono::steady_clock::now();
+            for (int s = 0; s < steps; ++s) simulation.step(s / 60.0f, displacement.data(), normals.data());
+            double ms = 1000.0 * secondsSince(start) / steps;
+            report("ocean_step_threads/" + std::to_string(size) + "/" + std::to_string(threads), ms, "ms/step");
+        }
+    }
+    report("ocean_step_threads/kernel", 0.0, ocean::kernelName());
+}
@@ -0,0 +1,44 @@
+#include "Bench.h"
+
+#include "Rays.h"
+
+// rays per second of the pyramid on one thread and on the pool, against the fixed step march
+// the first pass generates the tiles on the way, the others read the same resident tiles: the 16 views need more
+// than the default cache holds, so it is raised to keep this about the walk and not the generation
+BENCHMARK(raycast_throughput) {
+    ThreadPool pool;
+    HeightPyramid pyramid(raySpacing, &pool);
+    pyramid.maxTiles = 1 << 14;
+    std::vector<Ray> rays = cameraRays(pyramid, 4096, 3);
+    std::vector<RayHit> hits(rays.size());
+    auto start = std::chrono::steady_clock::now();
+    pyramid.raycast(rays.data(), hits.data(), (int)rays.size());
+    report("raycast_throughput/pyramid_cold", rays.size() / secondsSince(start), "rays/s");
+    report("raycast_throughput/tiles", pyramid.residentTiles(), "tiles");
+
+    start = std::chrono::steady_clock::now();
+    for (size_t k = 0; k < rays.size(); ++k) hits[k] = pyramid.raycast(rays[k]);
+    report("raycast_throughput/pyramid_single", rays.size() / secondsSince(start), "rays/s");
+
+    start = std::chrono::steady_clock::now();
+    pyramid.raycast(rays.data(), hits.data(), (int)rays.size());
+    report("raycast_throughput/pyramid_batch", rays.size() / secondsSince(start), "rays/s");
+
+    // the march is slow enough that a quarter of the rays tells
+    size_t marched = rays.size() / 4;
+    start = std::chrono::steady_clock::now();
+    for (size_t k = 0; k < marched; ++k) hits[k] = marchRay(pyramid, rays[k], 0.5f * raySpacing);
+    report("raycast_throughput/march_single", marched / secondsSince(start), "rays/s");
+
+    std::vector<float> xs(1 << 16), ys(1 << 16), heights(1 << 16);
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+    for (size_t k = 0; k < xs.size(); ++k) {
+        xs[k] = position(rng);
+        ys[k] = position(rng);
+    }
+    start = std::chrono::steady_clock::now();
+    pyramid.heights(xs.data(), ys.data(), heights.data(), (int)xs.size());
+    report("raycast_throughput/heights_batch", xs.size() / secondsSince(start), "queries/s");
+    report("raycast_throughput/threads", pool.size(), "threads");
+}
@@ -0,0 +1,47 @@
+#include "Bench.h"
+
+#include "ScatterData.h"
+
+static const float scatterWater = 0.5f; // World::waterHeight
+
+// how fast the workers fill a field around a camera, and what the culling of a frame costs and keeps for cameras
+// looking along the ground. The second field is four times denser than the world to see how it scales
+BENCHMARK(scatter_throughput) {
+    for (int densityScale = 1; densityScale <= 4; densityScale *= 4) {
+        ScatterSettings settings(scatterWater);
+        for (ScatterRule &rule : settings.rules) rule.density *= densityScale;
+        std::string name = "scatter_throughput/x" + std::to_string(densityScale) + "/";
+
+        ScatterField field(settings);
+        OpenGP::Vec3 eye(3.7f, -6.2f, 1.5f);
+        auto start = std::chrono::steady_clock::now();
+        field.update(eye, true);
+        double seconds = secondsSince(start);
+        report(name + "fill", field.stats.tilesResident / seconds, "tiles/s");
+        report(name + "fill_instances", field.stats.instancesResident / seconds, "instances/s");
+        report(name + "resident", (double)field.stats.instancesResident, "instances");
+        report(name + "resident_bytes", (double)field.stats.residentBytes, "bytes");
+
+        OpenGP::Mat4x4 projection = perspectiveMatrix(80.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+        CullPlane none = clipPlane(OpenGP::Vec3(0, 0, -1), 1000.0f);
+        const int views = 16;
+        size_t meshes = 0, impostors = 0;
+        int visible = 0, culled = 0;
+        start = std::chrono::steady_clock::now();
+        for (int v = 0; v < views; ++v) {
+            float angle = v * 6.2831853f / views;
+            OpenGP::Vec3 ahead(std::cos(angle), std::sin(angle), -0.15f);
+            field.cull(projection * lookAtMatrix(eye, eye + ahead, OpenGP::Vec3(0, 0, 1)), eye, none);
+            meshes += field.stats.drawn(SCATTER_MESH);
+            impostors += field.stats.drawn(SCATTER_IMPOSTOR);
+            visible += field.stats.tilesVisible;
+            culled += field.stats.tilesCulledFrustum;
+        }
+        seconds = secondsSince(start);
+        report(name + "cull_time", 1e6 * seconds / views, "us");
+        report(name + "meshes_drawn", (double)meshes / views, "instances");
+        report(name + "impostors_drawn", (double)impostors / views, "instances");
+        report(name + "tiles_visible", (double)visible / views, "tiles");
+        report(name + "tiles_culled_frustum", (double)culled / views, "tiles");
+    }
+}
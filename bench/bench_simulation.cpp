@@ -0,0 +1,19 @@
+#include "Bench.h"
+
+#include "Simulation.h"
+
+// the cost of a tick of the camera motion with the ground clamp against the heightfield function
+BENCHMARK(simulation_step) {
+    CameraMotion motion;
+    motion.groundHeight = [](float x, float y) { return 0.2f * std::sin(x) * std::cos(y); };
+    std::vector<TickInput> inputs(1 << 20);
+    for (size_t k = 0; k < inputs.size(); ++k) {
+        inputs[k].keys = (uint32_t)(k >> 8) & (SIM_KEY_FORWARD | SIM_KEY_RIGHT);
+        inputs[k].lookX = (k % 64 == 0) ? 1.0f : 0.0f;
+    }
+    auto start = std::chrono::steady_clock::now();
+    CameraState end = Simulation::replay(motion, CameraState(), inputs, 1.0 / 120.0);
+    double seconds = secondsSince(start);
+    report("simulation_step/step", 1e9 * seconds / inputs.size(), "ns");
+    report("simulation_step/distance", end.position.norm(), "units");
+}
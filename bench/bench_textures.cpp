@@ -0,0 +1,85 @@
+#include "Bench.h"
+
+#include "ImageCache.h"
+#include "ThreadPool.h"
+
+// the files World loads at startup, the first six with their mip chain
+static const char *startupTextures[] = {
+    "grass.png", "rock.png", "sand.png", "snow.png", "water.png", "cloud.png",
+    "miramar_ft.png", "miramar_bk.png", "miramar_dn.png", "miramar_up.png", "miramar_rt.png", "miramar_lf.png"
+};
+static const int numStartupTextures = 12, numMipmapped = 6;
+
+// loads all of them the way TextureLoader does, returns the time in ms and how many came from the cache
+static double loadAll(ThreadPool *pool, const std::string &cacheDir, int &fromCache, size_t &bytes) {
+    std::vector<TextureImage> images(numStartupTextures);
+    auto load = [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            loadImage(std::string(VIRTUALWORLD_TEXTURE_DIR) + "/" + startupTextures[i], cacheDir, i < numMipmapped, images[i]);
+        }
+    };
+    auto start = std::chrono::steady_clock::now();
+    if (pool) pool->parallelFor(0, numStartupTextures, 1, load);
+    else load(0, numStartupTextures);
+    // touch every byte, a mapping costs nothing until it is read and the upload reads it all
+    unsigned int checksum = 0;
+    for (const TextureImage &image : images) {
+        for (size_t k = 0; k < image.bytes; k += 4096) checksum += image.pixels[k];
+    }
+    double ms = 1000.0 * secondsSince(start);
+    static volatile unsigned int sink;
+    sink = checksum;
+
+    fromCache = 0;
+    bytes = 0;
+    for (const TextureImage &image : images) {
+        fromCache += image.fromCache ? 1 : 0;
+        bytes += image.bytes;
+    }
+    return ms;
+}
+
+// cold start (decode, flip, mips and cache write) against warm start (mapping the cache) for the startup textures
+BENCHMARK(texture_startup) {
+    std::string cacheDir = "bench_texture_cache";
+    ThreadPool pool;
+    int fromCache;
+    size_t bytes;
+
+    // a stale cache from an earlier run would make the cold numbers warm
+    for (int i = 0; i < numStartupTextures; ++i) {
+        std::string file = std::string(VIRTUALWORLD_TEXTURE_DIR) + "/" + startupTextures[i];
+        remove(imageCachePath(cacheDir, file, i < numMipmapped).c_str());
+    }
+
+    report("texture_startup/serial_no_cache", loadAll(nullptr, "", fromCache, bytes), "ms");
+    report("texture_startup/cold", loadAll(&pool, cacheDir, fromCache, bytes), "ms");
+    report("texture_startup/cold_from_cache", fromCache, "textures");
+    report("texture_startup/warm", loadAll(&pool, cacheDir, fromCache, bytes), "ms");
+    report("texture_startup/warm_from_cache", fromCache, "textures");
+    report("texture_startup/bytes", (double)bytes, "bytes");
+    report("texture_startup/threads", pool.size(), "threads");
+}
+
+// LodePNG alone on one core, the files already in memory: MB/s of the PNG bytes read and of the RGBA8 pixels written
+BENCHMARK(texture_decode) {
+    std::vector<std::vector<unsigned char>> files(numStartupTextures);
+    size_t fileBytes = 0;
+    for (int i = 0; i < numStartupTextures; ++i) {
+        lodepng::load_file(files[i], std::string(VIRTUALWORLD_TEXTURE_DIR) + "/" + startupTextures[i]);
+        fileBytes += files[i].size();
+    }
+    size_t pixelBytes = 0;
+    int failures = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const std::vector<unsigned char> &file : files) {
+        std::vector<unsigned char> pixels;
+        unsigned width, height;
+        if (file.empty() || lodepng::decode(pixels, width, height, file) != 0) ++failures;
+        pixelBytes += pixels.size();
+    }
+    double seconds = secondsSince(start);
+    report("texture_decode/png", fileBytes / seconds / 1048576.0, "MB/s");
+    report("texture_decode/rgba", pixelBytes / seconds / 1048576.0, "MB/s");
+    reportFailures("texture_decode/failures", failures, "files");
+}
@@ -0,0 +1,97 @@
+#include "Bench.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "ChunkData.h"
+#include "TerrainLOD.h"
+#include "TileStore.h"
+
+namespace {
+
+void removeStore(const TileStore &store, const std::vector<ChunkKey> &keys) {
+    for (const ChunkKey &key : keys) remove(store.path(key).c_str());
+#ifndef _WIN32
+    rmdir(store.directory.c_str());
+    rmdir(store.directory.substr(0, store.directory.rfind('/')).c_str());
+#endif
+}
+
+// the pages of a tile out of the page cache, as after a reboot. Best effort: it only drops clean pages, so the
+// file is synced first
+void dropFromPageCache(const std::string &file) {
+#ifndef _WIN32
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#else
+    (void)file;
+#endif
+}
+
+} // namespace
+
+// a region generated, then read back from the store with its files in the page cache (warm) and after they were
+// dropped from it (cold). Every vertex is read, like the upload does. Generation is on one core to compare with
+// the reads, which are on one core too
+BENCHMARK(tilestore_read) {
+    LODSettings lod;
+    HeightfieldParams params;
+    HeightfieldGenerator generator(nullptr, params);
+    TileStore store("bench_tile_store", params, lod.quads, lod.spacing);
+
+    std::vector<ChunkKey> keys;
+    for (int y = -4; y < 4; ++y) {
+        for (int x = -4; x < 4; ++x) keys.push_back(ChunkKey{ 0, x, y });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (const ChunkKey &key : keys) {
+        ChunkData chunk;
+        buildChunk(generator, key, lod.quads, lod.spacing, chunk);
+        store.write(chunk);
+    }
+    double generateSeconds = secondsSince(start);
+    store.flush();
+    double bytes = (double)store.stats.bytesWritten;
+
+    int failures = store.stats.writeFailures;
+    auto readAll = [&]() {
+        unsigned int sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const ChunkKey &key : keys) {
+            ChunkData chunk;
+            if (!store.read(key, chunk)) {
+                ++failures;
+                continue;
+            }
+            const unsigned char *p = (const unsigned char*)chunk.vertexData();
+            for (size_t k = 0; k < chunk.vertexCount() * sizeof(TerrainVertex); ++k) sum += p[k];
+        }
+        double seconds = secondsSince(start);
+        volatile unsigned int sink = sum;
+        (void)sink;
+        return seconds;
+    };
+
+    readAll(); // so the first warm pass is not the one that maps the files for the first time
+    double warmSeconds = readAll();
+    for (const ChunkKey &key : keys) dropFromPageCache(store.path(key));
+    double coldSeconds = readAll();
+
+    report("tilestore_read/generate", keys.size() / generateSeconds, "chunks/s");
+    report("tilestore_read/cold", keys.size() / coldSeconds, "chunks/s");
+    report("tilestore_read/cold_throughput", bytes / coldSeconds / 1048576.0, "MB/s");
+    report("tilestore_read/warm", keys.size() / warmSeconds, "chunks/s");
+    report("tilestore_read/warm_throughput", bytes / warmSeconds / 1048576.0, "MB/s");
+    report("tilestore_read/tile_bytes", bytes / keys.size(), "bytes");
+    reportFailures("tilestore_read/failures", failures, "chunks");
+    removeStore(store, keys);
+}
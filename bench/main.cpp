@@ -0,0 +1,11 @@
+#include "Bench.h"
+
+int main(int argc, char** argv) {
+    std::string filter = argc > 1 ? argv[1] : "";
+    for (auto &benchmark : benchmarks()) {
+        if (benchmark.name.find(filter) == std::string::npos) continue;
+        std::cout << "== " << benchmark.name << std::endl;
+        benchmark.run();
+    }
+    return benchmarkFailures() ? 1 : 0;
+}
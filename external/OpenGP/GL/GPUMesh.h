@@ -117,6 +117,12 @@ public:
 
     }
 
+    /// the buffer of an attribute, null if it has none
+    VectorArrayBuffer *get_vbo(const std::string &name) {
+        auto it = vbos.find(name);
+        return it == vbos.end() ? nullptr : it->second.first.get();
+    }
+
     void set_vpoint(const std::vector<Vec3> &vpoint) {
         set_vbo<Vec3>("vposition", vpoint);
     }
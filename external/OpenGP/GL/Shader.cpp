@@ -9,6 +9,8 @@ namespace OpenGP {
 //=============================================================================
 
 void Shader::clear() {
+    for (GLuint ShaderID : pending) glDeleteShader(ShaderID);
+    pending.clear();
     glDeleteProgram(pid);
     _is_valid = false;
     pid = glCreateProgram();
@@ -70,6 +72,39 @@ bool OpenGP::Shader::has_uniform(const char* name) const {
     return uniforms.find(std::string(name)) != uniforms.end();
 }
 
+GLint OpenGP::Shader::uniform_location(const char* name) const {
+    auto it = uniforms.find(std::string(name));
+    return it == uniforms.end() ? -1 : (GLint)it->second;
+}
+
+/// GL ignores location -1, like the name setters ignore unknown names
+void OpenGP::Shader::set_uniform(GLint location, int scalar) {
+    assert( check_is_current() );
+    glUniform1i(location, scalar);
+}
+
+void OpenGP::Shader::set_uniform(GLint location, float scalar) {
+    assert( check_is_current() );
+    glUniform1f(location, scalar);
+}
+
+void OpenGP::Shader::set_uniform(GLint location, const Eigen::Vector3f& vector) {
+    assert( check_is_current() );
+    glUniform3fv(location, 1, vector.data());
+}
+
+void OpenGP::Shader::set_uniform(GLint location, const Eigen::Matrix4f& matrix) {
+    assert( check_is_current() );
+    glUniformMatrix4fv(location, 1, GL_FALSE, matrix.data());
+}
+
+bool OpenGP::Shader::bind_uniform_block(const char* name, GLuint binding) {
+    GLuint index = glGetUniformBlockIndex(pid, name);
+    if (index == GL_INVALID_INDEX) return false;
+    glUniformBlockBinding(pid, index, binding);
+    return true;
+}
+
 void Shader::set_attribute(const char* name, float value) {
     assert( check_is_current() );
     if (!has_attribute(name)) return;
@@ -217,8 +252,42 @@ bool OpenGP::Shader::add_shader_from_source(const char* code, GLenum type) {
 }
 
 bool OpenGP::Shader::link() {
+    link_async();
+    return finish_link();
+}
+
+void OpenGP::Shader::compile_async(const char* code, GLenum type) {
+    if (verbose) mDebug() << "Compiling shader";
+    GLuint ShaderID = glCreateShader(type);
+    glShaderSource(ShaderID, 1, &code, NULL);
+    glCompileShader(ShaderID);
+    /// the status is only asked for in finish_link(), asking now would wait for the compiler
+    glAttachShader(pid, ShaderID);
+    pending.push_back(ShaderID);
+}
+
+void OpenGP::Shader::link_async(bool retrievable) {
     if (verbose) mDebug() << "Linking shader program";
+    if (retrievable) glProgramParameteri(pid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(pid);
+}
+
+bool OpenGP::Shader::finish_link() {
+    /// the logs of the shaders compiled by compile_async()
+    for (GLuint ShaderID : pending) {
+        GLint Compiled = GL_FALSE;
+        glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Compiled);
+        if (!Compiled) {
+            int InfoLogLength;
+            glGetShaderiv(ShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+            std::vector<char> ShaderErrorMessage( std::max(InfoLogLength, int(1)) );
+            glGetShaderInfoLog(ShaderID, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+            mDebug() << std::string(&ShaderErrorMessage[0]);
+        }
+        glDetachShader(pid, ShaderID);
+        glDeleteShader(ShaderID);
+    }
+    pending.clear();
 
     /// Check the program
     GLint Success = GL_FALSE;
@@ -230,35 +299,56 @@ bool OpenGP::Shader::link() {
         glGetProgramInfoLog(pid, InfoLogLength, NULL, &ProgramErrorMessage[0]);
         mDebug() << "Failed: " << &ProgramErrorMessage[0];
     } else {
+        introspect();
+    }
+
+    return Success;
+}
 
-        uniforms.clear();
-        attributes.clear();
+bool OpenGP::Shader::load_binary(GLenum format, const void* data, GLsizei length) {
+    glProgramBinary(pid, format, data, length);
+    GLint Success = GL_FALSE;
+    glGetProgramiv(pid, GL_LINK_STATUS, &Success);
+    if (Success) introspect();
+    return Success;
+}
 
-        _is_valid = true;
+bool OpenGP::Shader::get_binary(std::vector<char>& data, GLenum& format) const {
+    GLint length = 0;
+    glGetProgramiv(pid, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return false;
+    data.resize(length);
+    GLsizei written = 0;
+    glGetProgramBinary(pid, length, &written, &format, data.data());
+    data.resize(written);
+    return written > 0;
+}
 
-        GLchar buffer[128];
+void OpenGP::Shader::introspect() {
+    uniforms.clear();
+    attributes.clear();
 
-        GLint attribs_count, attrib_size, attrib_location;
-        GLenum attrib_type;
-        glGetProgramiv(pid, GL_ACTIVE_ATTRIBUTES, &attribs_count);
-        for (GLint i = 0;i < attribs_count;i++) {
-            glGetActiveAttrib(pid, i, 128, nullptr, &attrib_size, &attrib_type, buffer);
-            attrib_location = glGetAttribLocation(pid, buffer);
-            attributes[std::string(buffer)] = attrib_location;
-        }
+    _is_valid = true;
 
-        GLint uniforms_count, uniform_size, uniform_location;
-        GLenum uniform_type;
-        glGetProgramiv(pid, GL_ACTIVE_UNIFORMS, &uniforms_count);
-        for (GLint i = 0;i < uniforms_count;i++) {
-            glGetActiveUniform(pid, i, 128, nullptr, &uniform_size, &uniform_type, buffer);
-            uniform_location = glGetUniformLocation(pid, buffer);
-            uniforms[std::string(buffer)] = uniform_location;
-        }
+    GLchar buffer[128];
 
+    GLint attribs_count, attrib_size, attrib_location;
+    GLenum attrib_type;
+    glGetProgramiv(pid, GL_ACTIVE_ATTRIBUTES, &attribs_count);
+    for (GLint i = 0;i < attribs_count;i++) {
+        glGetActiveAttrib(pid, i, 128, nullptr, &attrib_size, &attrib_type, buffer);
+        attrib_location = glGetAttribLocation(pid, buffer);
+        attributes[std::string(buffer)] = attrib_location;
     }
 
-    return Success;
+    GLint uniforms_count, uniform_size, uniform_location;
+    GLenum uniform_type;
+    glGetProgramiv(pid, GL_ACTIVE_UNIFORMS, &uniforms_count);
+    for (GLint i = 0;i < uniforms_count;i++) {
+        glGetActiveUniform(pid, i, 128, nullptr, &uniform_size, &uniform_type, buffer);
+        uniform_location = glGetUniformLocation(pid, buffer);
+        uniforms[std::string(buffer)] = uniform_location;
+    }
 }
 
 //=============================================================================
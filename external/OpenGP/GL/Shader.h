@@ -6,6 +6,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <Eigen/Dense>
 #include <OpenGP/GL/gl.h>
@@ -35,6 +36,7 @@ private:
     bool _is_valid = false;
     std::unordered_map<std::string, GLuint> attributes;
     std::unordered_map<std::string, GLuint> uniforms;
+    std::vector<GLuint> pending; ///< compiled without waiting, checked by finish_link()
 public:
     bool verbose = false; ///< prints messages
 /// @}
@@ -46,7 +48,10 @@ public:
     Shader(const Shader&) = delete;
     Shader &operator=(const Shader&) = delete;
 
-    ~Shader() { glDeleteProgram(pid); }
+    ~Shader() {
+        for (GLuint id : pending) glDeleteShader(id);
+        glDeleteProgram(pid);
+    }
 
     GLuint programId() const { return pid; }
 
@@ -84,6 +89,24 @@ public:
     HEADERONLY_INLINE bool link();
 /// @}
 
+/// @{ compile and link without waiting: the driver may work on the program in the background (on its own threads
+/// with GL_KHR_parallel_shader_compile) until finish_link() asks for the result
+public:
+    HEADERONLY_INLINE void compile_async(const char* code, GLenum type);
+    HEADERONLY_INLINE void link_async(bool retrievable = false); ///< retrievable: get_binary() will be called
+    HEADERONLY_INLINE bool finish_link();
+/// @}
+
+/// @{ program binaries (GL 4.1 / ARB_get_program_binary)
+public:
+    /// false if the driver rejects the binary, e.g. after an update, compile the sources then
+    HEADERONLY_INLINE bool load_binary(GLenum format, const void* data, GLsizei length);
+    HEADERONLY_INLINE bool get_binary(std::vector<char>& data, GLenum& format) const;
+/// @}
+
+private:
+    HEADERONLY_INLINE void introspect();
+
 /// @{ uniforms setters
 public:
     HEADERONLY_INLINE void set_uniform(const char* name, int scalar);
@@ -102,6 +125,21 @@ public:
 
     HEADERONLY_INLINE bool has_uniform(const char* name) const;
 
+/// @{ cached locations: look a uniform up once, then set it without hashing its name on every draw
+public:
+    HEADERONLY_INLINE GLint uniform_location(const char* name) const; ///< -1 if the program has no such uniform
+    HEADERONLY_INLINE void set_uniform(GLint location, int scalar);
+    HEADERONLY_INLINE void set_uniform(GLint location, float scalar);
+    HEADERONLY_INLINE void set_uniform(GLint location, const Eigen::Vector3f& vector);
+    HEADERONLY_INLINE void set_uniform(GLint location, const Eigen::Matrix4f& matrix);
+/// @}
+
+/// @{ uniform blocks
+public:
+    /// the block reads from the buffer bound at this index of GL_UNIFORM_BUFFER, false if the program has no such block
+    HEADERONLY_INLINE bool bind_uniform_block(const char* name, GLuint binding);
+/// @}
+
 /// @{ setters for *constant* vertex attributes
 public:
     HEADERONLY_INLINE void set_attribute(const char* name, float value);
@@ -77,7 +77,7 @@ public:
     GenericTexture &operator=(const GenericTexture&) = delete;
 
     virtual ~GenericTexture() {
-        glGenTextures(1, &_id);
+        glDeleteTextures(1, &_id);
     }
 
     void bind() const { glBindTexture(GL_TEXTURE_2D, _id); }
@@ -205,6 +205,7 @@ using RGBA8Texture = Texture<GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE>;
 using RGB8Texture = Texture<GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE>;
 using RGB32FTexture = Texture<GL_RGB32F, GL_RGB, GL_FLOAT>;
 using R32FTexture = Texture<GL_R32F, GL_RED, GL_FLOAT>;
+using R8Texture = Texture<GL_R8, GL_RED, GL_UNSIGNED_BYTE>;
 using D16Texture = Texture<GL_DEPTH_COMPONENT, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT>;
 
 //=============================================================================
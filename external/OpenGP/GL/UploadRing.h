@@ -0,0 +1,261 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <OpenGP/GL/gl.h>
+#include <OpenGP/GL/Buffer.h>
+#include <OpenGP/GL/Texture.h>
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// What the ring did, the frame_* members are reset by begin_frame
+struct UploadRingStats {
+    bool persistent = false;   ///< glBufferStorage, otherwise the glBufferSubData fallback
+    size_t frame_bytes = 0;    ///< allocated this frame
+    int frame_copies = 0;      ///< copies issued this frame
+    int frame_refused = 0;     ///< allocations that did not fit in the budget of this frame
+    int stalls = 0;            ///< begin_frame waited for the GPU to finish reading a region
+    double stall_ms = 0.0;     ///< in those waits
+    int blocked_frames = 0;    ///< frames without a region, the next one still had allocations nobody released
+};
+
+/// Streams data to buffers and textures without reallocating their storage.
+///
+/// The ring is one buffer split in `regions` regions of `budget` bytes, the frames take them in turn. Any thread
+/// allocates from the region of the current frame and writes into the allocation, the GL thread then copies it
+/// into a buffer (glCopyBufferSubData) or a texture (glTexSubImage from the ring bound as the pixel unpack buffer)
+/// and releases it. end_frame fences the copies of the frame, and begin_frame waits for that fence before it hands
+/// a region out again, which only happens when the GPU is `regions` frames behind (counted as a stall).
+///
+/// With GL_ARB_buffer_storage (core in 4.4) the buffer stays mapped for its whole life, otherwise the regions are
+/// client memory and the copies are glBufferSubData and glTexSubImage calls from it, which copy at the call.
+///
+/// A region is not handed out again while it has allocations that were not released, every allocation has to be
+/// released once it is copied, or when it will not be.
+class UploadRing {
+public:
+
+    static const int regions = 3;
+
+    struct Allocation {
+        unsigned char *data = nullptr; ///< null when the allocation was refused
+        GLintptr offset = 0;           ///< in the ring buffer
+        GLsizeiptr size = 0;
+        int region = -1;
+
+        explicit operator bool() const { return data != nullptr; }
+    };
+
+    UploadRingStats stats;
+
+private:
+
+    struct Region {
+        GLsizeiptr head = 0;
+        int pending = 0;       ///< allocations not released yet
+        long last_frame = -1;  ///< the last frame that copied from it
+    };
+
+    GLuint buffer = 0;
+    unsigned char *mapped = nullptr;      ///< the persistent mapping
+    std::vector<unsigned char> client;    ///< the regions of the fallback
+    GLsizeiptr region_size;
+    Region ring[regions];
+    int current = -1;                     ///< the region of this frame, -1 when it is blocked
+    long frame = 0;
+    long completed_frame = -1;            ///< the GPU is done with every copy up to this frame
+    std::deque<std::pair<long, GLsync>> fences;
+    std::mutex mutex;
+
+public:
+
+    /// budget is the bytes a frame can allocate, allow_persistent false forces the fallback
+    explicit UploadRing(GLsizeiptr budget, bool allow_persistent = true) : region_size(budget) {
+        stats.persistent = allow_persistent && has_buffer_storage();
+        GLsizeiptr bytes = budget * regions;
+        if (stats.persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glBufferStorage(GL_COPY_READ_BUFFER, bytes, nullptr, flags);
+            mapped = (unsigned char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, bytes, flags);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            if (!mapped) {
+                glDeleteBuffers(1, &buffer);
+                buffer = 0;
+                stats.persistent = false;
+            }
+        }
+        if (!stats.persistent) client.resize(bytes);
+        current = 0;
+    }
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing &operator=(const UploadRing&) = delete;
+
+    ~UploadRing() {
+        for (auto &fence : fences) glDeleteSync(fence.second);
+        if (buffer) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+        }
+    }
+
+    GLsizeiptr budget() const { return region_size; }
+
+    /// size bytes from the region of this frame, any thread; refused (and counted) once the budget is spent
+    Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Allocation allocation;
+        if (current < 0) return allocation;
+        Region &region = ring[current];
+        GLsizeiptr start = (region.head + alignment - 1) / alignment * alignment;
+        if (start + size > region_size) {
+            stats.frame_refused++;
+            return allocation;
+        }
+        region.head = start + size;
+        region.pending++;
+        stats.frame_bytes += size;
+        allocation.offset = current * region_size + start;
+        allocation.data = (mapped ? mapped : client.data()) + allocation.offset;
+        allocation.size = size;
+        allocation.region = current;
+        return allocation;
+    }
+
+    /// size bytes of the allocation from byte from into the buffer at offset, GL thread
+    void copy_to_buffer(const Allocation &allocation, GLintptr from, GLsizeiptr size, GLuint target, GLintptr offset) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+        if (stats.persistent) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset + from, offset, size);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        } else {
+            glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, allocation.data + from);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        copied(allocation);
+    }
+
+    /// the whole allocation to the start of the buffer
+    template <GLenum TARGET>
+    void copy_to_buffer(const Allocation &allocation, GenericBuffer<TARGET> &target) {
+        copy_to_buffer(allocation, 0, allocation.size, target.id(), 0);
+    }
+
+    /// the texels of the allocation from byte from into a box of level 0 of the texture, GL thread. GL_TEXTURE_2D
+    /// ignores z and depth, GL_TEXTURE_2D_ARRAY and GL_TEXTURE_3D take them. Leaves nothing bound to target
+    void copy_to_texture(const Allocation &allocation, GLintptr from, GLenum target, GLuint texture, GLint x, GLint y,
+                         GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type) {
+        // an offset into the unpack buffer, or a pointer to client memory
+        const GLvoid *pixels = stats.persistent ? (const GLvoid*)(allocation.offset + from) : allocation.data + from;
+        if (stats.persistent) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        glBindTexture(target, texture);
+        if (target == GL_TEXTURE_2D) {
+            glTexSubImage2D(target, 0, x, y, width, height, format, type, pixels);
+        } else {
+            glTexSubImage3D(target, 0, x, y, z, width, height, depth, format, type, pixels);
+        }
+        glBindTexture(target, 0);
+        if (stats.persistent) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        copied(allocation);
+    }
+
+    /// the whole allocation into the texture, with its format and type
+    void copy_to_texture(const Allocation &allocation, GenericTexture &texture, GLint x, GLint y, GLsizei width,
+                         GLsizei height) {
+        copy_to_texture(allocation, 0, GL_TEXTURE_2D, texture.id(), x, y, 0, width, height, 1,
+                        texture.get_format(), texture.get_type());
+    }
+
+    /// the allocation will not be copied any more, any thread
+    void release(Allocation &allocation) {
+        if (allocation.region < 0) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        ring[allocation.region].pending--;
+        allocation = Allocation();
+    }
+
+    /// fences the copies of the frame, GL thread
+    void end_frame() {
+        if (stats.persistent && stats.frame_copies > 0) {
+            fences.push_back(std::make_pair(frame, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)));
+        }
+    }
+
+    /// moves on to the region of the next frame, waiting for the GPU to be done with it if it has to, GL thread
+    void begin_frame() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++frame;
+        stats.frame_bytes = 0;
+        stats.frame_copies = 0;
+        stats.frame_refused = 0;
+        int next = (int)(frame % regions);
+        Region &region = ring[next];
+        if (region.pending > 0) {
+            current = -1;
+            stats.blocked_frames++;
+            return;
+        }
+        if (region.last_frame > completed_frame) wait_for(region.last_frame);
+        region.head = 0;
+        current = next;
+    }
+
+    /// GL_ARB_buffer_storage, with its entry point
+    static bool has_buffer_storage() {
+        if (!glBufferStorage) return false;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (extension && strcmp(extension, "GL_ARB_buffer_storage") == 0) return true;
+        }
+        return false;
+    }
+
+private:
+
+    void copied(const Allocation &allocation) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ring[allocation.region].last_frame = frame;
+        stats.frame_copies++;
+    }
+
+    // the fences come in frame order, once one has passed so have the ones before it
+    void wait_for(long until) {
+        while (!fences.empty() && fences.front().first <= until) {
+            GLsync fence = fences.front().second;
+            GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (status == GL_TIMEOUT_EXPIRED) {
+                auto start = std::chrono::steady_clock::now();
+                while (status == GL_TIMEOUT_EXPIRED) status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+                stats.stalls++;
+                stats.stall_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+            completed_frame = fences.front().first;
+            glDeleteSync(fence);
+            fences.pop_front();
+        }
+        completed_frame = std::max(completed_frame, until);
+    }
+
+};
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
@@ -0,0 +1,101 @@
+#ifndef HEIGHTFIELDCHECK_H
+#define HEIGHTFIELDCHECK_H
+
+#include "utility.h"
+#include "HeightfieldGenerator.h"
+
+#include <random>
+
+// the CPU generator against the GLSL it was ported from (heightfield_vshader_reference.glsl), on the GPU of the
+// context: the points of a grid around the origin at the spacing of the chunks and random points far out go through
+// the shader with transform feedback, and their heights are compared with the ones of HeightfieldGenerator for seed 0,
+// the world the shader made. inversesqrt() and pow() may be approximate in GLSL, so the heights only have to agree to
+// within a tolerance, not bit for bit
+
+const char* heightfield_vshader_reference =
+#include "heightfield_vshader_reference.glsl"
+;
+
+namespace heightfieldcheck {
+
+struct Result {
+    int samples;
+    double maxError;
+    double meanError;
+    int mismatches;     ///< farther apart than tolerance
+    float tolerance;
+};
+
+inline Result run(int samples, float tolerance = 1e-3f) {
+    std::vector<float> points(2 * samples);
+    const int side = std::max(1, (int)std::sqrt((float)samples / 2));
+    const float spacing = 20.0f / 1024.0f;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> far(-500.0f, 500.0f);
+    for (int k = 0; k < samples; ++k) {
+        if (k < side * side) {
+            points[2 * k] = (float)(k % side - side / 2) * spacing;
+            points[2 * k + 1] = (float)(k / side - side / 2) * spacing;
+        } else {
+            points[2 * k] = far(rng);
+            points[2 * k + 1] = far(rng);
+        }
+    }
+
+    Shader shader;
+    shader.add_vshader_from_source(heightfield_vshader_reference);
+    const char *varyings[] = { "height" };
+    glTransformFeedbackVaryings(shader.programId(), 1, varyings, GL_INTERLEAVED_ATTRIBS);
+    shader.link();
+
+    VertexArrayObject vao;
+    GenericArrayBuffer input;
+    input.upload_raw_block(points.data(), (GLsizeiptr)points.size() * sizeof(float));
+    vao.bind();
+    input.bind();
+    GLint location = glGetAttribLocation(shader.programId(), "point");
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
+
+    GLuint output;
+    glGenBuffers(1, &output);
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, output);
+    glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, samples * sizeof(float), nullptr, GL_STATIC_READ);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, output);
+
+    shader.bind();
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, samples);
+    glEndTransformFeedback();
+    glDisable(GL_RASTERIZER_DISCARD);
+    shader.unbind();
+    vao.unbind();
+
+    std::vector<float> gpu(samples);
+    glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, samples * sizeof(float), gpu.data());
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+    glDeleteBuffers(1, &output);
+
+    std::vector<float> xs(samples), ys(samples), cpu(samples);
+    for (int k = 0; k < samples; ++k) {
+        xs[k] = points[2 * k];
+        ys[k] = points[2 * k + 1];
+    }
+    HeightfieldGenerator generator;
+    generator.heights(xs.data(), ys.data(), cpu.data(), samples);
+
+    Result result = { samples, 0.0, 0.0, 0, tolerance };
+    for (int k = 0; k < samples; ++k) {
+        double error = std::abs((double)gpu[k] - (double)cpu[k]);
+        if (!(error <= tolerance)) result.mismatches++; // NaN counts too
+        result.maxError = std::max(result.maxError, error);
+        result.meanError += error / samples;
+    }
+    return result;
+}
+
+} // namespace heightfieldcheck
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef SKYBENCHMARK_H
+#define SKYBENCHMARK_H
+
+#include "World.h"
+
+#include <chrono>
+
+// GPU cost of the sky of a frame at every cloud quality (see Clouds.h): the cloud map update, then the skybox in
+// a texture of the size of the water reflection and over the whole screen, with the camera looking up so that every pixel is sky.
+// "reference" is the shader from before the cloud map, which evaluates the clouds for every pixel of both draws.
+
+namespace sky {
+
+struct Result {
+    std::string quality;
+    double msPerFrame;
+};
+
+inline std::vector<Result> run(World &world, int frames, std::unique_ptr<Shader> reference) {
+    Camera &camera = world.camera;
+    camera.cameraPos = Vec3(0.0f, 0.0f, 2.0f);
+    camera.setAngles(0.0f, 0.6f);
+    Skybox &skybox = world.skybox;
+
+    // the two draws of the sky in a frame, without the terrain and the water
+    RenderGraph graph(world.uniforms, world.width, world.height);
+    int reflection = graph.createTexture("sky reflection", GRAPH_RGBA8, world.water.reflectionWidth, world.water.reflectionHeight, true);
+    int depth = graph.createTexture("sky reflection depth", GRAPH_DEPTH16, world.water.reflectionWidth, world.water.reflectionHeight);
+    RenderPass &reflectionPass = graph.pass(graph.addPass("sky reflection"));
+    reflectionPass.view.uniformSlot = World::REFLECTION_PASS;
+    reflectionPass.color = reflection;
+    reflectionPass.depth = depth;
+    reflectionPass.execute = [&](const PassContext&) { skybox.draw(); };
+    RenderPass &mainPass = graph.pass(graph.addPass("sky main"));
+    mainPass.view.uniformSlot = World::MAIN_PASS;
+    mainPass.color = graphBackbuffer;
+    mainPass.depth = graphBackbuffer;
+    mainPass.execute = [&](const PassContext&) { skybox.draw(); };
+    graph.compile();
+
+    auto timeFrames = [&](bool updateClouds) {
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; ++f) {
+            float time = f / 60.0f;
+            if (updateClouds) skybox.clouds.update(time);
+            graph.execute(camera, time);
+        }
+        glFinish();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+    };
+
+    std::vector<Result> results;
+    for (int level = 0; level < numCloudQualities; ++level) {
+        skybox.clouds.setQuality(level);
+        timeFrames(true); // the first frame renders the whole map, and the driver compiles what it defers
+        results.push_back(Result{ cloudQualities[level].name, timeFrames(true) });
+    }
+
+    std::unique_ptr<Shader> current = std::move(skybox.skyboxShader);
+    skybox.setShader(std::move(reference));
+    timeFrames(false);
+    results.push_back(Result{ "reference", timeFrames(false) });
+    skybox.setShader(std::move(current));
+    return results;
+}
+
+} // namespace sky
+
+#endif
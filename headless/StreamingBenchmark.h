@@ -0,0 +1,230 @@
+#ifndef STREAMINGBENCHMARK_H
+#define STREAMINGBENCHMARK_H
+
+#include "utility.h"
+#include "TextureArray.h"
+#include "ThreadPool.h"
+
+#include <OpenGP/GL/UploadRing.h>
+
+#include <chrono>
+#include <deque>
+#include <future>
+
+// the cost of streaming a synthetic load like the one of the world three ways (see UploadRing.h):
+//
+//   direct    what the chunks and the scatter did before the ring: every new tile gets its vertices with
+//             glBufferData and its horizon map with glTexImage3D, and the instance buffers are respecified
+//   subdata   the ring without GL_ARB_buffer_storage: the worker writes into client memory, the new storage is
+//             allocated empty and filled with glBufferSubData and glTexSubImage3D, the instance buffers keep theirs
+//   ring      the same through the persistently mapped ring, copies on the GPU from the buffer the worker wrote
+//
+// every frame a worker makes the tiles and the instances of the next frame while the GL thread uploads the ones of
+// this frame and draws every resident tile and the instances as points, one value in 16, so that the GPU reads every
+// buffer and texture without the draws taking over the frame on a software renderer. The oldest tiles go to make
+// room for the new ones.
+
+namespace streaming {
+
+const char* vshader = R"(
+#version 330 core
+layout(location = 0) in float value;
+uniform sampler2DArray maps;
+out float shade;
+void main() {
+    shade = value + texelFetch(maps, ivec3(gl_VertexID % 65, 0, gl_VertexID & 1), 0).r;
+    gl_Position = vec4(fract(value) * 2.0 - 1.0, fract(value * 7.0) * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+const char* fshader = R"(
+#version 330 core
+in float shade;
+out vec4 color;
+void main() { color = vec4(fract(shade)); }
+)";
+
+struct Load {
+    int tilesPerFrame = 8;     ///< new tiles every frame
+    int residentTiles = 64;
+    int tileCols = 65;         ///< a chunk of the terrain
+    int instances = 20000;     ///< per component, five components like ScatterBatch
+    GLsizeiptr budget = 4 << 20;
+
+    GLsizeiptr vertexBytes() const { return (GLsizeiptr)tileCols * tileCols * 8; }   ///< like TerrainVertex
+    GLsizeiptr mapBytes() const { return (GLsizeiptr)tileCols * tileCols * 4 * 2; }  ///< two RGBA8 layers
+    GLsizeiptr instanceBytes() const { return (GLsizeiptr)instances * sizeof(float); }
+    size_t frameBytes() const { return (size_t)tilesPerFrame * (vertexBytes() + mapBytes()) + 5 * instanceBytes(); }
+};
+
+struct Result {
+    std::string method;
+    bool available;
+    double uploadMs;    ///< per frame, on the GL thread
+    double frameMs;     ///< per frame, with the draws and the GPU
+    int stalls;
+    double stallMs;
+    int refused;        ///< allocations that did not fit in the budget, those went the direct way
+};
+
+struct Tile {
+    std::unique_ptr<VertexArrayObject> vao;
+    std::unique_ptr<GenericArrayBuffer> vertices;
+    std::unique_ptr<TextureArray> map;
+};
+
+// what the worker made for a frame: in the ring, or in memory of its own when there is no ring or it was full
+struct Made {
+    std::vector<UploadRing::Allocation> staging; ///< per tile, then the instances
+    std::vector<std::vector<unsigned char>> data;
+};
+
+inline void fill(unsigned char *out, GLsizeiptr bytes, int seed) {
+    float *values = (float*)out;
+    for (GLsizeiptr k = 0; k < bytes / (GLsizeiptr)sizeof(float); ++k) values[k] = (float)((k + seed) % 1021) / 1021.0f;
+}
+
+inline Made make(const Load &load, UploadRing *ring, int frame) {
+    Made made;
+    GLsizeiptr sizes[2] = { load.vertexBytes() + load.mapBytes(), 5 * load.instanceBytes() };
+    for (int k = 0; k <= load.tilesPerFrame; ++k) {
+        GLsizeiptr bytes = sizes[k == load.tilesPerFrame];
+        UploadRing::Allocation staging;
+        if (ring) staging = ring->allocate(bytes);
+        made.data.push_back(std::vector<unsigned char>(staging ? 0 : bytes));
+        fill(staging ? staging.data : made.data.back().data(), bytes, frame * 131 + k);
+        made.staging.push_back(staging);
+    }
+    return made;
+}
+
+const int drawStride = 16;
+
+inline void setAttribute(VertexArrayObject &vao, GenericArrayBuffer &buffer) {
+    vao.bind();
+    buffer.bind();
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, drawStride * sizeof(float), (const GLvoid*)0);
+    vao.unbind();
+}
+
+inline Result runMethod(const std::string &method, int frames, const Load &load, Shader &shader) {
+    Result result = { method, true, 0.0, 0.0, 0, 0.0, 0 };
+    std::unique_ptr<UploadRing> ring;
+    if (method != "direct") {
+        ring = std::unique_ptr<UploadRing>(new UploadRing(load.budget, method == "ring"));
+        result.available = method == "subdata" || ring->stats.persistent;
+        if (!result.available) return result;
+    }
+    const int cols = load.tileCols;
+    std::deque<Tile> tiles;
+    GenericArrayBuffer instanceBuffers[5];
+    VertexArrayObject instanceVaos[5];
+    for (int c = 0; c < 5; ++c) {
+        if (ring) instanceBuffers[c].upload_raw_block(nullptr, load.instanceBytes(), GL_STREAM_DRAW);
+        setAttribute(instanceVaos[c], instanceBuffers[c]);
+    }
+
+    ThreadPool worker(1);
+    UploadRing *staging = ring.get();
+    std::future<Made> next = std::async(std::launch::deferred, [&]() { return make(load, staging, 0); });
+    double uploadMs = 0.0;
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        if (ring) ring->begin_frame();
+        Made made = next.get();
+        // the next frame is made while this one is uploaded and drawn
+        auto promise = std::make_shared<std::promise<Made>>();
+        next = promise->get_future();
+        worker.submit([&load, staging, f, promise]() { promise->set_value(make(load, staging, f + 1)); });
+
+        auto uploadStart = std::chrono::steady_clock::now();
+        for (int k = 0; k < load.tilesPerFrame; ++k) {
+            UploadRing::Allocation &from = made.staging[k];
+            const unsigned char *data = made.data[k].data();
+            Tile tile;
+            tile.vao = std::unique_ptr<VertexArrayObject>(new VertexArrayObject());
+            tile.vao->unbind();
+            tile.vertices = std::unique_ptr<GenericArrayBuffer>(new GenericArrayBuffer());
+            tile.map = std::unique_ptr<TextureArray>(new TextureArray());
+            tile.map->bind();
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, cols, cols, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         from ? nullptr : data + load.vertexBytes());
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            tile.map->unbind();
+            if (from) {
+                tile.vertices->upload_raw_block(nullptr, load.vertexBytes());
+                ring->copy_to_buffer(from, 0, load.vertexBytes(), tile.vertices->id(), 0);
+                ring->copy_to_texture(from, load.vertexBytes(), GL_TEXTURE_2D_ARRAY, tile.map->id(), 0, 0, 0, cols,
+                                      cols, 2, GL_RGBA, GL_UNSIGNED_BYTE);
+                ring->release(from);
+            } else {
+                tile.vertices->upload_raw_block(data, load.vertexBytes());
+            }
+            setAttribute(*tile.vao, *tile.vertices);
+            tiles.push_back(std::move(tile));
+        }
+        while ((int)tiles.size() > load.residentTiles) tiles.pop_front();
+        UploadRing::Allocation &instances = made.staging.back();
+        for (int c = 0; c < 5; ++c) {
+            if (instances) {
+                ring->copy_to_buffer(instances, c * load.instanceBytes(), load.instanceBytes(), instanceBuffers[c].id(), 0);
+            } else {
+                instanceBuffers[c].upload_raw_block(made.data.back().data() + c * load.instanceBytes(), load.instanceBytes());
+            }
+        }
+        if (instances) ring->release(instances);
+        uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+
+        shader.bind();
+        glActiveTexture(GL_TEXTURE0);
+        for (Tile &tile : tiles) {
+            tile.map->bind();
+            tile.vao->bind();
+            glDrawArrays(GL_POINTS, 0, (GLsizei)(load.vertexBytes() / sizeof(float) / drawStride));
+        }
+        for (VertexArrayObject &vao : instanceVaos) {
+            vao.bind();
+            glDrawArrays(GL_POINTS, 0, load.instances / drawStride);
+        }
+        glBindVertexArray(0);
+        shader.unbind();
+        if (ring) {
+            result.refused += ring->stats.frame_refused;
+            ring->end_frame();
+        }
+    }
+    glFinish();
+    result.frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+    result.uploadMs = uploadMs / frames;
+
+    // the worker still writes into the ring
+    Made last = next.get();
+    for (UploadRing::Allocation &allocation : last.staging) if (ring) ring->release(allocation);
+    if (ring) {
+        result.stalls = ring->stats.stalls;
+        result.stallMs = ring->stats.stall_ms;
+    }
+    return result;
+}
+
+inline std::vector<Result> run(int frames, const Load &load = Load()) {
+    std::unique_ptr<Shader> shader(new Shader());
+    shader->add_vshader_from_source(vshader);
+    shader->add_fshader_from_source(fshader);
+    shader->link();
+    shader->bind();
+    shader->set_uniform("maps", 0);
+    shader->unbind();
+
+    std::vector<Result> results;
+    for (const char *method : { "direct", "subdata", "ring" }) {
+        runMethod(method, std::min(frames, 10), load, *shader); // the driver settles its allocations
+        results.push_back(runMethod(method, frames, load, *shader));
+    }
+    return results;
+}
+
+} // namespace streaming
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef SUBMISSIONBENCHMARK_H
+#define SUBMISSIONBENCHMARK_H
+
+#include "utility.h"
+#include "Camera.h"
+#include "UniformBlocks.h"
+
+#include <chrono>
+#include <functional>
+
+// CPU time to get the camera and the constants of one frame into the programs, without drawing anything:
+//
+//   names      what the draws did before the uniform blocks: every draw copies the camera, recomputes its
+//              matrices and sets each uniform by name (a std::string built and hashed per call)
+//   locations  the same uniforms through locations looked up once (Shader::uniform_location)
+//   blocks     what World does now: the matrices once per pass, one write of the Camera block per pass
+//
+// the frame is the one of World::drawFrame: skybox and terrain in the reflection, terrain in the refraction,
+// then terrain, skybox and water
+
+namespace submission {
+
+// programs with the uniforms the terrain, skybox and water shaders had before the blocks
+const char* terrain_vshader = R"(
+#version 330 core
+in vec3 vposition;
+uniform mat4 M, V, P;
+uniform vec3 viewPos, clipPlaneNormal;
+uniform float clipPlaneHeight;
+void main() {
+    gl_Position = P * V * M * vec4(vposition + viewPos, 1.0);
+    gl_ClipDistance[0] = dot(vec4(clipPlaneNormal, clipPlaneHeight), vec4(vposition, 1.0));
+}
+)";
+const char* terrain_fshader = R"(
+#version 330 core
+uniform sampler2D grass, rock, sand, snow;
+uniform float waterHeight;
+uniform vec3 skyColor, lightPos;
+out vec4 color;
+void main() {
+    vec2 uv = vec2(waterHeight);
+    color = texture(grass, uv) + texture(rock, uv) + texture(sand, uv) + texture(snow, uv) + vec4(skyColor + lightPos, 1.0);
+}
+)";
+const char* skybox_vshader = R"(
+#version 330 core
+in vec3 vposition;
+uniform mat4 projection, view;
+void main() { gl_Position = projection * view * vec4(vposition, 1.0); }
+)";
+const char* skybox_fshader = R"(
+#version 330 core
+uniform samplerCube skybox;
+uniform sampler2D cloudTexture;
+uniform float time;
+uniform vec3 baseSkyColor;
+out vec4 color;
+void main() { color = texture(skybox, vec3(time)) + texture(cloudTexture, vec2(time)) + vec4(baseSkyColor, 1.0); }
+)";
+const char* water_vshader = R"(
+#version 330 core
+in vec3 vposition;
+uniform mat4 M, V, P;
+uniform vec3 viewPos;
+void main() { gl_Position = P * V * M * vec4(vposition + viewPos, 1.0); }
+)";
+const char* water_fshader = R"(
+#version 330 core
+uniform sampler2D reflectionTexture, refractionTexture, waterTexture;
+uniform float time;
+out vec4 color;
+void main() {
+    color = texture(reflectionTexture, vec2(time)) + texture(refractionTexture, vec2(time)) + texture(waterTexture, vec2(time));
+}
+)";
+// a program that reads everything from the blocks
+const char* blocks_vshader = R"(
+#version 330 core
+in vec3 vposition;
+void main() { gl_Position = P * V * vec4(vposition + viewPos + lightPos * waterHeight, time + clipPlaneHeight); }
+)";
+const char* blocks_fshader = R"(
+#version 330 core
+out vec4 color;
+void main() { color = vec4(skyColor + clipPlaneNormal, 1.0); }
+)";
+
+inline std::unique_ptr<Shader> program(const std::string &vshader, const std::string &fshader) {
+    std::unique_ptr<Shader> shader(new Shader());
+    shader->add_vshader_from_source(vshader.c_str());
+    shader->add_fshader_from_source(fshader.c_str());
+    shader->link();
+    return shader;
+}
+
+// the uniforms of the terrain, skybox and water programs, looked up once
+struct TerrainLocations {
+    GLint M, V, P, viewPos, clipPlaneNormal, clipPlaneHeight, waterHeight, skyColor, lightPos, layers[4];
+    explicit TerrainLocations(const Shader &s)
+        : M(s.uniform_location("M")), V(s.uniform_location("V")), P(s.uniform_location("P")),
+          viewPos(s.uniform_location("viewPos")), clipPlaneNormal(s.uniform_location("clipPlaneNormal")),
+          clipPlaneHeight(s.uniform_location("clipPlaneHeight")), waterHeight(s.uniform_location("waterHeight")),
+          skyColor(s.uniform_location("skyColor")), lightPos(s.uniform_location("lightPos")) {
+        const char *names[] = { "grass", "rock", "sand", "snow" };
+        for (int i = 0; i < 4; ++i) layers[i] = s.uniform_location(names[i]);
+    }
+};
+
+struct SkyboxLocations {
+    GLint view, projection, time, baseSkyColor, skybox, cloudTexture;
+    explicit SkyboxLocations(const Shader &s)
+        : view(s.uniform_location("view")), projection(s.uniform_location("projection")), time(s.uniform_location("time")),
+          baseSkyColor(s.uniform_location("baseSkyColor")), skybox(s.uniform_location("skybox")),
+          cloudTexture(s.uniform_location("cloudTexture")) {}
+};
+
+struct WaterLocations {
+    GLint M, V, P, viewPos, time, reflectionTexture, refractionTexture, waterTexture;
+    explicit WaterLocations(const Shader &s)
+        : M(s.uniform_location("M")), V(s.uniform_location("V")), P(s.uniform_location("P")),
+          viewPos(s.uniform_location("viewPos")), time(s.uniform_location("time")),
+          reflectionTexture(s.uniform_location("reflectionTexture")),
+          refractionTexture(s.uniform_location("refractionTexture")), waterTexture(s.uniform_location("waterTexture")) {}
+};
+
+struct Constants {
+    Mat4x4 M = Mat4x4::Identity();
+    Vec3 skyColor = Vec3(0.6f, 0.7f, 0.8f), lightPos = Vec3(30.0f, 30.0f, 30.0f);
+    float waterHeight = 0.5f;
+    Vec3 clipPlaneNormal = Vec3(0, 0, -1);
+    float clipPlaneHeight = 1000.0f;
+};
+
+// the camera is taken by value, like the draws took it
+inline void terrainByName(Shader &s, Camera camera, const Constants &c) {
+    s.bind();
+    s.set_uniform("M", c.M);
+    s.set_uniform("V", camera.viewMatrix());
+    s.set_uniform("P", camera.projectionMatrix());
+    s.set_uniform("viewPos", camera.cameraPos);
+    s.set_uniform("clipPlaneNormal", c.clipPlaneNormal);
+    s.set_uniform("clipPlaneHeight", c.clipPlaneHeight);
+    s.set_uniform("waterHeight", c.waterHeight);
+    s.set_uniform("skyColor", c.skyColor);
+    s.set_uniform("lightPos", c.lightPos);
+    const char *names[] = { "grass", "rock", "sand", "snow" };
+    for (int i = 0; i < 4; ++i) s.set_uniform(names[i], i);
+}
+
+inline void skyboxByName(Shader &s, Camera camera, float time, const Constants &c) {
+    s.bind();
+    s.set_uniform("view", camera.viewMatrix());
+    s.set_uniform("projection", camera.projectionMatrix());
+    s.set_uniform("time", time);
+    s.set_uniform("baseSkyColor", c.skyColor);
+    s.set_uniform("skybox", 0);
+    s.set_uniform("cloudTexture", 1);
+}
+
+inline void waterByName(Shader &s, Camera camera, float time, const Constants &c) {
+    s.bind();
+    s.set_uniform("M", c.M);
+    s.set_uniform("V", camera.viewMatrix());
+    s.set_uniform("P", camera.projectionMatrix());
+    s.set_uniform("viewPos", camera.cameraPos);
+    s.set_uniform("time", time);
+    s.set_uniform("reflectionTexture", 0);
+    s.set_uniform("refractionTexture", 1);
+    s.set_uniform("waterTexture", 2);
+}
+
+inline void terrainByLocation(Shader &s, const TerrainLocations &l, const Camera &camera, const Constants &c) {
+    s.bind();
+    s.set_uniform(l.M, c.M);
+    s.set_uniform(l.V, camera.viewMatrix());
+    s.set_uniform(l.P, camera.projectionMatrix());
+    s.set_uniform(l.viewPos, camera.cameraPos);
+    s.set_uniform(l.clipPlaneNormal, c.clipPlaneNormal);
+    s.set_uniform(l.clipPlaneHeight, c.clipPlaneHeight);
+    s.set_uniform(l.waterHeight, c.waterHeight);
+    s.set_uniform(l.skyColor, c.skyColor);
+    s.set_uniform(l.lightPos, c.lightPos);
+    for (int i = 0; i < 4; ++i) s.set_uniform(l.layers[i], i);
+}
+
+inline void skyboxByLocation(Shader &s, const SkyboxLocations &l, const Camera &camera, float time, const Constants &c) {
+    s.bind();
+    s.set_uniform(l.view, camera.viewMatrix());
+    s.set_uniform(l.projection, camera.projectionMatrix());
+    s.set_uniform(l.time, time);
+    s.set_uniform(l.baseSkyColor, c.skyColor);
+    s.set_uniform(l.skybox, 0);
+    s.set_uniform(l.cloudTexture, 1);
+}
+
+inline void waterByLocation(Shader &s, const WaterLocations &l, const Camera &camera, float time, const Constants &c) {
+    s.bind();
+    s.set_uniform(l.M, c.M);
+    s.set_uniform(l.V, camera.viewMatrix());
+    s.set_uniform(l.P, camera.projectionMatrix());
+    s.set_uniform(l.viewPos, camera.cameraPos);
+    s.set_uniform(l.time, time);
+    s.set_uniform(l.reflectionTexture, 0);
+    s.set_uniform(l.refractionTexture, 1);
+    s.set_uniform(l.waterTexture, 2);
+}
+
+struct Result {
+    double namesUs, locationsUs, blocksUs; ///< per frame
+};
+
+inline Result run(int frames, int width, int height) {
+    Constants c;
+    Camera camera(width, height);
+    std::unique_ptr<Shader> terrain = program(terrain_vshader, terrain_fshader);
+    std::unique_ptr<Shader> skybox = program(skybox_vshader, skybox_fshader);
+    std::unique_ptr<Shader> water = program(water_vshader, water_fshader);
+    std::unique_ptr<Shader> blocks = program(withUniformBlocks(blocks_vshader), withUniformBlocks(blocks_fshader));
+    bindUniformBlocks(*blocks);
+    TerrainLocations terrainLocations(*terrain);
+    SkyboxLocations skyboxLocations(*skybox);
+    WaterLocations waterLocations(*water);
+    FrameUniforms uniforms(3);
+    uniforms.setMaterial(c.skyColor, c.lightPos, c.waterHeight);
+
+    auto timeFrames = [&](const std::function<void(float)> &frame) {
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; ++f) frame(f / 60.0f);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        glFinish();
+        return us / frames;
+    };
+
+    Result result;
+    result.namesUs = timeFrames([&](float time) {
+        skyboxByName(*skybox, camera, time, c);
+        terrainByName(*terrain, camera, c);
+        terrainByName(*terrain, camera, c);
+        terrainByName(*terrain, camera, c);
+        skyboxByName(*skybox, camera, time, c);
+        waterByName(*water, camera, time, c);
+    });
+    result.locationsUs = timeFrames([&](float time) {
+        skyboxByLocation(*skybox, skyboxLocations, camera, time, c);
+        terrainByLocation(*terrain, terrainLocations, camera, c);
+        terrainByLocation(*terrain, terrainLocations, camera, c);
+        terrainByLocation(*terrain, terrainLocations, camera, c);
+        skyboxByLocation(*skybox, skyboxLocations, camera, time, c);
+        waterByLocation(*water, waterLocations, camera, time, c);
+    });
+    result.blocksUs = timeFrames([&](float time) {
+        // the draws only bind their program, the same one here for all six
+        for (int pass = 0; pass < 3; ++pass) {
+            Mat4x4 view = camera.viewMatrix(), projection = camera.projectionMatrix();
+            uniforms.setPass(pass, view, projection, camera.cameraPos, time, c.clipPlaneNormal, c.clipPlaneHeight);
+            int draws = pass == 0 ? 2 : pass == 1 ? 1 : 3;
+            for (int d = 0; d < draws; ++d) blocks->bind();
+        }
+    });
+    glUseProgram(0);
+    return result;
+}
+
+} // namespace submission
+
+#endif
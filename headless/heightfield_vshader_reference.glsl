@@ -0,0 +1,80 @@
+R"(
+#version 330 core
+
+// the heights as the terrain vertex shader computed them before the CPU generator took over (see
+// src/HeightfieldGenerator.h), Perlin2D and hybridMultiFractal copied unchanged, for `headless --heightfield-check`:
+// every point goes through the noise and its height comes back through transform feedback
+
+in vec2 point;
+out float height;
+
+float Perlin2D( vec2 P ) {
+    //  https://github.com/BrianSharpe/Wombat/blob/master/Perlin2D.glsl
+
+    // establish our grid cell and unit position
+    vec2 Pi = floor(P);
+    vec4 Pf_Pfmin1 = P.xyxy - vec4( Pi, Pi + 1.0 );
+
+    // calculate the hash
+    vec4 Pt = vec4( Pi.xy, Pi.xy + 1.0 );
+    Pt = Pt - floor(Pt * ( 1.0 / 71.0 )) * 71.0;
+    Pt += vec2( 26.0, 161.0 ).xyxy;
+    Pt *= Pt;
+    Pt = Pt.xzxz * Pt.yyww;
+    vec4 hash_x = fract( Pt * ( 1.0 / 951.135664 ) );
+    vec4 hash_y = fract( Pt * ( 1.0 / 642.949883 ) );
+
+    // calculate the gradient results
+    vec4 grad_x = hash_x - 0.49999;
+    vec4 grad_y = hash_y - 0.49999;
+    vec4 grad_results = inversesqrt( grad_x * grad_x + grad_y * grad_y ) * ( grad_x * Pf_Pfmin1.xzxz + grad_y * Pf_Pfmin1.yyww );
+
+    // Classic Perlin Interpolation
+    grad_results *= 1.4142135623730950488016887242097;  // scale things to a strict -1.0->1.0 range  *= 1.0/sqrt(0.5)
+    vec2 blend = Pf_Pfmin1.xy * Pf_Pfmin1.xy * Pf_Pfmin1.xy * (Pf_Pfmin1.xy * (Pf_Pfmin1.xy * 6.0 - 15.0) + 10.0);
+    vec4 blend2 = vec4( blend, vec2( 1.0 - blend ) );
+    return dot( grad_results, blend2.zxzx * blend2.wwyy );
+}
+
+// adapted from texturing and modeling a procedural approach
+float hybridMultiFractal(vec2 point) {
+    // set up
+    float H = 0.25;
+    float offset =  0.7;
+    float lacunarity = 2;
+    float octaves = 8;
+    float frequency = 0.55;// 0.45; //0.7;
+
+    float value = 1.0;
+    float signal = 0.0;
+    float rmd = 0.0;
+    float pwHL = pow(lacunarity, -H);
+    float pwr = pwHL;
+    float weight = 0.;
+
+    // get zeroth octave of function
+    value = pwr*(Perlin2D(point * frequency)+offset);
+    weight = value;
+    point *= lacunarity;
+    pwr *= pwHL;
+
+    // start from 1 and start weighing the signals
+    for (int i=1; i<octaves; i++) {
+        weight = weight > 1.0f ? 1.0f : weight;
+
+        signal = pwr*(Perlin2D(point * frequency)+offset);
+        
+        value += weight*signal;
+        weight *= signal;
+        pwr *= pwHL;
+        point *= lacunarity;
+    }
+
+    return value;
+}
+
+void main() {
+    height = hybridMultiFractal(point);
+    gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+}
+)"
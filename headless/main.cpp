@@ -0,0 +1,451 @@
+// offscreen frame time harness: renders the same world as the window along a scripted camera path
+// in an EGL pbuffer (a software context such as Mesa llvmpipe is enough), then prints per pass CPU/GPU
+// timings and frame time percentiles as JSON, and optionally dumps frames as PNGs for image diffs
+//
+//   headless [--frames N] [--width W] [--height H] [--json out.json] [--trace trace.json] [--png-dir dir] [--png-every K]
+//            [--splat array|reference] [--submission N] [--water-budget MS] [--scatter-density X] [--shader-cache DIR]
+//            [--clouds low|medium|high|reference] [--sky N] [--ocean N] [--graph FILE]
+//            [--occlusion on|off] [--seed N] [--tile-store DIR] [--erosion on|off] [--horizons on|off]
+//            [--upload-ring on|subdata|off] [--streaming N] [--heightfield-check N]
+//
+// the timings are the profiler scopes of World::drawFrame (see Profiler.h), --trace writes them all for chrome://tracing
+// --splat reference shades the terrain with the shader from before the splat weights, for a before/after comparison
+// of the fragment cost (compare the terrain pass at two resolutions, the vertex work does not change with it)
+// --water-budget MS lets WaterQuality scale the water FBOs to that frame time (see WaterQuality.h), its decisions
+// are in the counters of the JSON. Without it the FBOs keep their default sizes, so runs stay comparable
+// --scatter-density X scales how many grass, tree and rock instances are placed (see ScatterData.h), 0 places none;
+// the instance and tile counts of the culling are in the counters of the JSON
+// --shader-cache DIR keeps the program binaries there (see ShaderCache.h), without it every program is compiled so
+// that runs do not depend on the ones before them. The "startup" object of the JSON has the time from the context to
+// the end of the first frame and what the cache did, a run on an empty DIR gives the cold time to first frame and the
+// next run on it the warm one
+// --clouds sets the size and refresh rate of the cloud map of the skybox (see Clouds.h), reference evaluates the
+// clouds for every sky pixel like the skybox did before it. --sky N only times N frames of the sky at every level
+// --ocean N simulates the waves of the water on an N x N grid (see Ocean.h), 64 to 512; the milliseconds of a step on
+// the workers and the frames that went without a new step are in the counters of the JSON
+// --graph FILE writes the render graph of the frame as it was compiled to FILE (see RenderGraph.h): the passes in
+// the order they ran, the textures with the passes they live over and the pool they share, and their memory
+// --occlusion off draws the main pass without culling what the terrain hides (see Occlusion.h), for a before/after
+// comparison; the chunks and scatter tiles it culled in each pass are in the counters of the JSON
+// --seed N renders another world (see HeightfieldGenerator.h), 0 is the original one. --tile-store DIR keeps the
+// terrain chunks of every world there (see TileStore.h), without it every chunk is built so that the chunk timings
+// do not depend on earlier runs; what came from the store and what was built is in the "terrain" object of the JSON,
+// a second run over the same frames with the same DIR builds nothing
+// --erosion off renders the terrain straight from the noise, without the droplets and the wetness (see Erosion.h);
+// the tiles that were eroded and the ones that came from the store are in the "terrain" object of the JSON
+// --horizons off draws the terrain without the sun shadows and the ambient occlusion of the horizon maps (see
+// Horizon.h), the maps the workers baked and the bytes of the resident ones are in the "terrain" object of the JSON
+// --upload-ring off uploads the terrain chunks and the scatter instances straight from their data like before the
+// ring (see UploadRing.h), subdata uses the ring without persistent mapping; the bytes, refusals and stalls of the
+// ring are in the counters of the JSON. --streaming N only times N frames of a synthetic streaming load through
+// each upload path and prints them (see StreamingBenchmark.h)
+// --submission N only times N frames worth of uniform updates three ways and prints them (see SubmissionBenchmark.h)
+// --heightfield-check N only compares the heights of N points from the CPU generator with the ones of the GLSL it
+// was ported from and prints how far apart they are (see HeightfieldCheck.h), exits with 1 when they disagree
+
+#include "utility.h"
+#include "World.h"
+#include "SubmissionBenchmark.h"
+#include "SkyBenchmark.h"
+#include "StreamingBenchmark.h"
+#include "HeightfieldCheck.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+using namespace OpenGP;
+
+const char* terrain_fshader_reference =
+#include "terrain_fshader_reference.glsl"
+;
+
+const char* skybox_fshader_reference =
+#include "skybox_fshader_reference.glsl"
+;
+
+struct Options {
+    int frames = 300;
+    int width = 1280, height = 720;
+    std::string json;     ///< stdout when empty
+    std::string trace;    ///< no Chrome trace when empty
+    std::string pngDir;   ///< no images when empty
+    int pngEvery = 60;
+    std::string splat = "array"; ///< or "reference"
+    int submission = 0;          ///< frames of the submission benchmark, which then runs instead of the world
+    double waterBudgetMs = 0.0;  ///< target frame time of the water quality controller, 0 leaves it off
+    float scatterDensity = 1.0f; ///< scales the densities of the scatter rules
+    std::string shaderCache;     ///< empty for no program binaries
+    std::string clouds = cloudQualities[defaultCloudQuality].name; ///< or "reference"
+    int sky = 0;                 ///< frames of the sky benchmark, which then runs instead of the frames
+    int ocean = OceanParams().size;
+    std::string graph;           ///< no dump of the render graph when empty
+    std::string occlusion = "on"; ///< or "off"
+    unsigned int seed = 0;
+    std::string tileStore;       ///< empty to build every chunk
+    std::string erosion = "on";  ///< or "off"
+    std::string horizons = "on"; ///< or "off"
+    std::string uploadRing = "on"; ///< or "subdata", "off"
+    int streaming = 0;           ///< frames of the streaming benchmark, which then runs instead of the world
+    int heightfieldCheck = 0;    ///< points of the heightfield check, which then runs instead of the world
+};
+
+static bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        std::string value = argv[++i];
+        if (arg == "--frames") options.frames = std::atoi(value.c_str());
+        else if (arg == "--width") options.width = std::atoi(value.c_str());
+        else if (arg == "--height") options.height = std::atoi(value.c_str());
+        else if (arg == "--json") options.json = value;
+        else if (arg == "--trace") options.trace = value;
+        else if (arg == "--png-dir") options.pngDir = value;
+        else if (arg == "--png-every") options.pngEvery = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--splat") options.splat = value;
+        else if (arg == "--submission") options.submission = std::atoi(value.c_str());
+        else if (arg == "--water-budget") options.waterBudgetMs = std::atof(value.c_str());
+        else if (arg == "--scatter-density") options.scatterDensity = (float)std::atof(value.c_str());
+        else if (arg == "--shader-cache") options.shaderCache = value == "none" ? "" : value;
+        else if (arg == "--clouds") options.clouds = value;
+        else if (arg == "--sky") options.sky = std::atoi(value.c_str());
+        else if (arg == "--ocean") options.ocean = std::atoi(value.c_str());
+        else if (arg == "--graph") options.graph = value;
+        else if (arg == "--occlusion") options.occlusion = value;
+        else if (arg == "--seed") options.seed = (unsigned int)std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--tile-store") options.tileStore = value == "none" ? "" : value;
+        else if (arg == "--erosion") options.erosion = value;
+        else if (arg == "--horizons") options.horizons = value;
+        else if (arg == "--upload-ring") options.uploadRing = value;
+        else if (arg == "--streaming") options.streaming = std::atoi(value.c_str());
+        else if (arg == "--heightfield-check") options.heightfieldCheck = std::atoi(value.c_str());
+        else return false;
+    }
+    return options.frames > 0 && options.width > 0 && options.height > 0 && options.scatterDensity >= 0.0f &&
+           (options.splat == "array" || options.splat == "reference") &&
+           (options.clouds == "reference" || cloudQualityLevel(options.clouds) >= 0) &&
+           (options.occlusion == "on" || options.occlusion == "off") &&
+           (options.erosion == "on" || options.erosion == "off") &&
+           (options.horizons == "on" || options.horizons == "off") &&
+           (options.uploadRing == "on" || options.uploadRing == "subdata" || options.uploadRing == "off") &&
+           options.ocean >= 64 && options.ocean <= 512 && (options.ocean & (options.ocean - 1)) == 0;
+}
+
+// a GL 3.3 core context on a pbuffer, preferring the surfaceless platform so that no X server is needed
+static bool createContext(int width, int height) {
+    EGLDisplay display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+#endif
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cerr << "headless: no EGL display" << std::endl;
+        return false;
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs) || numConfigs == 0) {
+        std::cerr << "headless: no EGL config with a pbuffer and desktop GL" << std::endl;
+        return false;
+    }
+
+    const EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+
+    eglBindAPI(EGL_OPENGL_API);
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context)) {
+        std::cerr << "headless: could not create a GL 3.3 core context" << std::endl;
+        return false;
+    }
+
+    // GLEW built for GLX reports the missing X display once it has loaded the GL entry points, that is fine here
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if (err == GLEW_ERROR_NO_GLX_DISPLAY) err = GLEW_OK;
+#endif
+    if (err != GLEW_OK || !glGenVertexArrays) {
+        std::cerr << "headless: GLEW initialization failed" << std::endl;
+        return false;
+    }
+    while (glGetError() != GL_NO_ERROR) {}
+    return true;
+}
+
+// the same flight for every run: a slow orbit around the island that dips towards the water
+static void scriptCamera(Camera &camera, int frame) {
+    float t = frame / 60.0f;
+    float angle = 0.25f * t;
+    float radius = 6.0f + 1.5f * std::sin(0.4f * t);
+    camera.cameraPos = Vec3(radius * std::sin(angle), -radius * std::cos(angle), 1.6f + 0.8f * std::sin(0.3f * t));
+    // look at the centre, a little down
+    camera.setAngles(angle + (float)M_PI, -0.25f);
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t k = (size_t)std::min<double>(values.size() - 1, std::floor(p / 100.0 * values.size()));
+    return values[k];
+}
+
+static void writeStats(std::ostream &out, const std::vector<double> &values) {
+    double sum = 0.0;
+    for (double v : values) sum += v;
+    out << "{ \"mean\": " << (values.empty() ? 0.0 : sum / values.size())
+        << ", \"p50\": " << percentile(values, 50)
+        << ", \"p90\": " << percentile(values, 90)
+        << ", \"p99\": " << percentile(values, 99)
+        << ", \"max\": " << percentile(values, 100) << " }";
+}
+
+static std::string jsonString(const char *s) {
+    std::string escaped = "\"";
+    for (; s && *s; ++s) {
+        if (*s == '"' || *s == '\\') escaped += '\\';
+        escaped += *s;
+    }
+    return escaped + "\"";
+}
+
+// the default framebuffer as a PNG, rows flipped from the GL bottom up order
+static void dumpFrame(const std::string &filename, int width, int height) {
+    std::vector<unsigned char> pixels(4 * width * height), flipped(4 * width * height);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    for (int j = 0; j < height; ++j) {
+        memcpy(&flipped[4 * j * width], &pixels[4 * (height - 1 - j) * width], 4 * width);
+    }
+    unsigned error = lodepng::encode(filename, flipped, width, height);
+    if (error) std::cerr << "encoder error " << error << ": " << lodepng_error_text(error) << std::endl;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: headless [--frames N] [--width W] [--height H] [--json out.json] [--trace trace.json] [--png-dir dir] [--png-every K] [--splat array|reference] [--submission N] [--water-budget MS] [--scatter-density X] [--shader-cache DIR] [--clouds low|medium|high|reference] [--sky N] [--ocean N] [--graph FILE] [--occlusion on|off] [--seed N] [--tile-store DIR] [--erosion on|off] [--horizons on|off] [--upload-ring on|subdata|off] [--streaming N] [--heightfield-check N]" << std::endl;
+        return 2;
+    }
+    if (!createContext(options.width, options.height)) return 1;
+
+    if (options.submission > 0) {
+        submission::Result result = submission::run(options.submission, options.width, options.height);
+        std::cout << "{\n  \"renderer\": " << jsonString((const char*)glGetString(GL_RENDERER)) << ",\n"
+                  << "  \"frames\": " << options.submission << ",\n"
+                  << "  \"submission_us_per_frame\": { \"names\": " << result.namesUs << ", \"locations\": "
+                  << result.locationsUs << ", \"blocks\": " << result.blocksUs << " }\n}" << std::endl;
+        return 0;
+    }
+    if (options.heightfieldCheck > 0) {
+        heightfieldcheck::Result result = heightfieldcheck::run(options.heightfieldCheck);
+        std::cout << "{\n  \"renderer\": " << jsonString((const char*)glGetString(GL_RENDERER)) << ",\n"
+                  << "  \"heightfield_check\": { \"samples\": " << result.samples << ", \"max_error\": "
+                  << result.maxError << ", \"mean_error\": " << result.meanError << ", \"tolerance\": "
+                  << result.tolerance << ", \"mismatches\": " << result.mismatches << " }\n}" << std::endl;
+        return result.mismatches > 0 ? 1 : 0;
+    }
+    if (options.streaming > 0) {
+        streaming::Load load;
+        std::vector<streaming::Result> results = streaming::run(options.streaming, load);
+        std::cout << "{\n  \"renderer\": " << jsonString((const char*)glGetString(GL_RENDERER)) << ",\n"
+                  << "  \"frames\": " << options.streaming << ", \"bytes_per_frame\": " << load.frameBytes()
+                  << ", \"budget\": " << load.budget << ",\n  \"streaming\": {";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const streaming::Result &r = results[i];
+            std::cout << (i ? ",\n" : "\n") << "    " << jsonString(r.method.c_str()) << ": ";
+            if (!r.available) {
+                std::cout << "null";
+                continue;
+            }
+            std::cout << "{ \"upload_ms\": " << r.uploadMs << ", \"frame_ms\": " << r.frameMs << ", \"stalls\": "
+                      << r.stalls << ", \"stall_ms\": " << r.stallMs << ", \"refused\": " << r.refused << " }";
+        }
+        std::cout << "\n  }\n}" << std::endl;
+        return 0;
+    }
+
+    // everything between the context and the first finished frame, the textures and the programs mostly
+    auto startup = std::chrono::steady_clock::now();
+    HeightfieldParams terrainParams;
+    terrainParams.seed = options.seed;
+    ErosionParams erosionParams;
+    erosionParams.enabled = options.erosion == "on";
+    HorizonParams horizonParams;
+    horizonParams.enabled = options.horizons == "on";
+    World world(options.width, options.height, options.shaderCache, terrainParams, options.tileStore, erosionParams,
+                horizonParams);
+    double worldMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup).count();
+    if (options.splat == "reference") {
+        world.terrain.setShader(world.shaders.link("terrain reference", terrain_vshader, terrain_fshader_reference));
+    }
+    if (options.sky > 0) {
+        std::vector<sky::Result> results =
+            sky::run(world, options.sky, world.shaders.link("skybox reference", skybox_vshader, skybox_fshader_reference));
+        std::cout << "{\n  \"renderer\": " << jsonString((const char*)glGetString(GL_RENDERER)) << ",\n"
+                  << "  \"width\": " << options.width << ", \"height\": " << options.height << ",\n"
+                  << "  \"frames\": " << options.sky << ",\n  \"sky_ms_per_frame\": {";
+        for (size_t i = 0; i < results.size(); ++i) {
+            std::cout << (i ? ", " : " ") << jsonString(results[i].quality.c_str()) << ": " << results[i].msPerFrame;
+        }
+        std::cout << " }\n}" << std::endl;
+        return 0;
+    }
+    if (options.clouds == "reference") {
+        world.skybox.setShader(world.shaders.link("skybox reference", skybox_vshader, skybox_fshader_reference));
+    } else {
+        world.skybox.clouds.setQuality(cloudQualityLevel(options.clouds));
+    }
+    if (options.ocean != world.water.ocean->params().size) {
+        OceanParams ocean;
+        ocean.size = options.ocean;
+        world.water.setOcean(ocean);
+    }
+    // images have to be reproducible, so do not let the streaming depend on how fast the machine is
+    world.blockingStreaming = !options.pngDir.empty();
+    world.waterQuality.targetFrameMs = options.waterBudgetMs;
+    world.occlusionCulling = options.occlusion == "on";
+    if (options.uploadRing != "on") world.setUploadRing(options.uploadRing == "subdata", false);
+    if (options.scatterDensity != 1.0f) world.scatter.scaleDensity(options.scatterDensity);
+    Profiler &profile = profiler();
+    profile.setHistorySize(options.frames);
+
+    // wall clock time of every frame, waiting for the GPU to finish it
+    std::vector<double> frameMs;
+    double firstFrameMs = 0.0;
+    for (int frame = 0; frame < options.frames; ++frame) {
+        scriptCamera(world.camera, frame);
+        auto start = std::chrono::steady_clock::now();
+        profile.beginFrame();
+        // a fixed time step, the water and the clouds animate the same on every machine
+        world.drawFrame(frame / 60.0f);
+        profile.endFrame();
+        glFinish();
+        frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        if (frame == 0) firstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup).count();
+
+        if (!options.pngDir.empty() && frame % options.pngEvery == 0) {
+            std::ostringstream name;
+            name << options.pngDir << "/frame_" << frame << ".png";
+            dumpFrame(name.str(), options.width, options.height);
+        }
+    }
+    profile.flush();
+
+    if (!options.graph.empty()) {
+        std::ofstream graph(options.graph);
+        world.graph.dump(graph);
+    }
+
+    // every scope across the frames, in the order they first ran
+    std::vector<std::string> scopes, counterNames;
+    std::map<std::string, std::vector<double>> cpuMs, gpuMs, counters;
+    std::vector<double> gpuFrameMs;
+    for (size_t age = profile.numFrames(); age-- > 0;) {
+        const ProfileFrame &f = profile.frame(age);
+        gpuFrameMs.push_back(f.gpuMs);
+        for (const ProfileSample &sample : f.samples) {
+            if (!cpuMs.count(sample.name)) scopes.push_back(sample.name);
+            cpuMs[sample.name].push_back(sample.cpuMs);
+            gpuMs[sample.name].push_back(sample.gpuMs);
+        }
+        for (const ProfileCounter &c : f.counters) {
+            if (!counters.count(c.name)) counterNames.push_back(c.name);
+            counters[c.name].push_back(c.value);
+        }
+    }
+
+    if (!options.trace.empty()) {
+        std::ofstream trace(options.trace);
+        profile.writeChromeTrace(trace);
+    }
+
+    std::ofstream file;
+    if (!options.json.empty()) file.open(options.json);
+    std::ostream &out = options.json.empty() ? std::cout : file;
+
+    out << "{\n";
+    out << "  \"renderer\": " << jsonString((const char*)glGetString(GL_RENDERER)) << ",\n";
+    out << "  \"gl_version\": " << jsonString((const char*)glGetString(GL_VERSION)) << ",\n";
+    out << "  \"width\": " << options.width << ", \"height\": " << options.height << ",\n";
+    out << "  \"frames\": " << options.frames << ",\n";
+    out << "  \"splat\": " << jsonString(options.splat.c_str()) << ",\n";
+    out << "  \"clouds\": " << jsonString(options.clouds.c_str()) << ",\n";
+    out << "  \"ocean\": " << options.ocean << ",\n";
+    out << "  \"occlusion\": " << jsonString(options.occlusion.c_str()) << ",\n";
+    out << "  \"upload_ring\": " << (!world.uploads ? "\"off\"" : world.uploads->stats.persistent ? "\"persistent\"" : "\"subdata\"")
+        << ",\n";
+    out << "  \"graph\": { \"passes\": " << world.graph.order.size() << ", \"texture_bytes\": " << world.graph.bytes()
+        << ", \"unaliased_bytes\": " << world.graph.unaliasedBytes() << " },\n";
+    TileStore *store = world.terrain.chunks->store.get();
+    if (store) store->flush();
+    out << "  \"terrain\": { \"seed\": " << options.seed << ", \"tile_store\": " << jsonString(options.tileStore.c_str())
+        << ", \"tiles_read\": " << (store ? store->stats.tilesRead.load() : 0)
+        << ", \"tiles_missed\": " << (store ? store->stats.tilesMissed.load() : 0)
+        << ", \"tiles_written\": " << (store ? store->stats.tilesWritten.load() : 0);
+    ErosionField *erosion = world.terrain.erosion.get();
+    out << ", \"erosion\": " << jsonString(options.erosion.c_str())
+        << ", \"erosion_tiles_eroded\": " << (erosion ? erosion->stats.tilesEroded.load() : 0)
+        << ", \"erosion_tiles_from_store\": " << (erosion ? erosion->stats.tilesFromStore.load() : 0);
+    out << ", \"horizons\": " << jsonString(options.horizons.c_str())
+        << ", \"horizons_baked\": " << world.terrain.chunks->horizonsBaked.load()
+        << ", \"horizon_bytes\": " << world.terrain.chunks->stats.horizonBytes << " },\n";
+    out << "  \"gpu_timers\": " << (profile.gpuTimers ? "true" : "false") << ",\n";
+    const ShaderCache::Stats &shaders = world.shaders.stats;
+    out << "  \"startup\": { \"first_frame_ms\": " << firstFrameMs << ", \"world_ms\": " << worldMs
+        << ", \"textures_ms\": " << world.textures.stats.totalMs() << ",\n    \"shader_cache\": "
+        << jsonString(options.shaderCache.c_str()) << ", \"shader_hits\": " << shaders.hits
+        << ", \"shader_misses\": " << shaders.misses << ", \"shader_rejected\": " << shaders.rejected
+        << ", \"shader_stored\": " << shaders.stored << ",\n    \"program_binaries\": " << (shaders.binaries ? "true" : "false")
+        << ", \"parallel_compile\": " << (shaders.parallel ? "true" : "false")
+        << ", \"shader_request_ms\": " << shaders.requestMs << ", \"shader_wait_ms\": " << shaders.waitMs << " },\n";
+    out << "  \"frame_ms\": ";
+    writeStats(out, frameMs);
+    if (profile.gpuTimers) {
+        out << ",\n  \"gpu_frame_ms\": ";
+        writeStats(out, gpuFrameMs);
+    }
+    out << ",\n  \"passes\": {\n";
+    for (size_t i = 0; i < scopes.size(); ++i) {
+        out << "    " << jsonString(scopes[i].c_str()) << ": {\n      \"cpu_ms\": ";
+        writeStats(out, cpuMs[scopes[i]]);
+        if (profile.gpuTimers) {
+            out << ",\n      \"gpu_ms\": ";
+            writeStats(out, gpuMs[scopes[i]]);
+        }
+        out << "\n    }" << (i + 1 < scopes.size() ? "," : "") << "\n";
+    }
+    out << "  },\n  \"counters\": {\n";
+    for (size_t i = 0; i < counterNames.size(); ++i) {
+        out << "    " << jsonString(counterNames[i].c_str()) << ": ";
+        writeStats(out, counters[counterNames[i]]);
+        out << (i + 1 < counterNames.size() ? "," : "") << "\n";
+    }
+    out << "  }\n}\n";
+    return 0;
+}
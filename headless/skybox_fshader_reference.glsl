@@ -0,0 +1,128 @@
+R"(
+#version 330 core
+// the skybox shader from before the cloud map (see Clouds.h), the fBm of the clouds for every sky pixel
+out vec4 FragColor;
+
+in vec3 texCoords;
+
+uniform samplerCube skybox;
+uniform sampler2D cloudTexture;
+// time and skyColor come from the Camera and Material blocks
+
+float Perlin4D( vec4 P ) {
+    //  https://github.com/BrianSharpe/Wombat/blob/master/Perlin4D.glsl
+
+    // establish our grid cell and unit position
+    vec4 Pi = floor(P);
+    vec4 Pf = P - Pi;
+    vec4 Pf_min1 = Pf - 1.0;
+
+    // clamp the domain
+    Pi = Pi - floor(Pi * ( 1.0 / 69.0 )) * 69.0;
+    vec4 Pi_inc1 = step( Pi, vec4( 69.0 - 1.5 ) ) * ( Pi + 1.0 );
+
+    // calculate the hash.
+    const vec4 OFFSET = vec4( 16.841230, 18.774548, 16.873274, 13.664607 );
+    const vec4 SCALE = vec4( 0.102007, 0.114473, 0.139651, 0.084550 );
+    Pi = ( Pi * SCALE ) + OFFSET;
+    Pi_inc1 = ( Pi_inc1 * SCALE ) + OFFSET;
+    Pi *= Pi;
+    Pi_inc1 *= Pi_inc1;
+    vec4 x0y0_x1y0_x0y1_x1y1 = vec4( Pi.x, Pi_inc1.x, Pi.x, Pi_inc1.x ) * vec4( Pi.yy, Pi_inc1.yy );
+    vec4 z0w0_z1w0_z0w1_z1w1 = vec4( Pi.z, Pi_inc1.z, Pi.z, Pi_inc1.z ) * vec4( Pi.ww, Pi_inc1.ww );
+    const vec4 SOMELARGEFLOATS = vec4( 56974.746094, 47165.636719, 55049.667969, 49901.273438 );
+    vec4 hashval = x0y0_x1y0_x0y1_x1y1 * z0w0_z1w0_z0w1_z1w1.xxxx;
+    vec4 lowz_loww_hash_0 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.x ) );
+    vec4 lowz_loww_hash_1 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.y ) );
+    vec4 lowz_loww_hash_2 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.z ) );
+    vec4 lowz_loww_hash_3 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.w ) );
+    hashval = x0y0_x1y0_x0y1_x1y1 * z0w0_z1w0_z0w1_z1w1.yyyy;
+    vec4 highz_loww_hash_0 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.x ) );
+    vec4 highz_loww_hash_1 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.y ) );
+    vec4 highz_loww_hash_2 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.z ) );
+    vec4 highz_loww_hash_3 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.w ) );
+    hashval = x0y0_x1y0_x0y1_x1y1 * z0w0_z1w0_z0w1_z1w1.zzzz;
+    vec4 lowz_highw_hash_0 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.x ) );
+    vec4 lowz_highw_hash_1 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.y ) );
+    vec4 lowz_highw_hash_2 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.z ) );
+    vec4 lowz_highw_hash_3 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.w ) );
+    hashval = x0y0_x1y0_x0y1_x1y1 * z0w0_z1w0_z0w1_z1w1.wwww;
+    vec4 highz_highw_hash_0 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.x ) );
+    vec4 highz_highw_hash_1 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.y ) );
+    vec4 highz_highw_hash_2 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.z ) );
+    vec4 highz_highw_hash_3 = fract( hashval * ( 1.0 / SOMELARGEFLOATS.w ) );
+
+    // calculate the gradients
+    lowz_loww_hash_0 -= 0.49999;
+    lowz_loww_hash_1 -= 0.49999;
+    lowz_loww_hash_2 -= 0.49999;
+    lowz_loww_hash_3 -= 0.49999;
+    highz_loww_hash_0 -= 0.49999;
+    highz_loww_hash_1 -= 0.49999;
+    highz_loww_hash_2 -= 0.49999;
+    highz_loww_hash_3 -= 0.49999;
+    lowz_highw_hash_0 -= 0.49999;
+    lowz_highw_hash_1 -= 0.49999;
+    lowz_highw_hash_2 -= 0.49999;
+    lowz_highw_hash_3 -= 0.49999;
+    highz_highw_hash_0 -= 0.49999;
+    highz_highw_hash_1 -= 0.49999;
+    highz_highw_hash_2 -= 0.49999;
+    highz_highw_hash_3 -= 0.49999;
+
+    vec4 grad_results_lowz_loww = inversesqrt( lowz_loww_hash_0 * lowz_loww_hash_0 + lowz_loww_hash_1 * lowz_loww_hash_1 + lowz_loww_hash_2 * lowz_loww_hash_2 + lowz_loww_hash_3 * lowz_loww_hash_3 );
+    grad_results_lowz_loww *= ( vec2( Pf.x, Pf_min1.x ).xyxy * lowz_loww_hash_0 + vec2( Pf.y, Pf_min1.y ).xxyy * lowz_loww_hash_1 + Pf.zzzz * lowz_loww_hash_2 + Pf.wwww * lowz_loww_hash_3 );
+
+    vec4 grad_results_highz_loww = inversesqrt( highz_loww_hash_0 * highz_loww_hash_0 + highz_loww_hash_1 * highz_loww_hash_1 + highz_loww_hash_2 * highz_loww_hash_2 + highz_loww_hash_3 * highz_loww_hash_3 );
+    grad_results_highz_loww *= ( vec2( Pf.x, Pf_min1.x ).xyxy * highz_loww_hash_0 + vec2( Pf.y, Pf_min1.y ).xxyy * highz_loww_hash_1 + Pf_min1.zzzz * highz_loww_hash_2 + Pf.wwww * highz_loww_hash_3 );
+
+    vec4 grad_results_lowz_highw = inversesqrt( lowz_highw_hash_0 * lowz_highw_hash_0 + lowz_highw_hash_1 * lowz_highw_hash_1 + lowz_highw_hash_2 * lowz_highw_hash_2 + lowz_highw_hash_3 * lowz_highw_hash_3 );
+    grad_results_lowz_highw *= ( vec2( Pf.x, Pf_min1.x ).xyxy * lowz_highw_hash_0 + vec2( Pf.y, Pf_min1.y ).xxyy * lowz_highw_hash_1 + Pf.zzzz * lowz_highw_hash_2 + Pf_min1.wwww * lowz_highw_hash_3 );
+
+    vec4 grad_results_highz_highw = inversesqrt( highz_highw_hash_0 * highz_highw_hash_0 + highz_highw_hash_1 * highz_highw_hash_1 + highz_highw_hash_2 * highz_highw_hash_2 + highz_highw_hash_3 * highz_highw_hash_3 );
+    grad_results_highz_highw *= ( vec2( Pf.x, Pf_min1.x ).xyxy * highz_highw_hash_0 + vec2( Pf.y, Pf_min1.y ).xxyy * highz_highw_hash_1 + Pf_min1.zzzz * highz_highw_hash_2 + Pf_min1.wwww * highz_highw_hash_3 );
+
+    // Classic Perlin Interpolation
+    vec4 blend = Pf * Pf * Pf * (Pf * (Pf * 6.0 - 15.0) + 10.0);
+    vec4 res0 = grad_results_lowz_loww + ( grad_results_lowz_highw - grad_results_lowz_loww ) * blend.wwww;
+    vec4 res1 = grad_results_highz_loww + ( grad_results_highz_highw - grad_results_highz_loww ) * blend.wwww;
+    res0 = res0 + ( res1 - res0 ) * blend.zzzz;
+    blend.zw = vec2( 1.0 ) - blend.xy;
+    return dot( res0, blend.zxzx * blend.wwyy );
+}
+
+// simple Fractional Brownian Motion - adapted from the slides
+float fBm(vec4 uv) {
+    float total = 0.0;
+    float lacunarity = 2;
+    int octaves = 8;
+    for(int i = 0; i < octaves; i++) {
+        float freq = pow(lacunarity, float(i));
+        float amp = pow(1/lacunarity, float(i));
+        total += Perlin4D(uv * freq) * amp;
+    }
+    return total;
+}
+
+void main() {    
+    float noise = fBm(0.5 * vec4(2*texCoords, time/4));
+    vec4 sky = 0.4 * texture(skybox, texCoords) + 0.6*vec4(skyColor, 1.0); // make more blueish than actual texture
+    
+    // sphere mapping for cloud texture
+    float phi = acos(texCoords.y);
+    float pheta = atan(texCoords.z/texCoords.x);
+    vec4 cloudColor = 0.5 * texture(cloudTexture, vec2(phi/6, (3-pheta)/3)) + 0.5 * vec4(1, 1, 1, 1.0);  // make more whitish as well
+    
+    // adding trailing around the edges of a cloud
+    if (noise > 0. && noise <= 0.25) {
+        // mix to get seemless transition between background sky and the cloud at the edges of the clouds
+        float scale = (noise / 0.25);
+        FragColor = (1-scale) * sky + scale * cloudColor; 
+    } else if (noise > 0.25) {
+        // show the cloud texture if greater than the offset.
+        FragColor = cloudColor; 
+    } else {
+        FragColor = sky;
+    }
+}
+)"
\ No newline at end of file
@@ -0,0 +1,136 @@
+R"(
+#version 330 core
+
+// the terrain shading as it was before the splat weights (see src/terrain_fshader.glsl), kept for
+// `headless --splat reference`: every level samples its layers again, here from the same texture array
+uniform sampler2DArray layers;
+const int GRASS = 0, ROCK = 1, SAND = 2, SNOW = 3;
+uniform sampler2DArray horizons;
+
+// viewPos, waterHeight, skyColor and lightPos come from the Camera and Material blocks (see uniform_blocks.glsl)
+
+in vec2 uv;
+in vec3 fragPos;
+in float height;
+in vec3 normal;
+in float slope; 
+in float wetness;
+in vec2 horizonUV;
+in vec3 distanceFromCamera;
+
+out vec4 color;
+
+// prevent lines between two levels by blending several levels together
+vec4 mixBetweenLevels(vec4 col_middle, float height, vec4 col_lower, float height_lower, vec4 col_higher, float height_higher) {
+    float halfDistance = (height_higher - height_lower) / 2.0f;
+    if (height < (height_lower + halfDistance)) {
+        float pos = height - height_lower;
+        float posScaled = pos/halfDistance;
+        return col_middle * posScaled + col_lower * (1 - posScaled);
+    } else {
+        float pos = height_higher - height;
+        float posScaled = pos/halfDistance;
+        return col_middle * posScaled + col_higher * (1 - posScaled);
+    }
+}
+
+// mix with grass or snow based on level so that grass/snow appears deposited on the surface
+vec4 mixWithGrassAndSnow(int base, vec2 uv, float height, float slope) {
+    float mixWithGrassLevel = 1.6f;
+    float mixWithSnowLevel = mixWithGrassLevel + 1.6f;
+
+    vec4 with_grass = mix(texture(layers, vec3(uv, base)), texture(layers, vec3(uv, GRASS)), slope);
+    vec4 with_snow = mix(texture(layers, vec3(uv, base)), texture(layers, vec3(uv, SNOW)), slope);
+    vec4 col = texture(layers, vec3(uv, base));
+
+    // we have to mix between levels here again as otherwise we get a line here also...
+    return mixBetweenLevels(col, height, with_grass, mixWithGrassLevel,  with_snow, mixWithSnowLevel);
+}
+
+
+void main() {
+
+    /*
+    the shading is as such:
+        we have a pure snow level, followed by a rock, grass, sand and pure sand level
+        To make the rock, grass, sand levels in the middle 'impure', I mix them with the snow and the 
+        grass texture based on a seperate heights - see mixWithGrassAndSnowFunction => this looks like deposits 
+        on the terrain.
+    */
+
+    float pureSandLevel = waterHeight + 0.01f; // beach around the water => pure sand
+    float sandLevel = pureSandLevel + 0.15f;   // sand with some grass or snow
+    float grassLevel = sandLevel + 0.15f;      // grass with some grass or snow (preferably snow for some 'snowy grass')
+    float rockLevel = grassLevel + 1.6f;       // rock with some grass or snow
+    float snowLevel = rockLevel + 0.8f;        // pure snow
+
+    vec4 col;
+
+    vec4 pureSnowCol = texture(layers, vec3(uv, SNOW));
+    vec4 rockCol = mixWithGrassAndSnow(ROCK, uv, height, slope/10.0f);
+    vec4 grassCol = mixWithGrassAndSnow(GRASS, uv, height, slope);
+    vec4 sandCol = mixWithGrassAndSnow(SAND, uv, height, slope);
+    vec4 pureSandCol = texture(layers, vec3(uv, SAND));
+
+    // Blinn-Phong constants are placed here so we can update them at each level
+    float ka = 0.05f, kd = 0.15f, ks = 0.45f, p = 0.8f;
+    
+    if (height > snowLevel) {
+        col = pureSnowCol;
+    } else if (height >= grassLevel && height <= snowLevel) {
+        // rock but blend with grass below and snow above
+        col = mixBetweenLevels(rockCol, height, grassCol, grassLevel, pureSnowCol, snowLevel);
+    } else if (height >= sandLevel && height <= rockLevel) {
+        // texture with grass but blend with rock above and blend with sand below
+        col = mixBetweenLevels(grassCol, height, sandCol, sandLevel, rockCol, rockLevel);
+    } else if (height >= pureSandLevel && height <= grassLevel) {
+        // texture with sand but blend with grass above and blend with pureSand below
+        col = mixBetweenLevels(sandCol, height, pureSandCol, pureSandLevel, grassCol, grassLevel);
+    } else { 
+        // height <= pureSandLevel
+        col = pureSandCol;
+    }
+
+    // the wetness of the erosion, as in src/terrain_fshader.glsl
+    vec4 washedCol = mix(pureSandCol, texture(layers, vec3(uv, ROCK)), clamp((height - sandLevel) / (grassLevel - sandLevel), 0.0f, 1.0f));
+    col = mix(col, washedCol, 0.6f * wetness);
+    col *= 1.0f - 0.3f * wetness;
+
+    // Blinn-Phong calculation
+    vec3 lightDir = normalize(lightPos - fragPos);
+    float diffuse = kd * max(0.0f, dot(normal, lightDir));
+
+    vec3 viewDirection = viewPos - fragPos;
+    vec3 halfway = normalize(lightDir + viewDirection);
+    float specular = ks * max(0.0f, pow(dot(normal, halfway), p));
+
+    // the horizons of the chunk, as in src/terrain_fshader.glsl
+    vec4 horizonsA = texture(horizons, vec3(horizonUV, 0)), horizonsB = texture(horizons, vec3(horizonUV, 1));
+    float horizon[8] = float[8](horizonsA.x, horizonsA.y, horizonsA.z, horizonsA.w,
+                                horizonsB.x, horizonsB.y, horizonsB.z, horizonsB.w);
+    float azimuth = mod(atan(lightDir.y, lightDir.x) / (3.14159265f / 4.0f) + 8.0f, 8.0f);
+    int d = int(azimuth);
+    float sunHorizon = mix(horizon[d % 8], horizon[(d + 1) % 8], azimuth - float(d));
+    float sun = smoothstep(sunHorizon - 0.04f, sunHorizon + 0.04f, lightDir.z);
+    float sky = 1.0f - (dot(horizonsA, horizonsA) + dot(horizonsB, horizonsB)) / 8.0f;
+    float lit = (1.0f - 0.6f * (1.0f - sun)) * (1.0f - 0.5f * (1.0f - sky));
+
+    // I use the skyColor as the ambient color to make the fog look better.
+    col = ka*sky*vec4(skyColor, 1.0f) + lit*diffuse*col + lit*specular*col;
+
+    // visibility calculation => add fog so that we can hide 'render distance'  
+    // we mix the color with the skycolor based on the distance from the camera
+    // we use a visibility formula to detect how far an object is from the camera
+    // 1 => render normaly, 0 => fade into the skycolor
+    // visibility takes the distance from the camera and use an exponential decrease so that the fog scaling looks more natural
+    // visibility = exp(-pow(distance * density, gradient)) is such a formula
+    // density = thickness of the fog, higher value means less visiblr
+    // gradient = how quickly the visibility decreases with distance
+    float density = 0.1;
+    float gradient = 1.5;
+    float distance = length(distanceFromCamera.xyz);
+    float visibility = exp(-pow(distance * density, gradient));
+    visibility = clamp(visibility, 0.0, 1.0);
+    color = mix(vec4(skyColor, 1.0f),  col, visibility);
+}
+)"
\ No newline at end of file
@@ -0,0 +1,286 @@
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// BC1 (DXT1) and BC3 (DXT5) block compression on the CPU, nothing in here touches OpenGL
+//
+// Every 4x4 block is encoded independently: the colour endpoints are the extremes of the block along its
+// principal axis, refined once by least squares on the chosen indices, and BC3 adds an 8 level alpha ramp
+// between the alpha extremes. It is not a production quality encoder but it is fast and close enough for
+// terrain textures. Images are RGBA8, rows in whatever order they will be uploaded in.
+
+enum BlockFormat {
+    BLOCK_BC1 = 1, ///< RGB, 8 bytes per block
+    BLOCK_BC3 = 3  ///< RGBA, 16 bytes per block
+};
+
+inline int blockBytes(BlockFormat format) {
+    return format == BLOCK_BC1 ? 8 : 16;
+}
+
+inline size_t compressedSize(BlockFormat format, int width, int height) {
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+namespace bc {
+
+inline uint16_t pack565(const float c[3]) {
+    int r = std::min(31, std::max(0, (int)std::lround(c[0] * 31.0f / 255.0f)));
+    int g = std::min(63, std::max(0, (int)std::lround(c[1] * 63.0f / 255.0f)));
+    int b = std::min(31, std::max(0, (int)std::lround(c[2] * 31.0f / 255.0f)));
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void unpack565(uint16_t v, int c[3]) {
+    int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+// the 4 colour palette of a BC1 block in 4 colour mode
+inline void palette4(uint16_t c0, uint16_t c1, int palette[4][3]) {
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for (int k = 0; k < 3; ++k) {
+        palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+        palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+    }
+}
+
+// indices of the closest palette entries, as the 32 bit word of a BC1 block
+inline uint32_t pickIndices(const unsigned char block[16][4], const int palette[4][3], int indices[16]) {
+    uint32_t bits = 0;
+    for (int p = 0; p < 16; ++p) {
+        int best = 0, bestError = INT32_MAX;
+        for (int i = 0; i < 4; ++i) {
+            int dr = block[p][0] - palette[i][0], dg = block[p][1] - palette[i][1], db = block[p][2] - palette[i][2];
+            int error = dr * dr + dg * dg + db * db;
+            if (error < bestError) {
+                bestError = error;
+                best = i;
+            }
+        }
+        indices[p] = best;
+        bits |= (uint32_t)best << (2 * p);
+    }
+    return bits;
+}
+
+// always in 4 colour mode (c0 > c1), BC3 requires it and for BC1 we do not use the punch through alpha
+inline void encodeColor(const unsigned char block[16][4], unsigned char *out) {
+    float mean[3] = { 0, 0, 0 };
+    for (int p = 0; p < 16; ++p) for (int k = 0; k < 3; ++k) mean[k] += block[p][k] / 16.0f;
+
+    // principal axis by power iteration on the covariance
+    float cov[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int p = 0; p < 16; ++p) {
+        float r = block[p][0] - mean[0], g = block[p][1] - mean[1], b = block[p][2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+    float axis[3] = { 1, 1, 1 };
+    for (int it = 0; it < 8; ++it) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+        if (length < 1e-6f) break;
+        axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+    }
+
+    float lo = 1e30f, hi = -1e30f;
+    for (int p = 0; p < 16; ++p) {
+        float t = (block[p][0] - mean[0]) * axis[0] + (block[p][1] - mean[1]) * axis[1] + (block[p][2] - mean[2]) * axis[2];
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+    }
+    float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    if (axisLength2 > 0.0f) { lo /= axisLength2; hi /= axisLength2; }
+    float e0[3], e1[3];
+    for (int k = 0; k < 3; ++k) {
+        e0[k] = mean[k] + hi * axis[k];
+        e1[k] = mean[k] + lo * axis[k];
+    }
+
+    uint16_t c0 = pack565(e0), c1 = pack565(e1);
+    int palette[4][3], indices[16];
+    palette4(c0, c1, palette);
+    pickIndices(block, palette, indices);
+
+    // one least squares pass: the endpoints that best fit the chosen interpolation weights
+    static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float aa = 0, ab = 0, bb = 0, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+    for (int p = 0; p < 16; ++p) {
+        float a = weights[indices[p]], b = 1.0f - a;
+        aa += a * a; ab += a * b; bb += b * b;
+        for (int k = 0; k < 3; ++k) { ax[k] += a * block[p][k]; bx[k] += b * block[p][k]; }
+    }
+    float det = aa * bb - ab * ab;
+    if (std::fabs(det) > 1e-6f) {
+        for (int k = 0; k < 3; ++k) {
+            e0[k] = (ax[k] * bb - bx[k] * ab) / det;
+            e1[k] = (bx[k] * aa - ax[k] * ab) / det;
+        }
+        uint16_t r0 = pack565(e0), r1 = pack565(e1);
+        int refined[4][3], refinedIndices[16];
+        palette4(r0, r1, refined);
+        pickIndices(block, refined, refinedIndices);
+        // keep whichever is closer
+        long long before = 0, after = 0;
+        for (int p = 0; p < 16; ++p) {
+            for (int k = 0; k < 3; ++k) {
+                int d0 = block[p][k] - palette[indices[p]][k], d1 = block[p][k] - refined[refinedIndices[p]][k];
+                before += d0 * d0;
+                after += d1 * d1;
+            }
+        }
+        if (after < before) {
+            c0 = r0; c1 = r1;
+            memcpy(palette, refined, sizeof(palette));
+        }
+    }
+
+    uint32_t bits;
+    if (c0 == c1) {
+        bits = 0; // a flat block, every pixel is c0
+    } else {
+        if (c0 < c1) {
+            std::swap(c0, c1);
+            palette4(c0, c1, palette);
+        }
+        bits = pickIndices(block, palette, indices);
+    }
+    out[0] = c0 & 0xff; out[1] = c0 >> 8;
+    out[2] = c1 & 0xff; out[3] = c1 >> 8;
+    for (int k = 0; k < 4; ++k) out[4 + k] = (bits >> (8 * k)) & 0xff;
+}
+
+// the 8 level alpha block of BC3 (a0 > a1)
+inline void encodeAlpha(const unsigned char block[16][4], unsigned char *out) {
+    int a0 = 0, a1 = 255;
+    for (int p = 0; p < 16; ++p) {
+        a0 = std::max(a0, (int)block[p][3]);
+        a1 = std::min(a1, (int)block[p][3]);
+    }
+    out[0] = (unsigned char)a0;
+    out[1] = (unsigned char)a1;
+    uint64_t bits = 0;
+    if (a0 > a1) {
+        int ramp[8] = { a0, a1 };
+        for (int i = 1; i < 7; ++i) ramp[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        for (int p = 0; p < 16; ++p) {
+            int best = 0, bestError = 1 << 30;
+            for (int i = 0; i < 8; ++i) {
+                int error = std::abs(block[p][3] - ramp[i]);
+                if (error < bestError) { bestError = error; best = i; }
+            }
+            bits |= (uint64_t)best << (3 * p);
+        }
+    }
+    for (int k = 0; k < 6; ++k) out[2 + k] = (bits >> (8 * k)) & 0xff;
+}
+
+// the 4x4 block at (bx, by), pixels past the border repeat the last row/column
+inline void fetchBlock(const unsigned char *rgba, int width, int height, int bx, int by, unsigned char block[16][4]) {
+    for (int j = 0; j < 4; ++j) {
+        int y = std::min(4 * by + j, height - 1);
+        for (int i = 0; i < 4; ++i) {
+            int x = std::min(4 * bx + i, width - 1);
+            memcpy(block[4 * j + i], rgba + 4 * ((size_t)y * width + x), 4);
+        }
+    }
+}
+
+} // namespace bc
+
+// compresses one image, block rows are spread over the pool when there is one
+inline void compressImage(const unsigned char *rgba, int width, int height, BlockFormat format, unsigned char *out,
+                          ThreadPool *pool = nullptr) {
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    int bytes = blockBytes(format);
+    auto rows = [&](int begin, int end) {
+        unsigned char block[16][4];
+        for (int by = begin; by < end; ++by) {
+            for (int bx = 0; bx < blocksX; ++bx) {
+                unsigned char *dst = out + ((size_t)by * blocksX + bx) * bytes;
+                bc::fetchBlock(rgba, width, height, bx, by, block);
+                if (format == BLOCK_BC3) {
+                    bc::encodeAlpha(block, dst);
+                    dst += 8;
+                }
+                bc::encodeColor(block, dst);
+            }
+        }
+    };
+    if (pool) pool->parallelFor(0, blocksY, 4, rows);
+    else rows(0, blocksY);
+}
+
+// back to RGBA8, used to measure the error of the encoder
+inline void decompressImage(const unsigned char *blocks, int width, int height, BlockFormat format, unsigned char *rgba) {
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    int bytes = blockBytes(format);
+    for (int by = 0; by < blocksY; ++by) {
+        for (int bx = 0; bx < blocksX; ++bx) {
+            const unsigned char *src = blocks + ((size_t)by * blocksX + bx) * bytes;
+            int alpha[16];
+            for (int p = 0; p < 16; ++p) alpha[p] = 255;
+            if (format == BLOCK_BC3) {
+                int a0 = src[0], a1 = src[1];
+                int ramp[8] = { a0, a1 };
+                if (a0 > a1) {
+                    for (int i = 1; i < 7; ++i) ramp[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+                } else {
+                    for (int i = 1; i < 5; ++i) ramp[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+                    ramp[6] = 0;
+                    ramp[7] = 255;
+                }
+                uint64_t bits = 0;
+                for (int k = 0; k < 6; ++k) bits |= (uint64_t)src[2 + k] << (8 * k);
+                for (int p = 0; p < 16; ++p) alpha[p] = ramp[(bits >> (3 * p)) & 7];
+                src += 8;
+            }
+            uint16_t c0 = src[0] | (src[1] << 8), c1 = src[2] | (src[3] << 8);
+            uint32_t bits = src[4] | (src[5] << 8) | (src[6] << 16) | ((uint32_t)src[7] << 24);
+            int palette[4][3];
+            if (c0 > c1 || format == BLOCK_BC3) {
+                bc::palette4(c0, c1, palette);
+            } else {
+                bc::unpack565(c0, palette[0]);
+                bc::unpack565(c1, palette[1]);
+                for (int k = 0; k < 3; ++k) {
+                    palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+                    palette[3][k] = 0;
+                }
+            }
+            for (int j = 0; j < 4; ++j) {
+                for (int i = 0; i < 4; ++i) {
+                    int x = 4 * bx + i, y = 4 * by + j;
+                    if (x >= width || y >= height) continue;
+                    int p = 4 * j + i, index = (bits >> (2 * p)) & 3;
+                    unsigned char *dst = rgba + 4 * ((size_t)y * width + x);
+                    for (int k = 0; k < 3; ++k) dst[k] = (unsigned char)palette[index][k];
+                    dst[3] = (unsigned char)alpha[p];
+                }
+            }
+        }
+    }
+}
+
+// BC3 when some pixel is not opaque, BC1 otherwise
+inline BlockFormat chooseBlockFormat(const unsigned char *rgba, size_t pixels) {
+    for (size_t p = 0; p < pixels; ++p) {
+        if (rgba[4 * p + 3] != 255) return BLOCK_BC3;
+    }
+    return BLOCK_BC1;
+}
+
+#endif
@@ -1,14 +1,19 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
-#include "utility.h"
+#include <OpenGP/types.h>
+#include <OpenGP/GL/Eigen.h>
+#include <cmath>
+
+#include "Simulation.h"
+
+// no GL in here, the CPU library and the benchmarks use the camera without a context (see src/CMakeLists.txt)
 
 class Camera {
 public:
-    Vec3 cameraPos, cameraFront, cameraUp;
+    OpenGP::Vec3 cameraPos, cameraFront, cameraUp;
 
-    float fov, speed;
-    const float speedIncrement = 0.005f, mouseSensitivity = 0.005f;
+    float fov;
 
     // used for typical mouse control
     // yaw controls the side movement, yaw = 0 means we are looking forward, yaw = 90 means we are looking east, yaw = 270 means we are looking west
@@ -18,27 +23,37 @@ public:
     float nearPlane =0.1f, farPlane = 60.0f, aspectRatio;
 public:
     Camera(int _width, int _height) {
-        cameraPos = Vec3(0.0f, 0.0f, 3.0f);
-        cameraFront = Vec3(0.0f, -1.0f, 0.0f);
-        cameraUp = Vec3(0.0f, 0.0f, 1.0f);
+        cameraPos = OpenGP::Vec3(0.0f, 0.0f, 3.0f);
+        cameraFront = OpenGP::Vec3(0.0f, -1.0f, 0.0f);
+        cameraUp = OpenGP::Vec3(0.0f, 0.0f, 1.0f);
         fov = 80.0f;
-        speed = 0.01f;
-        yaw = 0.0f;
+        yaw = M_PI; // the cameraFront above
         pitch = 0.0f;
         aspectRatio = (float)_width / (float) _height;
     }
 
-    void updateCameraAngles(Vec2 changeInMousePosition) {
-        changeInMousePosition = mouseSensitivity * changeInMousePosition;
+    // the camera of a frame comes from the simulation thread (see Simulation.h)
+    void setState(const CameraState &state) {
+        cameraPos = state.position;
+        fov = state.fov;
+        setAngles(state.yaw, state.pitch);
+    }
 
-        yaw += changeInMousePosition.x();   // change the yaw/sideways angle based on change in x
-        pitch -= changeInMousePosition.y(); // change the pitch/vertical angle based on change in y
+    CameraState state() const {
+        CameraState state;
+        state.position = cameraPos;
+        state.yaw = yaw;
+        state.pitch = pitch;
+        state.fov = fov;
+        return state;
+    }
 
-        // we prevent the camera from turning over.
-        if(pitch > M_PI/2.0f - 0.01f)  pitch =  M_PI/2.0f - 0.01f;
-        if(pitch <  -M_PI/2.0f + 0.01f) pitch =  -M_PI/2.0f + 0.01f;
+    // used to script the camera, same angles as CameraState
+    void setAngles(float _yaw, float _pitch) {
+        yaw = _yaw;
+        pitch = _pitch;
 
-        cameraFront = Vec3( 
+        cameraFront = OpenGP::Vec3(
             sin(yaw) * cos(pitch),
             cos(yaw) * cos(pitch),
             sin(pitch)
@@ -48,56 +63,20 @@ public:
     void invertPitch() {
         pitch = -pitch;
 
-        cameraFront = Vec3(
+        cameraFront = OpenGP::Vec3(
             sin(yaw) * cos(pitch),
             cos(yaw) * cos(pitch),
             sin(pitch)
         );
     }
 
-    void updateCamera(KeyEvent k) {
-        // WASD
-        if (k.key == GLFW_KEY_W) {
-            cameraPos = cameraPos + speed * cameraFront.normalized();
-        }
-
-        if (k.key == GLFW_KEY_A) {
-            cameraPos = cameraPos - speed * cameraFront.normalized().cross(cameraUp);
-        }
-
-        if (k.key == GLFW_KEY_S) {
-            cameraPos = cameraPos - speed * cameraFront.normalized();
-        }
-
-        if (k.key == GLFW_KEY_D) {
-            cameraPos = cameraPos + speed * cameraFront.normalized().cross(cameraUp);
-        }
-
-        // arrow movements => up decreases the fov, right increases the speed
-        if (k.key == GLFW_KEY_UP) {
-            fov = std::max(1.0f, fov-1.0f);
-        }
-
-        if (k.key == GLFW_KEY_DOWN) {
-            fov = std::min(80.0f, fov + 1);
-        }
-
-        if (k.key == GLFW_KEY_RIGHT) {
-            speed = std::min(1.0f, speed + speedIncrement);
-        }
-
-        if (k.key == GLFW_KEY_LEFT) {
-            speed = std::max(0.001f, speed - speedIncrement);
-        }
-    }
-
-    Mat4x4 viewMatrix() {
-        Vec3 look = cameraFront + cameraPos;
-        return lookAt(cameraPos, look, cameraUp);
+    OpenGP::Mat4x4 viewMatrix() const {
+        OpenGP::Vec3 look = cameraFront + cameraPos;
+        return OpenGP::lookAt(cameraPos, look, cameraUp);
     }
 
-    Mat4x4 projectionMatrix() {
-        return perspective(fov, aspectRatio, nearPlane, farPlane);
+    OpenGP::Mat4x4 projectionMatrix() const {
+        return OpenGP::perspective(fov, aspectRatio, nearPlane, farPlane);
     }
 };
 
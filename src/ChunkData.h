@@ -0,0 +1,211 @@
+#ifndef CHUNKDATA_H
+#define CHUNKDATA_H
+
+#include <OpenGP/types.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "HeightfieldGenerator.h"
+#include "MappedFile.h"
+
+// the CPU half of a terrain chunk, nothing in here touches OpenGL so it can run on worker threads
+
+inline int index(int i, int j, int cols) {
+    return i + j * cols;
+}
+
+// chunks are addressed by a level of detail and integer coordinates, chunk (level, x, y) covers the samples
+// [x * quads, (x + 1) * quads] x [y * quads, (y + 1) * quads] of the world grid at level, whose spacing is
+// 2^level times the spacing of level 0. Every chunk has the same number of vertices whatever its level.
+struct ChunkKey {
+    int level, x, y;
+
+    bool operator==(const ChunkKey &other) const { return level == other.level && x == other.x && y == other.y; }
+    bool operator!=(const ChunkKey &other) const { return !(*this == other); }
+};
+
+struct ChunkKeyHash {
+    size_t operator()(const ChunkKey &key) const {
+        // shifted unsigned, the keys around the origin are negative
+        return std::hash<unsigned long long>()(((unsigned long long)(unsigned int)key.x << 32) ^ (unsigned int)key.y ^
+                                               ((unsigned long long)(unsigned int)key.level << 58));
+    }
+};
+
+inline float levelSpacing(float spacing, int level) {
+    // a power of two scaling is exact, so sample k of level l + 1 lands exactly on sample 2k of level l
+    return std::ldexp(spacing, level);
+}
+
+// what the GPU stores of a terrain vertex, 6 bytes instead of a Vec3 position and a Vec3 normal
+//
+// x and y are not stored at all: terrain_vshader.glsl derives them from gl_VertexID (the index into the
+// (quads + 1)^2 grid of the chunk) and the origin and spacing of the chunk, with the same expression as buildChunk.
+// The height is an unsigned offset from the base of the chunk on a grid of terrainHeightStep that is the same for
+// the whole world, so a vertex shared by two chunks decodes to the same height in both and no cracks open.
+// The normal always points up, so it is stored hemi-octahedral in two signed bytes. The wetness is how much water
+// the erosion ran over the vertex (see Erosion.h), 0 without erosion.
+struct TerrainVertex {
+    uint16_t height;  ///< heightBase + height steps of terrainHeightStep
+    int8_t normal[2]; ///< hemi-octahedral, see encodeNormal
+    uint8_t wetness;  ///< 0 to 255
+    uint8_t unused;
+};
+
+static_assert(sizeof(TerrainVertex) == 6, "the vertex layout is fixed");
+
+const float terrainHeightStep = 1.0f / 4096.0f; ///< so a chunk can span 16 units of height
+
+// the normal projected on the octahedron |x| + |y| + z = 1 and flattened on its xy plane
+inline void encodeNormal(const OpenGP::Vec3 &n, int8_t out[2]) {
+    float scale = 1.0f / (std::abs(n.x()) + std::abs(n.y()) + std::max(n.z(), 0.0f));
+    out[0] = (int8_t)std::lround(127.0f * n.x() * scale);
+    out[1] = (int8_t)std::lround(127.0f * n.y() * scale);
+}
+
+// what terrain_vshader.glsl does with the two bytes
+inline OpenGP::Vec3 decodeNormal(const int8_t in[2]) {
+    float x = std::max(in[0] / 127.0f, -1.0f), y = std::max(in[1] / 127.0f, -1.0f);
+    return OpenGP::Vec3(x, y, 1.0f - std::abs(x) - std::abs(y)).normalized();
+}
+
+inline float decodeHeight(int heightBase, uint16_t height) {
+    return (float)(heightBase + (int)height) * terrainHeightStep;
+}
+
+// the occluder of a chunk is a grid of chunkOccluderCells x chunkOccluderCells squares under its surface, every
+// corner of the grid at the lowest vertex of the squares of the chunk around it (see Occlusion.h)
+const int chunkOccluderCells = 8;
+
+struct ChunkData {
+    ChunkKey key;
+    std::vector<TerrainVertex> vertices; ///< (quads + 1)^2, row by row like index()
+    int heightBase;                      ///< in steps of terrainHeightStep
+    float minHeight, maxHeight;
+    int clampedHeights = 0;              ///< vertices more than 16 units above the lowest one of the chunk
+    std::vector<float> occluderHeights;  ///< (chunkOccluderCells + 1)^2, row by row
+    std::vector<unsigned char> horizons; ///< the horizon map, empty when the chunk has none (see Horizon.h)
+    uint32_t horizonKey = 0;             ///< of the HorizonParams it was baked with, 0 without one
+
+    // read from the tile store the vertices and the horizon map stay in the mapped file and go from there to the GPU
+    // (see TileStore.h)
+    std::unique_ptr<MappedFile> mapped;
+    const TerrainVertex *mappedVertices = nullptr;
+    size_t mappedCount = 0;
+    const unsigned char *mappedHorizons = nullptr;
+    size_t mappedHorizonBytes = 0;
+
+    const TerrainVertex *vertexData() const { return mapped ? mappedVertices : vertices.data(); }
+    size_t vertexCount() const { return mapped ? mappedCount : vertices.size(); }
+    const unsigned char *horizonData() const { return mappedHorizons ? mappedHorizons : horizons.data(); }
+    size_t horizonBytes() const { return mappedHorizons ? mappedHorizonBytes : horizons.size(); }
+};
+
+// the corners of the occluder grid, from the heights of the vertices of the chunk. A triangle of the grid is under
+// the triangles of the chunk over the same square: its corners are at most the lowest vertex of that square, and
+// the stitched edges only move vertices to others of the same square. Half a step lower for the rounding
+inline void buildOccluder(const std::vector<float> &heights, int quads, std::vector<float> &occluder) {
+    int cols = quads + 1, cells = chunkOccluderCells, size = quads / cells;
+    std::vector<float> cellMin(cells * cells, std::numeric_limits<float>::infinity());
+    for (int j = 0; j < cols; ++j) {
+        for (int i = 0; i < cols; ++i) {
+            float h = heights[index(i, j, cols)];
+            // a vertex on the border of two squares counts for both
+            for (int cj = std::max(0, (j - 1) / size); cj <= std::min(cells - 1, j / size); ++cj) {
+                for (int ci = std::max(0, (i - 1) / size); ci <= std::min(cells - 1, i / size); ++ci) {
+                    float &m = cellMin[index(ci, cj, cells)];
+                    m = std::min(m, h);
+                }
+            }
+        }
+    }
+    occluder.assign((cells + 1) * (cells + 1), std::numeric_limits<float>::infinity());
+    for (int cj = 0; cj < cells; ++cj) {
+        for (int ci = 0; ci < cells; ++ci) {
+            float m = cellMin[index(ci, cj, cells)] - 0.5f * terrainHeightStep;
+            for (int c = 0; c < 4; ++c) {
+                float &corner = occluder[index(ci + (c & 1), cj + (c >> 1), cells + 1)];
+                corner = std::min(corner, m);
+            }
+        }
+    }
+}
+
+// we need to build the grid with GL_TRIANGLE_STRIP
+// the best way is to build each row into a strip
+// then concatenate the strips
+// opengl provides  glEnable(GL_PRIMITIVE_RESTART) and  glPrimitiveRestartIndex(index)
+// such that when the given index is reached, the next primitive is built
+// every chunk has the same topology, so this is computed once and shared
+inline std::vector<unsigned int> gridStripIndices(int quads, unsigned int restart) {
+    int cols = quads + 1;
+    std::vector<unsigned int> indices;
+    indices.reserve(quads * (2 * cols + 1));
+
+    for (int j = 0; j < quads; ++j) {
+        for (int i = 0; i < cols; ++i) {
+            indices.push_back(index(i, j, cols));
+            indices.push_back(index(i, j + 1, cols));
+        }
+
+        // A new strip will begin when this index is reached
+        indices.push_back(restart);
+    }
+    return indices;
+}
+
+// the vertices of one chunk from the heights of its samples and the ring of samples around them, which the normals
+// need ((quads + 3)^2, row by row like generateGrid); wetness (optional) is the one of the (quads + 1)^2 samples
+inline void buildChunkFromApron(ChunkKey key, int quads, float spacing, const float *apron, const float *wetness,
+                                ChunkData &chunk) {
+    int cols = quads + 1;
+    spacing = levelSpacing(spacing, key.level);
+    std::vector<float> heights(cols * cols), normals(3 * cols * cols);
+    HeightfieldGenerator::apronNormals(apron, cols, cols, spacing, heights.data(), normals.data());
+
+    chunk.key = key;
+    chunk.minHeight = *std::min_element(heights.begin(), heights.end());
+    chunk.maxHeight = *std::max_element(heights.begin(), heights.end());
+    buildOccluder(heights, quads, chunk.occluderHeights);
+
+    // every vertex is rounded to the nearest step of the world wide grid, the base is the lowest of them
+    chunk.heightBase = (int)std::lround(chunk.minHeight / terrainHeightStep);
+    chunk.clampedHeights = 0;
+    chunk.mapped.reset();
+    chunk.mappedHorizons = nullptr;
+    chunk.horizons.clear();
+    chunk.horizonKey = 0;
+    chunk.vertices.resize(cols * cols);
+    for (int k = 0; k < cols * cols; ++k) {
+        long steps = std::lround(heights[k] / terrainHeightStep) - chunk.heightBase;
+        if (steps > 65535) {
+            steps = 65535;
+            chunk.clampedHeights++;
+        }
+        TerrainVertex &vertex = chunk.vertices[k];
+        vertex.height = (uint16_t)steps;
+        encodeNormal(OpenGP::Vec3(normals[3 * k], normals[3 * k + 1], normals[3 * k + 2]), vertex.normal);
+        vertex.wetness = wetness ? (uint8_t)std::lround(255.0f * std::min(1.0f, std::max(0.0f, wetness[k]))) : 0;
+        vertex.unused = 0;
+    }
+    // the box has to hold the rounded heights
+    chunk.minHeight = decodeHeight(chunk.heightBase, 0);
+    chunk.maxHeight += 0.5f * terrainHeightStep;
+}
+
+// heights and normals of one chunk, runs on whatever thread calls it
+// spacing is the one of level 0
+inline void buildChunk(const HeightfieldGenerator &generator, ChunkKey key, int quads, float spacing, ChunkData &chunk) {
+    int apronCols = quads + 3;
+    std::vector<float> apron(apronCols * apronCols);
+    generator.generateGrid(key.x * quads - 1, key.y * quads - 1, apronCols, apronCols, levelSpacing(spacing, key.level),
+                           apron.data());
+    buildChunkFromApron(key, quads, spacing, apron.data(), nullptr, chunk);
+}
+
+#endif
@@ -0,0 +1,388 @@
+#ifndef CHUNKMANAGER_H
+#define CHUNKMANAGER_H
+
+#include "utility.h"
+#include "ChunkData.h"
+#include "Erosion.h"
+#include "Horizon.h"
+#include "TerrainLOD.h"
+#include "TextureArray.h"
+#include "ThreadPool.h"
+#include "TileStore.h"
+
+#include <OpenGP/GL/UploadRing.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+struct ChunkStats {
+    int tilesResident = 0;
+    int tilesBuilding = 0;
+    int tilesVisible = 0;
+    int tilesUploaded = 0;      ///< this frame
+    int tilesFromStore = 0;     ///< of the uploaded ones, mapped from the tile store instead of built
+    int tilesEvicted = 0;       ///< this frame
+    float tilesBuiltPerSecond = 0.0f;
+    size_t uploadBytes = 0;     ///< this frame
+    size_t residentBytes = 0;   ///< vertex data (see TerrainVertex) and horizon maps
+    size_t horizonBytes = 0;    ///< the part of residentBytes in horizon maps
+    size_t indexBytes = 0;      ///< the one element buffer all the chunks share
+    size_t trianglesSubmitted = 0; ///< this frame, over all the passes
+};
+
+// the attribute locations of TerrainVertex in terrain_vshader.glsl
+enum TerrainAttribute {
+    TERRAIN_HEIGHT_ATTRIBUTE = 0,
+    TERRAIN_NORMAL_ATTRIBUTE = 1,
+    TERRAIN_WETNESS_ATTRIBUTE = 2
+};
+
+// the texture unit of the horizon maps in terrain_fshader.glsl, the splat layers are on 0 (see TerrainMaterial)
+const GLuint terrainHorizonUnit = 1;
+
+// 16 bit indices, a chunk has far fewer than 65535 vertices
+const GLushort chunkIndexRestart = 0xFFFF;
+
+// the uniforms of terrain_vshader.glsl that change from chunk to chunk, looked up once per program
+struct ChunkUniforms {
+    GLint origin = -1, spacing = -1, heightBase = -1;
+
+    explicit ChunkUniforms(const Shader *shader = nullptr) {
+        if (!shader) return;
+        origin = shader->uniform_location("chunkOrigin");
+        spacing = shader->uniform_location("chunkSpacing");
+        heightBase = shader->uniform_location("heightBase");
+    }
+};
+
+// a chunk whose vertices live on the GPU
+struct Chunk {
+    ChunkKey key;
+    std::unique_ptr<VertexArrayObject> vao;
+    std::unique_ptr<GenericArrayBuffer> vertices; ///< TerrainVertex
+    std::unique_ptr<TextureArray> horizons;       ///< the horizon map, null without one
+    int heightBase;
+    float minHeight, maxHeight;
+    std::vector<float> occluderHeights; ///< see buildOccluder
+    size_t bytes;
+    size_t horizonBytes; ///< the part of bytes in the horizon map
+    unsigned int lastUsedFrame;
+};
+
+// a chunk to draw this frame
+struct VisibleChunk {
+    Chunk *chunk;
+    int stitchMask;
+};
+
+// streams the terrain around the camera in chunks picked by the LOD quadtree (see TerrainLOD.h)
+// chunks are built on worker threads, uploaded on the GL thread when they are done and evicted
+// in least recently used order once the resident chunks go over the memory budget
+// with an upload ring the vertices and the horizon maps go through it into storage allocated once, and the chunks
+// that do not fit in the budget of a frame wait for the next one (see UploadRing.h)
+// with a tile store the workers map the chunks that are on disk and write the ones they build (see TileStore.h),
+// with an erosion field they build the chunks of the eroded world (see Erosion.h). The workers bake the horizon map of
+// a chunk they build, or of one from the store that has none or an outdated one, and write it back (see Horizon.h)
+class ChunkManager {
+public:
+    LODSettings lod;
+    size_t memoryBudget = 64 << 20;  ///< bytes of vertex data and horizon maps we keep on the GPU
+    int maxUploadsPerFrame = 8;
+
+    ChunkStats stats;
+    std::atomic<int> horizonsBaked;          ///< by the workers so far, see Horizon.h
+    std::vector<VisibleChunk> visibleChunks; ///< the chunks to draw this frame
+    std::vector<Chunk*> uploadedChunks;      ///< the chunks that were uploaded this frame
+
+private:
+    HeightfieldGenerator generator;
+    HorizonParams horizons;
+    unsigned int frame = 0;
+
+    // bound for the chunks without a horizon map: nothing above the horizontal anywhere, so no shadow and no occlusion
+    TextureArray flatHorizons;
+
+    // every chunk shares one element buffer holding the strips of the 16 stitch variants back to back
+    ElementArrayBuffer<GLushort> lodIndices;
+    int variantLength;
+    int variantTriangles[numStitchMasks];
+
+    // resident chunks, most recently used at the front
+    std::list<Chunk> lru;
+    std::unordered_map<ChunkKey, std::list<Chunk>::iterator, ChunkKeyHash> resident;
+
+    // chunks that have been handed to the workers and are not uploaded yet
+    std::unordered_set<ChunkKey, ChunkKeyHash> building;
+    std::mutex finishedMutex;
+    std::condition_variable finishedReady;
+    std::deque<std::unique_ptr<ChunkData>> finished;
+    std::deque<std::chrono::steady_clock::time_point> buildTimes;
+    std::atomic<bool> shuttingDown;
+
+public:
+    std::shared_ptr<TileStore> store;     ///< null without a tile store
+    std::shared_ptr<ErosionField> erosion; ///< null for the terrain straight from the noise
+    UploadRing *uploads = nullptr;         ///< null uploads every chunk straight from its data
+
+private:
+    // declared last so the workers are joined before anything they touch is destroyed
+    ThreadPool pool;
+
+public:
+    // without a store every chunk is generated; the store has to be the one of the erosion, if there is one
+    ChunkManager(LODSettings _lod, const HeightfieldParams &params = HeightfieldParams(),
+                 std::shared_ptr<TileStore> _store = nullptr, std::shared_ptr<ErosionField> _erosion = nullptr,
+                 const HorizonParams &_horizons = HorizonParams(), unsigned int numThreads = 0)
+        : lod(_lod), horizonsBaked(0), generator(nullptr, params), horizons(_horizons), shuttingDown(false), store(_store),
+          erosion(_erosion), pool(numThreads) {
+        assert((lod.quads + 1) * (lod.quads + 1) < chunkIndexRestart);
+        std::vector<GLushort> indices;
+        for (int mask = 0; mask < numStitchMasks; ++mask) {
+            std::vector<unsigned int> variant = stitchedStripIndices(lod.quads, mask, chunkIndexRestart);
+            variantLength = (int)variant.size();
+            variantTriangles[mask] = countStripTriangles(variant, chunkIndexRestart);
+            indices.insert(indices.end(), variant.begin(), variant.end());
+        }
+        lodIndices.upload(indices);
+        stats.indexBytes = indices.size() * sizeof(GLushort);
+
+        std::vector<unsigned char> flat(4 * terrainHorizonLayers, 0);
+        uploadHorizons(flatHorizons, 1, terrainHorizonLayers, flat.data());
+    }
+
+    ~ChunkManager() {
+        shuttingDown = true;
+    }
+
+    // called once per frame on the GL thread, before any of the passes draw
+    // with blocking set the call waits for every chunk in view, which is what we want on the first frame
+    void update(const Vec3 &cameraPos, bool blocking = false) {
+        ++frame;
+        stats.tilesUploaded = 0;
+        stats.tilesFromStore = 0;
+        stats.tilesEvicted = 0;
+        stats.uploadBytes = 0;
+        stats.trianglesSubmitted = 0;
+        uploadedChunks.clear();
+
+        std::vector<ChunkKey> wanted;
+        std::vector<SelectedChunk> selected;
+        auto isResident = [this](const ChunkKey &key) { return resident.count(key) > 0; };
+        selectChunks(lod, cameraPos, isResident, wanted, selected);
+        requestMissing(wanted, cameraPos, blocking);
+
+        if (blocking) {
+            std::unique_lock<std::mutex> lock(finishedMutex);
+            finishedReady.wait(lock, [&]() { return finished.size() == building.size(); });
+        }
+        uploadFinished(cameraPos, blocking ? INT_MAX : maxUploadsPerFrame, blocking);
+
+        // the selection depends on what is resident, so redo it once the new chunks are in
+        if (stats.tilesUploaded > 0) selectChunks(lod, cameraPos, isResident, wanted, selected);
+
+        visibleChunks.clear();
+        for (const SelectedChunk &s : selected) {
+            auto it = resident.find(s.key);
+            // touch the chunk so it moves to the front of the LRU list
+            it->second->lastUsedFrame = frame;
+            lru.splice(lru.begin(), lru, it->second);
+            visibleChunks.push_back(VisibleChunk{ &*it->second, s.stitchMask });
+        }
+
+        evict();
+        updateStats();
+    }
+
+    // the vertex layout of a new chunk has to be described once, at the fixed locations of terrain_vshader.glsl
+    void setAttributes(Chunk &chunk) {
+        chunk.vao->bind();
+        chunk.vertices->bind();
+        // converted to float as they are, the shader scales them
+        glEnableVertexAttribArray(TERRAIN_HEIGHT_ATTRIBUTE);
+        glVertexAttribPointer(TERRAIN_HEIGHT_ATTRIBUTE, 1, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(TerrainVertex),
+                              (const GLvoid*)offsetof(TerrainVertex, height));
+        glEnableVertexAttribArray(TERRAIN_NORMAL_ATTRIBUTE);
+        glVertexAttribPointer(TERRAIN_NORMAL_ATTRIBUTE, 2, GL_BYTE, GL_FALSE, sizeof(TerrainVertex),
+                              (const GLvoid*)offsetof(TerrainVertex, normal));
+        glEnableVertexAttribArray(TERRAIN_WETNESS_ATTRIBUTE);
+        glVertexAttribPointer(TERRAIN_WETNESS_ATTRIBUTE, 1, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TerrainVertex),
+                              (const GLvoid*)offsetof(TerrainVertex, wetness));
+        lodIndices.bind(); ///< the element buffer binding is part of the VAO
+        chunk.vao->unbind();
+    }
+
+    // with the terrain shader bound and terrainHorizonUnit active, the x and y of the vertices come from the key of
+    // the chunk
+    void draw(const VisibleChunk &visible, const ChunkUniforms &uniforms) {
+        const Chunk &chunk = *visible.chunk;
+        glUniform2i(uniforms.origin, chunk.key.x * lod.quads, chunk.key.y * lod.quads);
+        glUniform1f(uniforms.spacing, levelSpacing(lod.spacing, chunk.key.level));
+        glUniform1i(uniforms.heightBase, chunk.heightBase);
+        (chunk.horizons ? *chunk.horizons : flatHorizons).bind();
+        chunk.vao->bind();
+        size_t offset = (size_t)visible.stitchMask * variantLength * sizeof(GLushort);
+        glDrawElements(GL_TRIANGLE_STRIP, variantLength, GL_UNSIGNED_SHORT, (const GLvoid*)offset);
+        chunk.vao->unbind();
+        stats.trianglesSubmitted += variantTriangles[visible.stitchMask];
+    }
+
+private:
+    void requestMissing(const std::vector<ChunkKey> &wanted, const Vec3 &cameraPos, bool blocking) {
+        std::vector<std::pair<float, ChunkKey>> missing;
+        for (const ChunkKey &key : wanted) {
+            if (resident.count(key) || building.count(key)) continue;
+            missing.push_back(std::make_pair(distanceToChunk(lod, key, cameraPos.x(), cameraPos.y()), key));
+        }
+
+        // closest first, and keep the queue short so that chunks we fly past do not hold up the ones in front of us
+        std::sort(missing.begin(), missing.end(), [](const std::pair<float, ChunkKey> &a, const std::pair<float, ChunkKey> &b) {
+            return a.first < b.first;
+        });
+        size_t maxInFlight = blocking ? missing.size() + building.size() : 2 * pool.size();
+
+        for (auto &m : missing) {
+            if (building.size() >= maxInFlight) break;
+            ChunkKey key = m.second;
+            building.insert(key);
+            pool.submit([this, key]() {
+                if (shuttingDown) return;
+                std::unique_ptr<ChunkData> data(new ChunkData());
+                bool fromStore = store && store->read(key, *data);
+                if (!fromStore) {
+                    if (erosion) buildChunk(generator, *erosion, key, lod.quads, lod.spacing, *data);
+                    else buildChunk(generator, key, lod.quads, lod.spacing, *data);
+                }
+                bool bake = horizons.enabled && data->horizonKey != horizonKey(horizons);
+                if (bake) {
+                    bakeHorizons(generator, erosion.get(), horizons, lod.quads, lod.spacing, *data);
+                    horizonsBaked++;
+                }
+                if (store && (!fromStore || bake)) store->write(*data);
+
+                std::lock_guard<std::mutex> lock(finishedMutex);
+                finished.push_back(std::move(data));
+                buildTimes.push_back(std::chrono::steady_clock::now());
+                finishedReady.notify_all();
+            });
+        }
+    }
+
+    void uploadFinished(const Vec3 &cameraPos, int maxUploads, bool blocking) {
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        while (!finished.empty() && stats.tilesUploaded < maxUploads) {
+            const ChunkData &data = *finished.front();
+
+            // the camera moved on while it was being built, do not waste an upload on it
+            if (distanceToChunk(lod, data.key, cameraPos.x(), cameraPos.y()) > lod.viewRadius) {
+                building.erase(data.key);
+                finished.pop_front();
+                continue;
+            }
+
+            size_t vertexBytes = data.vertexCount() * sizeof(TerrainVertex);
+            bool drawHorizons = horizons.enabled &&
+                                data.horizonBytes() == (size_t)terrainHorizonLayers * 4 * data.vertexCount();
+            size_t horizonBytes = drawHorizons ? data.horizonBytes() : 0;
+            UploadRing::Allocation staging;
+            if (uploads) {
+                // the rest waits for the next frames once the budget of this one is spent, unless every chunk in
+                // view has to be there; the first one of a frame always goes, straight from its data if it has to
+                staging = uploads->allocate((GLsizeiptr)(vertexBytes + horizonBytes));
+                if (!staging && !blocking && stats.tilesUploaded > 0) break;
+            }
+            building.erase(data.key);
+
+            Chunk chunk;
+            chunk.key = data.key;
+            chunk.heightBase = data.heightBase;
+            chunk.minHeight = data.minHeight;
+            chunk.maxHeight = data.maxHeight;
+            chunk.occluderHeights = std::move(finished.front()->occluderHeights);
+            chunk.lastUsedFrame = frame;
+            chunk.vao = std::unique_ptr<VertexArrayObject>(new VertexArrayObject());
+            chunk.vao->unbind();
+            chunk.bytes = vertexBytes;
+            chunk.vertices = std::unique_ptr<GenericArrayBuffer>(new GenericArrayBuffer());
+            chunk.horizonBytes = 0;
+            if (drawHorizons) chunk.horizons = std::unique_ptr<TextureArray>(new TextureArray());
+            if (staging) {
+                memcpy(staging.data, data.vertexData(), vertexBytes);
+                if (drawHorizons) memcpy(staging.data + vertexBytes, data.horizonData(), horizonBytes);
+                chunk.vertices->upload_raw_block(nullptr, (GLsizeiptr)vertexBytes);
+                uploads->copy_to_buffer(staging, 0, (GLsizeiptr)vertexBytes, chunk.vertices->id(), 0);
+                if (drawHorizons) {
+                    uploadHorizons(*chunk.horizons, lod.quads + 1, terrainHorizonLayers, nullptr);
+                    uploads->copy_to_texture(staging, (GLintptr)vertexBytes, GL_TEXTURE_2D_ARRAY, chunk.horizons->id(),
+                                             0, 0, 0, lod.quads + 1, lod.quads + 1, terrainHorizonLayers, GL_RGBA,
+                                             GL_UNSIGNED_BYTE);
+                }
+                uploads->release(staging);
+            } else {
+                chunk.vertices->upload_raw_block(data.vertexData(), (GLsizeiptr)vertexBytes);
+                if (drawHorizons) uploadHorizons(*chunk.horizons, lod.quads + 1, terrainHorizonLayers, data.horizonData());
+            }
+            if (drawHorizons) {
+                chunk.horizonBytes = horizonBytes;
+                chunk.bytes += chunk.horizonBytes;
+                stats.horizonBytes += chunk.horizonBytes;
+            }
+            bool mapped = data.mapped != nullptr;
+            finished.pop_front();
+
+            stats.uploadBytes += chunk.bytes;
+            stats.residentBytes += chunk.bytes;
+            stats.tilesUploaded++;
+            if (mapped) stats.tilesFromStore++;
+
+            lru.push_front(std::move(chunk));
+            resident[lru.front().key] = lru.begin();
+            uploadedChunks.push_back(&lru.front());
+        }
+    }
+
+    // size x size texels of RGBA bytes in every layer, filtered between the vertices they sit on; null texels only
+    // allocates them
+    static void uploadHorizons(TextureArray &texture, int size, int layers, const unsigned char *texels) {
+        texture.internal_format = GL_RGBA8;
+        texture.width = texture.height = size;
+        texture.layers = layers;
+        texture.levels = 1;
+        texture.bind();
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        texture.unbind();
+    }
+
+    void evict() {
+        // never evict something we are about to draw
+        while (stats.residentBytes > memoryBudget && !lru.empty() && lru.back().lastUsedFrame != frame) {
+            stats.residentBytes -= lru.back().bytes;
+            stats.horizonBytes -= lru.back().horizonBytes;
+            stats.tilesEvicted++;
+            resident.erase(lru.back().key);
+            lru.pop_back();
+        }
+    }
+
+    void updateStats() {
+        stats.tilesResident = (int)lru.size();
+        stats.tilesBuilding = (int)building.size();
+        stats.tilesVisible = (int)visibleChunks.size();
+
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        auto now = std::chrono::steady_clock::now();
+        while (!buildTimes.empty() && now - buildTimes.front() > std::chrono::seconds(1)) buildTimes.pop_front();
+        stats.tilesBuiltPerSecond = (float)buildTimes.size();
+    }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef CLOUDS_H
+#define CLOUDS_H
+
+#include "utility.h"
+#include "ShaderCache.h"
+
+const char* const cloud_vshader =
+#include "cloud_vshader.glsl"
+;
+
+const char* const cloud_fshader =
+#include "cloud_fshader.glsl"
+;
+
+// The clouds of the skybox used to be 8 octaves of Perlin4D for every sky pixel, in the reflection and again in
+// the main pass. They only depend on the direction and the time, so their cover is rendered into a small map of
+// every direction (octahedral, with the zenith in the middle) that both skybox draws of a frame sample with
+// bilinear filtering. Nothing has to be reprojected when the camera turns, a direction keeps its texel, and the
+// clouds move slowly enough that a map can be refreshed over a few frames, a band of rows at a time.
+
+// one step of the quality setting
+struct CloudQuality {
+    const char *name;
+    int size;          ///< of the map, in texels on a side
+    int refreshFrames; ///< frames to refresh the whole map
+};
+
+const CloudQuality cloudQualities[] = {
+    { "low",    64,  4 },
+    { "medium", 128, 2 },
+    { "high",   256, 1 },
+};
+const int numCloudQualities = sizeof(cloudQualities) / sizeof(cloudQualities[0]);
+const int defaultCloudQuality = 1;
+
+// -1 for an unknown name
+inline int cloudQualityLevel(const std::string &name) {
+    for (int level = 0; level < numCloudQualities; ++level) {
+        if (name == cloudQualities[level].name) return level;
+    }
+    return -1;
+}
+
+class Clouds {
+public:
+    std::unique_ptr<Shader> shader;
+    std::unique_ptr<R8Texture> map;
+    std::unique_ptr<Framebuffer> fbo;
+    std::unique_ptr<VertexArrayObject> vao; ///< empty, the triangle comes from gl_VertexID
+
+    int level = -1;
+    int band = 0;           ///< the next band of rows to refresh
+    int rowsRendered = 0;   ///< by the last update
+    bool complete = false;  ///< every band has been rendered since the map was allocated
+
+private:
+    GLint mapSizeLocation = -1, timeLocation = -1;
+
+public:
+    // the program was requested as "clouds" (see ShaderCache.h)
+    explicit Clouds(ShaderCache &shaders, int _level = defaultCloudQuality) {
+        shader = shaders.take("clouds");
+        mapSizeLocation = shader->uniform_location("mapSize");
+        timeLocation = shader->uniform_location("cloudTime");
+        map = std::unique_ptr<R8Texture>(new R8Texture());
+        fbo = std::unique_ptr<Framebuffer>(new Framebuffer());
+        vao = std::unique_ptr<VertexArrayObject>(new VertexArrayObject());
+        vao->unbind();
+        setQuality(_level);
+    }
+
+    // a new size starts over, the first update renders the whole map
+    void setQuality(int _level) {
+        _level = std::max(0, std::min(numCloudQualities - 1, _level));
+        if (_level == level) return;
+        level = _level;
+        int size = cloudQualities[level].size;
+        map->allocate(size, size);
+        fbo->attach_color_texture(*map);
+        band = 0;
+        complete = false;
+    }
+
+    const CloudQuality &quality() const { return cloudQualities[level]; }
+
+    // renders the next band of rows with the clouds at time, call once per frame before the skybox draws
+    void update(float time) {
+        const CloudQuality &q = quality();
+        int bands = complete ? q.refreshFrames : 1;
+        int first = band * q.size / bands, last = (band + 1) * q.size / bands;
+
+        fbo->bind();
+        glViewport(0, 0, q.size, q.size);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(0, first, q.size, last - first);
+        glDisable(GL_DEPTH_TEST);
+        shader->bind();
+        shader->set_uniform(mapSizeLocation, (float)q.size);
+        shader->set_uniform(timeLocation, time);
+        vao->bind();
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        vao->unbind();
+        shader->unbind();
+        glEnable(GL_DEPTH_TEST);
+        glDisable(GL_SCISSOR_TEST);
+        fbo->unbind();
+
+        rowsRendered = last - first;
+        complete = true;
+        band = bands == 1 ? 0 : (band + 1) % bands;
+    }
+
+    void bind() const {
+        map->bind();
+    }
+};
+
+#endif
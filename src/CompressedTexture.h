@@ -0,0 +1,46 @@
+#ifndef COMPRESSEDTEXTURE_H
+#define COMPRESSEDTEXTURE_H
+
+#include "utility.h"
+#include "TextureContainer.h"
+
+// the runtime side of the baked textures: uploads the blocks of a container entry as they are
+// with glCompressedTexImage2D, nothing is decoded on the CPU
+
+inline GLenum compressedInternalFormat(uint32_t format) {
+    return format == BLOCK_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+// the GL side needs EXT_texture_compression_s3tc, which every desktop driver has
+inline bool compressedTexturesSupported() {
+    return GLEW_EXT_texture_compression_s3tc != 0;
+}
+
+class CompressedTexture : public GenericTexture {
+public:
+    CompressedTexture(const TextureContainer &container, const ContainerEntry &entry) {
+        internal_format = compressedInternalFormat(entry.format);
+        format = GL_RGBA;
+        type = GL_UNSIGNED_BYTE;
+        width = entry.width;
+        height = entry.height;
+
+        bind();
+        for (int l = 0; l < (int)entry.levels; ++l) {
+            int w = containerLevelWidth(entry, l), h = containerLevelHeight(entry, l);
+            glCompressedTexImage2D(GL_TEXTURE_2D, l, internal_format, w, h, 0,
+                                   (GLsizei)compressedSize((BlockFormat)entry.format, w, h), container.level(entry, l));
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry.levels - 1);
+        unbind();
+    }
+};
+
+// level 0 of an entry into the given target of the bound texture, e.g. a cubemap face
+inline void uploadCompressedFace(GLenum target, const TextureContainer &container, const ContainerEntry &entry) {
+    glCompressedTexImage2D(target, 0, compressedInternalFormat(entry.format), entry.width, entry.height, 0,
+                           (GLsizei)compressedSize((BlockFormat)entry.format, entry.width, entry.height),
+                           container.level(entry, 0));
+}
+
+#endif
@@ -0,0 +1,546 @@
+#ifndef EROSION_H
+#define EROSION_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "ChunkData.h"
+#include "HeightfieldGenerator.h"
+#include "ThreadPool.h"
+#include "TileStore.h"
+
+// hydraulic and thermal erosion of the terrain on the CPU, nothing in here touches OpenGL
+//
+// The noise has no idea where water runs, so the slopes it makes are all the same kind of bumpy. Here droplets are
+// rolled down it (hydraulic erosion: they pick up material where they speed up and drop it where they slow down or
+// fill a pit), then material slides off the slopes that are steeper than the talus angle (thermal erosion).
+//
+// The chunks of every level have to agree on the result, or cracks open between them, so the erosion does not run on
+// the chunks: it runs once on a world grid of its own, spacingFactor times coarser than the level 0 grid, and the
+// change it made to the heights is added to every sample after the noise, bilinear between the nodes of that grid.
+// Samples shared by two chunks sit at the same place of the grid and get the same change, whatever their level.
+//
+// The grid is cut into tiles of tileCells x tileCells cells. A tile is eroded on its own, with an apron of cells
+// around it so the droplets that run into it from outside are there too, and with a random generator seeded with the
+// world and the tile alone, so a tile comes out the same whichever thread erodes it and whatever ran before. It keeps
+// the change over its cells and blend cells past each side of them. Where neighbouring tiles overlap their changes
+// are crossfaded with weights that add up to one, summed in a fixed order, so the seams are smooth and the result
+// does not depend on the order the tiles were made in or on the number of threads that made them.
+//
+// Every droplet also leaves the water it carries in the cells it crosses. That flow is turned into a wetness in
+// [0, 1] that rides along with the heights into the vertices (see TerrainVertex), for terrain_fshader.glsl.
+
+struct ErosionParams {
+    bool enabled = true;
+    int spacingFactor = 4;      ///< the cells of the erosion grid are this many level 0 quads wide
+    int tileCells = 64;
+    int apron = 16;             ///< cells eroded around a tile and thrown away
+    int blend = 8;              ///< cells kept past each side of a tile and crossfaded with the neighbours
+
+    // hydraulic, the droplets move one cell per step
+    float dropletsPerCell = 0.5f;
+    int maxSteps = 32;
+    float inertia = 0.05f;
+    float capacity = 1.0f;      ///< sediment per unit of drop, speed and water
+    float minCapacity = 0.01f;
+    float erodeRate = 0.1f;
+    float depositRate = 0.3f;
+    float evaporation = 0.05f;
+    float gravity = 4.0f;
+    int brushRadius = 2;        ///< in cells, erosion takes from a disc so it does not dig one cell deep
+
+    // thermal
+    int thermalIterations = 10;
+    float talus = 2.0f;         ///< the steepest slope that holds, height over distance
+    float thermalRate = 0.25f;
+
+    float wetnessScale = 0.03f; ///< wetness is 1 - exp(-water * wetnessScale), water is in droplet steps
+    float maxChange = 0.5f;     ///< no height moves further, so the bounds of the noise widened by it still hold
+};
+
+// FNV-1a over everything the result depends on, 0 when the erosion is off (see TileStore)
+inline uint64_t erosionKey(const ErosionParams &params) {
+    if (!params.enabled) return 0;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](const void *data, size_t bytes) {
+        const unsigned char *p = (const unsigned char*)data;
+        for (size_t i = 0; i < bytes; ++i) hash = (hash ^ p[i]) * 0x100000001b3ull;
+    };
+    mix(&params.spacingFactor, sizeof(params.spacingFactor));
+    mix(&params.tileCells, sizeof(params.tileCells));
+    mix(&params.apron, sizeof(params.apron));
+    mix(&params.blend, sizeof(params.blend));
+    mix(&params.dropletsPerCell, sizeof(params.dropletsPerCell));
+    mix(&params.maxSteps, sizeof(params.maxSteps));
+    mix(&params.inertia, sizeof(params.inertia));
+    mix(&params.capacity, sizeof(params.capacity));
+    mix(&params.minCapacity, sizeof(params.minCapacity));
+    mix(&params.erodeRate, sizeof(params.erodeRate));
+    mix(&params.depositRate, sizeof(params.depositRate));
+    mix(&params.evaporation, sizeof(params.evaporation));
+    mix(&params.gravity, sizeof(params.gravity));
+    mix(&params.brushRadius, sizeof(params.brushRadius));
+    mix(&params.thermalIterations, sizeof(params.thermalIterations));
+    mix(&params.talus, sizeof(params.talus));
+    mix(&params.thermalRate, sizeof(params.thermalRate));
+    mix(&params.wetnessScale, sizeof(params.wetnessScale));
+    mix(&params.maxChange, sizeof(params.maxChange));
+    return hash == 0 ? 1 : hash;
+}
+
+// what a tile keeps: the change of the heights and the wetness on the (tileCells + 2 blend + 1)^2 nodes from
+// node (tx * tileCells - blend, ty * tileCells - blend) of the erosion grid
+struct ErosionTile {
+    int size = 0;
+    std::vector<float> delta, wetness;
+};
+
+struct ErosionStats {
+    std::atomic<int> tilesEroded, tilesFromStore;
+    std::atomic<long long> droplets, steps;
+
+    ErosionStats() : tilesEroded(0), tilesFromStore(0), droplets(0), steps(0) {}
+};
+
+// splitmix64, the stream of a tile only depends on the world and the tile
+struct ErosionRandom {
+    uint64_t state;
+
+    ErosionRandom(uint32_t seed, int tx, int ty) {
+        state = ((uint64_t)seed << 32) ^ ((uint64_t)(uint32_t)tx * 0x9E3779B97F4A7C15ull) ^
+                ((uint64_t)(uint32_t)ty * 0xC2B2AE3D27D4EB4Full) ^ 0x5851F42D4C957F2Dull;
+    }
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // uniform in [0, 1)
+    float uniform() {
+        return (float)(next() >> 40) * (1.0f / 16777216.0f);
+    }
+};
+
+namespace erosion {
+
+inline int floorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// the height and the gradient of the bilinear surface at (x, y), in the cell (i, j) it is in
+inline float surface(const std::vector<float> &h, int cols, float x, float y, float &gx, float &gy) {
+    int i = (int)x, j = (int)y;
+    float u = x - i, v = y - j;
+    const float *p = &h[i + j * cols];
+    float h00 = p[0], h10 = p[1], h01 = p[cols], h11 = p[cols + 1];
+    gx = (h10 - h00) * (1.0f - v) + (h11 - h01) * v;
+    gy = (h01 - h00) * (1.0f - u) + (h11 - h10) * u;
+    return h00 * (1.0f - u) * (1.0f - v) + h10 * u * (1.0f - v) + h01 * (1.0f - u) * v + h11 * u * v;
+}
+
+// the weight of a tile at node u along one axis: 1 over its cells, falling linearly to 0 over the blend cells on
+// both sides of each edge, where the weight of the neighbour rises by as much
+inline float blendWeight(int u, int t, int cells, int blend) {
+    if (blend == 0) return (u >= t * cells && u < (t + 1) * cells) ? 1.0f : 0.0f;
+    int inside = std::min(u - (t * cells - blend), (t + 1) * cells + blend - u);
+    return std::min(1.0f, std::max(0.0f, (float)inside / (float)(2 * blend)));
+}
+
+} // namespace erosion
+
+// erodes tile (tx, ty) of the erosion grid of the given spacing, runs on whatever thread calls it and only depends
+// on its arguments. The generator must not have a pool, the tile is one task
+inline void erodeTile(const HeightfieldGenerator &generator, const ErosionParams &params, float spacing, int tx, int ty,
+                      ErosionTile &tile, ErosionStats *stats = nullptr) {
+    const int cells = params.tileCells + 2 * params.apron, cols = cells + 1;
+    const int x0 = tx * params.tileCells - params.apron, y0 = ty * params.tileCells - params.apron;
+    std::vector<float> raw(cols * cols);
+    generator.generateGrid(x0, y0, cols, cols, spacing, raw.data());
+
+    std::vector<float> h(raw), water(cols * cols, 0.0f);
+
+    // the nodes around a node that erosion takes material from, weighted by how close they are
+    struct BrushNode { int di, dj; float weight; };
+    std::vector<BrushNode> brush;
+    float brushSum = 0.0f;
+    const int r = params.brushRadius;
+    for (int dj = -r + 1; dj <= r; ++dj) {
+        for (int di = -r + 1; di <= r; ++di) {
+            float d = std::sqrt((float)(di * di + dj * dj));
+            if (d >= (float)r) continue;
+            brush.push_back(BrushNode{ di, dj, (float)r - d });
+            brushSum += (float)r - d;
+        }
+    }
+    for (BrushNode &b : brush) b.weight /= brushSum;
+
+    // hydraulic: droplets from random places of the tile and its apron, one after the other
+    ErosionRandom random(generator.params.seed, tx, ty);
+    const int droplets = (int)(params.dropletsPerCell * (float)(cells * cells));
+    long long steps = 0;
+    for (int n = 0; n < droplets; ++n) {
+        float x = random.uniform() * cells, y = random.uniform() * cells;
+        float dx = 0.0f, dy = 0.0f, speed = 1.0f, volume = 1.0f, sediment = 0.0f;
+        for (int step = 0; step < params.maxSteps; ++step) {
+            int i = (int)x, j = (int)y;
+            float u = x - i, v = y - j;
+            float gx, gy;
+            float height = erosion::surface(h, cols, x, y, gx, gy);
+
+            // downhill, keeping some of the direction it had
+            dx = dx * params.inertia - gx * (1.0f - params.inertia);
+            dy = dy * params.inertia - gy * (1.0f - params.inertia);
+            float length = std::sqrt(dx * dx + dy * dy);
+            if (length < 1e-6f) break; // on a flat spot
+            dx /= length;
+            dy /= length;
+            float nx = x + dx, ny = y + dy;
+            if (nx < 0.0f || ny < 0.0f || nx >= (float)cells || ny >= (float)cells) break;
+            water[i + j * cols] += volume;
+            ++steps;
+
+            float ngx, ngy;
+            float dh = erosion::surface(h, cols, nx, ny, ngx, ngy) - height;
+            float capacity = std::max(-dh * speed * volume * params.capacity, params.minCapacity);
+            if (sediment > capacity || dh > 0.0f) {
+                // uphill it fills the pit behind it as far as it can, otherwise it drops a share of the excess
+                float amount = dh > 0.0f ? std::min(dh, sediment) : (sediment - capacity) * params.depositRate;
+                sediment -= amount;
+                float *p = &h[i + j * cols];
+                p[0] += amount * (1.0f - u) * (1.0f - v);
+                p[1] += amount * u * (1.0f - v);
+                p[cols] += amount * (1.0f - u) * v;
+                p[cols + 1] += amount * u * v;
+            } else {
+                // never more than the drop, so it does not dig a hole behind itself
+                float amount = std::min((capacity - sediment) * params.erodeRate, -dh);
+                for (const BrushNode &b : brush) {
+                    int bi = i + b.di, bj = j + b.dj;
+                    if (bi < 0 || bj < 0 || bi >= cols || bj >= cols) continue;
+                    h[bi + bj * cols] -= amount * b.weight;
+                    sediment += amount * b.weight;
+                }
+            }
+            speed = std::sqrt(std::max(0.0f, speed * speed - dh * params.gravity));
+            volume *= 1.0f - params.evaporation;
+            x = nx;
+            y = ny;
+        }
+    }
+
+    // thermal: every pair of neighbours steeper than the talus moves material from the higher to the lower one,
+    // all the pairs at once from the heights of the previous iteration, so the order of the nodes does not matter
+    std::vector<float> next(cols * cols);
+    const float talus = params.talus * spacing;
+    for (int iteration = 0; iteration < params.thermalIterations; ++iteration) {
+        for (int j = 0; j < cols; ++j) {
+            for (int i = 0; i < cols; ++i) {
+                int k = i + j * cols;
+                float change = 0.0f;
+                const int neighbours[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+                for (const auto &o : neighbours) {
+                    int ni = i + o[0], nj = j + o[1];
+                    if (ni < 0 || nj < 0 || ni >= cols || nj >= cols) continue;
+                    float d = h[k] - h[ni + nj * cols];
+                    float excess = std::abs(d) - talus;
+                    if (excess > 0.0f) change -= (d > 0.0f ? 0.5f : -0.5f) * excess;
+                }
+                next[k] = h[k] + params.thermalRate * change;
+            }
+        }
+        h.swap(next);
+    }
+
+    // the blend window
+    tile.size = params.tileCells + 2 * params.blend + 1;
+    tile.delta.resize(tile.size * tile.size);
+    tile.wetness.resize(tile.size * tile.size);
+    const int offset = params.apron - params.blend;
+    for (int j = 0; j < tile.size; ++j) {
+        for (int i = 0; i < tile.size; ++i) {
+            int k = (i + offset) + (j + offset) * cols;
+            float delta = h[k] - raw[k];
+            tile.delta[i + j * tile.size] = std::min(params.maxChange, std::max(-params.maxChange, delta));
+            tile.wetness[i + j * tile.size] = 1.0f - std::exp(-water[k] * params.wetnessScale);
+        }
+    }
+
+    if (stats) {
+        stats->tilesEroded++;
+        stats->droplets += droplets;
+        stats->steps += steps;
+    }
+}
+
+// header of an eroded tile in the tile store, the floats of the change and then the ones of the wetness follow
+struct ErosionTileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t world;           ///< the one of the store, it holds the erosion key
+    int32_t x, y;
+    int32_t size;
+    unsigned char padding[36];
+};
+
+static_assert(sizeof(ErosionTileHeader) == 64, "the tile layout is fixed");
+
+// the eroded world: tiles made on demand, from any thread, kept in memory and in the tile store if there is one,
+// and the blended change of the heights at any sample
+class ErosionField {
+public:
+    HeightfieldGenerator generator;
+    ErosionParams params;
+    float spacing;                      ///< of the erosion grid
+    float levelZeroSpacing;
+    std::shared_ptr<TileStore> store;   ///< may be null
+    size_t maxTiles = 512;              ///< about 27 MB, the least recently used half goes when there are more
+    ErosionStats stats;
+
+private:
+    struct CachedTile {
+        std::shared_future<std::shared_ptr<const ErosionTile>> tile;
+        unsigned long long lastUsed;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<ChunkKey, CachedTile, ChunkKeyHash> tiles; ///< level 0, x and y of the tile
+    unsigned long long uses = 0;
+
+public:
+    ErosionField(const HeightfieldParams &heightParams, const ErosionParams &_params, float _levelZeroSpacing,
+                 std::shared_ptr<TileStore> _store = nullptr)
+        : generator(nullptr, heightParams), params(_params), spacing(_levelZeroSpacing * (float)_params.spacingFactor),
+          levelZeroSpacing(_levelZeroSpacing), store(_store) {}
+
+    ErosionField(const ErosionField&) = delete;
+    ErosionField &operator=(const ErosionField&) = delete;
+
+    // the tile, eroded by the calling thread if nobody has it yet; threads asking for a tile another thread is
+    // eroding wait for it
+    std::shared_ptr<const ErosionTile> tile(int tx, int ty) {
+        ChunkKey key = { 0, tx, ty };
+        std::promise<std::shared_ptr<const ErosionTile>> promise;
+        std::shared_future<std::shared_ptr<const ErosionTile>> existing;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = tiles.find(key);
+            if (it != tiles.end()) {
+                it->second.lastUsed = ++uses;
+                existing = it->second.tile;
+            } else {
+                if (tiles.size() >= maxTiles) evictOldest();
+                CachedTile cached = { promise.get_future().share(), ++uses };
+                tiles.insert(std::make_pair(key, cached));
+            }
+        }
+        if (existing.valid()) return existing.get();
+
+        std::shared_ptr<ErosionTile> made = std::make_shared<ErosionTile>();
+        if (!read(tx, ty, *made)) {
+            erodeTile(generator, params, spacing, tx, ty, *made, &stats);
+            write(tx, ty, *made);
+        }
+        promise.set_value(made);
+        return made;
+    }
+
+    // makes the tiles under the rectangle of the world (the tiles around it as well, they blend into it) over the
+    // pool, one tile per task. A null pool makes them on the calling thread
+    void prepare(float x0, float y0, float x1, float y1, ThreadPool *pool = nullptr) {
+        int tx0, ty0, tx1, ty1;
+        tileRange(x0 / spacing, y0 / spacing, x1 / spacing, y1 / spacing, tx0, ty0, tx1, ty1);
+        int columns = tx1 - tx0 + 1, count = columns * (ty1 - ty0 + 1);
+        auto range = [&](int begin, int end) {
+            for (int k = begin; k < end; ++k) tile(tx0 + k % columns, ty0 + k / columns);
+        };
+        if (pool) pool->parallelFor(0, count, 1, range);
+        else range(0, count);
+    }
+
+    // the eroded grid of samples (x0 + i, y0 + j) * gridSpacing, i < cols, j < rows: the change is added to heights
+    // (the samples of the noise, row by row) and wetness (may be null) is written. gridSpacing is a level spacing,
+    // so the samples of every level land on the same places of the erosion grid
+    void apply(int x0, int y0, int cols, int rows, float gridSpacing, float *heights, float *wetness = nullptr) {
+        const float ratio = gridSpacing / spacing;
+        int u0 = (int)std::floor((float)x0 * ratio), v0 = (int)std::floor((float)y0 * ratio);
+        int u1 = (int)std::floor((float)(x0 + cols - 1) * ratio) + 1, v1 = (int)std::floor((float)(y0 + rows - 1) * ratio) + 1;
+        std::vector<float> delta, wet;
+        blendedNodes(u0, v0, u1, v1, delta, wet);
+
+        int nodeCols = u1 - u0 + 1;
+        for (int j = 0; j < rows; ++j) {
+            float v = (float)(y0 + j) * ratio;
+            int vj = (int)std::floor(v);
+            float fv = v - (float)vj;
+            for (int i = 0; i < cols; ++i) {
+                float u = (float)(x0 + i) * ratio;
+                int ui = (int)std::floor(u);
+                float fu = u - (float)ui;
+                int k = (ui - u0) + (vj - v0) * nodeCols;
+                heights[i + j * cols] += bilinear(delta, k, nodeCols, fu, fv);
+                if (wetness) wetness[i + j * cols] = bilinear(wet, k, nodeCols, fu, fv);
+            }
+        }
+    }
+
+    // the change added to the heights of the noise at scattered points of the world
+    void applyPoints(const float *xs, const float *ys, float *hs, int count) {
+        if (count == 0) return;
+        float xMin = xs[0], xMax = xs[0], yMin = ys[0], yMax = ys[0];
+        for (int k = 1; k < count; ++k) {
+            xMin = std::min(xMin, xs[k]);
+            xMax = std::max(xMax, xs[k]);
+            yMin = std::min(yMin, ys[k]);
+            yMax = std::max(yMax, ys[k]);
+        }
+        int u0 = (int)std::floor(xMin / spacing), v0 = (int)std::floor(yMin / spacing);
+        int u1 = (int)std::floor(xMax / spacing) + 1, v1 = (int)std::floor(yMax / spacing) + 1;
+        std::vector<float> delta, wet;
+        blendedNodes(u0, v0, u1, v1, delta, wet);
+
+        int nodeCols = u1 - u0 + 1;
+        for (int k = 0; k < count; ++k) {
+            float u = xs[k] / spacing, v = ys[k] / spacing;
+            int ui = (int)std::floor(u), vj = (int)std::floor(v);
+            hs[k] += bilinear(delta, (ui - u0) + (vj - v0) * nodeCols, nodeCols, u - (float)ui, v - (float)vj);
+        }
+    }
+
+    size_t residentTiles() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return tiles.size();
+    }
+
+private:
+    static float bilinear(const std::vector<float> &nodes, int k, int cols, float fu, float fv) {
+        float a = nodes[k] + fu * (nodes[k + 1] - nodes[k]);
+        float b = nodes[k + cols] + fu * (nodes[k + cols + 1] - nodes[k + cols]);
+        return a + fv * (b - a);
+    }
+
+    // the tiles whose blend window touches the nodes [u0, u1] x [v0, v1] (floats, in cells)
+    void tileRange(float u0, float v0, float u1, float v1, int &tx0, int &ty0, int &tx1, int &ty1) const {
+        tx0 = erosion::floorDiv((int)std::floor(u0) - params.blend, params.tileCells);
+        ty0 = erosion::floorDiv((int)std::floor(v0) - params.blend, params.tileCells);
+        tx1 = erosion::floorDiv((int)std::ceil(u1) + params.blend, params.tileCells);
+        ty1 = erosion::floorDiv((int)std::ceil(v1) + params.blend, params.tileCells);
+    }
+
+    // the crossfaded change and wetness at the nodes [u0, u1] x [v0, v1] of the erosion grid, row by row. Every
+    // node sums its tiles in the same order whichever call asks for it
+    void blendedNodes(int u0, int v0, int u1, int v1, std::vector<float> &delta, std::vector<float> &wetness) {
+        int cols = u1 - u0 + 1, rows = v1 - v0 + 1;
+        delta.assign(cols * rows, 0.0f);
+        wetness.assign(cols * rows, 0.0f);
+        int tx0, ty0, tx1, ty1;
+        tileRange((float)u0, (float)v0, (float)u1, (float)v1, tx0, ty0, tx1, ty1);
+        const int T = params.tileCells, B = params.blend;
+
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            for (int tx = tx0; tx <= tx1; ++tx) {
+                // the part of the window of the tile in the range
+                int wu0 = std::max(u0, tx * T - B), wu1 = std::min(u1, (tx + 1) * T + B);
+                int wv0 = std::max(v0, ty * T - B), wv1 = std::min(v1, (ty + 1) * T + B);
+                if (wu0 > wu1 || wv0 > wv1) continue;
+                std::shared_ptr<const ErosionTile> t = tile(tx, ty);
+                for (int v = wv0; v <= wv1; ++v) {
+                    float wv = erosion::blendWeight(v, ty, T, B);
+                    if (wv == 0.0f) continue;
+                    for (int u = wu0; u <= wu1; ++u) {
+                        float w = erosion::blendWeight(u, tx, T, B) * wv;
+                        if (w == 0.0f) continue;
+                        int k = (u - (tx * T - B)) + (v - (ty * T - B)) * t->size;
+                        delta[(u - u0) + (v - v0) * cols] += w * t->delta[k];
+                        wetness[(u - u0) + (v - v0) * cols] += w * t->wetness[k];
+                    }
+                }
+            }
+        }
+    }
+
+    std::string fileName(int tx, int ty) const {
+        char name[64];
+        snprintf(name, sizeof(name), "erosion_%d_%d.vwte", tx, ty);
+        return name;
+    }
+
+    bool read(int tx, int ty, ErosionTile &tile) {
+        if (!store) return false;
+        int size = params.tileCells + 2 * params.blend + 1;
+        size_t floats = (size_t)size * size;
+        std::unique_ptr<MappedFile> mapped = store->map(fileName(tx, ty));
+        ErosionTileHeader header;
+        if (!mapped || mapped->size != sizeof(header) + 2 * floats * sizeof(float)) return false;
+        memcpy(&header, mapped->data, sizeof(header));
+        if (memcmp(header.magic, "VWTE", 4) != 0 || header.version != tileStoreVersion || header.world != store->world ||
+            header.x != tx || header.y != ty || header.size != size) {
+            return false;
+        }
+        tile.size = size;
+        tile.delta.resize(floats);
+        tile.wetness.resize(floats);
+        memcpy(tile.delta.data(), mapped->data + sizeof(header), floats * sizeof(float));
+        memcpy(tile.wetness.data(), mapped->data + sizeof(header) + floats * sizeof(float), floats * sizeof(float));
+        stats.tilesFromStore++;
+        return true;
+    }
+
+    void write(int tx, int ty, const ErosionTile &tile) {
+        if (!store) return;
+        ErosionTileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "VWTE", 4);
+        header.version = tileStoreVersion;
+        header.world = store->world;
+        header.x = tx;
+        header.y = ty;
+        header.size = tile.size;
+        size_t floatBytes = tile.delta.size() * sizeof(float);
+        auto bytes = std::make_shared<std::vector<unsigned char>>(sizeof(header) + 2 * floatBytes);
+        memcpy(bytes->data(), &header, sizeof(header));
+        memcpy(bytes->data() + sizeof(header), tile.delta.data(), floatBytes);
+        memcpy(bytes->data() + sizeof(header) + floatBytes, tile.wetness.data(), floatBytes);
+        store->writeAsync(fileName(tx, ty), bytes);
+    }
+
+    // the tiles in use elsewhere stay alive through their shared_ptr, the ones being made through their promise
+    void evictOldest() {
+        std::vector<unsigned long long> ages;
+        for (auto &t : tiles) ages.push_back(t.second.lastUsed);
+        std::nth_element(ages.begin(), ages.begin() + ages.size() / 2, ages.end());
+        unsigned long long median = ages[ages.size() / 2];
+        for (auto it = tiles.begin(); it != tiles.end();) {
+            if (it->second.lastUsed <= median) it = tiles.erase(it);
+            else ++it;
+        }
+    }
+};
+
+// a chunk of the eroded world: the noise of its samples and the ring around them, the change of the erosion added
+// to all of them, then the normals and the vertices as buildChunk makes them
+inline void buildChunk(const HeightfieldGenerator &generator, ErosionField &erosion, ChunkKey key, int quads,
+                       float spacing, ChunkData &chunk) {
+    int cols = quads + 1, apronCols = quads + 3;
+    float gridSpacing = levelSpacing(spacing, key.level);
+    std::vector<float> apron(apronCols * apronCols), apronWetness(apronCols * apronCols), wetness(cols * cols);
+    generator.generateGrid(key.x * quads - 1, key.y * quads - 1, apronCols, apronCols, gridSpacing, apron.data());
+    erosion.apply(key.x * quads - 1, key.y * quads - 1, apronCols, apronCols, gridSpacing, apron.data(),
+                  apronWetness.data());
+    for (int j = 0; j < cols; ++j) {
+        for (int i = 0; i < cols; ++i) wetness[i + j * cols] = apronWetness[(i + 1) + (j + 1) * apronCols];
+    }
+    buildChunkFromApron(key, quads, spacing, apron.data(), wetness.data(), chunk);
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <OpenGP/types.h>
+
+// culling math for axis aligned boxes, no OpenGL in here
+
+// a plane a*x + b*y + c*z + d = 0, points with a positive distance are on the kept side
+struct CullPlane {
+    OpenGP::Vec4 coefficients;
+
+    float distance(const OpenGP::Vec3 &p) const {
+        return coefficients.head<3>().dot(p) + coefficients.w();
+    }
+
+    // the largest distance over the corners of a box, negative means the whole box is on the culled side
+    float maxDistance(const OpenGP::Vec3 &lo, const OpenGP::Vec3 &hi) const {
+        OpenGP::Vec3 corner(coefficients.x() >= 0 ? hi.x() : lo.x(),
+                            coefficients.y() >= 0 ? hi.y() : lo.y(),
+                            coefficients.z() >= 0 ? hi.z() : lo.z());
+        return distance(corner);
+    }
+};
+
+class Frustum {
+public:
+    CullPlane planes[6]; ///< left, right, bottom, top, near, far, pointing inwards
+
+public:
+    // Gribb/Hartmann extraction from projection * view, the planes end up in world space
+    explicit Frustum(const OpenGP::Mat4x4 &projectionView) {
+        OpenGP::Vec4 rows[4];
+        for (int r = 0; r < 4; ++r) rows[r] = projectionView.row(r).transpose();
+        for (int axis = 0; axis < 3; ++axis) {
+            planes[2 * axis].coefficients = rows[3] + rows[axis];
+            planes[2 * axis + 1].coefficients = rows[3] - rows[axis];
+        }
+        for (CullPlane &plane : planes) plane.coefficients /= plane.coefficients.head<3>().norm();
+    }
+
+    // conservative: a box that straddles two planes outside the frustum near a corner is kept
+    bool intersects(const OpenGP::Vec3 &lo, const OpenGP::Vec3 &hi) const {
+        for (const CullPlane &plane : planes) {
+            if (plane.maxDistance(lo, hi) < 0.0f) return false;
+        }
+        return true;
+    }
+};
+
+// the clip plane the terrain shader feeds to gl_ClipDistance[0], vertices with dot(normal, p) + height < 0 are clipped
+inline CullPlane clipPlane(const OpenGP::Vec3 &normal, float height) {
+    CullPlane plane;
+    plane.coefficients = OpenGP::Vec4(normal.x(), normal.y(), normal.z(), height);
+    return plane;
+}
+
+#endif
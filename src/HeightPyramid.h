@@ -0,0 +1,363 @@
+#ifndef HEIGHTPYRAMID_H
+#define HEIGHTPYRAMID_H
+
+#include <OpenGP/types.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "ChunkData.h"
+#include "Erosion.h"
+#include "HeightfieldGenerator.h"
+#include "ThreadPool.h"
+
+// height queries and ray casts against the terrain on the CPU, for picking, line of sight and keeping the camera
+// above the ground
+//
+// The surface is the one of the finest chunks: the level 0 grid of ChunkData.h with every quad split into the two
+// triangles of the strips. It is cut into tiles of tileQuads x tileQuads quads that are generated the first time a
+// query needs them. A tile keeps a min/max pyramid of its heights, level k holding the range of the blocks of
+// 2^k x 2^k quads. Rays step from tile to tile and only descend into the blocks whose range their heights overlap
+// (maximum mipmap tracing), so a ray that passes high over a block skips it in one step instead of marching
+// through it sample by sample. Above the bounds of the noise (HeightfieldGenerator::heightBounds, widened by what the
+// erosion may change) nothing can be hit, so the parts of a ray up there do not even build their tiles.
+
+struct Ray {
+    OpenGP::Vec3 origin;
+    OpenGP::Vec3 direction; ///< does not have to be unit length
+    float maxDistance;
+};
+
+struct RayHit {
+    bool hit = false;
+    float distance = 0.0f;  ///< along the normalized direction
+    OpenGP::Vec3 position = OpenGP::Vec3::Zero();
+};
+
+class HeightPyramid {
+public:
+    static const int tileQuads = 64;
+    static const int tileLevels = 7; ///< level tileLevels - 1 is the whole tile
+
+    HeightfieldGenerator generator;
+    float spacing;              ///< of the level 0 grid
+    ThreadPool *pool;           ///< for the batches, may be null
+    std::shared_ptr<ErosionField> erosion; ///< the one of the chunks, null for the terrain straight from the noise
+    size_t maxTiles = 1024;     ///< about 28 MB, the least recently used half goes when there are more
+    float minBound, maxBound;   ///< no height is outside
+
+private:
+    struct Tile {
+        std::vector<float> heights;                     ///< (tileQuads + 1)^2 samples, row major
+        std::vector<float> minHeights[tileLevels], maxHeights[tileLevels]; ///< level 0 comes from the corners
+    };
+    struct CachedTile {
+        std::shared_ptr<const Tile> tile;
+        unsigned long long lastUsed;
+    };
+
+    mutable std::mutex mutex;
+    mutable std::unordered_map<ChunkKey, CachedTile, ChunkKeyHash> tiles;
+    mutable unsigned long long uses = 0;
+
+public:
+    HeightPyramid(float _spacing, ThreadPool *_pool = nullptr, HeightfieldParams params = HeightfieldParams(),
+                  std::shared_ptr<ErosionField> _erosion = nullptr)
+        : generator(nullptr, params), spacing(_spacing), pool(_pool), erosion(_erosion) {
+        generator.heightBounds(minBound, maxBound);
+        if (erosion) {
+            minBound -= erosion->params.maxChange;
+            maxBound += erosion->params.maxChange;
+        }
+    }
+
+    HeightPyramid(const HeightPyramid&) = delete;
+    HeightPyramid &operator=(const HeightPyramid&) = delete;
+
+    // the height of the triangulated surface, which is what is drawn close to the camera
+    float height(float x, float y) const {
+        float gx = x / spacing, gy = y / spacing;
+        int i = (int)std::floor(gx), j = (int)std::floor(gy);
+        int tx = floorDiv(i, tileQuads), ty = floorDiv(j, tileQuads);
+        std::shared_ptr<const Tile> t = tile(tx, ty);
+        return surfaceHeight(*t, i - tx * tileQuads, j - ty * tileQuads, gx - i, gy - j);
+    }
+
+    // the first point where the ray crosses the surface within its maximum distance
+    RayHit raycast(const Ray &ray) const {
+        RayHit result;
+        float length = ray.direction.norm();
+        if (length == 0.0f) return result;
+        OpenGP::Vec3 d = ray.direction / length;
+        const OpenGP::Vec3 &o = ray.origin;
+
+        // a DDA over the tiles, each tile gets the part of the ray that lies over it
+        float tileSize = tileQuads * spacing;
+        int tx = (int)std::floor(o.x() / tileSize), ty = (int)std::floor(o.y() / tileSize);
+        const float inf = std::numeric_limits<float>::infinity();
+        int stepX = d.x() > 0.0f ? 1 : -1, stepY = d.y() > 0.0f ? 1 : -1;
+        float nextX = d.x() != 0.0f ? ((float)((tx + (stepX > 0)) * tileQuads) * spacing - o.x()) / d.x() : inf;
+        float nextY = d.y() != 0.0f ? ((float)((ty + (stepY > 0)) * tileQuads) * spacing - o.y()) / d.y() : inf;
+        float deltaX = d.x() != 0.0f ? tileSize / std::abs(d.x()) : inf;
+        float deltaY = d.y() != 0.0f ? tileSize / std::abs(d.y()) : inf;
+
+        // only the part of the ray under the highest possible height can hit
+        float t = 0.0f, tEnd = ray.maxDistance;
+        if (d.z() != 0.0f) {
+            float tBound = (maxBound - o.z()) / d.z();
+            if (d.z() > 0.0f) tEnd = std::min(tEnd, tBound);
+            else t = std::max(t, tBound);
+        } else if (o.z() > maxBound) {
+            return result;
+        }
+        if (t > tEnd) return result;
+        // walk the tiles up to the one where that part starts
+        while (std::min(nextX, nextY) < t) {
+            if (nextX < nextY) {
+                tx += stepX;
+                nextX += deltaX;
+            } else {
+                ty += stepY;
+                nextY += deltaY;
+            }
+        }
+
+        while (t <= tEnd) {
+            float tExit = std::min(std::min(nextX, nextY), tEnd);
+            float distance;
+            if (castTile(tx, ty, o, d, t, tExit, distance)) {
+                result.hit = true;
+                result.distance = distance;
+                result.position = o + distance * d;
+                return result;
+            }
+            if (tExit >= tEnd) break;
+            if (nextX < nextY) {
+                tx += stepX;
+                t = nextX;
+                nextX += deltaX;
+            } else {
+                ty += stepY;
+                t = nextY;
+                nextY += deltaY;
+            }
+        }
+        return result;
+    }
+
+    // true if nothing is in the way between the two points
+    bool lineOfSight(const OpenGP::Vec3 &from, const OpenGP::Vec3 &to) const {
+        Ray ray = { from, to - from, (to - from).norm() };
+        return !raycast(ray).hit;
+    }
+
+    // the batches are split over the pool, in chunks big enough that the tiles a chunk needs stay hot
+    void raycast(const Ray *rays, RayHit *hits, int count) const {
+        auto range = [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) hits[i] = raycast(rays[i]);
+        };
+        if (pool) pool->parallelFor(0, count, 64, range);
+        else range(0, count);
+    }
+
+    void heights(const float *xs, const float *ys, float *out, int count) const {
+        auto range = [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) out[i] = height(xs[i], ys[i]);
+        };
+        if (pool) pool->parallelFor(0, count, 256, range);
+        else range(0, count);
+    }
+
+    size_t residentTiles() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return tiles.size();
+    }
+
+private:
+    static int floorDiv(int a, int b) {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    std::shared_ptr<const Tile> tile(int tx, int ty) const {
+        ChunkKey key = { 0, tx, ty };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = tiles.find(key);
+            if (it != tiles.end()) {
+                it->second.lastUsed = ++uses;
+                return it->second.tile;
+            }
+        }
+
+        // built outside the lock, two threads may build the same tile and the second one is dropped
+        std::shared_ptr<const Tile> built = buildTile(tx, ty);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tiles.size() >= maxTiles) evictOldest();
+        CachedTile cached = { built, ++uses };
+        return tiles.insert(std::make_pair(key, cached)).first->second.tile;
+    }
+
+    // the tiles in use elsewhere stay alive through their shared_ptr
+    void evictOldest() const {
+        std::vector<unsigned long long> ages;
+        for (auto &t : tiles) ages.push_back(t.second.lastUsed);
+        std::nth_element(ages.begin(), ages.begin() + ages.size() / 2, ages.end());
+        unsigned long long median = ages[ages.size() / 2];
+        for (auto it = tiles.begin(); it != tiles.end();) {
+            if (it->second.lastUsed <= median) it = tiles.erase(it);
+            else ++it;
+        }
+    }
+
+    std::shared_ptr<const Tile> buildTile(int tx, int ty) const {
+        std::shared_ptr<Tile> t = std::make_shared<Tile>();
+        int cols = tileQuads + 1;
+        t->heights.resize(cols * cols);
+        // the same samples as the level 0 chunk (tx, ty), see buildChunk
+        generator.generateGrid(tx * tileQuads, ty * tileQuads, cols, cols, spacing, t->heights.data());
+        if (erosion) erosion->apply(tx * tileQuads, ty * tileQuads, cols, cols, spacing, t->heights.data());
+
+        for (int level = 1; level < tileLevels; ++level) {
+            int blocks = tileQuads >> level;
+            t->minHeights[level].resize(blocks * blocks);
+            t->maxHeights[level].resize(blocks * blocks);
+            for (int j = 0; j < blocks; ++j) {
+                for (int i = 0; i < blocks; ++i) {
+                    float lo = std::numeric_limits<float>::infinity(), hi = -lo;
+                    for (int c = 0; c < 4; ++c) {
+                        float clo, chi;
+                        blockRange(*t, level - 1, 2 * i + (c & 1), 2 * j + (c >> 1), clo, chi);
+                        lo = std::min(lo, clo);
+                        hi = std::max(hi, chi);
+                    }
+                    t->minHeights[level][index(i, j, blocks)] = lo;
+                    t->maxHeights[level][index(i, j, blocks)] = hi;
+                }
+            }
+        }
+        return t;
+    }
+
+    static void blockRange(const Tile &t, int level, int i, int j, float &lo, float &hi) {
+        if (level == 0) {
+            // a quad lies between its corners, level 0 is not stored
+            const int cols = tileQuads + 1;
+            float h00 = t.heights[index(i, j, cols)], h10 = t.heights[index(i + 1, j, cols)];
+            float h01 = t.heights[index(i, j + 1, cols)], h11 = t.heights[index(i + 1, j + 1, cols)];
+            lo = std::min(std::min(h00, h10), std::min(h01, h11));
+            hi = std::max(std::max(h00, h10), std::max(h01, h11));
+            return;
+        }
+        int blocks = tileQuads >> level;
+        lo = t.minHeights[level][index(i, j, blocks)];
+        hi = t.maxHeights[level][index(i, j, blocks)];
+    }
+
+    // u, v in [0, 1] within quad (i, j), split along the (i, j + 1) - (i + 1, j) diagonal like the strips
+    static float surfaceHeight(const Tile &t, int i, int j, float u, float v) {
+        const int cols = tileQuads + 1;
+        float h00 = t.heights[index(i, j, cols)], h10 = t.heights[index(i + 1, j, cols)];
+        float h01 = t.heights[index(i, j + 1, cols)], h11 = t.heights[index(i + 1, j + 1, cols)];
+        if (u + v <= 1.0f) return h00 + u * (h10 - h00) + v * (h01 - h00);
+        return h11 + (1.0f - u) * (h01 - h11) + (1.0f - v) * (h10 - h11);
+    }
+
+    // the block of a level the ray is in at u (in quads from the tile corner), on a boundary the one it moves into
+    static int blockIndex(float u, int size, int blocks) {
+        return std::max(0, std::min(blocks - 1, (int)std::floor(u / size)));
+    }
+
+    // the part [t0, t1] of the ray over tile (tx, ty). The walk steps through the blocks of one level at a time:
+    // a block the ray stays above is skipped and the walk goes up a level, otherwise it goes down a level,
+    // down to the quads where the surface is intersected
+    bool castTile(int tx, int ty, const OpenGP::Vec3 &o, const OpenGP::Vec3 &d, float t0, float t1, float &distance) const {
+        std::shared_ptr<const Tile> tile = this->tile(tx, ty);
+        const Tile &t = *tile;
+
+        // in quads from the corner of the tile
+        float ox = (o.x() - (float)(tx * tileQuads) * spacing) / spacing, oy = (o.y() - (float)(ty * tileQuads) * spacing) / spacing;
+        float dx = d.x() / spacing, dy = d.y() / spacing;
+        const float inf = std::numeric_limits<float>::infinity();
+        float invX = dx != 0.0f ? 1.0f / dx : inf, invY = dy != 0.0f ? 1.0f / dy : inf;
+        int stepX = dx > 0.0f ? 1 : -1, stepY = dy > 0.0f ? 1 : -1;
+
+        int level = tileLevels - 1;
+        float ta = t0;
+        while (ta < t1) {
+            int size = 1 << level, blocks = tileQuads >> level;
+            int i = blockIndex(ox + ta * dx, size, blocks), j = blockIndex(oy + ta * dy, size, blocks);
+            float exitX = dx != 0.0f ? ((float)((i + (stepX > 0)) * size) - ox) * invX : inf;
+            float exitY = dy != 0.0f ? ((float)((j + (stepY > 0)) * size) - oy) * invY : inf;
+            // rounding put us back in the block we just left, move on to the next one
+            if (exitX <= ta) {
+                i += stepX;
+                exitX += size * std::abs(invX);
+            }
+            if (exitY <= ta) {
+                j += stepY;
+                exitY += size * std::abs(invY);
+            }
+            if (i < 0 || i >= blocks || j < 0 || j >= blocks) return false;
+            float tb = std::min(std::min(exitX, exitY), t1);
+
+            float lo, hi;
+            blockRange(t, level, i, j, lo, hi);
+            // the ray is straight, over [ta, tb] its height stays between the ones at the ends
+            if (std::min(o.z() + ta * d.z(), o.z() + tb * d.z()) > hi) {
+                ta = tb;
+                level = std::min(level + 1, tileLevels - 1);
+                continue;
+            }
+            if (level > 0) {
+                --level;
+                continue;
+            }
+            if (intersectQuad(t, i, j, o, d, ox, oy, dx, dy, ta, tb, distance)) return true;
+            ta = tb;
+        }
+        return false;
+    }
+
+    // on each of the two triangles of a quad the surface is a plane, so the height of the ray over the surface is
+    // linear in t and its zero is found exactly. A ray that starts under the surface hits where it starts
+    bool intersectQuad(const Tile &t, int i, int j, const OpenGP::Vec3 &o, const OpenGP::Vec3 &d, float ox, float oy,
+                       float dx, float dy, float ta, float tb, float &distance) const {
+        auto above = [&](float tt) {
+            float u = std::max(0.0f, std::min(1.0f, ox + tt * dx - i));
+            float v = std::max(0.0f, std::min(1.0f, oy + tt * dy - j));
+            return o.z() + tt * d.z() - surfaceHeight(t, i, j, u, v);
+        };
+
+        // where the ray crosses the diagonal u + v = 1
+        float pieces[3] = { ta, tb, tb };
+        int count = 2;
+        if (dx + dy != 0.0f) {
+            float tDiagonal = (1.0f - (ox - i) - (oy - j)) / (dx + dy);
+            if (tDiagonal > ta && tDiagonal < tb) {
+                pieces[1] = tDiagonal;
+                count = 3;
+            }
+        }
+
+        float fa = above(ta);
+        if (fa <= 0.0f) {
+            distance = ta;
+            return true;
+        }
+        for (int k = 1; k < count; ++k) {
+            float fb = above(pieces[k]);
+            if (fb <= 0.0f) {
+                distance = pieces[k - 1] + (pieces[k] - pieces[k - 1]) * fa / (fa - fb);
+                return true;
+            }
+            fa = fb;
+        }
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef HEIGHTFIELDGENERATOR_H
+#define HEIGHTFIELDGENERATOR_H
+
+#include <OpenGP/types.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+#include "ThreadPool.h"
+
+// CPU version of the terrain noise that used to be evaluated per vertex in terrain_vshader.glsl
+//
+// Perlin2D and hybridMultiFractal are written once as templates over a "lane" type so that the scalar,
+// SSE4.1 and AVX2 versions execute exactly the same float operations in the same order as the GLSL.
+// The three CPU paths therefore agree bit for bit. Against the GPU the only differences come from the
+// driver: inversesqrt() and pow() are allowed to be approximate in GLSL, here they are 1/sqrt and std::pow.
+// Build with -ffp-contract=off (the top level CMakeLists does) so the compiler does not fuse multiply-adds
+// in some paths and not in others.
+
+// the constants hybridMultiFractal used in terrain_vshader.glsl
+// the seed shifts the lattice of every octave by its own whole number of cells, seed 0 is the original world
+struct HeightfieldParams {
+    float H = 0.25f;
+    float offset = 0.7f;
+    float lacunarity = 2.0f;
+    int octaves = 8;
+    float frequency = 0.55f;
+    uint32_t seed = 0;
+};
+
+namespace heightfield {
+
+// scalar lanes are plain floats
+inline float vfloor(float a) { return std::floor(a); }
+inline float vsqrt(float a) { return std::sqrt(a); }
+inline float vmin(float a, float b) { return a > b ? b : a; }
+inline float vmax(float a, float b) { return a > b ? a : b; }
+
+// a lane of one float with the load and store of the wide ones, for the tails of rows and builds without SSE4.1
+struct Float1 {
+    static const int width = 1;
+    float v;
+    Float1() {}
+    Float1(float s) : v(s) {}
+    static Float1 load(const float *p) { return *p; }
+    void store(float *p) const { *p = v; }
+};
+inline Float1 operator+(Float1 a, Float1 b) { return a.v + b.v; }
+inline Float1 operator-(Float1 a, Float1 b) { return a.v - b.v; }
+inline Float1 operator*(Float1 a, Float1 b) { return a.v * b.v; }
+inline Float1 operator/(Float1 a, Float1 b) { return a.v / b.v; }
+inline Float1 vsqrt(Float1 a) { return std::sqrt(a.v); }
+inline Float1 vmin(Float1 a, Float1 b) { return vmin(a.v, b.v); }
+inline Float1 vmax(Float1 a, Float1 b) { return vmax(a.v, b.v); }
+
+#if defined(__SSE4_1__)
+struct Float4 {
+    static const int width = 4;
+    __m128 v;
+    Float4() {}
+    Float4(__m128 _v) : v(_v) {}
+    Float4(float s) : v(_mm_set1_ps(s)) {}
+    static Float4 load(const float *p) { return _mm_loadu_ps(p); }
+    void store(float *p) const { _mm_storeu_ps(p, v); }
+};
+inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+inline Float4 vfloor(Float4 a) { return _mm_floor_ps(a.v); }
+inline Float4 vsqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+// minps (maxps) returns the second operand unless the first is smaller (larger), like the scalar ones
+inline Float4 vmin(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+inline Float4 vmax(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+#endif
+
+#if defined(__AVX2__)
+struct Float8 {
+    static const int width = 8;
+    __m256 v;
+    Float8() {}
+    Float8(__m256 _v) : v(_v) {}
+    Float8(float s) : v(_mm256_set1_ps(s)) {}
+    static Float8 load(const float *p) { return _mm256_loadu_ps(p); }
+    void store(float *p) const { _mm256_storeu_ps(p, v); }
+};
+inline Float8 operator+(Float8 a, Float8 b) { return _mm256_add_ps(a.v, b.v); }
+inline Float8 operator-(Float8 a, Float8 b) { return _mm256_sub_ps(a.v, b.v); }
+inline Float8 operator*(Float8 a, Float8 b) { return _mm256_mul_ps(a.v, b.v); }
+inline Float8 operator/(Float8 a, Float8 b) { return _mm256_div_ps(a.v, b.v); }
+inline Float8 vfloor(Float8 a) { return _mm256_floor_ps(a.v); }
+inline Float8 vsqrt(Float8 a) { return _mm256_sqrt_ps(a.v); }
+inline Float8 vmin(Float8 a, Float8 b) { return _mm256_min_ps(a.v, b.v); }
+inline Float8 vmax(Float8 a, Float8 b) { return _mm256_max_ps(a.v, b.v); }
+#endif
+
+template <typename T>
+inline T fract(T a) { return a - vfloor(a); }
+
+// the lattice shift of an octave, whole cells in [0, 71) since the hash repeats every 71 cells
+inline void latticeShift(uint32_t seed, int octave, float &x, float &y) {
+    if (seed == 0) {
+        x = y = 0.0f;
+        return;
+    }
+    uint64_t z = ((uint64_t)seed << 32 | (uint32_t)octave) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    x = (float)(z % 71);
+    y = (float)((z >> 32) % 71);
+}
+
+// https://github.com/BrianSharpe/Wombat/blob/master/Perlin2D.glsl, one lane per sample
+// shiftX and shiftY are whole cells added to the lattice before the hash, adding 0 leaves every bit as it was
+template <typename T>
+inline T perlin2D(T px, T py, T shiftX = T(0.0f), T shiftY = T(0.0f)) {
+    // establish our grid cell and unit position
+    T pix = vfloor(px), piy = vfloor(py);
+    T fx = px - pix, fy = py - piy;
+    T fx1 = px - (pix + T(1.0f)), fy1 = py - (piy + T(1.0f));
+
+    // calculate the hash, Pt = (x0, y0, x1, y1)
+    T x0 = pix + shiftX, y0 = piy + shiftY, x1 = x0 + T(1.0f), y1 = y0 + T(1.0f);
+    const T inv71 = T(1.0f / 71.0f);
+    x0 = x0 - vfloor(x0 * inv71) * T(71.0f);
+    y0 = y0 - vfloor(y0 * inv71) * T(71.0f);
+    x1 = x1 - vfloor(x1 * inv71) * T(71.0f);
+    y1 = y1 - vfloor(y1 * inv71) * T(71.0f);
+    x0 = x0 + T(26.0f); y0 = y0 + T(161.0f);
+    x1 = x1 + T(26.0f); y1 = y1 + T(161.0f);
+    x0 = x0 * x0; y0 = y0 * y0;
+    x1 = x1 * x1; y1 = y1 * y1;
+
+    // Pt.xzxz * Pt.yyww
+    T corner[4] = { x0 * y0, x1 * y0, x0 * y1, x1 * y1 };
+    T cornerX[4] = { fx, fx1, fx, fx1 };
+    T cornerY[4] = { fy, fy, fy1, fy1 };
+
+    const T invX = T(1.0f / 951.135664f);
+    const T invY = T(1.0f / 642.949883f);
+    T grad[4];
+    for (int c = 0; c < 4; ++c) {
+        // calculate the gradient results
+        T gradX = fract(corner[c] * invX) - T(0.49999f);
+        T gradY = fract(corner[c] * invY) - T(0.49999f);
+        T invLength = T(1.0f) / vsqrt(gradX * gradX + gradY * gradY);
+        grad[c] = invLength * (gradX * cornerX[c] + gradY * cornerY[c]);
+        // scale things to a strict -1.0->1.0 range  *= 1.0/sqrt(0.5)
+        grad[c] = grad[c] * T(1.4142135623730950488016887242097f);
+    }
+
+    // Classic Perlin Interpolation
+    T bx = fx * fx * fx * (fx * (fx * T(6.0f) - T(15.0f)) + T(10.0f));
+    T by = fy * fy * fy * (fy * (fy * T(6.0f) - T(15.0f)) + T(10.0f));
+    T bx1 = T(1.0f) - bx, by1 = T(1.0f) - by;
+
+    // dot( grad_results, blend2.zxzx * blend2.wwyy )
+    return grad[0] * (bx1 * by1) + grad[1] * (bx * by1) + grad[2] * (bx1 * by) + grad[3] * (bx * by);
+}
+
+// adapted from texturing and modeling a procedural approach, same as the old terrain_vshader.glsl
+template <typename T>
+inline T hybridMultiFractal(T x, T y, const HeightfieldParams &params) {
+    const float pwHL = std::pow(params.lacunarity, -params.H);
+    float pwr = pwHL;
+    float shiftX, shiftY;
+
+    // get zeroth octave of function
+    latticeShift(params.seed, 0, shiftX, shiftY);
+    T value = T(pwr) * (perlin2D(x * T(params.frequency), y * T(params.frequency), T(shiftX), T(shiftY)) + T(params.offset));
+    T weight = value;
+    x = x * T(params.lacunarity);
+    y = y * T(params.lacunarity);
+    pwr *= pwHL;
+
+    // start from 1 and start weighing the signals
+    for (int i = 1; i < params.octaves; ++i) {
+        weight = vmin(weight, T(1.0f));
+
+        latticeShift(params.seed, i, shiftX, shiftY);
+        T signal = T(pwr) * (perlin2D(x * T(params.frequency), y * T(params.frequency), T(shiftX), T(shiftY)) + T(params.offset));
+
+        value = value + weight * signal;
+        weight = weight * signal;
+        pwr *= pwHL;
+        x = x * T(params.lacunarity);
+        y = y * T(params.lacunarity);
+    }
+
+    return value;
+}
+
+template <typename T>
+inline int heightsWithLanes(const float *xs, const float *ys, float *out, int count, const HeightfieldParams &params) {
+    int i = 0;
+    for (; i + T::width <= count; i += T::width) {
+        hybridMultiFractal(T::load(xs + i), T::load(ys + i), params).store(out + i);
+    }
+    return i;
+}
+
+} // namespace heightfield
+
+class HeightfieldGenerator {
+public:
+    HeightfieldParams params;
+    ThreadPool *pool; ///< may be null, everything then runs on the calling thread
+
+public:
+    HeightfieldGenerator(ThreadPool *_pool = nullptr, HeightfieldParams _params = HeightfieldParams())
+        : params(_params), pool(_pool) {}
+
+    static const char* kernelName() {
+#if defined(__AVX2__)
+        return "AVX2";
+#elif defined(__SSE4_1__)
+        return "SSE4.1";
+#else
+        return "scalar";
+#endif
+    }
+
+    // authoritative height at a world position, the chunks are built from the same function
+    float height(float x, float y) const {
+        return heightfield::hybridMultiFractal(x, y, params);
+    }
+
+    // bounds of every height the function can return, from interval arithmetic over the octaves with Perlin2D
+    // in [-1, 1]. Conservative: the real range over any area is narrower
+    void heightBounds(float &lo, float &hi) const {
+        const float pwHL = std::pow(params.lacunarity, -params.H);
+        float pwr = pwHL;
+        auto product = [](float a0, float a1, float b0, float b1, float &lo, float &hi) {
+            float p[4] = { a0 * b0, a0 * b1, a1 * b0, a1 * b1 };
+            lo = *std::min_element(p, p + 4);
+            hi = *std::max_element(p, p + 4);
+        };
+        lo = pwr * (params.offset - 1.0f);
+        hi = pwr * (params.offset + 1.0f);
+        float weightLo = lo, weightHi = hi;
+        pwr *= pwHL;
+        for (int i = 1; i < params.octaves; ++i) {
+            weightLo = std::min(weightLo, 1.0f);
+            weightHi = std::min(weightHi, 1.0f);
+            float signalLo = pwr * (params.offset - 1.0f), signalHi = pwr * (params.offset + 1.0f);
+            float termLo, termHi;
+            product(weightLo, weightHi, signalLo, signalHi, termLo, termHi);
+            lo += termLo;
+            hi += termHi;
+            weightLo = termLo;
+            weightHi = termHi;
+            pwr *= pwHL;
+        }
+    }
+
+    // central differences with the given step, this is what the A, B, C, D samples in the old vertex shader
+    // were meant to compute. The shader wrote `position.xy + (1, 0)`, which is a comma expression adding 0,
+    // so on the GPU all four samples equalled the height and the normal was always (0, 0, 1).
+    OpenGP::Vec3 normal(float x, float y, float step = 1.0f) const {
+        float dx = height(x - step, y) - height(x + step, y);
+        float dy = height(x, y - step) - height(x, y + step);
+        return OpenGP::Vec3(dx, dy, 2.0f * step).normalized();
+    }
+
+    // heights of count arbitrary points, vectorized but single threaded
+    void heights(const float *xs, const float *ys, float *out, int count) const {
+        int i = 0;
+#if defined(__AVX2__)
+        i += heightfield::heightsWithLanes<heightfield::Float8>(xs + i, ys + i, out + i, count - i, params);
+#endif
+#if defined(__SSE4_1__)
+        i += heightfield::heightsWithLanes<heightfield::Float4>(xs + i, ys + i, out + i, count - i, params);
+#endif
+        for (; i < count; ++i) out[i] = height(xs[i], ys[i]);
+    }
+
+    // the reference path used to validate the vectorized kernels
+    void heightsScalar(const float *xs, const float *ys, float *out, int count) const {
+        for (int i = 0; i < count; ++i) out[i] = height(xs[i], ys[i]);
+    }
+
+    // samples a cols x rows grid where sample (i, j) lies at ((x0 + i) * spacing, (y0 + j) * spacing)
+    // grids are addressed by integer sample coordinates so that neighbouring tiles agree exactly on their shared edge
+    // heights is row major (i + j * cols), normals (optional) holds 3 floats per sample and uses central differences
+    // over the grid spacing, which needs a one sample apron that is evaluated but not returned
+    void generateGrid(int x0, int y0, int cols, int rows, float spacing, float *heights, float *normals = nullptr) const {
+        if (normals == nullptr) {
+            evaluateGrid(x0, y0, cols, rows, spacing, heights);
+            return;
+        }
+
+        int apronCols = cols + 2, apronRows = rows + 2;
+        std::vector<float> apron(apronCols * apronRows);
+        evaluateGrid(x0 - 1, y0 - 1, apronCols, apronRows, spacing, apron.data());
+        apronNormals(apron.data(), cols, rows, spacing, heights, normals);
+    }
+
+    // the heights and normals of a cols x rows grid from the (cols + 2) x (rows + 2) grid around it, for the stages
+    // that change the heights before the normals are taken (see Erosion.h)
+    static void apronNormals(const float *apron, int cols, int rows, float spacing, float *heights, float *normals) {
+        int apronCols = cols + 2;
+        for (int j = 0; j < rows; ++j) {
+            for (int i = 0; i < cols; ++i) {
+                int a = (i + 1) + (j + 1) * apronCols;
+                heights[i + j * cols] = apron[a];
+
+                float dx = apron[a - 1] - apron[a + 1];
+                float dy = apron[a - apronCols] - apron[a + apronCols];
+                float dz = 2.0f * spacing;
+                float invLength = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz);
+                float *n = normals + 3 * (i + j * cols);
+                n[0] = dx * invLength;
+                n[1] = dy * invLength;
+                n[2] = dz * invLength;
+            }
+        }
+    }
+
+private:
+    void evaluateGrid(int x0, int y0, int cols, int rows, float spacing, float *heights) const {
+        auto rowRange = [&](int begin, int end) {
+            std::vector<float> xs(cols), ys(cols);
+            for (int i = 0; i < cols; ++i) xs[i] = (float)(x0 + i) * spacing;
+            for (int j = begin; j < end; ++j) {
+                std::fill(ys.begin(), ys.end(), (float)(y0 + j) * spacing);
+                this->heights(xs.data(), ys.data(), heights + j * cols, cols);
+            }
+        };
+
+        if (pool) pool->parallelFor(0, rows, 4, rowRange);
+        else rowRange(0, rows);
+    }
+};
+
+#endif
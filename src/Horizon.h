@@ -0,0 +1,257 @@
+#ifndef HORIZON_H
+#define HORIZON_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "ChunkData.h"
+#include "Erosion.h"
+#include "HeightfieldGenerator.h"
+
+// horizon mapping of the terrain on the CPU, for the sun shadows and the ambient occlusion of terrain_fshader.glsl
+// without another pass over the terrain, nothing in here touches OpenGL
+//
+// Every vertex of a chunk gets how high the terrain around it rises in a few directions, as the sine of the elevation
+// of its horizon. The sun is behind the hills where its elevation is under the horizon in its direction, and the sky
+// a point sees is what its horizons leave of it, so the shader gets both from the map of the chunk with two texture
+// fetches, and the sun is free to move since nothing depends on it here.
+//
+// The horizon is searched on a few grids that are all aligned with the world grid: the grid of the chunk with a
+// margin around it, then grids 4, 16 and 64 times coarser, each one from where the one before leaves off to steps
+// samples along every direction, so the search reaches steps * 64 samples of the chunk away for about
+// (steps * grids) samples per direction. The directions are the ones of the lattice (the axes, the diagonals, and the
+// knight moves for 16 of them), so every sample is a node of its grid and a row of vertices reads rows of the grid:
+// no interpolation, and 4 or 8 vertices at a time in the lanes of HeightfieldGenerator.h. On the coarse grids the
+// horizon is found at their nodes, together with a chord of how it changes with the height it is seen from, and is
+// interpolated to the vertices between the nodes with the height of each vertex. Vertices shared by two chunks see
+// the same samples, so neighbouring maps meet on the edges.
+//
+// The chunks of the eroded world look over the eroded heights, on the grids at most as coarse as the erosion grid:
+// past that the change of the erosion is well under the size of the cells.
+
+struct HorizonParams {
+    bool enabled = true;
+    int directions = 8; ///< 4, 8 or 16, counterclockwise from +x; terrain_fshader.glsl reads 8 (two RGBA layers)
+    int steps = 16;     ///< samples along a direction on every coarse grid, the grid of the chunk takes steps / 2
+    int grids = 4;      ///< the grid of the chunk, then 4, 16, 64... times coarser while the chunk spans whole cells
+};
+
+// the layers of the maps terrain_fshader.glsl reads, the maps of another number of directions are not drawn
+const int terrainHorizonLayers = 2;
+
+// FNV-1a over the parameters, 0 when the maps are not baked (see ChunkData::horizonKey)
+inline uint32_t horizonKey(const HorizonParams &params) {
+    if (!params.enabled) return 0;
+    uint32_t hash = 0x811c9dc5u;
+    auto mix = [&hash](const void *data, size_t bytes) {
+        const unsigned char *p = (const unsigned char*)data;
+        for (size_t i = 0; i < bytes; ++i) hash = (hash ^ p[i]) * 0x01000193u;
+    };
+    mix(&params.directions, sizeof(params.directions));
+    mix(&params.steps, sizeof(params.steps));
+    mix(&params.grids, sizeof(params.grids));
+    return hash ? hash : 1u;
+}
+
+namespace horizon {
+
+// direction d of count, a step along it moves (dx, dy) nodes
+inline void direction(int d, int count, int &dx, int &dy) {
+    static const int lattice[16][2] = {
+        { 1, 0 }, { 2, 1 }, { 1, 1 }, { 1, 2 }, { 0, 1 }, { -1, 2 }, { -1, 1 }, { -2, 1 },
+        { -1, 0 }, { -2, -1 }, { -1, -1 }, { -1, -2 }, { 0, -1 }, { 1, -2 }, { 1, -1 }, { 2, -1 }
+    };
+    int k = d * (16 / count);
+    dx = lattice[k][0];
+    dy = lattice[k][1];
+}
+
+// the largest (h[i + k * offset] - h[i] + lift) * invDistance[k] over the steps k in [first, last], for count nodes of
+// a row, or start if it is larger
+template <typename T>
+inline int marchLanes(const float *h, int count, int offset, int first, int last, const float *invDistance, float lift,
+                      float start, float *out) {
+    int i = 0;
+    for (; i + T::width <= count; i += T::width) {
+        T h0 = T::load(h + i) - T(lift), best = T(start);
+        for (int k = first; k <= last; ++k) best = vmax(best, (T::load(h + i + k * offset) - h0) * T(invDistance[k]));
+        best.store(out + i);
+    }
+    return i;
+}
+
+inline void march(const float *h, int count, int offset, int first, int last, const float *invDistance, float lift,
+                  float start, float *out) {
+    int i = 0;
+#if defined(__AVX2__)
+    i += marchLanes<heightfield::Float8>(h + i, count - i, offset, first, last, invDistance, lift, start, out + i);
+#endif
+#if defined(__SSE4_1__)
+    i += marchLanes<heightfield::Float4>(h + i, count - i, offset, first, last, invDistance, lift, start, out + i);
+#endif
+    marchLanes<heightfield::Float1>(h + i, count - i, offset, first, last, invDistance, lift, start, out + i);
+}
+
+// best = max(best, a - h * g) for count vertices of a row, a and g interpolated between two rows with fv
+template <typename T>
+inline int fromCoarseLanes(const float *a0, const float *a1, const float *g0, const float *g1, float fv,
+                           const float *h, int count, float *best) {
+    int i = 0;
+    for (; i + T::width <= count; i += T::width) {
+        T a = T::load(a0 + i) + T(fv) * (T::load(a1 + i) - T::load(a0 + i));
+        T g = T::load(g0 + i) + T(fv) * (T::load(g1 + i) - T::load(g0 + i));
+        vmax(T::load(best + i), a - T::load(h + i) * g).store(best + i);
+    }
+    return i;
+}
+
+inline void fromCoarse(const float *a0, const float *a1, const float *g0, const float *g1, float fv, const float *h,
+                       int count, float *best) {
+    int i = 0;
+#if defined(__AVX2__)
+    i += fromCoarseLanes<heightfield::Float8>(a0 + i, a1 + i, g0 + i, g1 + i, fv, h + i, count - i, best + i);
+#endif
+#if defined(__SSE4_1__)
+    i += fromCoarseLanes<heightfield::Float4>(a0 + i, a1 + i, g0 + i, g1 + i, fv, h + i, count - i, best + i);
+#endif
+    fromCoarseLanes<heightfield::Float1>(a0 + i, a1 + i, g0 + i, g1 + i, fv, h + i, count - i, best + i);
+}
+
+// the tangent of the elevation to its sine, a horizon under the horizontal is the horizontal
+template <typename T>
+inline int sineLanes(float *values, int count) {
+    int i = 0;
+    for (; i + T::width <= count; i += T::width) {
+        T t = vmax(T::load(values + i), T(0.0f));
+        (t / vsqrt(T(1.0f) + t * t)).store(values + i);
+    }
+    return i;
+}
+
+inline void sine(float *values, int count) {
+    int i = 0;
+#if defined(__AVX2__)
+    i += sineLanes<heightfield::Float8>(values + i, count - i);
+#endif
+#if defined(__SSE4_1__)
+    i += sineLanes<heightfield::Float4>(values + i, count - i);
+#endif
+    sineLanes<heightfield::Float1>(values + i, count - i);
+}
+
+// the cols x cols samples (x0 + i, y0 + j) * gridSpacing of the world, eroded when erosion is given
+inline void sampleGrid(const HeightfieldGenerator &generator, ErosionField *erosion, int x0, int y0, int cols,
+                       float gridSpacing, std::vector<float> &heights) {
+    heights.resize(cols * cols);
+    generator.generateGrid(x0, y0, cols, cols, gridSpacing, heights.data());
+    if (erosion) erosion->apply(x0, y0, cols, cols, gridSpacing, heights.data());
+}
+
+} // namespace horizon
+
+// the horizon map of the chunk into chunk.horizons: directions / 4 layers of (quads + 1)^2 RGBA texels, row by row
+// like the vertices, texel k of layer l holds the sines of the horizons of vertex k in the directions 4l to 4l + 3.
+// spacing is the one of level 0 and erosion is null for the terrain straight from the noise. Runs on whatever thread
+// calls it
+inline void bakeHorizons(const HeightfieldGenerator &generator, ErosionField *erosion, const HorizonParams &params,
+                         int quads, float spacing, ChunkData &chunk) {
+    const int cols = quads + 1, count = cols * cols, directions = params.directions;
+    const float chunkSpacing = levelSpacing(spacing, chunk.key.level);
+    const int reach = directions > 8 ? 2 : 1; ///< the longest step is 2 nodes along an axis
+    const int first = std::max(1, params.steps / 8), fineSteps = std::min(params.steps, 4 * first);
+    const int margin = params.steps * reach, fineMargin = fineSteps * reach;
+    std::vector<float> best(directions * count), invDistance(params.steps + 1);
+
+    // the grid of the chunk: every step up to where the first coarse grid starts
+    std::vector<float> fine;
+    const int fineCols = cols + 2 * fineMargin;
+    horizon::sampleGrid(generator, erosion, chunk.key.x * quads - fineMargin, chunk.key.y * quads - fineMargin,
+                        fineCols, chunkSpacing, fine);
+    const float *vertexHeights = fine.data() + fineMargin + fineMargin * fineCols; ///< row j at j * fineCols
+    for (int d = 0; d < directions; ++d) {
+        int dx, dy;
+        horizon::direction(d, directions, dx, dy);
+        float stepLength = std::sqrt((float)(dx * dx + dy * dy)) * chunkSpacing;
+        for (int k = 1; k <= fineSteps; ++k) invDistance[k] = 1.0f / ((float)k * stepLength);
+        for (int j = 0; j < cols; ++j) {
+            horizon::march(vertexHeights + j * fineCols, cols, dx + dy * fineCols, 1, fineSteps, invDistance.data(),
+                           0.0f, 0.0f, best.data() + d * count + j * cols);
+        }
+    }
+
+    // the coarse grids pick up where the one before stops: their first step is 4 steps of the one before, a quarter
+    // of its reach (or all of it for the grid of the chunk)
+    std::vector<float> coarse, low, high, a, g, rowsA, rowsG;
+    for (int grid = 1, factor = 4; grid < params.grids && quads % factor == 0; ++grid, factor *= 4) {
+        const float gridSpacing = chunkSpacing * (float)factor, lift = gridSpacing;
+        const int nodes = quads / factor + 1, coarseCols = nodes + 2 * margin;
+        bool eroded = erosion && gridSpacing <= erosion->spacing;
+        horizon::sampleGrid(generator, eroded ? erosion : nullptr, chunk.key.x * quads / factor - margin,
+                            chunk.key.y * quads / factor - margin, coarseCols, gridSpacing, coarse);
+        const float *nodeHeights = coarse.data() + margin + margin * coarseCols;
+        low.resize(nodes * nodes);
+        high.resize(nodes * nodes);
+        a.resize(nodes * nodes);
+        g.resize(nodes * nodes);
+        rowsA.resize(nodes * cols);
+        rowsG.resize(nodes * cols);
+
+        for (int d = 0; d < directions; ++d) {
+            int dx, dy;
+            horizon::direction(d, directions, dx, dy);
+            float stepLength = std::sqrt((float)(dx * dx + dy * dy)) * gridSpacing;
+            for (int k = first; k <= params.steps; ++k) invDistance[k] = 1.0f / ((float)k * stepLength);
+            const int offset = dx + dy * coarseCols;
+            const float none = -std::numeric_limits<float>::infinity();
+            for (int j = 0; j < nodes; ++j) {
+                const float *row = nodeHeights + j * coarseCols;
+                horizon::march(row, nodes, offset, first, params.steps, invDistance.data(), 0.0f, none, low.data() + j * nodes);
+                horizon::march(row, nodes, offset, first, params.steps, invDistance.data(), lift, none, high.data() + j * nodes);
+            }
+
+            // the horizon seen from a height h at a node is about low + (node height - h) * g, where g is the slope
+            // of the chord between the node height and lift under it; a holds the part that does not depend on h
+            for (int j = 0; j < nodes; ++j) {
+                for (int i = 0; i < nodes; ++i) {
+                    int k = i + j * nodes;
+                    g[k] = (high[k] - low[k]) / lift;
+                    a[k] = low[k] + nodeHeights[i + j * coarseCols] * g[k];
+                }
+            }
+
+            // along the rows of nodes first, then between the rows for every row of vertices. A vertex on a node
+            // takes its values as they are (times 0 of the next one), so the edges of two chunks agree
+            for (int j = 0; j < nodes; ++j) {
+                for (int i = 0; i < cols; ++i) {
+                    int u = i / factor, next = std::min(u + 1, nodes - 1);
+                    float fu = (float)(i % factor) / (float)factor;
+                    const float *rowA = a.data() + j * nodes, *rowG = g.data() + j * nodes;
+                    rowsA[i + j * cols] = rowA[u] + fu * (rowA[next] - rowA[u]);
+                    rowsG[i + j * cols] = rowG[u] + fu * (rowG[next] - rowG[u]);
+                }
+            }
+            for (int j = 0; j < cols; ++j) {
+                int v = j / factor, next = std::min(v + 1, nodes - 1);
+                float fv = (float)(j % factor) / (float)factor;
+                horizon::fromCoarse(rowsA.data() + v * cols, rowsA.data() + next * cols, rowsG.data() + v * cols,
+                                    rowsG.data() + next * cols, fv, vertexHeights + j * fineCols, cols,
+                                    best.data() + d * count + j * cols);
+            }
+        }
+    }
+
+    horizon::sine(best.data(), (int)best.size());
+    chunk.horizons.resize(best.size());
+    for (int d = 0; d < directions; ++d) {
+        unsigned char *texels = chunk.horizons.data() + (d / 4) * 4 * count + d % 4;
+        const float *sines = best.data() + d * count;
+        for (int k = 0; k < count; ++k) texels[4 * k] = (unsigned char)(255.0f * sines[k] + 0.5f);
+    }
+    chunk.mappedHorizons = nullptr;
+    chunk.horizonKey = horizonKey(params);
+}
+
+#endif
@@ -0,0 +1,235 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <OpenGP/external/LodePNG/lodepng.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "MappedFile.h"
+
+// the CPU half of texture loading, nothing in here touches OpenGL so it can run on worker threads
+//
+// A PNG is decoded once into RGBA8 rows flipped to the OpenGL bottom up order, with its mip chain computed
+// by a 2x2 box filter. The result is written to a cache file that is memory mapped on the next start,
+// so warm starts go straight from the page cache to the upload without decoding anything.
+// The cache is keyed on the size and modification time of the PNG, editing a texture rebuilds its entry.
+
+// an RGBA8 image and its mip levels back to back, level 0 first, rows bottom up
+struct TextureImage {
+    std::string file;
+    int width = 0, height = 0;
+    int levels = 0;
+    const unsigned char *pixels = nullptr; ///< either decoded.data() or inside mapped
+    size_t bytes = 0;
+    bool fromCache = false;
+
+    std::vector<unsigned char> decoded;
+    std::unique_ptr<MappedFile> mapped;
+
+    int levelWidth(int level) const { return std::max(1, width >> level); }
+    int levelHeight(int level) const { return std::max(1, height >> level); }
+    size_t levelOffset(int level) const {
+        size_t offset = 0;
+        for (int l = 0; l < level; ++l) offset += 4 * (size_t)levelWidth(l) * levelHeight(l);
+        return offset;
+    }
+};
+
+inline int fullMipLevels(int width, int height) {
+    int levels = 1;
+    while ((width >> levels) > 0 || (height >> levels) > 0) ++levels;
+    return levels;
+}
+
+// 2x2 box filter, odd sizes drop the last row/column like glGenerateMipmap implementations usually do
+inline void downsample(const unsigned char *src, int width, int height, unsigned char *dst) {
+    int w = std::max(1, width / 2), h = std::max(1, height / 2);
+    for (int y = 0; y < h; ++y) {
+        const unsigned char *row0 = src + 4 * (size_t)std::min(2 * y, height - 1) * width;
+        const unsigned char *row1 = src + 4 * (size_t)std::min(2 * y + 1, height - 1) * width;
+        for (int x = 0; x < w; ++x) {
+            int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (int c = 0; c < 4; ++c) {
+                int sum = row0[4 * x0 + c] + row0[4 * x1 + c] + row1[4 * x0 + c] + row1[4 * x1 + c];
+                dst[4 * ((size_t)y * w + x) + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+// resamples an RGBA8 image to width x height with a bilinear filter that wraps around the edges, since the textures
+// tile, into level 0 of image and builds the mip chain if asked to. For the layers of a texture array that come in
+// another size than the others (see TextureLoader::textureArray and bake/)
+inline void resampleImage(const unsigned char *src, int srcWidth, int srcHeight, int width, int height, bool mipmaps,
+                          TextureImage &image) {
+    image.width = width;
+    image.height = height;
+    image.levels = mipmaps ? fullMipLevels(width, height) : 1;
+    image.bytes = image.levelOffset(image.levels);
+    image.decoded.resize(image.bytes);
+    image.mapped.reset();
+
+    float scaleX = (float)srcWidth / width, scaleY = (float)srcHeight / height;
+    auto at = [&](int x, int y, int c) {
+        x = (x % srcWidth + srcWidth) % srcWidth;
+        y = (y % srcHeight + srcHeight) % srcHeight;
+        return (float)src[4 * ((size_t)y * srcWidth + x) + c];
+    };
+    for (int y = 0; y < height; ++y) {
+        float sy = (y + 0.5f) * scaleY - 0.5f;
+        int y0 = (int)std::floor(sy);
+        float fy = sy - y0;
+        for (int x = 0; x < width; ++x) {
+            float sx = (x + 0.5f) * scaleX - 0.5f;
+            int x0 = (int)std::floor(sx);
+            float fx = sx - x0;
+            for (int c = 0; c < 4; ++c) {
+                float v = (1 - fy) * ((1 - fx) * at(x0, y0, c) + fx * at(x0 + 1, y0, c)) +
+                          fy * ((1 - fx) * at(x0, y0 + 1, c) + fx * at(x0 + 1, y0 + 1, c));
+                image.decoded[4 * ((size_t)y * width + x) + c] = (unsigned char)std::lround(v);
+            }
+        }
+    }
+    for (int l = 1; l < image.levels; ++l) {
+        downsample(&image.decoded[image.levelOffset(l - 1)], image.levelWidth(l - 1), image.levelHeight(l - 1),
+                   &image.decoded[image.levelOffset(l)]);
+    }
+    image.pixels = image.decoded.data();
+}
+
+// decodes a PNG, flips it while copying it into level 0 and builds the mip chain if asked to
+inline bool decodeImage(const std::string &file, bool mipmaps, TextureImage &image) {
+    std::vector<unsigned char> raw;
+    unsigned width, height;
+    unsigned error = lodepng::decode(raw, width, height, file);
+    if (error) {
+        fprintf(stderr, "decoder error %u: %s (%s)\n", error, lodepng_error_text(error), file.c_str());
+        return false;
+    }
+
+    image.file = file;
+    image.width = (int)width;
+    image.height = (int)height;
+    image.levels = mipmaps ? fullMipLevels(image.width, image.height) : 1;
+    image.bytes = image.levelOffset(image.levels);
+    image.decoded.resize(image.bytes);
+
+    size_t rowBytes = 4 * (size_t)width;
+    for (unsigned j = 0; j < height; ++j) {
+        memcpy(&image.decoded[j * rowBytes], &raw[(height - 1 - j) * rowBytes], rowBytes);
+    }
+    for (int l = 1; l < image.levels; ++l) {
+        downsample(&image.decoded[image.levelOffset(l - 1)], image.levelWidth(l - 1), image.levelHeight(l - 1),
+                   &image.decoded[image.levelOffset(l)]);
+    }
+    image.pixels = image.decoded.data();
+    image.fromCache = false;
+    return true;
+}
+
+struct ImageCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width, height, levels;
+    uint32_t reserved;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t bytes;
+    unsigned char padding[16]; ///< the pixels start 64 bytes in
+};
+
+static_assert(sizeof(ImageCacheHeader) == 64, "the cache layout is fixed");
+
+const uint32_t imageCacheVersion = 1;
+
+inline std::string imageCachePath(const std::string &cacheDir, const std::string &file, bool mipmaps) {
+    std::string name = file;
+    std::replace(name.begin(), name.end(), '/', '_');
+    std::replace(name.begin(), name.end(), '\\', '_');
+    return cacheDir + "/" + name + (mipmaps ? ".mips" : "") + ".texcache";
+}
+
+inline bool sourceStamp(const std::string &file, uint64_t &size, int64_t &time) {
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0) return false;
+    size = (uint64_t)st.st_size;
+    time = (int64_t)st.st_mtime;
+    return true;
+}
+
+inline bool readImageCache(const std::string &cacheDir, const std::string &file, bool mipmaps, TextureImage &image) {
+    uint64_t size;
+    int64_t time;
+    if (!sourceStamp(file, size, time)) return false;
+
+    std::unique_ptr<MappedFile> mapped(new MappedFile());
+    if (!mapped->open(imageCachePath(cacheDir, file, mipmaps)) || mapped->size < sizeof(ImageCacheHeader)) return false;
+    ImageCacheHeader header;
+    memcpy(&header, mapped->data, sizeof(header));
+    if (memcmp(header.magic, "VWTC", 4) != 0 || header.version != imageCacheVersion ||
+        header.sourceSize != size || header.sourceTime != time ||
+        mapped->size != sizeof(header) + header.bytes) return false;
+
+    image.file = file;
+    image.width = (int)header.width;
+    image.height = (int)header.height;
+    image.levels = (int)header.levels;
+    image.bytes = (size_t)header.bytes;
+    if (image.levelOffset(image.levels) != image.bytes) return false;
+    image.pixels = mapped->data + sizeof(header);
+    image.mapped = std::move(mapped);
+    image.fromCache = true;
+    return true;
+}
+
+// writes to a temporary file renamed into place, so a crash never leaves a truncated entry behind
+inline bool writeImageCache(const std::string &cacheDir, const TextureImage &image, bool mipmaps) {
+    ImageCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "VWTC", 4);
+    header.version = imageCacheVersion;
+    header.width = image.width;
+    header.height = image.height;
+    header.levels = image.levels;
+    header.bytes = image.bytes;
+    if (!sourceStamp(image.file, header.sourceSize, header.sourceTime)) return false;
+
+#ifdef _WIN32
+    _mkdir(cacheDir.c_str());
+#else
+    mkdir(cacheDir.c_str(), 0755);
+#endif
+    std::string path = imageCachePath(cacheDir, image.file, mipmaps);
+    std::string temporary = path + ".tmp";
+    FILE *f = fopen(temporary.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(image.pixels, 1, image.bytes, f) == image.bytes;
+    ok = (fclose(f) == 0) && ok;
+    remove(path.c_str());
+    ok = ok && rename(temporary.c_str(), path.c_str()) == 0;
+    if (!ok) remove(temporary.c_str());
+    return ok;
+}
+
+// maps the cached entry when it is up to date, otherwise decodes the PNG and caches it
+// an empty cacheDir disables the cache
+inline bool loadImage(const std::string &file, const std::string &cacheDir, bool mipmaps, TextureImage &image) {
+    if (!cacheDir.empty() && readImageCache(cacheDir, file, mipmaps, image)) return true;
+    if (!decodeImage(file, mipmaps, image)) return false;
+    if (!cacheDir.empty()) writeImageCache(cacheDir, image, mipmaps);
+    return true;
+}
+
+#endif
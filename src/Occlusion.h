@@ -0,0 +1,235 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <OpenGP/types.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// occlusion culling against the terrain on the CPU, no OpenGL in here
+//
+// The occluders are the terrain itself, cut down to what can be rasterized quickly and is never in front of what
+// is drawn: every chunk carries a coarse grid whose vertices lie at or under its surface (see ChunkData.h), so
+// everything under that grid is under the ground. A ray from a camera above the ground that gets under it has
+// crossed the drawn surface first, and whatever lies behind that point is hidden.
+//
+// The grids of the chunks in view are rasterized into a small buffer holding the inverse view depth (1 / w of clip
+// space, which is affine on the screen so no pixel divides) of the nearest occluder of every pixel, sampled at the
+// pixel centres, 0 where there is none. Level 0 of the pyramid takes the farthest occluder of every pixel and its
+// eight neighbours, so a pixel that an occluder only partly covers does not count as covered, and level k the
+// farthest of 2x2 texels of level k - 1 (Hi-Z). A box is occluded when its nearest corner is behind the farthest
+// occluder over the rectangle it projects to, which a level where that rectangle spans a few texels answers in a
+// handful of reads.
+//
+// Only a camera above the ground can use it: the mirrored camera of the reflection is under the ground and the
+// refraction clips the hills the rays cross, so World only culls the main pass with it.
+
+class OcclusionBuffer {
+public:
+    int width, height;
+    std::vector<std::vector<float>> levels; ///< the pyramid of 1 / w, level 0 at width x height, 0 where nothing is
+    std::vector<int> levelWidths, levelHeights;
+
+    int trianglesRasterized = 0;            ///< since begin
+    int boxesTested = 0, boxesOccluded = 0; ///< since begin
+
+private:
+    std::vector<float> inverseDepth;        ///< of the nearest occluder at the pixel centres
+    std::vector<float> rowMin;              ///< scratch of finish
+    OpenGP::Mat4x4 projectionView = OpenGP::Mat4x4::Identity();
+
+public:
+    // 256 x 144 is a 5 x 5 block of pixels of a 1280 x 720 frame
+    explicit OcclusionBuffer(int _width = 256, int _height = 144) : width(_width), height(_height) {
+        inverseDepth.assign(width * height, 0.0f);
+        rowMin.assign(width * height, 0.0f);
+        int w = width, h = height;
+        while (true) {
+            levelWidths.push_back(w);
+            levelHeights.push_back(h);
+            levels.push_back(std::vector<float>(w * h, 0.0f));
+            if (w == 1 && h == 1) break;
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+        }
+    }
+
+    // clears the buffer for a camera, the occluders and the tests that follow use its projection * view
+    void begin(const OpenGP::Mat4x4 &_projectionView) {
+        projectionView = _projectionView;
+        std::fill(inverseDepth.begin(), inverseDepth.end(), 0.0f);
+        trianglesRasterized = 0;
+        boxesTested = 0;
+        boxesOccluded = 0;
+    }
+
+    // a grid of cells x cells squares of cellSize from (x0, y0), with the (cells + 1)^2 heights of its corners row
+    // by row, two triangles per square
+    void addHeightGrid(float x0, float y0, float cellSize, int cells, const float *heights) {
+        int cols = cells + 1;
+        std::vector<OpenGP::Vec4> clip(cols * cols);
+        for (int j = 0; j < cols; ++j) {
+            for (int i = 0; i < cols; ++i) {
+                OpenGP::Vec4 p(x0 + i * cellSize, y0 + j * cellSize, heights[i + j * cols], 1.0f);
+                clip[i + j * cols] = projectionView * p;
+            }
+        }
+        for (int j = 0; j < cells; ++j) {
+            for (int i = 0; i < cells; ++i) {
+                int a = i + j * cols, b = a + 1, c = a + cols, d = c + 1;
+                addClipTriangle(clip[a], clip[b], clip[c]);
+                addClipTriangle(clip[b], clip[d], clip[c]);
+            }
+        }
+    }
+
+    void addTriangle(const OpenGP::Vec3 &a, const OpenGP::Vec3 &b, const OpenGP::Vec3 &c) {
+        addClipTriangle(toClip(a), toClip(b), toClip(c));
+    }
+
+    // builds the pyramid, call after the occluders and before the tests
+    void finish() {
+        // the farthest of 3 x 3 pixels, along the rows and then along the columns
+        for (int y = 0; y < height; ++y) {
+            const float *row = &inverseDepth[y * width];
+            float *out = &rowMin[y * width];
+            for (int x = 0; x < width; ++x) {
+                out[x] = std::min(std::min(row[std::max(0, x - 1)], row[x]), row[std::min(width - 1, x + 1)]);
+            }
+        }
+        std::vector<float> &base = levels[0];
+        for (int y = 0; y < height; ++y) {
+            const float *above = &rowMin[std::max(0, y - 1) * width], *row = &rowMin[y * width];
+            const float *below = &rowMin[std::min(height - 1, y + 1) * width];
+            for (int x = 0; x < width; ++x) base[x + y * width] = std::min(std::min(above[x], row[x]), below[x]);
+        }
+        for (size_t level = 1; level < levels.size(); ++level) {
+            const std::vector<float> &fine = levels[level - 1];
+            int fw = levelWidths[level - 1], fh = levelHeights[level - 1];
+            int w = levelWidths[level], h = levelHeights[level];
+            std::vector<float> &coarse = levels[level];
+            for (int y = 0; y < h; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    int x0 = 2 * x, y0 = 2 * y, x1 = std::min(x0 + 1, fw - 1), y1 = std::min(y0 + 1, fh - 1);
+                    coarse[x + y * w] = std::min(std::min(fine[x0 + y0 * fw], fine[x1 + y0 * fw]),
+                                                 std::min(fine[x0 + y1 * fw], fine[x1 + y1 * fw]));
+                }
+            }
+        }
+    }
+
+    // true when the box is hidden behind the occluders, conservative: a box that reaches in front of the near
+    // plane or off the buffer is visible
+    bool occluded(const OpenGP::Vec3 &lo, const OpenGP::Vec3 &hi) {
+        boxesTested++;
+        float nearest = 0.0f; ///< 1 / w
+        const float inf = std::numeric_limits<float>::infinity();
+        float minX = inf, minY = inf, maxX = -inf, maxY = -inf;
+        for (int corner = 0; corner < 8; ++corner) {
+            OpenGP::Vec3 p((corner & 1) ? hi.x() : lo.x(), (corner & 2) ? hi.y() : lo.y(), (corner & 4) ? hi.z() : lo.z());
+            OpenGP::Vec4 c = toClip(p);
+            if (c.z() < -c.w() || c.w() <= 0.0f) return false;
+            nearest = std::max(nearest, 1.0f / c.w());
+            float sx, sy;
+            toScreen(c, sx, sy);
+            minX = std::min(minX, sx);
+            maxX = std::max(maxX, sx);
+            minY = std::min(minY, sy);
+            maxY = std::max(maxY, sy);
+        }
+        int x0 = std::max(0, (int)std::floor(minX)), x1 = std::min(width - 1, (int)std::floor(maxX));
+        int y0 = std::max(0, (int)std::floor(minY)), y1 = std::min(height - 1, (int)std::floor(maxY));
+        if (x0 > x1 || y0 > y1) return false;
+
+        // the level where the rectangle spans at most 4 x 4 texels
+        size_t level = 0;
+        while ((x1 - x0 > 3 || y1 - y0 > 3) && level + 1 < levels.size()) {
+            x0 >>= 1; x1 >>= 1; y0 >>= 1; y1 >>= 1;
+            ++level;
+        }
+        const std::vector<float> &texels = levels[level];
+        int w = levelWidths[level];
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                if (texels[x + y * w] <= nearest) return false;
+            }
+        }
+        boxesOccluded++;
+        return true;
+    }
+
+    // the view depth of the nearest occluder at a pixel centre, +infinity where there is none (for the benchmarks)
+    float depthAt(int x, int y) const {
+        float inverse = inverseDepth[x + y * width];
+        return inverse > 0.0f ? 1.0f / inverse : std::numeric_limits<float>::infinity();
+    }
+
+    // the share of the pixels of level 0 that are covered
+    float coverage() const {
+        int covered = 0;
+        for (float d : levels[0]) covered += d > 0.0f ? 1 : 0;
+        return (float)covered / (float)levels[0].size();
+    }
+
+private:
+    OpenGP::Vec4 toClip(const OpenGP::Vec3 &p) const {
+        return projectionView * OpenGP::Vec4(p.x(), p.y(), p.z(), 1.0f);
+    }
+
+    // pixels of the buffer, x and y grow with the ones of normalized device coordinates
+    void toScreen(const OpenGP::Vec4 &c, float &x, float &y) const {
+        x = (c.x() / c.w() * 0.5f + 0.5f) * width;
+        y = (c.y() / c.w() * 0.5f + 0.5f) * height;
+    }
+
+    // clipped against the near plane z = -w first, which also removes everything behind the camera
+    void addClipTriangle(const OpenGP::Vec4 &a, const OpenGP::Vec4 &b, const OpenGP::Vec4 &c) {
+        const OpenGP::Vec4 *in[3] = { &a, &b, &c };
+        OpenGP::Vec4 polygon[4];
+        int count = 0;
+        for (int k = 0; k < 3; ++k) {
+            const OpenGP::Vec4 &p = *in[k], &q = *in[(k + 1) % 3];
+            float dp = p.z() + p.w(), dq = q.z() + q.w();
+            if (dp >= 0.0f) polygon[count++] = p;
+            if ((dp >= 0.0f) != (dq >= 0.0f)) polygon[count++] = p + (q - p) * (dp / (dp - dq));
+        }
+        for (int k = 1; k + 1 < count; ++k) rasterize(polygon[0], polygon[k], polygon[k + 1]);
+    }
+
+    // the pixels whose centre is in the triangle, either winding; 1 / w is affine on the screen
+    void rasterize(const OpenGP::Vec4 &a, const OpenGP::Vec4 &b, const OpenGP::Vec4 &c) {
+        float ax, ay, bx, by, cx, cy;
+        toScreen(a, ax, ay);
+        toScreen(b, bx, by);
+        toScreen(c, cx, cy);
+        float area = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+        if (area == 0.0f || !std::isfinite(area)) return;
+        trianglesRasterized++;
+
+        int x0 = std::max(0, (int)std::ceil(std::min(std::min(ax, bx), cx) - 0.5f));
+        int x1 = std::min(width - 1, (int)std::floor(std::max(std::max(ax, bx), cx) - 0.5f));
+        int y0 = std::max(0, (int)std::ceil(std::min(std::min(ay, by), cy) - 0.5f));
+        int y1 = std::min(height - 1, (int)std::floor(std::max(std::max(ay, by), cy) - 0.5f));
+        if (x0 > x1 || y0 > y1) return;
+
+        // the barycentric weights of b and c and the 1 / w they interpolate are affine, they step along the rows
+        float invArea = 1.0f / area;
+        float ia = 1.0f / a.w(), ib = 1.0f / b.w(), ic = 1.0f / c.w();
+        float wbX = (cy - ay) * invArea, wbY = -(cx - ax) * invArea;
+        float wcX = -(by - ay) * invArea, wcY = (bx - ax) * invArea;
+        float px = x0 + 0.5f - ax;
+        for (int y = y0; y <= y1; ++y) {
+            float py = y + 0.5f - ay;
+            float wb = px * wbX + py * wbY, wc = px * wcX + py * wcY;
+            float *row = &inverseDepth[y * width];
+            for (int x = x0; x <= x1; ++x, wb += wbX, wc += wcX) {
+                if (wb < 0.0f || wc < 0.0f || wb + wc > 1.0f) continue;
+                float inverse = ia + wb * (ib - ia) + wc * (ic - ia);
+                row[x] = std::max(row[x], inverse);
+            }
+        }
+    }
+};
+
+#endif
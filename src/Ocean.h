@@ -0,0 +1,212 @@
+#ifndef OCEAN_H
+#define OCEAN_H
+
+#include "utility.h"
+#include "OceanSimulation.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <future>
+
+// the displacement and normal maps of the water, stepped on worker threads (see OceanSimulation.h)
+//
+// The render thread never waits for the simulation. Steps write straight into one of three pixel unpack buffers
+// of a ring; once a step is done the next frame uploads the maps from its buffer, fences the upload and starts
+// the next step into the next buffer. A buffer is only written again after its fence has passed, and a frame
+// that finds the step still running or the next buffer still in use by the GPU keeps the maps it has. With
+// GL_ARB_buffer_storage the buffers stay mapped for their whole life, otherwise the buffer of a step is mapped
+// unsynchronized while it runs.
+
+struct OceanStats {
+    int steps = 0;             ///< started
+    int uploads = 0;
+    int busyFrames = 0;        ///< frames that kept the old maps, the step was still running
+    int ringFullFrames = 0;    ///< frames that could not start a step, the GPU still read the next buffer
+    double stepMs = 0.0;       ///< of the last step, on the workers
+    size_t uploadBytes = 0;
+    bool persistent = false;   ///< the buffers are persistently mapped
+};
+
+class Ocean {
+public:
+    static const int ringSize = 3;
+
+    OceanSimulation simulation;
+    std::unique_ptr<RGB32FTexture> displacement;
+    std::unique_ptr<RGBA8Texture> normals;
+    OceanStats stats;
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        unsigned char *mapped = nullptr; ///< the persistent mapping, or the mapping of the step that runs
+        GLsync fence = 0;                ///< the upload from the buffer
+    };
+
+    ThreadPool pool;
+    Slot slots[ringSize];
+    int writing = -1;                    ///< the slot of the step that runs
+    int next = 0;                        ///< the slot of the next step
+    std::future<void> running;
+    std::shared_ptr<double> runningMs;
+
+public:
+    // the steps run on threads workers, the FFTs of a step split across them
+    explicit Ocean(const OceanParams &params = OceanParams(), unsigned int threads = 2)
+        : simulation(params), pool(std::max(1u, threads)) {
+        simulation.pool = &pool;
+        int n = simulation.size();
+
+        displacement = std::unique_ptr<RGB32FTexture>(new RGB32FTexture());
+        displacement->allocate(n, n);
+        normals = std::unique_ptr<RGBA8Texture>(new RGBA8Texture());
+        normals->allocate(n, n);
+        // flat water until the first step is uploaded
+        std::vector<float> flat(3 * n * n, 0.0f);
+        std::vector<unsigned char> up(4 * n * n);
+        for (size_t i = 0; i < up.size(); i += 4) {
+            up[i] = 128; up[i + 1] = 128; up[i + 2] = 255; up[i + 3] = 0;
+        }
+        displacement->upload_raw(n, n, flat.data());
+        normals->upload_raw(n, n, up.data());
+        // the maps tile, the vertex shader reads level 0 of the displacement, the normals are filtered
+        displacement->bind();
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        normals->bind();
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        normals->unbind();
+
+        stats.persistent = hasGLExtension("GL_ARB_buffer_storage") && glBufferStorage != nullptr;
+        GLsizeiptr bytes = (GLsizeiptr)slotBytes();
+        for (Slot &slot : slots) {
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            if (stats.persistent) {
+                // coherent, the workers' writes are visible to every command issued after the step is done
+                GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, flags);
+                slot.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags);
+            } else {
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            }
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    Ocean(const Ocean&) = delete;
+    Ocean &operator=(const Ocean&) = delete;
+
+    ~Ocean() {
+        // the workers write into the mapped buffers
+        if (running.valid()) running.wait();
+        for (Slot &slot : slots) {
+            if (slot.mapped) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            }
+            if (slot.fence) glDeleteSync(slot.fence);
+            glDeleteBuffers(1, &slot.buffer);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    const OceanParams &params() const { return simulation.params; }
+
+    // once per frame: uploads the step that finished and starts the one for time
+    // wait makes every frame show the step of its own time, for reproducible images
+    void update(float time, bool wait = false) {
+        if (wait) {
+            if (running.valid()) finishStep();
+            if (startStep(time, true)) finishStep();
+            return;
+        }
+        if (running.valid()) {
+            if (running.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                stats.busyFrames++;
+                return;
+            }
+            finishStep();
+        }
+        startStep(time, false);
+    }
+
+    // displacement on unit, normals on unit + 1
+    void bind(int unit) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        displacement->bind();
+        glActiveTexture(GL_TEXTURE0 + unit + 1);
+        normals->bind();
+    }
+
+private:
+    size_t slotBytes() const {
+        return simulation.displacementBytes() + simulation.normalBytes();
+    }
+
+    bool startStep(float time, bool wait) {
+        Slot &slot = slots[next];
+        if (slot.fence) {
+            GLenum status = glClientWaitSync(slot.fence, 0, wait ? GL_TIMEOUT_IGNORED : 0);
+            if (status == GL_TIMEOUT_EXPIRED) {
+                stats.ringFullFrames++;
+                return false;
+            }
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+        }
+        if (!stats.persistent) {
+            // the GPU is done with the buffer, nothing to synchronize
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            slot.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)slotBytes(),
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            if (!slot.mapped) return false;
+        }
+
+        writing = next;
+        next = (next + 1) % ringSize;
+        stats.steps++;
+        float *displacementOut = (float*)slot.mapped;
+        unsigned char *normalsOut = slot.mapped + simulation.displacementBytes();
+        auto ms = std::make_shared<double>(0.0);
+        runningMs = ms;
+        OceanSimulation *sim = &simulation;
+        running = pool.submit([sim, time, displacementOut, normalsOut, ms]() {
+            auto start = std::chrono::steady_clock::now();
+            sim->step(time, displacementOut, normalsOut);
+            *ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        });
+        return true;
+    }
+
+    void finishStep() {
+        running.get();
+        stats.stepMs = *runningMs;
+        Slot &slot = slots[writing];
+        int n = simulation.size();
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        if (!stats.persistent) {
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            slot.mapped = nullptr;
+        }
+        displacement->bind();
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n, n, GL_RGB, GL_FLOAT, (const void*)0);
+        normals->bind();
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n, n, GL_RGBA, GL_UNSIGNED_BYTE,
+                        (const void*)simulation.displacementBytes());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        normals->unbind();
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        writing = -1;
+        stats.uploads++;
+        stats.uploadBytes += slotBytes();
+    }
+};
+
+#endif
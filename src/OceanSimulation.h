@@ -0,0 +1,364 @@
+#ifndef OCEANSIMULATION_H
+#define OCEANSIMULATION_H
+
+#include <OpenGP/types.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "HeightfieldGenerator.h"
+#include "ThreadPool.h"
+
+// Tessendorf's ocean ("Simulating Ocean Water") on the CPU, nothing in here touches OpenGL
+//
+// A Phillips spectrum of random amplitudes is drawn once. A step turns it into the spectrum at a time, and
+// inverse FFTs of it give the heights, the horizontal (choppy) displacement and the slopes on an N x N grid that
+// tiles over patchSize world units. The real fields go two to a complex transform (A + iB of two real fields
+// transforms to a + ib), so the five fields cost three 2D transforms. The 2D transform is radix 2 along the
+// columns, a transpose, and along the columns again: along a column the butterflies of neighbouring columns are
+// independent and contiguous in memory, so the SSE4.1/AVX2 lanes of HeightfieldGenerator.h take 4 or 8 columns
+// at once without any shuffles, and the thread pool takes strips of columns.
+
+struct OceanParams {
+    int size = 128;                     ///< N, a power of two from 64 to 512
+    float patchSize = 2.0f;             ///< world units the maps tile over
+    float windSpeed = 0.4f;             ///< the longest waves are windSpeed^2 / gravity
+    OpenGP::Vec2 windDirection = OpenGP::Vec2(1.0f, 0.4f);
+    float gravity = 1.0f;               ///< world units / s^2, 9.81 makes the waves of a lake this size too fast
+    float waveHeight = 0.005f;          ///< root mean square of the heights, the spectrum is scaled to it
+    float choppiness = 1.5f;            ///< of the horizontal displacement
+    float loopSeconds = 200.0f;         ///< the frequencies are rounded so that the waves repeat after this
+    uint32_t seed = 1;
+};
+
+namespace ocean {
+
+#if defined(__AVX2__)
+typedef heightfield::Float8 Lanes;
+#elif defined(__SSE4_1__)
+typedef heightfield::Float4 Lanes;
+#else
+typedef heightfield::Float1 Lanes;
+#endif
+
+// columns a task transforms, a multiple of every lane width. Wider strips run the butterflies of a row over more
+// lanes at once, up to 64 columns of a 512 field (256 KB with the imaginary parts) that stay in the L2 cache; the
+// field still splits into 8 strips for the threads
+inline int stripWidth(int n) {
+    return std::max(16, std::min(64, n / 8));
+}
+
+// e^(+2 pi i m / n) for m < n / 2 and the bit reversal permutation of n rows
+struct FFTPlan {
+    int n = 0;
+    std::vector<float> cosines, sines;
+    std::vector<int> reversed;
+
+    explicit FFTPlan(int _n = 0) : n(_n) {
+        int bits = 0;
+        while ((1 << bits) < n) ++bits;
+        cosines.resize(n / 2);
+        sines.resize(n / 2);
+        for (int m = 0; m < n / 2; ++m) {
+            double angle = 2.0 * M_PI * m / n;
+            cosines[m] = (float)std::cos(angle);
+            sines[m] = (float)std::sin(angle);
+        }
+        reversed.resize(n);
+        for (int r = 0; r < n; ++r) {
+            int v = 0;
+            for (int b = 0; b < bits; ++b) v |= ((r >> b) & 1) << (bits - 1 - b);
+            reversed[r] = v;
+        }
+    }
+};
+
+// unnormalized inverse DFT along the columns [c0, c1) of a row major n x n field, in place
+template <typename T>
+inline void inverseColumns(const FFTPlan &plan, float *re, float *im, int c0, int c1) {
+    const int n = plan.n;
+    for (int r = 0; r < n; ++r) {
+        int s = plan.reversed[r];
+        if (s <= r) continue;
+        std::swap_ranges(re + r * n + c0, re + r * n + c1, re + s * n + c0);
+        std::swap_ranges(im + r * n + c0, im + r * n + c1, im + s * n + c0);
+    }
+
+    for (int half = 1; half < n; half *= 2) {
+        int twiddleStep = n / (2 * half);
+        for (int start = 0; start < n; start += 2 * half) {
+            for (int k = 0; k < half; ++k) {
+                T wr(plan.cosines[k * twiddleStep]), wi(plan.sines[k * twiddleStep]);
+                float *aRe = re + (start + k) * n, *aIm = im + (start + k) * n;
+                float *bRe = aRe + half * n, *bIm = aIm + half * n;
+                for (int c = c0; c < c1; c += T::width) {
+                    T br = T::load(bRe + c), bi = T::load(bIm + c);
+                    T tr = br * wr - bi * wi, ti = br * wi + bi * wr;
+                    T ar = T::load(aRe + c), ai = T::load(aIm + c);
+                    (ar + tr).store(aRe + c);
+                    (ai + ti).store(aIm + c);
+                    (ar - tr).store(bRe + c);
+                    (ai - ti).store(bIm + c);
+                }
+            }
+        }
+    }
+}
+
+// out = in transposed, over the rows [r0, r1) of in
+inline void transposeRows(const float *in, float *out, int n, int r0, int r1) {
+    const int block = 16;
+    for (int rb = r0; rb < r1; rb += block) {
+        for (int cb = 0; cb < n; cb += block) {
+            int re = std::min(r1, rb + block), ce = std::min(n, cb + block);
+            for (int r = rb; r < re; ++r) {
+                for (int c = cb; c < ce; ++c) out[c * n + r] = in[r * n + c];
+            }
+        }
+    }
+}
+
+// unnormalized 2D inverse DFT of a row major n x n field, out(r, c) = sum over (u, v) of in(u, v) e^(2 pi i (u r + v c) / n)
+// the result comes out transposed, scratch[c * n + r] = out(r, c), so a caller that lays out its input transposed
+// gets its output the right way around without a second transpose. re and im are overwritten, pool may be null
+template <typename T = Lanes>
+inline void inverseFFT2D(const FFTPlan &plan, float *re, float *im, float *scratchRe, float *scratchIm, ThreadPool *pool) {
+    const int n = plan.n;
+    auto columns = [&](float *fr, float *fi) {
+        const int width = stripWidth(n);
+        auto strips = [&](int begin, int end) {
+            for (int s = begin; s < end; ++s) inverseColumns<T>(plan, fr, fi, s * width, std::min(n, (s + 1) * width));
+        };
+        int numStrips = (n + width - 1) / width;
+        if (pool) pool->parallelFor(0, numStrips, 1, strips);
+        else strips(0, numStrips);
+    };
+
+    // along u, then swap the axes so that v runs along the columns, and along v
+    columns(re, im);
+    auto rows = [&](int begin, int end) {
+        transposeRows(re, scratchRe, n, begin, end);
+        transposeRows(im, scratchIm, n, begin, end);
+    };
+    if (pool) pool->parallelFor(0, n, 32, rows);
+    else rows(0, n);
+    columns(scratchRe, scratchIm);
+}
+
+inline const char *kernelName() {
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE4_1__)
+    return "SSE4.1";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace ocean
+
+// one ocean, step() may run on any thread but only one step at a time
+class OceanSimulation {
+public:
+    OceanParams params;
+    ThreadPool *pool; ///< may be null, everything then runs on the calling thread
+
+private:
+    int n;
+    ocean::FFTPlan plan;
+    // per wavenumber, stored with kx along the rows (see inverseFFT2D): h0(k) + conj(h0(-k)) and
+    // h0(k) - conj(h0(-k)), choppiness / |k|, and the frequency as a multiple of 2 pi / loopSeconds
+    std::vector<float> sumRe, sumIm, differenceRe, differenceIm, choppy;
+    std::vector<int> harmonic;
+    std::vector<float> wavenumbers; ///< of the FFT indices
+    // e^(i m 2 pi t / loopSeconds) of the step for every harmonic, instead of a sine and a cosine per wavenumber
+    std::vector<float> phaseCos, phaseSin;
+    // the three complex fields the spectrum of a step goes into, and the transforms of them
+    std::vector<float> fieldRe[3], fieldIm[3], outRe[3], outIm[3];
+
+public:
+    explicit OceanSimulation(const OceanParams &_params = OceanParams(), ThreadPool *_pool = nullptr)
+        : params(_params), pool(_pool), n(_params.size), plan(_params.size) {
+        size_t count = (size_t)n * n;
+        sumRe.assign(count, 0.0f); sumIm.assign(count, 0.0f);
+        differenceRe.assign(count, 0.0f); differenceIm.assign(count, 0.0f);
+        choppy.assign(count, 0.0f);
+        harmonic.assign(count, 0);
+        wavenumbers.resize(n);
+        for (int m = 0; m < n; ++m) wavenumbers[m] = wavenumber(m);
+        for (int f = 0; f < 3; ++f) {
+            fieldRe[f].resize(count); fieldIm[f].resize(count);
+            outRe[f].resize(count); outIm[f].resize(count);
+        }
+        initialSpectrum();
+    }
+
+    int size() const { return n; }
+
+    // bytes step() writes to displacement and to normals
+    size_t displacementBytes() const { return (size_t)n * n * 3 * sizeof(float); }
+    size_t normalBytes() const { return (size_t)n * n * 4; }
+
+    // the waves at time seconds, row major with x along the rows and y from one row to the next:
+    // displacement holds 3 floats per texel (x, y, height) in world units, normals 4 bytes per texel, the normal
+    // mapped from [-1, 1] to [0, 255] and the foam where the choppy displacement folds the surface
+    void step(float time, float *displacement, unsigned char *normals) {
+        spectrum(time);
+        for (int f = 0; f < 3; ++f) {
+            ocean::inverseFFT2D(plan, fieldRe[f].data(), fieldIm[f].data(), outRe[f].data(), outIm[f].data(), pool);
+        }
+        auto rows = [&](int begin, int end) { output(begin, end, displacement, normals); };
+        if (pool) pool->parallelFor(0, n, 16, rows);
+        else rows(0, n);
+    }
+
+    // the height of the waves alone, to check the spectrum, step() has to have run
+    float rmsHeight() const {
+        double sum = 0.0;
+        for (float h : outRe[0]) sum += (double)h * h;
+        return (float)std::sqrt(sum / ((double)n * n));
+    }
+
+private:
+    // the wavenumber of FFT index m, the upper half of the indices are the negative ones
+    float wavenumber(int m) const {
+        return 2.0f * (float)M_PI * (float)(m < n / 2 ? m : m - n) / params.patchSize;
+    }
+
+    // Phillips spectrum with the small waves damped and the waves going against the wind mostly gone
+    float phillips(float kx, float ky) const {
+        float k2 = kx * kx + ky * ky;
+        if (k2 == 0.0f) return 0.0f;
+        OpenGP::Vec2 wind = params.windDirection.normalized();
+        float largest = params.windSpeed * params.windSpeed / params.gravity;
+        float smallest = largest / 1000.0f;
+        float cosine = (kx * wind.x() + ky * wind.y()) / std::sqrt(k2);
+        float directional = cosine * cosine * (cosine < 0.0f ? 0.25f : 1.0f);
+        return std::exp(-1.0f / (k2 * largest * largest)) / (k2 * k2) * directional * std::exp(-k2 * smallest * smallest);
+    }
+
+    // the random amplitudes, scaled so that the heights have the requested root mean square
+    void initialSpectrum() {
+        // mt19937 is the same sequence everywhere, std::normal_distribution is not, hence Box-Muller
+        std::mt19937 rng(params.seed);
+        auto uniform = [&]() { return ((double)rng() + 0.5) / 4294967296.0; };
+        std::vector<float> re((size_t)n * n), im((size_t)n * n);
+        for (int u = 0; u < n; ++u) {
+            for (int v = 0; v < n; ++v) {
+                double radius = std::sqrt(-2.0 * std::log(uniform())), angle = 2.0 * M_PI * uniform();
+                // the Nyquist row and column have no negative partner, the fields would not be real
+                bool nyquist = u == n / 2 || v == n / 2;
+                float amplitude = nyquist ? 0.0f : std::sqrt(phillips(wavenumber(u), wavenumber(v)) / 2.0f);
+                re[u * n + v] = amplitude * (float)(radius * std::cos(angle));
+                im[u * n + v] = amplitude * (float)(radius * std::sin(angle));
+            }
+        }
+
+        // the variance of the heights is the sum of |h0(k)|^2 + |h0(-k)|^2 (Parseval, the cross terms average out)
+        double variance = 0.0;
+        for (size_t i = 0; i < re.size(); ++i) variance += 2.0 * ((double)re[i] * re[i] + (double)im[i] * im[i]);
+        float scale = variance > 0.0 ? (float)(params.waveHeight / std::sqrt(variance)) : 0.0f;
+
+        float base = 2.0f * (float)M_PI / params.loopSeconds;
+        int harmonics = 0;
+        for (int u = 0; u < n; ++u) {
+            for (int v = 0; v < n; ++v) {
+                int i = u * n + v, negative = ((n - u) % n) * n + (n - v) % n;
+                // h0(k) and conj(h0(-k))
+                float aRe = scale * re[i], aIm = scale * im[i], bRe = scale * re[negative], bIm = -scale * im[negative];
+                sumRe[i] = aRe + bRe;
+                sumIm[i] = aIm + bIm;
+                differenceRe[i] = aRe - bRe;
+                differenceIm[i] = aIm - bIm;
+                float kx = wavenumber(u), ky = wavenumber(v), length = std::sqrt(kx * kx + ky * ky);
+                choppy[i] = length > 0.0f ? params.choppiness / length : 0.0f;
+                float deep = std::sqrt(params.gravity * length);
+                harmonic[i] = (int)std::floor(deep / base);
+                harmonics = std::max(harmonics, harmonic[i] + 1);
+            }
+        }
+        phaseCos.resize(harmonics);
+        phaseSin.resize(harmonics);
+    }
+
+    // h(k, t) = h0(k) e^(i w t) + conj(h0(-k)) e^(-i w t) = sum cos(w t) + i difference sin(w t), and from it the spectra of the other fields:
+    // slopes i k h, horizontal displacement -i k / |k| h. Two real fields per complex one: A + iB
+    void spectrum(float time) {
+        // in double and reduced to one period, the phases of a long run stay exact
+        double cycles = std::fmod((double)time / params.loopSeconds, 1.0);
+        for (size_t m = 0; m < phaseCos.size(); ++m) {
+            double angle = 2.0 * M_PI * std::fmod(m * cycles, 1.0);
+            phaseCos[m] = (float)std::cos(angle);
+            phaseSin[m] = (float)std::sin(angle);
+        }
+
+        const float *cosines = phaseCos.data(), *sines = phaseSin.data(), *ks = wavenumbers.data();
+        auto rows = [&](int begin, int end) {
+            for (int u = begin; u < end; ++u) {
+                float kx = ks[u];
+                int row = u * n;
+                const float *aRe = &sumRe[row], *aIm = &sumIm[row], *dRe = &differenceRe[row], *dIm = &differenceIm[row];
+                const float *chop = &choppy[row];
+                const int *m = &harmonic[row];
+                float *re0 = &fieldRe[0][row], *im0 = &fieldIm[0][row], *re1 = &fieldRe[1][row], *im1 = &fieldIm[1][row];
+                float *re2 = &fieldRe[2][row], *im2 = &fieldIm[2][row];
+                for (int v = 0; v < n; ++v) {
+                    float ky = ks[v];
+                    float c = cosines[m[v]], s = sines[m[v]];
+                    float hr = aRe[v] * c - dIm[v] * s;
+                    float hi = aIm[v] * c + dRe[v] * s;
+
+                    float ux = chop[v] * kx, uy = chop[v] * ky;
+                    // i k h = (-k hi, k hr), -i u h = (u hi, -u hr)
+                    float slopeXRe = -kx * hi, slopeXIm = kx * hr;
+                    float slopeYRe = -ky * hi, slopeYIm = ky * hr;
+                    float dxRe = ux * hi, dxIm = -ux * hr;
+                    float dyRe = uy * hi, dyIm = -uy * hr;
+
+                    // (height, slope x), (slope y, displacement x), (displacement y, nothing)
+                    re0[v] = hr - slopeXIm;       im0[v] = hi + slopeXRe;
+                    re1[v] = slopeYRe - dxIm;     im1[v] = slopeYIm + dxRe;
+                    re2[v] = dyRe;                im2[v] = dyIm;
+                }
+            }
+        };
+        if (pool) pool->parallelFor(0, n, 16, rows);
+        else rows(0, n);
+    }
+
+    void output(int begin, int end, float *displacement, unsigned char *normals) const {
+        const float *height = outRe[0].data(), *slopeX = outIm[0].data(), *slopeY = outRe[1].data();
+        const float *dx = outIm[1].data(), *dy = outRe[2].data();
+        float inverseSpacing = n / (2.0f * params.patchSize);
+        auto byte = [](float a) { return (unsigned char)std::max(0.0f, std::min(255.0f, 127.5f * a + 127.5f + 0.5f)); };
+        for (int y = begin; y < end; ++y) {
+            // the maps tile, the neighbours of the edges are on the other side
+            int up = (y + 1 == n ? 0 : y + 1) * n, down = (y == 0 ? n - 1 : y - 1) * n;
+            for (int x = 0; x < n; ++x) {
+                int i = y * n + x, right = x + 1 == n ? 0 : x + 1, left = x == 0 ? n - 1 : x - 1;
+                float *d = displacement + 3 * i;
+                d[0] = dx[i];
+                d[1] = dy[i];
+                d[2] = height[i];
+
+                float nx = -slopeX[i], ny = -slopeY[i];
+                float invLength = 1.0f / std::sqrt(nx * nx + ny * ny + 1.0f);
+                // the Jacobian of the horizontal displacement, the crests get foam as it drops towards 0, where the
+                // surface would fold over itself
+                float dxdx = (dx[y * n + right] - dx[y * n + left]) * inverseSpacing;
+                float dydy = (dy[up + x] - dy[down + x]) * inverseSpacing;
+                float dxdy = (dx[up + x] - dx[down + x]) * inverseSpacing;
+                float jacobian = (1.0f + dxdx) * (1.0f + dydy) - dxdy * dxdy;
+                unsigned char *normal = normals + 4 * i;
+                normal[0] = byte(nx * invLength);
+                normal[1] = byte(ny * invLength);
+                normal[2] = byte(invLength);
+                normal[3] = byte(std::max(0.0f, std::min(1.0f, 4.0f * (0.9f - jacobian))) * 2.0f - 1.0f);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,267 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "utility.h"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// scoped CPU/GPU markers for the passes of a frame
+//
+//     profiler().beginFrame();
+//     { PROFILE_SCOPE("reflection"); ... }
+//     profiler().endFrame();
+//
+// Scopes nest. GPU times come from GL_TIMESTAMP queries written at both ends of a scope. The queries of a
+// frame are only read back when their set comes around again two frames later (double buffered), by which
+// time the GPU is normally done with them, so profiling does not stall the pipeline.
+// Resolved frames go into a ring buffer of the last historySize frames.
+// Everything here has to be called from the GL thread.
+
+struct ProfileSample {
+    const char *name;  ///< string literal, the macro is meant for constant names
+    int depth;         ///< 0 for the outermost scopes
+    double cpuStartMs; ///< from the start of the frame
+    double cpuMs;
+    double gpuStartMs; ///< from the start of the frame on the GPU, -1 without timer queries
+    double gpuMs;      ///< -1 without timer queries
+};
+
+// a value recorded once in a frame, e.g. a decision of the code that adapts the quality to the frame time
+struct ProfileCounter {
+    const char *name;  ///< string literal, like the scope names
+    double value;
+};
+
+struct ProfileFrame {
+    unsigned int index = 0;
+    double startMs = 0.0; ///< since the profiler was created
+    double cpuMs = 0.0;
+    double gpuMs = -1.0;
+    std::vector<ProfileSample> samples;   ///< in the order the scopes were opened
+    std::vector<ProfileCounter> counters; ///< in the order they were recorded
+};
+
+class Profiler {
+public:
+    bool enabled = true;
+    bool gpuTimers = false; ///< GL 3.3 or ARB_timer_query, known after the first frame
+
+private:
+    // the queries of one frame in flight
+    struct QuerySet {
+        std::vector<GLuint> queries;
+        size_t used = 0;
+        std::vector<std::pair<size_t, size_t>> sampleQueries; ///< begin/end query of every sample
+        size_t frameBegin = 0, frameEnd = 0;
+        ProfileFrame frame;
+        bool pending = false;
+    };
+
+    QuerySet sets[2];
+    int current = 0;
+    bool inFrame = false, initialized = false;
+    unsigned int frameIndex = 0;
+    std::vector<int> open; ///< samples of the current frame that are not closed yet
+
+    std::vector<ProfileFrame> history;
+    size_t historySize = 240, historyHead = 0;
+
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point frameStart;
+
+public:
+    // the query objects are not deleted, the profiler lives until exit and they go away with the context
+
+    void beginFrame() {
+        if (!enabled) return;
+        if (!initialized) {
+            gpuTimers = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+            initialized = true;
+        }
+
+        QuerySet &set = sets[current];
+        if (set.pending) resolve(set);
+        set.used = 0;
+        set.sampleQueries.clear();
+        set.frame = ProfileFrame();
+        set.frame.index = frameIndex++;
+
+        frameStart = std::chrono::steady_clock::now();
+        set.frame.startMs = msBetween(origin, frameStart);
+        if (gpuTimers) set.frameBegin = timestamp(set);
+        open.clear();
+        inFrame = true;
+    }
+
+    void endFrame() {
+        if (!inFrame) return;
+        while (!open.empty()) pop();
+
+        QuerySet &set = sets[current];
+        set.frame.cpuMs = msBetween(frameStart, std::chrono::steady_clock::now());
+        if (gpuTimers) set.frameEnd = timestamp(set);
+        set.pending = true;
+        inFrame = false;
+
+        // without GPU timings there is nothing to wait for
+        if (!gpuTimers) resolve(set);
+        current ^= 1;
+    }
+
+    void push(const char *name) {
+        if (!inFrame) return;
+        QuerySet &set = sets[current];
+        ProfileSample sample = { name, (int)open.size(), msBetween(frameStart, std::chrono::steady_clock::now()), 0.0, -1.0, -1.0 };
+        open.push_back((int)set.frame.samples.size());
+        set.frame.samples.push_back(sample);
+        set.sampleQueries.push_back(std::make_pair(gpuTimers ? timestamp(set) : 0, (size_t)0));
+    }
+
+    void pop() {
+        if (!inFrame || open.empty()) return;
+        QuerySet &set = sets[current];
+        int s = open.back();
+        open.pop_back();
+        ProfileSample &sample = set.frame.samples[s];
+        sample.cpuMs = msBetween(frameStart, std::chrono::steady_clock::now()) - sample.cpuStartMs;
+        if (gpuTimers) set.sampleQueries[s].second = timestamp(set);
+    }
+
+    // records a value for the current frame, it shows next to the scopes and as a counter track in the trace
+    void counter(const char *name, double value) {
+        if (!inFrame) return;
+        ProfileCounter c = { name, value };
+        sets[current].frame.counters.push_back(c);
+    }
+
+    // waits for the frames still in flight, e.g. before reading the results at the end of a benchmark
+    void flush() {
+        for (int i = 0; i < 2; ++i) {
+            QuerySet &set = sets[(current + i) & 1];
+            if (set.pending) resolve(set);
+        }
+    }
+
+    // frames older than this are dropped from the ring buffer
+    void setHistorySize(size_t frames) {
+        std::vector<ProfileFrame> kept;
+        for (size_t age = std::min(numFrames(), frames); age-- > 0;) kept.push_back(frame(age));
+        history.swap(kept);
+        historySize = std::max<size_t>(1, frames);
+        historyHead = history.size() % historySize;
+    }
+
+    size_t numFrames() const {
+        return history.size();
+    }
+
+    // the resolved frames, age 0 is the most recent one
+    const ProfileFrame& frame(size_t age) const {
+        size_t newest = (historyHead + history.size() - 1) % history.size();
+        return history[(newest + history.size() - age) % history.size()];
+    }
+
+    // average time of the scopes called name over the last frames, sums the scopes that run more than once
+    // a frame. Returns false if no resolved frame has that scope, gpuMs is -1 without timer queries
+    bool average(const std::string &name, size_t frames, double &cpuMs, double &gpuMs) const {
+        size_t count = 0;
+        cpuMs = 0.0;
+        gpuMs = 0.0;
+        for (size_t age = 0; age < std::min(frames, numFrames()); ++age) {
+            bool found = false;
+            for (const ProfileSample &sample : frame(age).samples) {
+                if (name != sample.name) continue;
+                cpuMs += sample.cpuMs;
+                gpuMs += sample.gpuMs;
+                found = true;
+            }
+            if (found) ++count;
+        }
+        if (count == 0) return false;
+        cpuMs /= count;
+        gpuMs = gpuTimers ? gpuMs / count : -1.0;
+        return true;
+    }
+
+    // the frames in the ring buffer in the Chrome trace event format (chrome://tracing, Perfetto)
+    // CPU scopes are on one track and GPU scopes on another, the GPU track is aligned on the CPU start of each frame,
+    // the counters are set at the start of their frame
+    void writeChromeTrace(std::ostream &out) const {
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+        auto event = [&](const char *name, int track, double startMs, double durationMs) {
+            out << ",\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << track
+                << ",\"ts\":" << 1000.0 * startMs << ",\"dur\":" << 1000.0 * durationMs << "}";
+        };
+        for (size_t age = numFrames(); age-- > 0;) {
+            const ProfileFrame &f = frame(age);
+            event("frame", 0, f.startMs, f.cpuMs);
+            if (f.gpuMs >= 0.0) event("frame", 1, f.startMs, f.gpuMs);
+            for (const ProfileSample &sample : f.samples) {
+                event(sample.name, 0, f.startMs + sample.cpuStartMs, sample.cpuMs);
+                if (sample.gpuMs >= 0.0) event(sample.name, 1, f.startMs + sample.gpuStartMs, sample.gpuMs);
+            }
+            for (const ProfileCounter &c : f.counters) {
+                out << ",\n{\"name\":\"" << c.name << "\",\"ph\":\"C\",\"pid\":0,\"ts\":" << 1000.0 * f.startMs
+                    << ",\"args\":{\"value\":" << c.value << "}}";
+            }
+        }
+        out << "\n]}\n";
+    }
+
+private:
+    static double msBetween(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    }
+
+    size_t timestamp(QuerySet &set) {
+        if (set.used == set.queries.size()) {
+            GLuint query;
+            glGenQueries(1, &query);
+            set.queries.push_back(query);
+        }
+        glQueryCounter(set.queries[set.used], GL_TIMESTAMP);
+        return set.used++;
+    }
+
+    void resolve(QuerySet &set) {
+        ProfileFrame &f = set.frame;
+        if (gpuTimers) {
+            std::vector<GLuint64> ns(set.used);
+            for (size_t q = 0; q < set.used; ++q) glGetQueryObjectui64v(set.queries[q], GL_QUERY_RESULT, &ns[q]);
+            GLuint64 begin = ns[set.frameBegin];
+            f.gpuMs = (ns[set.frameEnd] - begin) * 1e-6;
+            for (size_t s = 0; s < f.samples.size(); ++s) {
+                f.samples[s].gpuStartMs = (ns[set.sampleQueries[s].first] - begin) * 1e-6;
+                f.samples[s].gpuMs = (ns[set.sampleQueries[s].second] - ns[set.sampleQueries[s].first]) * 1e-6;
+            }
+        }
+        set.pending = false;
+
+        if (history.size() < historySize) history.push_back(f);
+        else history[historyHead] = f;
+        historyHead = (historyHead + 1) % historySize;
+    }
+};
+
+// the profiler of the GL thread
+inline Profiler& profiler() {
+    static Profiler instance;
+    return instance;
+}
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char *name) { profiler().push(name); }
+    ~ProfileScope() { profiler().pop(); }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef PROFILEROVERLAY_H
+#define PROFILEROVERLAY_H
+
+#include "Profiler.h"
+
+#include <OpenGP/GL/ImguiRenderer.h>
+#include <algorithm>
+#include <cstdio>
+
+// an ImGui window with the averages of every scope over the last frames and a graph of the frame times
+// only reads the profiler, so it does not need any input from the window
+inline void drawProfilerWindow(const Profiler &profiler, size_t frames = 60) {
+    ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(360, 300), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Profiler");
+
+    size_t count = std::min(frames, profiler.numFrames());
+    if (count == 0) {
+        ImGui::Text("no frames yet");
+        ImGui::End();
+        return;
+    }
+
+    std::vector<float> cpu(count), gpu(count);
+    for (size_t i = 0; i < count; ++i) {
+        const ProfileFrame &frame = profiler.frame(count - 1 - i);
+        cpu[i] = (float)frame.cpuMs;
+        gpu[i] = (float)std::max(0.0, frame.gpuMs);
+    }
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "cpu %.2f ms", cpu.back());
+    ImGui::PlotLines("##cpu", cpu.data(), (int)count, 0, overlay, 0.0f, FLT_MAX, ImVec2(0, 50));
+    if (profiler.gpuTimers) {
+        snprintf(overlay, sizeof(overlay), "gpu %.2f ms", gpu.back());
+        ImGui::PlotLines("##gpu", gpu.data(), (int)count, 0, overlay, 0.0f, FLT_MAX, ImVec2(0, 50));
+    }
+
+    // the scopes of the latest frame, with their averages over the window
+    ImGui::Columns(3, "scopes");
+    ImGui::Text("scope"); ImGui::NextColumn();
+    ImGui::Text("cpu ms"); ImGui::NextColumn();
+    ImGui::Text("gpu ms"); ImGui::NextColumn();
+    ImGui::Separator();
+    for (const ProfileSample &sample : profiler.frame(0).samples) {
+        double cpuMs, gpuMs;
+        if (!profiler.average(sample.name, count, cpuMs, gpuMs)) continue;
+        ImGui::Text("%*s%s", 2 * sample.depth, "", sample.name); ImGui::NextColumn();
+        ImGui::Text("%.3f", cpuMs); ImGui::NextColumn();
+        if (gpuMs >= 0.0) ImGui::Text("%.3f", gpuMs);
+        else ImGui::Text("-");
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    // the counters of the latest frame
+    const std::vector<ProfileCounter> &counters = profiler.frame(0).counters;
+    if (!counters.empty()) {
+        ImGui::Separator();
+        for (const ProfileCounter &c : counters) ImGui::Text("%s: %g", c.name, c.value);
+    }
+    ImGui::End();
+}
+
+#endif
@@ -0,0 +1,433 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include "utility.h"
+#include "Camera.h"
+#include "Profiler.h"
+#include "UniformBlocks.h"
+
+#include <functional>
+#include <iomanip>
+#include <ostream>
+
+// the passes of a frame and the textures they draw into
+//
+// A pass declares the textures it samples, the ones it draws into and the camera it sees the world with, and the
+// graph does the rest of what drawFrame used to spell out by hand: it orders the passes after the ones whose
+// output they read, drops the passes nothing reads from, works out the camera (mirrored for the reflection,
+// without touching the camera of the frame), writes it into the Camera block, binds the framebuffer, sets the
+// viewport and clears. Only the passes that draw into the default framebuffer or into a persistent texture, one
+// that keeps its content for later frames, are needed for their own sake.
+//
+// Every other texture is transient: it lives from the first to the last live pass that uses it, and transient
+// textures whose lives do not overlap share one texture of a pool. A transient texture that is only drawn into,
+// like a depth buffer, can share a larger texture with the viewport at its own size; a sampled one only shares a
+// texture of exactly its size, so that its texture coordinates stay in [0, 1].
+
+enum GraphFormat { GRAPH_RGBA8, GRAPH_DEPTH16 };
+
+const int graphNone = -2;       ///< no color or no depth
+const int graphBackbuffer = -1; ///< the default framebuffer, as the color and the depth of a pass
+
+inline const char *graphFormatName(GraphFormat format) {
+    return format == GRAPH_RGBA8 ? "RGBA8" : "D16";
+}
+
+inline size_t graphTexelBytes(GraphFormat format) {
+    return format == GRAPH_RGBA8 ? 4 : 2;
+}
+
+struct GraphResource {
+    const char *name;
+    GraphFormat format;
+    int width, height;
+    bool persistent;            ///< keeps what was drawn into it across frames, never shares its texture
+
+    // worked out by compile()
+    int firstUse = -1, lastUse = -1; ///< positions in the order of the live passes, -1 when no live pass uses it
+    bool sampled = false;       ///< a live pass reads it
+    int physical = -1;          ///< its texture of the pool, for a transient one
+    std::unique_ptr<GenericTexture> texture; ///< of a persistent one
+
+    size_t bytes() const { return (size_t)width * height * graphTexelBytes(format); }
+};
+
+// how a pass sees the world
+struct GraphView {
+    int uniformSlot = 0;        ///< its slot of the Camera block (see FrameUniforms)
+    bool mirrored = false;      ///< the camera mirrored in the plane z = mirrorHeight
+    float mirrorHeight = 0.0f;
+    Vec3 clipPlaneNormal = Vec3(0, 0, -1);
+    float clipPlaneHeight = 1000.0f;
+};
+
+// what the graph hands to a pass when it runs
+struct PassContext {
+    const Camera &camera;       ///< mirrored when the view is
+    Mat4x4 projectionView;
+    const GraphView &view;
+    int width, height;
+};
+
+struct RenderPass {
+    const char *name;           ///< string literal, it is the profiler scope of the pass
+    GraphView view;
+    std::vector<int> reads;     ///< resources it samples
+    int color = graphNone, depth = graphNone; ///< resources it draws into, or graphBackbuffer
+    GLbitfield clear = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT;
+    bool enabled = true;        ///< set per frame, a disabled pass leaves its persistent outputs as they were
+    std::function<void(const PassContext&)> execute;
+
+    // worked out by compile()
+    bool live = false;
+    std::unique_ptr<Framebuffer> fbo;
+};
+
+class RenderGraph {
+public:
+    struct Physical {
+        GraphFormat format;
+        int width, height;
+        bool fixedSize;         ///< a sampled resource uses it, it cannot grow
+        int lastUse;
+        int users;
+        std::unique_ptr<GenericTexture> texture;
+    };
+
+    std::vector<GraphResource> resources;
+    std::vector<RenderPass> passes;
+    std::vector<int> order;     ///< the live passes in the order they run
+    std::vector<Physical> pool;
+    int width, height;          ///< of the default framebuffer
+
+private:
+    FrameUniforms &uniforms;
+    bool compiled = false;
+
+public:
+    RenderGraph(FrameUniforms &_uniforms, int _width, int _height) : width(_width), height(_height), uniforms(_uniforms) {}
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph &operator=(const RenderGraph&) = delete;
+
+    // name is a string literal
+    int createTexture(const char *name, GraphFormat format, int w, int h, bool persistent = false) {
+        GraphResource resource;
+        resource.name = name;
+        resource.format = format;
+        resource.width = w;
+        resource.height = h;
+        resource.persistent = persistent;
+        resources.push_back(std::move(resource));
+        compiled = false;
+        return (int)resources.size() - 1;
+    }
+
+    // name is a string literal, fill in the pass it returns
+    int addPass(const char *name) {
+        RenderPass pass;
+        pass.name = name;
+        passes.push_back(std::move(pass));
+        compiled = false;
+        return (int)passes.size() - 1;
+    }
+
+    RenderPass &pass(int index) { return passes[index]; }
+
+    // the next frame compiles the graph again, a persistent texture loses its content
+    void resize(int resource, int w, int h) {
+        GraphResource &r = resources[resource];
+        if (r.width == w && r.height == h) return;
+        r.width = w;
+        r.height = h;
+        compiled = false;
+    }
+
+    // the texture of a resource, valid until the graph is compiled again
+    GenericTexture &texture(int resource) {
+        GraphResource &r = resources[resource];
+        return r.persistent ? *r.texture : *pool[r.physical].texture;
+    }
+
+    // orders and culls the passes, assigns the textures and builds the framebuffers, execute() calls it when needed
+    void compile() {
+        order = sortPasses();
+        cull();
+        assignTextures();
+        buildFramebuffers();
+        compiled = true;
+    }
+
+    // runs the live, enabled passes with the camera of the frame
+    void execute(const Camera &camera, float time) {
+        if (!compiled) compile();
+        Framebuffer *bound = nullptr;
+        for (int index : order) {
+            RenderPass &pass = passes[index];
+            if (!pass.enabled) continue;
+            PROFILE_SCOPE(pass.name);
+
+            const GraphView &view = pass.view;
+            Camera passCamera = camera;
+            if (view.mirrored) {
+                passCamera.cameraPos.z() -= 2 * (passCamera.cameraPos.z() - view.mirrorHeight);
+                passCamera.invertPitch();
+            }
+            Mat4x4 viewMatrix = passCamera.viewMatrix(), projection = passCamera.projectionMatrix();
+            uniforms.setPass(view.uniformSlot, viewMatrix, projection, passCamera.cameraPos, time,
+                             view.clipPlaneNormal, view.clipPlaneHeight);
+
+            int w = width, h = height;
+            if (pass.fbo) {
+                pass.fbo->bind();
+                bound = pass.fbo.get();
+                const GraphResource &target = resources[pass.color >= 0 ? pass.color : pass.depth];
+                w = target.width;
+                h = target.height;
+            } else if (bound) {
+                bound->unbind();
+                bound = nullptr;
+            }
+            glViewport(0, 0, w, h);
+            if (pass.clear) glClear(pass.clear);
+
+            PassContext context = { passCamera, projection * viewMatrix, view, w, h };
+            pass.execute(context);
+        }
+        if (bound) bound->unbind();
+    }
+
+    // bytes of the textures the graph allocated, and what they would take without sharing
+    size_t bytes() const {
+        size_t total = 0;
+        for (const GraphResource &r : resources) total += r.persistent && r.firstUse >= 0 ? r.bytes() : 0;
+        for (const Physical &p : pool) total += (size_t)p.width * p.height * graphTexelBytes(p.format);
+        return total;
+    }
+
+    size_t unaliasedBytes() const {
+        size_t total = 0;
+        for (const GraphResource &r : resources) total += r.firstUse >= 0 ? r.bytes() : 0;
+        return total;
+    }
+
+    void printStats() const {
+        std::cout << "render graph: " << order.size() << " of " << passes.size() << " passes live, " << pool.size()
+                  << " pooled textures, " << bytes() / 1024 << " KB of textures (" << unaliasedBytes() / 1024
+                  << " KB without aliasing)" << std::endl;
+    }
+
+    // the compiled graph: the passes in order, the resources with their lives and textures, and the memory
+    void dump(std::ostream &out) const {
+        auto resourceName = [&](int r) -> std::string {
+            if (r == graphBackbuffer) return "backbuffer";
+            return r == graphNone ? "-" : resources[r].name;
+        };
+        out << "passes (" << order.size() << " of " << passes.size() << " live)\n";
+        for (size_t i = 0; i < order.size(); ++i) {
+            const RenderPass &pass = passes[order[i]];
+            out << "  " << i << " " << pass.name << ": camera slot " << pass.view.uniformSlot;
+            if (pass.view.mirrored) out << " mirrored at z = " << pass.view.mirrorHeight;
+            out << ", color " << resourceName(pass.color) << ", depth " << resourceName(pass.depth) << ", reads";
+            if (pass.reads.empty()) out << " nothing";
+            for (int r : pass.reads) out << " " << resourceName(r);
+            out << "\n";
+        }
+        for (const RenderPass &pass : passes) {
+            if (!pass.live) out << "  culled " << pass.name << ": nothing reads what it draws\n";
+        }
+
+        out << "resources\n";
+        for (const GraphResource &r : resources) {
+            out << "  " << r.name << ": " << graphFormatName(r.format) << " " << r.width << "x" << r.height << ", "
+                << r.bytes() << " bytes, ";
+            if (r.firstUse < 0) out << "unused\n";
+            else if (r.persistent) out << "persistent\n";
+            else out << "transient over passes " << r.firstUse << "-" << r.lastUse << " in pool texture " << r.physical << "\n";
+        }
+        out << "pool\n";
+        for (size_t p = 0; p < pool.size(); ++p) {
+            out << "  " << p << ": " << graphFormatName(pool[p].format) << " " << pool[p].width << "x" << pool[p].height
+                << ", " << (size_t)pool[p].width * pool[p].height * graphTexelBytes(pool[p].format) << " bytes, "
+                << pool[p].users << (pool[p].users == 1 ? " resource\n" : " resources\n");
+        }
+        out << "textures: " << bytes() << " bytes, " << unaliasedBytes() << " without aliasing\n";
+    }
+
+private:
+    bool writes(const RenderPass &pass, int resource) const {
+        return pass.color == resource || pass.depth == resource;
+    }
+
+    bool readsFrom(const RenderPass &pass, int resource) const {
+        return std::find(pass.reads.begin(), pass.reads.end(), resource) != pass.reads.end();
+    }
+
+    // a pass runs after every pass that draws into what it reads, and after the passes declared before it that
+    // draw into the same texture. Ties keep the order of declaration
+    std::vector<int> sortPasses() const {
+        int n = (int)passes.size();
+        std::vector<std::vector<int>> after(n);
+        std::vector<int> incoming(n, 0);
+        auto edge = [&](int from, int to) {
+            if (std::find(after[from].begin(), after[from].end(), to) != after[from].end()) return;
+            after[from].push_back(to);
+            incoming[to]++;
+        };
+        for (int a = 0; a < n; ++a) {
+            for (int b = 0; b < n; ++b) {
+                if (a == b) continue;
+                const RenderPass &writer = passes[a], &other = passes[b];
+                for (int output : { writer.color, writer.depth }) {
+                    if (output == graphNone) continue;
+                    if (output >= 0 && readsFrom(other, output) && !writes(other, output)) edge(a, b);
+                    if (a < b && writes(other, output)) edge(a, b);
+                }
+            }
+        }
+
+        std::vector<int> sorted;
+        std::vector<bool> done(n, false);
+        for (int step = 0; step < n; ++step) {
+            int next = -1;
+            for (int p = 0; p < n && next < 0; ++p) {
+                if (!done[p] && incoming[p] == 0) next = p;
+            }
+            if (next < 0) {
+                std::cout << "render graph: the passes depend on each other in a cycle, they run as declared" << std::endl;
+                sorted.clear();
+                for (int p = 0; p < n; ++p) sorted.push_back(p);
+                return sorted;
+            }
+            done[next] = true;
+            sorted.push_back(next);
+            for (int to : after[next]) incoming[to]--;
+        }
+        return sorted;
+    }
+
+    // walking back from the end: a pass is live if it draws into the backbuffer or into a persistent texture, or
+    // into something a live pass after it reads
+    void cull() {
+        for (RenderPass &pass : passes) pass.live = false;
+        for (int i = (int)order.size() - 1; i >= 0; --i) {
+            RenderPass &pass = passes[order[i]];
+            for (int output : { pass.color, pass.depth }) {
+                if (output == graphBackbuffer || (output >= 0 && resources[output].persistent)) pass.live = true;
+                for (int j = i + 1; j < (int)order.size() && output >= 0 && !pass.live; ++j) {
+                    if (passes[order[j]].live && readsFrom(passes[order[j]], output)) pass.live = true;
+                }
+            }
+        }
+        std::vector<int> live;
+        for (int index : order) {
+            if (passes[index].live) live.push_back(index);
+        }
+        order.swap(live);
+    }
+
+    // the lives of the resources over the live passes, then the transient ones into the pool, first fit
+    void assignTextures() {
+        for (GraphResource &r : resources) {
+            r.firstUse = r.lastUse = -1;
+            r.sampled = false;
+            r.physical = -1;
+        }
+        for (int i = 0; i < (int)order.size(); ++i) {
+            const RenderPass &pass = passes[order[i]];
+            std::vector<int> used = pass.reads;
+            used.push_back(pass.color);
+            used.push_back(pass.depth);
+            for (int r : used) {
+                if (r < 0) continue;
+                GraphResource &resource = resources[r];
+                if (resource.firstUse < 0) resource.firstUse = i;
+                resource.lastUse = i;
+            }
+            for (int r : pass.reads) resources[r].sampled = true;
+        }
+
+        std::vector<int> transient;
+        for (int r = 0; r < (int)resources.size(); ++r) {
+            if (!resources[r].persistent && resources[r].firstUse >= 0) transient.push_back(r);
+        }
+        std::stable_sort(transient.begin(), transient.end(),
+                         [&](int a, int b) { return resources[a].firstUse < resources[b].firstUse; });
+
+        std::vector<Physical> old;
+        old.swap(pool);
+        for (int r : transient) {
+            GraphResource &resource = resources[r];
+            int chosen = -1;
+            for (int p = 0; p < (int)pool.size() && chosen < 0; ++p) {
+                Physical &physical = pool[p];
+                if (physical.format != resource.format || physical.lastUse >= resource.firstUse) continue;
+                bool sameSize = physical.width == resource.width && physical.height == resource.height;
+                if (resource.sampled ? sameSize :
+                    (!physical.fixedSize || (physical.width >= resource.width && physical.height >= resource.height))) {
+                    chosen = p;
+                }
+            }
+            if (chosen < 0) {
+                Physical physical;
+                physical.format = resource.format;
+                physical.width = resource.width;
+                physical.height = resource.height;
+                physical.fixedSize = false;
+                physical.lastUse = -1;
+                physical.users = 0;
+                pool.push_back(std::move(physical));
+                chosen = (int)pool.size() - 1;
+            }
+            Physical &physical = pool[chosen];
+            physical.width = std::max(physical.width, resource.width);
+            physical.height = std::max(physical.height, resource.height);
+            physical.fixedSize = physical.fixedSize || resource.sampled;
+            physical.lastUse = resource.lastUse;
+            physical.users++;
+            resource.physical = chosen;
+        }
+
+        // the textures of the last compile are kept and reallocated where their size changed
+        for (size_t p = 0; p < pool.size(); ++p) {
+            Physical &physical = pool[p];
+            if (p < old.size() && old[p].format == physical.format) physical.texture = std::move(old[p].texture);
+            allocate(physical.texture, physical.format, physical.width, physical.height);
+        }
+        for (GraphResource &resource : resources) {
+            if (resource.persistent && resource.firstUse >= 0) {
+                allocate(resource.texture, resource.format, resource.width, resource.height);
+            }
+        }
+    }
+
+    static void allocate(std::unique_ptr<GenericTexture> &texture, GraphFormat format, int w, int h) {
+        if (!texture) {
+            if (format == GRAPH_RGBA8) texture = std::unique_ptr<GenericTexture>(new RGBA8Texture());
+            else texture = std::unique_ptr<GenericTexture>(new D16Texture());
+            // required as no mipmap
+            texture->bind();
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            texture->unbind();
+        } else if ((int)texture->get_width() == w && (int)texture->get_height() == h) {
+            return;
+        }
+        if (format == GRAPH_RGBA8) static_cast<RGBA8Texture&>(*texture).allocate(w, h);
+        else static_cast<D16Texture&>(*texture).allocate(w, h);
+    }
+
+    void buildFramebuffers() {
+        for (RenderPass &pass : passes) {
+            pass.fbo.reset();
+            if (!pass.live) continue;
+            bool backbuffer = pass.color == graphBackbuffer || pass.depth == graphBackbuffer;
+            if (backbuffer || (pass.color == graphNone && pass.depth == graphNone)) continue;
+            pass.fbo = std::unique_ptr<Framebuffer>(new Framebuffer());
+            if (pass.color >= 0) pass.fbo->attach_color_texture(texture(pass.color));
+            if (pass.depth >= 0) pass.fbo->attach_depth_texture(texture(pass.depth));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,255 @@
+#ifndef SCATTER_H
+#define SCATTER_H
+
+#include "utility.h"
+#include "Camera.h"
+#include "Frustum.h"
+#include "ScatterData.h"
+#include "ShaderCache.h"
+#include "UniformBlocks.h"
+
+#include <OpenGP/GL/GPUMesh.h>
+#include <OpenGP/GL/UploadRing.h>
+
+const char* const scatter_vshader =
+#include "scatter_vshader.glsl"
+;
+
+const char* const scatter_fshader =
+#include "scatter_fshader.glsl"
+;
+
+const char* const impostor_vshader =
+#include "impostor_vshader.glsl"
+;
+
+const char* const impostor_fshader =
+#include "impostor_fshader.glsl"
+;
+
+// a model of the scatter, z up with the ground at 0, at scale 1
+struct ScatterModel {
+    std::vector<Vec3> positions, normals, colors;
+    std::vector<unsigned int> triangles;
+
+    unsigned int vertex(const Vec3 &p, const Vec3 &n, const Vec3 &c) {
+        positions.push_back(p);
+        normals.push_back(n.normalized());
+        colors.push_back(c);
+        return (unsigned int)positions.size() - 1;
+    }
+
+    // a ring of segments around the z axis from (r0, z0) to (r1, z1), pointy when r1 is 0
+    void cone(float r0, float z0, float r1, float z1, int segments, const Vec3 &c0, const Vec3 &c1) {
+        float rise = (r0 - r1) / (z1 - z0);
+        unsigned int first = (unsigned int)positions.size();
+        for (int s = 0; s <= segments; ++s) {
+            float a = 6.2831853f * s / segments;
+            Vec3 out(std::cos(a), std::sin(a), 0.0f);
+            Vec3 n = out + Vec3(0.0f, 0.0f, rise);
+            vertex(r0 * out + Vec3(0.0f, 0.0f, z0), n, c0);
+            vertex(r1 * out + Vec3(0.0f, 0.0f, z1), n, c1);
+        }
+        for (int s = 0; s < segments; ++s) {
+            unsigned int a = first + 2 * s;
+            triangles.insert(triangles.end(), { a, a + 2, a + 1, a + 1, a + 2, a + 3 });
+        }
+    }
+};
+
+// three blades leaning out, the normals point up so the tuft is lit like the ground under it
+inline ScatterModel grassModel() {
+    ScatterModel model;
+    Vec3 root(0.10f, 0.22f, 0.05f), tip(0.45f, 0.62f, 0.20f);
+    for (int b = 0; b < 3; ++b) {
+        float a = 6.2831853f * b / 3.0f;
+        Vec3 out(std::cos(a), std::sin(a), 0.0f), side(-std::sin(a), std::cos(a), 0.0f);
+        Vec3 n = Vec3(0.0f, 0.0f, 1.0f) + 0.3f * out;
+        unsigned int v0 = model.vertex(0.08f * out - 0.06f * side, n, root);
+        unsigned int v1 = model.vertex(0.08f * out + 0.06f * side, n, root);
+        unsigned int v2 = model.vertex(0.30f * out + Vec3(0.0f, 0.0f, 1.0f), n, tip);
+        model.triangles.insert(model.triangles.end(), { v0, v1, v2 });
+    }
+    return model;
+}
+
+// a trunk and two cones of leaves, the impostor in impostor_fshader.glsl draws the same outline
+inline ScatterModel treeModel() {
+    ScatterModel model;
+    Vec3 bark(0.25f, 0.17f, 0.10f), dark(0.08f, 0.20f, 0.07f), light(0.18f, 0.38f, 0.12f);
+    model.cone(0.06f, -0.05f, 0.04f, 0.35f, 6, bark, bark);
+    model.cone(0.40f, 0.25f, 0.0f, 0.75f, 8, dark, light);
+    model.cone(0.28f, 0.55f, 0.0f, 1.0f, 8, dark, light);
+    return model;
+}
+
+// a squashed sphere with a deterministic bump per vertex, half in the ground
+inline ScatterModel rockModel() {
+    ScatterModel model;
+    const int rings = 4, segments = 7;
+    Vec3 grey(0.52f, 0.50f, 0.47f);
+    ScatterRandom random(7, ScatterKey{ SCATTER_ROCK, 0, 0 });
+    for (int r = 0; r <= rings; ++r) {
+        float v = 3.1415927f * r / rings;
+        for (int s = 0; s <= segments; ++s) {
+            float a = 6.2831853f * (s % segments) / segments;
+            Vec3 n(std::sin(v) * std::cos(a), std::sin(v) * std::sin(a), std::cos(v));
+            // the seam and the poles share their bump so that the surface stays closed
+            float bump = (r == 0 || r == rings || s == segments) ? 1.0f : 0.8f + 0.35f * random.uniform();
+            model.vertex(Vec3(0.45f * bump * n.x(), 0.38f * bump * n.y(), 0.05f + 0.38f * bump * n.z()), n, grey * (0.8f + 0.2f * bump));
+        }
+    }
+    for (int r = 0; r < rings; ++r) {
+        for (int s = 0; s < segments; ++s) {
+            unsigned int a = r * (segments + 1) + s, b = a + segments + 1;
+            model.triangles.insert(model.triangles.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    return model;
+}
+
+// what a billboard has to cover, the impostor shader draws the outline of the kind inside it
+inline ScatterModel impostorModel() {
+    ScatterModel model;
+    Vec3 up(0.0f, 0.0f, 1.0f), white(1.0f, 1.0f, 1.0f);
+    model.vertex(Vec3(-1.0f, 0.0f, 0.0f), up, white);
+    model.vertex(Vec3(1.0f, 0.0f, 0.0f), up, white);
+    model.vertex(Vec3(1.0f, 0.0f, 1.0f), up, white);
+    model.vertex(Vec3(-1.0f, 0.0f, 1.0f), up, white);
+    model.triangles = { 0, 1, 2, 0, 2, 3 };
+    return model;
+}
+
+// the uniforms of the scatter and impostor shaders that change from draw to draw, looked up once per program
+struct ScatterUniforms {
+    GLint kind = -1, extent = -1, fadeDistance = -1;
+
+    explicit ScatterUniforms(const Shader *shader = nullptr) {
+        if (!shader) return;
+        kind = shader->uniform_location("kind");
+        extent = shader->uniform_location("extent");
+        fadeDistance = shader->uniform_location("fadeDistance");
+    }
+};
+
+// grass, trees and rocks on the terrain: the placement and the culling are in ScatterData.h, this draws what is
+// left with one instanced draw per kind and band. The instances are streamed into one buffer per component of
+// ScatterBatch (x, y, z, yaw and scale with a divisor of 1) and the models are in the same VAOs. With an upload ring
+// the instance buffers only grow and the instances are copied into them from the ring (see UploadRing.h).
+class Scatter {
+public:
+    std::unique_ptr<ScatterField> field;
+    std::unique_ptr<Shader> meshShader, impostorShader;
+    std::unique_ptr<GPUMesh> meshes[NUM_SCATTER_KINDS][NUM_SCATTER_BANDS];
+
+    bool firstUpdate = true;
+    size_t uploadBytes = 0; ///< instance data streamed in the last draw
+    UploadRing *uploads = nullptr; ///< null respecifies the instance buffers every draw
+
+private:
+    std::shared_ptr<ErosionField> erosion;
+    ScatterUniforms uniforms[NUM_SCATTER_BANDS];
+
+public:
+    // the programs were requested as "scatter" and "impostor" (see ShaderCache.h), params and erosion are the world
+    // of the terrain
+    Scatter(float waterHeight, ShaderCache &shaders, const HeightfieldParams &params = HeightfieldParams(),
+            std::shared_ptr<ErosionField> _erosion = nullptr)
+        : erosion(_erosion) {
+        field = std::unique_ptr<ScatterField>(new ScatterField(ScatterSettings(waterHeight, params), 0, erosion));
+
+        meshShader = shaders.take("scatter");
+        impostorShader = shaders.take("impostor");
+        uniforms[SCATTER_MESH] = ScatterUniforms(meshShader.get());
+        uniforms[SCATTER_IMPOSTOR] = ScatterUniforms(impostorShader.get());
+
+        ScatterModel models[NUM_SCATTER_KINDS] = { grassModel(), treeModel(), rockModel() };
+        ScatterModel billboard = impostorModel();
+        for (int kind = 0; kind < NUM_SCATTER_KINDS; ++kind) {
+            meshes[kind][SCATTER_MESH] = createMesh(models[kind], *meshShader);
+            meshes[kind][SCATTER_IMPOSTOR] = createMesh(billboard, *impostorShader);
+        }
+    }
+
+    // starts over with every density scaled, 0 scatters nothing
+    void scaleDensity(float factor) {
+        ScatterSettings settings = field->settings;
+        for (ScatterRule &rule : settings.rules) rule.density *= factor;
+        field = std::unique_ptr<ScatterField>(new ScatterField(settings, 0, erosion));
+        firstUpdate = true;
+    }
+
+    void update(const Camera &camera, bool blocking = false) {
+        field->update(camera.cameraPos, blocking || firstUpdate);
+        firstUpdate = false;
+    }
+
+    // the camera is in the Camera block already, it is given here for the culling
+    // the occlusion buffer is the one the terrain filled for the same camera, or none
+    void draw(const Mat4x4 &projectionView, const Vec3 &cameraPos, Vec3 clipPlaneNormal, float clipPlaneHeight,
+              OcclusionBuffer *occlusion = nullptr) {
+        field->cull(projectionView, cameraPos, clipPlane(clipPlaneNormal, clipPlaneHeight), occlusion);
+
+        uploadBytes = 0;
+        for (int band = 0; band < NUM_SCATTER_BANDS; ++band) {
+            Shader &shader = band == SCATTER_MESH ? *meshShader : *impostorShader;
+            const ScatterUniforms &locations = uniforms[band];
+            shader.bind();
+            for (int kind = 0; kind < NUM_SCATTER_KINDS; ++kind) {
+                const ScatterBatch &batch = field->batches[kind][band];
+                if (batch.size() == 0) continue;
+                const ScatterRule &rule = field->settings.rules[kind];
+                GPUMesh &mesh = *meshes[kind][band];
+                upload(mesh, batch);
+
+                shader.set_uniform(locations.kind, kind);
+                shader.set_uniform(locations.extent, Vec3(rule.modelRadius, rule.modelBottom, rule.modelTop));
+                // the last tenth of the range shrinks the instances away instead of popping them
+                shader.set_uniform(locations.fadeDistance, band == SCATTER_MESH && rule.meshDistance >= rule.impostorDistance ?
+                                                           rule.meshDistance : 0.0f);
+                mesh.draw_instanced((GLsizei)batch.size());
+            }
+            shader.unbind();
+        }
+    }
+
+private:
+    static std::unique_ptr<GPUMesh> createMesh(const ScatterModel &model, Shader &shader) {
+        std::unique_ptr<GPUMesh> mesh(new GPUMesh());
+        mesh->set_vbo<Vec3>("vposition", model.positions);
+        mesh->set_vbo<Vec3>("vnormal", model.normals);
+        mesh->set_vbo<Vec3>("vcolor", model.colors);
+        mesh->set_triangles(model.triangles);
+        // empty until the first frame, the buffers only have to exist for the VAO to point at them
+        const char *components[] = { "ix", "iy", "iz", "iyaw", "iscale" };
+        for (const char *name : components) mesh->set_vbo_raw<float>(name, nullptr, 0, 1);
+        shader.bind();
+        mesh->set_attributes(shader);
+        shader.unbind();
+        return mesh;
+    }
+
+    // respecifies the instance buffers in place, the VAO keeps pointing at the same buffer objects. Through the ring
+    // they keep their storage, a batch that does not fit in what is left of the budget of the frame goes the old way
+    void upload(GPUMesh &mesh, const ScatterBatch &batch) {
+        GLsizeiptr count = (GLsizeiptr)batch.size(), bytes = count * sizeof(float);
+        const char *components[] = { "ix", "iy", "iz", "iyaw", "iscale" };
+        const float *values[] = { batch.x.data(), batch.y.data(), batch.z.data(), batch.yaw.data(), batch.scale.data() };
+        UploadRing::Allocation staging;
+        if (uploads) staging = uploads->allocate(5 * bytes);
+        for (int c = 0; c < 5; ++c) {
+            if (!staging) {
+                mesh.set_vbo_raw<float>(components[c], values[c], count, 1);
+                continue;
+            }
+            memcpy(staging.data + c * bytes, values[c], bytes);
+            // half again as many as needed, so that the storage settles after a few frames
+            if (mesh.get_vbo(components[c])->size() < count) mesh.set_vbo_raw<float>(components[c], nullptr, count + count / 2, 1);
+            uploads->copy_to_buffer(staging, c * bytes, bytes, mesh.get_vbo(components[c])->id(), 0);
+        }
+        if (staging) uploads->release(staging);
+        uploadBytes += 5 * bytes;
+    }
+};
+
+#endif
@@ -0,0 +1,463 @@
+#ifndef SCATTERDATA_H
+#define SCATTERDATA_H
+
+#include <OpenGP/types.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Erosion.h"
+#include "Frustum.h"
+#include "Occlusion.h"
+#include "HeightfieldGenerator.h"
+#include "ThreadPool.h"
+
+// the CPU half of the vegetation and the rocks, nothing in here touches OpenGL so it can run on worker threads
+//
+// the ground is cut into square tiles, one per kind of instance. A tile always gets the same instances: the
+// candidates come from a random generator seeded with the tile and the kind, and they are kept or dropped with
+// the height and slope bands of terrain_fshader.glsl, so whatever order the workers build the tiles in and
+// however often a tile is evicted and built again, the world looks the same.
+
+enum ScatterKind { SCATTER_GRASS, SCATTER_TREE, SCATTER_ROCK, NUM_SCATTER_KINDS };
+
+// full meshes close to the camera, camera facing billboards further away
+enum ScatterBand { SCATTER_MESH, SCATTER_IMPOSTOR, NUM_SCATTER_BANDS };
+
+// the levels of terrain_fshader.glsl, which derives them from the water height the same way
+struct TerrainBands {
+    float pureSandLevel, sandLevel, grassLevel, rockLevel, snowLevel;
+
+    explicit TerrainBands(float waterHeight) {
+        pureSandLevel = waterHeight + 0.01f; // beach around the water => pure sand
+        sandLevel = pureSandLevel + 0.15f;
+        grassLevel = sandLevel + 0.15f;
+        rockLevel = grassLevel + 1.6f;
+        snowLevel = rockLevel + 0.8f;
+    }
+};
+
+// where and how many instances of a kind go, and how far they are drawn
+struct ScatterRule {
+    float density = 1.0f;          ///< candidates per square unit, on a jittered grid
+    float coverage = 1.0f;         ///< chance to keep a candidate in the middle of its bands
+    float clumping = 0.0f;         ///< how much low frequency noise groups the instances into patches
+    float lowLevel = 0.0f, highLevel = 0.0f; ///< height band
+    float heightFeather = 0.1f;    ///< the chance fades out over this much height at both ends of the band
+    float minSlope = 0.0f, maxSlope = 1.6f; ///< radians, acos of the normal z like the shader
+    float slopeFeather = 0.1f;
+    float minScale = 1.0f, maxScale = 1.0f;
+    float meshDistance = 0.0f;     ///< full meshes for tiles closer than this
+    float impostorDistance = 0.0f; ///< billboards up to here, nothing after
+    // the extent of the model (see Scatter.h) at scale 1, for the bounds of the tiles
+    float modelRadius = 0.5f, modelBottom = 0.0f, modelTop = 1.0f;
+};
+
+struct ScatterSettings {
+    float tileSize = 64 * 20.0f / 1024.0f; ///< a level 0 terrain chunk
+    float normalStep = 20.0f / 1024.0f;    ///< the spacing the finest chunks take their normals over
+    unsigned int seed = 1;
+    HeightfieldParams terrain;             ///< the world the instances stand on
+    ScatterRule rules[NUM_SCATTER_KINDS];
+
+    // the placement changes with the seed of the world, seed 0 keeps the original one
+    explicit ScatterSettings(float waterHeight, const HeightfieldParams &_terrain = HeightfieldParams())
+        : seed(1 + _terrain.seed), terrain(_terrain) {
+        TerrainBands bands(waterHeight);
+
+        // the shader deposits snow instead of grass on the slopes above the middle of the grass band
+        float depositLevel = bands.grassLevel + 0.5f * (bands.rockLevel - bands.grassLevel);
+
+        // grass where the shader shows the grass layer, off the steepest parts
+        ScatterRule &grass = rules[SCATTER_GRASS];
+        grass.density = 900.0f;
+        grass.coverage = 0.7f;
+        grass.clumping = 0.6f;
+        grass.lowLevel = bands.sandLevel;
+        grass.highLevel = depositLevel;
+        grass.heightFeather = 0.2f;
+        grass.maxSlope = 1.0f;
+        grass.slopeFeather = 0.2f;
+        grass.minScale = 0.03f;
+        grass.maxScale = 0.06f;
+        grass.meshDistance = grass.impostorDistance = 5.0f;
+        grass.modelRadius = 0.35f;
+
+        // trees in patches on the lower part of the grass band
+        ScatterRule &tree = rules[SCATTER_TREE];
+        tree.density = 16.0f;
+        tree.coverage = 0.6f;
+        tree.clumping = 1.0f;
+        tree.lowLevel = bands.grassLevel;
+        tree.highLevel = depositLevel - 0.2f;
+        tree.heightFeather = 0.15f;
+        tree.maxSlope = 0.9f;
+        tree.minScale = 0.2f;
+        tree.maxScale = 0.4f;
+        tree.meshDistance = 8.0f;
+        tree.impostorDistance = 22.0f;
+        tree.modelRadius = 0.4f;
+        tree.modelBottom = -0.05f;
+
+        // rocks from the beach to the snow, on the steeper slopes
+        ScatterRule &rock = rules[SCATTER_ROCK];
+        rock.density = 16.0f;
+        rock.coverage = 0.6f;
+        rock.clumping = 0.5f;
+        rock.lowLevel = bands.pureSandLevel;
+        rock.highLevel = bands.snowLevel;
+        rock.heightFeather = 0.1f;
+        rock.minSlope = 0.9f;
+        rock.minScale = 0.02f;
+        rock.maxScale = 0.08f;
+        rock.meshDistance = 6.0f;
+        rock.impostorDistance = 14.0f;
+        rock.modelRadius = 0.5f;
+        rock.modelBottom = -0.3f;
+        rock.modelTop = 0.45f;
+    }
+};
+
+struct ScatterKey {
+    int kind, x, y;
+
+    bool operator==(const ScatterKey &other) const { return kind == other.kind && x == other.x && y == other.y; }
+};
+
+struct ScatterKeyHash {
+    size_t operator()(const ScatterKey &key) const {
+        // shifted unsigned, the keys around the origin are negative
+        return std::hash<unsigned long long>()(((unsigned long long)(unsigned int)key.x << 32) ^ (unsigned int)key.y ^
+                                               ((unsigned long long)(unsigned int)key.kind << 58));
+    }
+};
+
+// the instances of one kind in one tile, one array per component (structure of arrays) so that a whole tile is
+// appended to the instance buffers of a frame with one copy per component
+struct ScatterTile {
+    ScatterKey key;
+    std::vector<float> x, y, z, yaw, scale;
+    OpenGP::Vec3 lo, hi; ///< bounds of the instanced models, valid when the tile is not empty
+
+    size_t size() const { return x.size(); }
+    size_t bytes() const { return 5 * size() * sizeof(float); }
+};
+
+// splitmix64, the stream of a tile only depends on its key and the seed
+struct ScatterRandom {
+    uint64_t state;
+
+    ScatterRandom(unsigned int seed, const ScatterKey &key) {
+        state = ((uint64_t)seed << 32) ^ ((uint64_t)(uint32_t)key.x * 0x9E3779B97F4A7C15ull) ^
+                ((uint64_t)(uint32_t)key.y * 0xC2B2AE3D27D4EB4Full) ^ ((uint64_t)key.kind * 0x165667B19E3779F9ull);
+    }
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // uniform in [0, 1)
+    float uniform() {
+        return (float)(next() >> 40) * (1.0f / 16777216.0f);
+    }
+};
+
+// 1 inside [lo, hi], falling to 0 over feather outside of it
+inline float bandWeight(float value, float lo, float hi, float feather) {
+    float f = std::max(feather, 1e-6f);
+    return std::min(1.0f, std::max(0.0f, (value - lo) / f + 1.0f)) * std::min(1.0f, std::max(0.0f, (hi - value) / f + 1.0f));
+}
+
+// the slope of the terrain shader from heights at +-step around a point, like the normals of generateGrid
+inline float scatterSlope(float west, float east, float south, float north, float step) {
+    float dx = west - east, dy = south - north, dz = 2.0f * step;
+    return std::acos(dz / std::sqrt(dx * dx + dy * dy + dz * dz));
+}
+
+// places the instances of one tile, the heights of all the candidates go through the vectorized kernel at once
+// and then get the change of the erosion, if the terrain has one
+inline void buildScatterTile(const HeightfieldGenerator &generator, const ScatterSettings &settings, ScatterKey key,
+                             ScatterTile &tile, ErosionField *erosion = nullptr) {
+    const ScatterRule &rule = settings.rules[key.kind];
+    ScatterRandom random(settings.seed, key);
+    tile.key = key;
+
+    int cells = rule.density > 0.0f ? std::max(1, (int)std::lround(settings.tileSize * std::sqrt(rule.density))) : 0;
+    int count = cells * cells;
+    float cell = settings.tileSize / cells;
+    float x0 = key.x * settings.tileSize, y0 = key.y * settings.tileSize;
+    float step = settings.normalStep;
+
+    // every candidate is sampled at its position and at its four neighbours for the slope
+    std::vector<float> xs(5 * count), ys(5 * count), hs(5 * count);
+    for (int j = 0; j < cells; ++j) {
+        for (int i = 0; i < cells; ++i) {
+            int c = i + j * cells;
+            float x = x0 + (i + random.uniform()) * cell;
+            float y = y0 + (j + random.uniform()) * cell;
+            const float offsets[5][2] = { { 0, 0 }, { -step, 0 }, { step, 0 }, { 0, -step }, { 0, step } };
+            for (int s = 0; s < 5; ++s) {
+                xs[s * count + c] = x + offsets[s][0];
+                ys[s * count + c] = y + offsets[s][1];
+            }
+        }
+    }
+    generator.heights(xs.data(), ys.data(), hs.data(), 5 * count);
+    if (erosion) erosion->applyPoints(xs.data(), ys.data(), hs.data(), 5 * count);
+
+    tile.x.clear(); tile.y.clear(); tile.z.clear(); tile.yaw.clear(); tile.scale.clear();
+    float zLo = INFINITY, zHi = -INFINITY, reach = 0.0f;
+    for (int c = 0; c < count; ++c) {
+        // always three draws per candidate, so what comes after does not depend on what was kept before
+        float keep = random.uniform(), yaw = random.uniform(), size = random.uniform();
+
+        float x = xs[c], y = ys[c], h = hs[c];
+        float slope = scatterSlope(hs[count + c], hs[2 * count + c], hs[3 * count + c], hs[4 * count + c], step);
+        float noise = heightfield::perlin2D(x * 0.35f + 31.7f * key.kind, y * 0.35f);
+        float chance = std::min(1.0f, std::max(0.0f, rule.coverage + rule.clumping * noise)) *
+                       bandWeight(h, rule.lowLevel, rule.highLevel, rule.heightFeather) *
+                       bandWeight(slope, rule.minSlope, rule.maxSlope, rule.slopeFeather);
+        if (keep >= chance) continue;
+
+        float scale = rule.minScale + size * (rule.maxScale - rule.minScale);
+        tile.x.push_back(x);
+        tile.y.push_back(y);
+        tile.z.push_back(h);
+        tile.yaw.push_back(6.2831853f * yaw);
+        tile.scale.push_back(scale);
+        zLo = std::min(zLo, h + rule.modelBottom * scale);
+        zHi = std::max(zHi, h + rule.modelTop * scale);
+        reach = std::max(reach, rule.modelRadius * scale);
+    }
+
+    tile.lo = OpenGP::Vec3(x0 - reach, y0 - reach, zLo);
+    tile.hi = OpenGP::Vec3(x0 + settings.tileSize + reach, y0 + settings.tileSize + reach, zHi);
+}
+
+// distance in the ground plane from a point to the square of a tile
+inline float distanceToTile(const ScatterSettings &settings, const ScatterKey &key, float px, float py) {
+    float size = settings.tileSize;
+    float dx = std::max(0.0f, std::max(key.x * size - px, px - (key.x + 1) * size));
+    float dy = std::max(0.0f, std::max(key.y * size - py, py - (key.y + 1) * size));
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+// the instances of one kind and band that are drawn this frame, in the layout of the instance buffers
+struct ScatterBatch {
+    std::vector<float> x, y, z, yaw, scale;
+
+    size_t size() const { return x.size(); }
+
+    void clear() {
+        x.clear(); y.clear(); z.clear(); yaw.clear(); scale.clear();
+    }
+
+    void append(const ScatterTile &tile) {
+        x.insert(x.end(), tile.x.begin(), tile.x.end());
+        y.insert(y.end(), tile.y.begin(), tile.y.end());
+        z.insert(z.end(), tile.z.begin(), tile.z.end());
+        yaw.insert(yaw.end(), tile.yaw.begin(), tile.yaw.end());
+        scale.insert(scale.end(), tile.scale.begin(), tile.scale.end());
+    }
+};
+
+struct ScatterStats {
+    int tilesResident = 0;
+    int tilesBuilding = 0;
+    int tilesBuilt = 0;              ///< this frame
+    int tilesVisible = 0;            ///< in the last cull, tiles with something drawn
+    int tilesCulledFrustum = 0;
+    int tilesCulledClipPlane = 0;
+    int tilesCulledOcclusion = 0;    ///< behind the terrain, with an occlusion buffer
+    int tilesCulledDistance = 0;     ///< resident, but further than the band of their kind (they are kept a little longer)
+    size_t instancesResident = 0;
+    size_t residentBytes = 0;
+    size_t instancesDrawn[NUM_SCATTER_KINDS][NUM_SCATTER_BANDS] = {};
+
+    size_t drawn(ScatterBand band) const {
+        size_t total = 0;
+        for (int kind = 0; kind < NUM_SCATTER_KINDS; ++kind) total += instancesDrawn[kind][band];
+        return total;
+    }
+};
+
+// keeps the tiles of every kind within its impostor distance of the camera, builds the missing ones on worker
+// threads and picks what to draw each frame: per tile against the frustum and the clip plane, then by distance
+class ScatterField {
+public:
+    ScatterSettings settings;
+    ScatterStats stats;
+    ScatterBatch batches[NUM_SCATTER_KINDS][NUM_SCATTER_BANDS]; ///< filled by cull
+
+private:
+    HeightfieldGenerator generator;
+    std::shared_ptr<ErosionField> erosion;
+    std::unordered_map<ScatterKey, std::unique_ptr<ScatterTile>, ScatterKeyHash> resident;
+
+    // tiles that have been handed to the workers and are not resident yet
+    std::unordered_set<ScatterKey, ScatterKeyHash> building;
+    std::mutex finishedMutex;
+    std::condition_variable finishedReady;
+    std::deque<std::unique_ptr<ScatterTile>> finished;
+    std::atomic<bool> shuttingDown;
+
+    // declared last so the workers are joined before anything they touch is destroyed
+    ThreadPool pool;
+
+public:
+    // erosion is the one of the terrain, so the instances stand on the eroded ground
+    ScatterField(const ScatterSettings &_settings, unsigned int numThreads = 0, std::shared_ptr<ErosionField> _erosion = nullptr)
+        : settings(_settings), generator(nullptr, _settings.terrain), erosion(_erosion), shuttingDown(false),
+          pool(numThreads) {}
+
+    ~ScatterField() {
+        shuttingDown = true;
+    }
+
+    // called once per frame before cull, with blocking set it waits for every tile in range
+    void update(const OpenGP::Vec3 &cameraPos, bool blocking = false) {
+        stats.tilesBuilt = 0;
+
+        std::vector<std::pair<float, ScatterKey>> missing;
+        for (int kind = 0; kind < NUM_SCATTER_KINDS; ++kind) {
+            float radius = settings.rules[kind].impostorDistance;
+            int x0 = (int)std::floor((cameraPos.x() - radius) / settings.tileSize);
+            int x1 = (int)std::floor((cameraPos.x() + radius) / settings.tileSize);
+            int y0 = (int)std::floor((cameraPos.y() - radius) / settings.tileSize);
+            int y1 = (int)std::floor((cameraPos.y() + radius) / settings.tileSize);
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    ScatterKey key = { kind, x, y };
+                    float distance = distanceToTile(settings, key, cameraPos.x(), cameraPos.y());
+                    if (distance > radius || resident.count(key) || building.count(key)) continue;
+                    missing.push_back(std::make_pair(distance, key));
+                }
+            }
+        }
+        requestMissing(missing, blocking);
+
+        if (blocking) {
+            std::unique_lock<std::mutex> lock(finishedMutex);
+            finishedReady.wait(lock, [&]() { return finished.size() == building.size(); });
+        }
+        collectFinished(cameraPos);
+        evict(cameraPos);
+
+        stats.tilesResident = (int)resident.size();
+        stats.tilesBuilding = (int)building.size();
+    }
+
+    // fills batches with the instances to draw for a camera, an occlusion buffer has to hold the occluders of the
+    // same camera already (see Occlusion.h)
+    void cull(const OpenGP::Mat4x4 &projectionView, const OpenGP::Vec3 &cameraPos, const CullPlane &clip,
+              OcclusionBuffer *occlusion = nullptr) {
+        for (auto &kind : batches) {
+            for (ScatterBatch &batch : kind) batch.clear();
+        }
+        stats.tilesVisible = 0;
+        stats.tilesCulledFrustum = 0;
+        stats.tilesCulledClipPlane = 0;
+        stats.tilesCulledOcclusion = 0;
+        stats.tilesCulledDistance = 0;
+
+        Frustum frustum(projectionView);
+        for (auto &entry : resident) {
+            const ScatterTile &tile = *entry.second;
+            if (tile.size() == 0) continue;
+            const ScatterRule &rule = settings.rules[tile.key.kind];
+
+            float distance = distanceToTile(settings, tile.key, cameraPos.x(), cameraPos.y());
+            ScatterBand band = distance < rule.meshDistance ? SCATTER_MESH : SCATTER_IMPOSTOR;
+            if (distance >= rule.impostorDistance) {
+                stats.tilesCulledDistance++;
+            } else if (clip.maxDistance(tile.lo, tile.hi) < 0.0f) {
+                stats.tilesCulledClipPlane++;
+            } else if (!frustum.intersects(tile.lo, tile.hi)) {
+                stats.tilesCulledFrustum++;
+            } else if (occlusion && occlusion->occluded(tile.lo, tile.hi)) {
+                stats.tilesCulledOcclusion++;
+            } else {
+                stats.tilesVisible++;
+                batches[tile.key.kind][band].append(tile);
+            }
+        }
+
+        for (int kind = 0; kind < NUM_SCATTER_KINDS; ++kind) {
+            for (int band = 0; band < NUM_SCATTER_BANDS; ++band) stats.instancesDrawn[kind][band] = batches[kind][band].size();
+        }
+    }
+
+    int threads() const { return pool.size(); }
+
+private:
+    void requestMissing(std::vector<std::pair<float, ScatterKey>> &missing, bool blocking) {
+        // closest first, and keep the queue short so that tiles we fly past do not hold up the ones in front of us
+        std::sort(missing.begin(), missing.end(), [](const std::pair<float, ScatterKey> &a, const std::pair<float, ScatterKey> &b) {
+            return a.first < b.first;
+        });
+        size_t maxInFlight = blocking ? missing.size() + building.size() : 4 * pool.size();
+
+        for (auto &m : missing) {
+            if (building.size() >= maxInFlight) break;
+            ScatterKey key = m.second;
+            building.insert(key);
+            pool.submit([this, key]() {
+                std::unique_ptr<ScatterTile> tile(new ScatterTile());
+                if (!shuttingDown) buildScatterTile(generator, settings, key, *tile, erosion.get());
+                tile->key = key;
+
+                std::lock_guard<std::mutex> lock(finishedMutex);
+                finished.push_back(std::move(tile));
+                finishedReady.notify_all();
+            });
+        }
+    }
+
+    void collectFinished(const OpenGP::Vec3 &cameraPos) {
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        while (!finished.empty()) {
+            std::unique_ptr<ScatterTile> tile = std::move(finished.front());
+            finished.pop_front();
+            building.erase(tile->key);
+
+            // the camera moved on while it was being built
+            float radius = settings.rules[tile->key.kind].impostorDistance;
+            if (distanceToTile(settings, tile->key, cameraPos.x(), cameraPos.y()) > radius) continue;
+
+            stats.instancesResident += tile->size();
+            stats.residentBytes += tile->bytes();
+            stats.tilesBuilt++;
+            resident[tile->key] = std::move(tile);
+        }
+    }
+
+    // the tiles are only CPU memory, they go as soon as they are a tile out of range so that going back and
+    // forth over a boundary does not build the same tile again and again
+    void evict(const OpenGP::Vec3 &cameraPos) {
+        for (auto it = resident.begin(); it != resident.end();) {
+            const ScatterTile &tile = *it->second;
+            float radius = settings.rules[tile.key.kind].impostorDistance + settings.tileSize;
+            if (distanceToTile(settings, tile.key, cameraPos.x(), cameraPos.y()) > radius) {
+                stats.instancesResident -= tile.size();
+                stats.residentBytes -= tile.bytes();
+                it = resident.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+#endif
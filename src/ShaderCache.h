@@ -0,0 +1,211 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include "utility.h"
+#include "ImageCache.h"
+#include "UniformBlocks.h"
+
+#include <chrono>
+#include <map>
+
+// GL_KHR_parallel_shader_compile, not in our GLEW
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// the sources of a program, the uniform blocks are added to both
+struct ShaderSource {
+    std::string name;
+    const char *vshader, *fshader;
+};
+
+// every program of the world, built once at startup before the textures load
+//
+// A program is keyed by a hash of its sources (with the uniform blocks) and of the vendor, renderer and version
+// strings of the driver. A key found on disk is loaded with glProgramBinary and skips the compiler entirely;
+// otherwise the program is compiled and linked without waiting for the result (see Shader::compile_async), which
+// the driver does on its own threads with GL_KHR_parallel_shader_compile, so the compiles overlap the texture
+// decoding that follows. take() then waits for the program and stores its glGetProgramBinary output for the next
+// start. A binary the driver rejects (it changed without changing its strings) is compiled like a miss.
+class ShaderCache {
+public:
+    struct Stats {
+        int hits = 0;
+        int misses = 0;
+        int rejected = 0;       ///< binaries on disk the driver did not take, counted in misses too
+        int stored = 0;
+        bool binaries = false;  ///< the driver has at least one program binary format
+        bool parallel = false;  ///< GL_KHR_parallel_shader_compile
+        double requestMs = 0.0; ///< reading the binaries and issuing the compiles
+        double waitMs = 0.0;    ///< blocked in take() on programs that were not done yet
+    };
+
+    Stats stats;
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t format;
+        uint32_t reserved;
+        uint64_t bytes;
+    };
+    static_assert(sizeof(Header) == 32, "the cache layout is fixed");
+    static const uint32_t version = 1;
+
+    struct Entry {
+        std::unique_ptr<Shader> shader;
+        uint64_t key = 0;
+        bool compiled = false; ///< a miss, its binary is stored once it links
+    };
+
+    std::string dir;
+    std::string driver;
+    std::map<std::string, Entry> entries;
+
+public:
+    // an empty dir compiles everything and stores nothing
+    explicit ShaderCache(const std::string &_dir = "shader_cache") : dir(_dir) {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        stats.binaries = formats > 0;
+        stats.parallel = hasGLExtension("GL_KHR_parallel_shader_compile");
+        const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for (GLenum name : strings) {
+            const char *s = (const char*)glGetString(name);
+            driver += s ? s : "";
+            driver += '\n';
+        }
+    }
+
+    // requests all of them right away
+    ShaderCache(const std::string &_dir, const std::vector<ShaderSource> &programs) : ShaderCache(_dir) {
+        for (const ShaderSource &program : programs) request(program.name, program.vshader, program.fshader);
+    }
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache &operator=(const ShaderCache&) = delete;
+
+    // starts building a program, take() gets it
+    void request(const std::string &name, const char *vshader, const char *fshader) {
+        auto start = std::chrono::steady_clock::now();
+        std::string vsource = withUniformBlocks(vshader), fsource = withUniformBlocks(fshader);
+        Entry &entry = entries[name];
+        entry.shader = std::unique_ptr<Shader>(new Shader());
+        entry.shader->verbose = true;
+        entry.key = hash(driver + '\0' + vsource + '\0' + fsource);
+        entry.compiled = !load(entry);
+        if (entry.compiled) {
+            ++stats.misses;
+            entry.shader->compile_async(vsource.c_str(), GL_VERTEX_SHADER);
+            entry.shader->compile_async(fsource.c_str(), GL_FRAGMENT_SHADER);
+            entry.shader->link_async(useFiles());
+        } else {
+            ++stats.hits;
+        }
+        stats.requestMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // the linked program with its uniform blocks bound, waits for it if the driver is still working on it
+    std::unique_ptr<Shader> take(const std::string &name) {
+        auto it = entries.find(name);
+        assert(it != entries.end());
+        Entry entry = std::move(it->second);
+        entries.erase(it);
+        if (entry.compiled) {
+            auto start = std::chrono::steady_clock::now();
+            bool linked = entry.shader->finish_link();
+            stats.waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (linked && useFiles()) stats.stored += store(entry);
+        }
+        bindUniformBlocks(*entry.shader);
+        return std::move(entry.shader);
+    }
+
+    std::unique_ptr<Shader> link(const std::string &name, const char *vshader, const char *fshader) {
+        request(name, vshader, fshader);
+        return take(name);
+    }
+
+    // whether the program is linked, without waiting for it (always true without the extension)
+    bool ready(const std::string &name) const {
+        auto it = entries.find(name);
+        if (it == entries.end() || !it->second.compiled || !stats.parallel) return true;
+        GLint done = GL_FALSE;
+        glGetProgramiv(it->second.shader->programId(), GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+
+    void printStats() const {
+        std::cout << "shaders: " << stats.hits << " from cache, " << stats.misses << " compiled (" << stats.rejected
+                  << " binaries rejected" << (stats.parallel ? ", in parallel" : "") << "), request " << stats.requestMs
+                  << " ms, wait " << stats.waitMs << " ms" << std::endl;
+    }
+
+private:
+    bool useFiles() const { return !dir.empty() && stats.binaries; }
+
+    // 64 bit FNV-1a
+    static uint64_t hash(const std::string &s) {
+        uint64_t h = 14695981039346656037ull;
+        for (unsigned char c : s) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    std::string path(uint64_t key) const {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.glbin", (unsigned long long)key);
+        return dir + "/" + name;
+    }
+
+    bool load(Entry &entry) {
+        if (!useFiles()) return false;
+        MappedFile mapped;
+        if (!mapped.open(path(entry.key)) || mapped.size < sizeof(Header)) return false;
+        Header header;
+        memcpy(&header, mapped.data, sizeof(header));
+        if (memcmp(header.magic, "VWSB", 4) != 0 || header.version != version || header.key != entry.key ||
+            mapped.size != sizeof(header) + header.bytes) return false;
+        if (entry.shader->load_binary(header.format, mapped.data + sizeof(header), (GLsizei)header.bytes)) return true;
+        ++stats.rejected;
+        // a failed glProgramBinary leaves the program unlinked, start over with a fresh one
+        entry.shader = std::unique_ptr<Shader>(new Shader());
+        entry.shader->verbose = true;
+        return false;
+    }
+
+    // like writeImageCache: a temporary file renamed into place
+    bool store(const Entry &entry) const {
+        std::vector<char> binary;
+        GLenum format = 0;
+        if (!entry.shader->get_binary(binary, format)) return false;
+        Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "VWSB", 4);
+        header.version = version;
+        header.key = entry.key;
+        header.format = format;
+        header.bytes = binary.size();
+
+#ifdef _WIN32
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+        std::string file = path(entry.key), temporary = file + ".tmp";
+        FILE *f = fopen(temporary.c_str(), "wb");
+        if (!f) return false;
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(binary.data(), 1, binary.size(), f) == binary.size();
+        ok = (fclose(f) == 0) && ok;
+        remove(file.c_str());
+        ok = ok && rename(temporary.c_str(), file.c_str()) == 0;
+        if (!ok) remove(temporary.c_str());
+        return ok;
+    }
+};
+
+#endif
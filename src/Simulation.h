@@ -0,0 +1,259 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <OpenGP/types.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// the camera moves on its own thread at a fixed timestep
+//
+// the window only records which keys are held and how far the mouse moved, the simulation thread samples that
+// every tick and integrates the camera with the tick length, so the motion no longer depends on the key repeat
+// rate or the frame rate. Every tick is handed to the render thread through a lock-free triple buffer with the
+// tick before it, and the render thread interpolates between the two, so nothing the simulation does can hold up
+// a frame and nothing the renderer does can hold up a tick. Nothing in here touches OpenGL.
+
+// keys the simulation knows about, as bits of TickInput::keys (main.cpp maps the GLFW keys to them)
+enum SimulationKey : uint32_t {
+    SIM_KEY_FORWARD = 1 << 0,   ///< W
+    SIM_KEY_LEFT = 1 << 1,      ///< A
+    SIM_KEY_BACK = 1 << 2,      ///< S
+    SIM_KEY_RIGHT = 1 << 3,     ///< D
+    SIM_KEY_ZOOM_IN = 1 << 4,   ///< up arrow, decreases the fov
+    SIM_KEY_ZOOM_OUT = 1 << 5,  ///< down arrow
+    SIM_KEY_FASTER = 1 << 6,    ///< right arrow
+    SIM_KEY_SLOWER = 1 << 7     ///< left arrow
+};
+
+// what one tick sees of the input: the keys held when it ran and the mouse motion since the tick before
+struct TickInput {
+    uint32_t keys = 0;
+    float lookX = 0.0f, lookY = 0.0f;
+};
+
+// everything of the camera that moves, Camera::setState takes it
+struct CameraState {
+    OpenGP::Vec3 position = OpenGP::Vec3(0.0f, 0.0f, 3.0f);
+    float yaw = 0.0f, pitch = 0.0f; ///< same angles as Camera
+    float fov = 80.0f;
+    float speed = 0.6f;             ///< units per second
+
+    OpenGP::Vec3 front() const {
+        return OpenGP::Vec3(std::sin(yaw) * std::cos(pitch), std::cos(yaw) * std::cos(pitch), std::sin(pitch));
+    }
+};
+
+inline CameraState interpolate(const CameraState &a, const CameraState &b, float t) {
+    CameraState s = b;
+    s.position = a.position + t * (b.position - a.position);
+    s.yaw = a.yaw + t * (b.yaw - a.yaw);
+    s.pitch = a.pitch + t * (b.pitch - a.pitch);
+    s.fov = a.fov + t * (b.fov - a.fov);
+    return s;
+}
+
+// how the input moves the camera over one tick
+struct CameraMotion {
+    float mouseSensitivity = 0.005f;
+    float fovRate = 30.0f;        ///< degrees per second while an arrow is held
+    float speedDoubling = 1.0f;   ///< seconds of holding an arrow to double or halve the speed
+    float minSpeed = 0.05f, maxSpeed = 50.0f;
+
+    // the height of the ground under a point, when set the camera cannot move closer to it than groundClearance
+    // called on the simulation thread
+    std::function<float(float, float)> groundHeight;
+    float groundClearance = 0.15f; // a bit more than the near plane, so the ground is never cut open
+
+    void step(CameraState &state, const TickInput &input, float dt) const {
+        state.yaw += mouseSensitivity * input.lookX;
+        state.pitch -= mouseSensitivity * input.lookY;
+        // we prevent the camera from turning over.
+        state.pitch = std::min(state.pitch, (float)M_PI / 2.0f - 0.01f);
+        state.pitch = std::max(state.pitch, -(float)M_PI / 2.0f + 0.01f);
+
+        OpenGP::Vec3 front = state.front(), up(0.0f, 0.0f, 1.0f);
+        OpenGP::Vec3 side = front.cross(up);
+        OpenGP::Vec3 direction = OpenGP::Vec3::Zero();
+        if (input.keys & SIM_KEY_FORWARD) direction += front;
+        if (input.keys & SIM_KEY_BACK) direction -= front;
+        if (input.keys & SIM_KEY_RIGHT) direction += side;
+        if (input.keys & SIM_KEY_LEFT) direction -= side;
+        state.position += state.speed * dt * direction;
+
+        // do not walk into the mountains
+        if (groundHeight) {
+            float ground = groundHeight(state.position.x(), state.position.y()) + groundClearance;
+            state.position.z() = std::max(state.position.z(), ground);
+        }
+
+        if (input.keys & SIM_KEY_ZOOM_IN) state.fov = std::max(1.0f, state.fov - fovRate * dt);
+        if (input.keys & SIM_KEY_ZOOM_OUT) state.fov = std::min(80.0f, state.fov + fovRate * dt);
+
+        float doubling = std::exp2(dt / speedDoubling);
+        if (input.keys & SIM_KEY_FASTER) state.speed = std::min(maxSpeed, state.speed * doubling);
+        if (input.keys & SIM_KEY_SLOWER) state.speed = std::max(minSpeed, state.speed / doubling);
+    }
+};
+
+// single producer, single consumer: the writer fills its slot and swaps it with the middle one, the reader swaps
+// the middle one with its slot when it holds something newer. Neither side ever waits for the other, and the
+// reader always sees the latest complete value.
+template <typename T>
+class TripleBuffer {
+private:
+    static const int freshBit = 4; ///< set on the middle index when the writer put something there
+    T slots[3];
+    std::atomic<int> middle;
+    int back = 0, front = 1;        ///< owned by the writer and by the reader
+
+public:
+    TripleBuffer() : middle(2) {}
+
+    // writer side
+    T &writeSlot() { return slots[back]; }
+
+    void publish() {
+        back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & ~freshBit;
+    }
+
+    // reader side, returns whether a newer value came in
+    bool update() {
+        if (!(middle.load(std::memory_order_acquire) & freshBit)) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & ~freshBit;
+        return true;
+    }
+
+    const T &read() const { return slots[front]; }
+};
+
+// what a tick hands to the render thread
+struct SimulationFrame {
+    CameraState previous, current;
+    uint64_t tick = 0;   ///< of current, previous is the tick before
+};
+
+class Simulation {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    const double tickSeconds;
+    CameraMotion motion;
+
+    // with record set, the input of every tick is appended to recording, read it once the thread has stopped
+    bool record = false;
+    std::vector<TickInput> recording;
+
+private:
+    CameraState state; ///< owned by the simulation thread once it runs
+    TripleBuffer<SimulationFrame> frames;
+    SimulationFrame latest; ///< what the render thread read last
+
+    // written by the window thread, taken by the ticks
+    std::atomic<uint32_t> keys;
+    std::atomic<float> lookX, lookY;
+
+    std::atomic<bool> running;
+    std::atomic<double> stepMs;
+    std::thread thread;
+    Clock::time_point startTime;
+
+public:
+    explicit Simulation(const CameraState &start = CameraState(), double _tickSeconds = 1.0 / 120.0)
+        : tickSeconds(_tickSeconds), state(start), keys(0), lookX(0.0f), lookY(0.0f), running(false), stepMs(0.0) {
+        latest.previous = latest.current = start;
+    }
+
+    ~Simulation() {
+        stop();
+    }
+
+    Simulation(const Simulation&) = delete;
+    Simulation &operator=(const Simulation&) = delete;
+
+    void start() {
+        if (running) return;
+        running = true;
+        startTime = Clock::now();
+        thread = std::thread([this]() { run(); });
+    }
+
+    void stop() {
+        running = false;
+        if (thread.joinable()) thread.join();
+    }
+
+    // input side, from the window callbacks
+    void setKey(uint32_t key, bool down) {
+        if (down) keys.fetch_or(key);
+        else keys.fetch_and(~key);
+    }
+
+    void addLook(float dx, float dy) {
+        add(lookX, dx);
+        add(lookY, dy);
+    }
+
+    // render side: the camera one tick in the past, interpolated between the two ticks around that time
+    CameraState view() {
+        if (frames.update()) latest = frames.read();
+        double ticks = std::chrono::duration<double>(Clock::now() - startTime).count() / tickSeconds;
+        float t = (float)std::min(1.0, std::max(0.0, ticks - (double)latest.tick));
+        return interpolate(latest.previous, latest.current, t);
+    }
+
+    uint64_t tick() const { return latest.tick; }
+
+    // the state after the last tick, read it once the thread has stopped
+    const CameraState &simulated() const { return state; }
+
+    // the average cost of a tick on the simulation thread
+    double averageStepMs() const { return stepMs; }
+
+    // the same ticks as the thread, without the thread and without the clock
+    static CameraState replay(const CameraMotion &motion, CameraState start, const std::vector<TickInput> &inputs, double tickSeconds) {
+        for (const TickInput &input : inputs) motion.step(start, input, (float)tickSeconds);
+        return start;
+    }
+
+private:
+    static void add(std::atomic<float> &value, float delta) {
+        float old = value.load();
+        while (!value.compare_exchange_weak(old, old + delta)) {}
+    }
+
+    void run() {
+        uint64_t tick = 0;
+        while (running) {
+            // catch up with the clock, then sleep until the next tick is due
+            double due = std::chrono::duration<double>(Clock::now() - startTime).count() / tickSeconds;
+            while ((double)(tick + 1) <= due && running) {
+                auto begin = Clock::now();
+                TickInput input;
+                input.keys = keys.load();
+                input.lookX = lookX.exchange(0.0f);
+                input.lookY = lookY.exchange(0.0f);
+                if (record) recording.push_back(input);
+
+                SimulationFrame &frame = frames.writeSlot();
+                frame.previous = state;
+                motion.step(state, input, (float)tickSeconds);
+                frame.current = state;
+                frame.tick = ++tick;
+                frames.publish();
+
+                double ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+                stepMs = 0.9 * stepMs + 0.1 * ms;
+            }
+            std::this_thread::sleep_until(startTime + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>((tick + 1) * tickSeconds)));
+        }
+    }
+};
+
+#endif
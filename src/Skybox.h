@@ -3,16 +3,20 @@
 
 #include "utility.h"
 #include "Camera.h"
+#include "Clouds.h"
+#include "ShaderCache.h"
+#include "TextureLoader.h"
+#include "UniformBlocks.h"
 
-const char* skybox_vshader =
+const char* const skybox_vshader =
 #include "skybox_vshader.glsl"
 ;
 
-const char* skybox_fshader =
+const char* const skybox_fshader =
 #include "skybox_fshader.glsl"
 ;
 
-std::vector<Vec3> skyboxVertices =
+static const std::vector<Vec3> skyboxVertices =
 {
     //   Coordinates
     Vec3(-1.0f, -1.0f,  1.0f), //        7--------6
@@ -25,7 +29,7 @@ std::vector<Vec3> skyboxVertices =
     Vec3(-1.0f,  1.0f, -1.0f)
 };
 
-std::vector<unsigned int> skyboxIndices =
+static const std::vector<unsigned int> skyboxIndices =
 {
     // Right
     1, 2, 6,
@@ -55,17 +59,15 @@ public:
     std::unique_ptr<GPUMesh> skyboxMesh;
     GLuint skyboxTexture;
 
-    std::unique_ptr<RGBA8Texture> cloudTexture;
-    Vec3 skyColor;
+    std::unique_ptr<GenericTexture> cloudTexture;
+
+    // the cloud cover the skybox samples, rendered once per frame for the reflection and the main pass
+    Clouds clouds;
 
 public:
-    Skybox(Vec3 _skyColor) {
-        skyboxShader = std::unique_ptr<Shader>(new Shader());
-        skyboxShader->verbose = true;
-        skyboxShader->add_vshader_from_source(skybox_vshader);
-        skyboxShader->add_fshader_from_source(skybox_fshader);
-        skyboxShader->link();
-        skyColor = _skyColor;
+    // the sky colour is in the Material block (see UniformBlocks.h)
+    // the program was requested as "skybox" (see ShaderCache.h)
+    Skybox(TextureLoader &textures, ShaderCache &shaders) : clouds(shaders) {
 
         // Load skybox textures
         const std::string skyList[] = { "miramar_ft", "miramar_bk", "miramar_dn", "miramar_up", "miramar_rt", "miramar_lf" };
@@ -80,18 +82,13 @@ public:
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
         // load CUBE_MAP textures => the string name array already have them correctly sorted
-        int tex_wh = 1024;
         for (int i = 0; i < 6; ++i) {
-            std::vector<unsigned char> image;
-            loadTexture(image, (skyList[i] + ".png").c_str());
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, tex_wh, tex_wh, 0, GL_RGBA, GL_UNSIGNED_BYTE, &image[0]);
+            textures.uploadFace(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, skyList[i] + ".png");
         }
 
         // load cloud texture
-        std::string name = "cloud.png";
-        loadTexture(cloudTexture, name.c_str());
+        cloudTexture = textures.texture("cloud.png");
         cloudTexture->bind();
-        glGenerateMipmap(GL_TEXTURE_2D);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -100,28 +97,36 @@ public:
         skyboxMesh = std::unique_ptr<GPUMesh>(new GPUMesh());
         skyboxMesh->set_vbo<Vec3>("vposition", skyboxVertices);
         skyboxMesh->set_triangles(skyboxIndices);
+
+        setShader(shaders.take("skybox"));
+    }
+
+    // swaps in another program built from skybox_vshader, the headless harness compares the old clouds with it
+    void setShader(std::unique_ptr<Shader> shader) {
+        skyboxShader = std::move(shader);
+        // the camera and the time come from the Camera block, the samplers never change
+        skyboxShader->bind();
+        skyboxShader->set_uniform("skybox", 0);
+        skyboxShader->set_uniform("cloudTexture", 1);
+        skyboxShader->set_uniform("cloudMap", 2);
+        // the vertex array keeps the attributes
+        skyboxMesh->set_attributes(*skyboxShader);
+        skyboxShader->unbind();
     }
 
-    void draw(Camera camera, float time) {
+    void draw() {
         
         // we use GL_LEQUAL as the depth of the cubemap will always be 1 and we don't want it to get discarded
         glDepthFunc(GL_LEQUAL);
         skyboxShader->bind();
 
-        skyboxShader->set_uniform("view", camera.viewMatrix());
-        skyboxShader->set_uniform("projection", camera.projectionMatrix());
-        skyboxShader->set_uniform("time", time);
-        skyboxShader->set_uniform("baseSkyColor", skyColor);
-
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
-        skyboxShader->set_uniform("skybox", 0);
-
         glActiveTexture(GL_TEXTURE1);
         cloudTexture->bind();
-        skyboxShader->set_uniform("cloudTexture", 1);
+        glActiveTexture(GL_TEXTURE2);
+        clouds.bind();
 
-        skyboxMesh->set_attributes(*skyboxShader);
         skyboxMesh->draw();
 
         // Switch back to the normal depth function
@@ -3,122 +3,189 @@
 
 #include "utility.h"
 #include "Camera.h"
-
-const char* terrain_vshader =
+#include "ChunkManager.h"
+#include "Frustum.h"
+#include "HeightPyramid.h"
+#include "Occlusion.h"
+#include "Profiler.h"
+#include "ShaderCache.h"
+#include "TextureLoader.h"
+#include "UniformBlocks.h"
+
+const char* const terrain_vshader =
 #include "terrain_vshader.glsl"
 ;
 
-const char* terrain_fshader =
+const char* const terrain_fshader =
 #include "terrain_fshader.glsl"
 ;
 
-int index(int i, int j, int cols) {
-    return i + j * cols;
-}
+// the layers of the splat texture array, in the order terrain_fshader.glsl indexes them
+const char* const terrainLayers[] = { "grass.png", "rock.png", "sand.png", "snow.png" };
+
+// the texture state of the terrain, built once: all the layers in one array on one unit, so a draw binds it
+// with a single call and the sampler uniform never changes
+struct TerrainMaterial {
+    std::unique_ptr<TextureArray> layers;
+    GLuint unit = 0;
+
+    void bind() const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        layers->bind();
+    }
+};
+
+// the passes that draw the terrain, each keeps the culling counters of its last draw
+enum TerrainPass {
+    TERRAIN_PASS_REFLECTION = 0,
+    TERRAIN_PASS_REFRACTION,
+    TERRAIN_PASS_MAIN,
+    NUM_TERRAIN_PASSES
+};
+
+// what the culling did in one pass
+struct CullStats {
+    int chunksDrawn = 0;
+    int chunksCulledFrustum = 0;
+    int chunksCulledClipPlane = 0; ///< entirely on the clipped side of the water plane
+    int chunksCulledOcclusion = 0; ///< behind the terrain in front of them, only in a pass with an occlusion buffer
+};
 
 class Terrain {
 public:
     std::unique_ptr<Shader> terrainShader;
-    std::unique_ptr<GPUMesh> terrainMesh;
-    std::map<std::string, std::unique_ptr<RGBA8Texture>> terrainTextures;
-    float waterHeight;
+    ChunkUniforms chunkUniforms;
+    std::unique_ptr<ChunkManager> chunks;
+    std::unique_ptr<HeightPyramid> ground; ///< height queries and ray casts on the CPU, against the finest chunks
+    std::shared_ptr<ErosionField> erosion; ///< null when the terrain is not eroded, the scatter stands on it too
+    TerrainMaterial material;
     
-    Mat4x4 M = Mat4x4::Identity(); // the model matrix is always an identity, we displace manually
-    
-    Vec3 skyColor, lightPos;
-
-    Terrain(float size_grid_x, float size_grid_y, float _waterHeight, Vec3 _skyColor, Vec3 _lightPos) 
-        : waterHeight(_waterHeight), skyColor(_skyColor), lightPos(_lightPos) {
-        terrainShader = std::unique_ptr<Shader>(new Shader());
-        terrainShader->verbose = true;
-        terrainShader->add_vshader_from_source(terrain_vshader);
-        terrainShader->add_fshader_from_source(terrain_fshader);
-        terrainShader->link();
-
-        const std::string list[] = { "grass", "rock", "sand", "snow" };
-        for (int i=0 ; i < 4 ; ++i) {
-            loadTexture(terrainTextures[list[i]], (list[i]+".png").c_str());
-            terrainTextures[list[i]]->bind();
-            glGenerateMipmap(GL_TEXTURE_2D);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    Mat4x4 M = Mat4x4::Identity(); // the model matrix is always an identity, chunks are built in world space
+
+    bool firstUpdate = true;
+
+    // culling counters of the last draw of each pass
+    CullStats passStats[NUM_TERRAIN_PASSES];
+
+    // the water height, sky colour and light position are in the Material block (see UniformBlocks.h)
+    // the program was requested as "terrain" (see ShaderCache.h)
+    // params is the world (its seed among them), eroded with erosionParams when they are enabled (see Erosion.h)
+    // the chunks and the eroded tiles are kept in tileStoreDir across runs, empty builds them every time
+    // the chunks are shadowed with horizon maps baked with horizonParams when they are enabled (see Horizon.h)
+    Terrain(float size_grid_x, TextureLoader &textures, ShaderCache &shaders,
+            const HeightfieldParams &params = HeightfieldParams(), const std::string &tileStoreDir = "",
+            const ErosionParams &erosionParams = ErosionParams(), const HorizonParams &horizonParams = HorizonParams()) {
+        // the mip chains come with the textures (see TextureLoader.h)
+        material.layers = textures.textureArray(std::vector<std::string>(std::begin(terrainLayers), std::end(terrainLayers)));
+        material.layers->bind();
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        material.layers->unbind();
+
+        // close to the camera the world grid keeps the density of the old 1024x1024 mesh over a size_grid_x wide area,
+        // further away the LOD quadtree halves it every time the distance doubles (see TerrainLOD.h)
+        // A higher resolution here leads to better textures at the expense of computational speed
+        int n_width = 1024;
+        LODSettings lod;
+        lod.quads = 64;
+        lod.spacing = size_grid_x / (float)n_width;
+        lod.maxLevel = 4;
+        // the fog hides everything after about 1.5 times the grid size
+        lod.viewRadius = 1.5f * size_grid_x;
+        std::shared_ptr<TileStore> store;
+        if (!tileStoreDir.empty()) {
+            store = std::make_shared<TileStore>(tileStoreDir, params, lod.quads, lod.spacing, erosionKey(erosionParams));
         }
+        if (erosionParams.enabled) erosion = std::make_shared<ErosionField>(params, erosionParams, lod.spacing, store);
+        chunks = std::unique_ptr<ChunkManager>(new ChunkManager(lod, params, store, erosion, horizonParams));
+        ground = std::unique_ptr<HeightPyramid>(new HeightPyramid(lod.spacing, nullptr, params, erosion));
 
-        terrainMesh = std::unique_ptr<GPUMesh>(new GPUMesh());
-        // divides the plane rectangle into n_width along the width and n_height along the height to create a 
-        // displaceable grid. A higher resolution here leads to better textures at the expense of computational speed
-        int n_width =  1024;
-        int n_height = 1024;
-
-        // texture coordinates are calculated as per the positions so that we can move the tile
-        // to get an infinite world.
-        std::vector<Vec3> points;
-        std::vector<unsigned int> indices;
-
-        for (int j = 0; j < n_width; ++j) {
-            for (int i = 0; i < n_height; ++i) {
-                // we create a vertices from [-size_grid_x, size_grid_x] instead of [-1, 1] => this creates a larger terrain 
-                // that we can blur to give the illusion that it is infinite
-                float x = -size_grid_x / 2 + (float) j / (float)n_width  * size_grid_x;
-                float y = -size_grid_y / 2 + (float) i / (float)n_height * size_grid_y;
-                points.push_back(Vec3(x, y, 0.0f));
-            }
-        }
+        setShader(shaders.take("terrain"));
+    }
 
-        // we need to build the grid with GL_TRIANGLE_STRIP
-        // the best way is to build each row into a strip
-        // then concatenate the strips
-        // opengl provides  glEnable(GL_PRIMITIVE_RESTART) and  glPrimitiveRestartIndex(index)
-        // such that when the given index is reached, the next primitive is built
-        for(int j = 0; j < n_width - 1; ++j) {
-            indices.push_back(index(0, j, n_width));
-            indices.push_back(index(0, j + 1, n_width));
-
-            for(int i = 1; i < n_height; ++i) {
-                indices.push_back(index(i, j, n_width));
-                indices.push_back(index(i, j + 1, n_height));
-            }
+    // swaps in a program with another fragment shader (built from terrain_vshader), call before the first update
+    void setShader(std::unique_ptr<Shader> shader) {
+        terrainShader = std::move(shader);
 
-            // A new strip will begin when this index is reached
-            indices.push_back(indexRestart);
-        }
+        // the camera and the world constants come from the uniform blocks (see UniformBlocks.h),
+        // what is left never changes and is set once here
+        terrainShader->bind();
+        terrainShader->set_uniform("layers", (int)material.unit);
+        terrainShader->set_uniform("horizons", (int)terrainHorizonUnit);
+        terrainShader->set_uniform("M", M);
+        terrainShader->set_uniform("chunkCols", chunks->lod.quads + 1);
+        terrainShader->set_uniform("heightStep", terrainHeightStep);
+        terrainShader->unbind();
+        chunkUniforms = ChunkUniforms(terrainShader.get());
+    }
+
+    // streams in the chunks around the camera, call once per frame before drawing any pass
+    // with blocking set every chunk in view is built before returning, so a frame never shows a coarser patch
+    void update(const Camera &camera, bool blocking = false) {
+        chunks->update(camera.cameraPos, blocking || firstUpdate);
+        firstUpdate = false;
 
-        terrainMesh->set_vbo<Vec3>("vposition", points);
-        terrainMesh->set_triangles(indices);
+        // the vertex layout of a chunk only has to be described once
+        for (Chunk *chunk : chunks->uploadedChunks) chunks->setAttributes(*chunk);
     }
 
-    void draw(Camera camera, Vec3 clipPlaneNormal, float clipPlaneHeight) {
-        terrainShader->bind();
+    // the camera and the clip plane of the pass are in the Camera block already, they are given here for the culling
+    // with an occlusion buffer the chunks that pass the frustum are rasterized into it as occluders first, and the
+    // ones hidden behind them are not drawn; the buffer is left with them for the rest of the pass (see Occlusion.h)
+    void draw(const Mat4x4 &projectionView, Vec3 clipPlaneNormal, float clipPlaneHeight,
+              TerrainPass pass = TERRAIN_PASS_MAIN, OcclusionBuffer *occlusion = nullptr) {
+        // cull on the CPU before any vertex runs: against the frustum of the camera of this pass (the mirrored
+        // one for the reflection) and against the water clip plane, which gl_ClipDistance only applies per vertex
+        Frustum frustum(projectionView);
+        CullPlane clip = clipPlane(clipPlaneNormal, clipPlaneHeight);
+        CullStats cull;
+        std::vector<const VisibleChunk*> drawn;
+        for (const VisibleChunk &visible : chunks->visibleChunks) {
+            Vec3 lo, hi;
+            chunkBox(chunks->lod, visible.chunk->key, visible.chunk->minHeight, visible.chunk->maxHeight, lo, hi);
+            if (clip.maxDistance(lo, hi) < 0.0f) {
+                cull.chunksCulledClipPlane++;
+            } else if (!frustum.intersects(lo, hi)) {
+                cull.chunksCulledFrustum++;
+            } else {
+                drawn.push_back(&visible);
+            }
+        }
 
-        terrainShader->set_uniform("M", M);
-        terrainShader->set_uniform("V", camera.viewMatrix());
-        terrainShader->set_uniform("P", camera.projectionMatrix());
-        terrainShader->set_uniform("viewPos", camera.cameraPos);
-
-        // set clipping plane for the reflection and refraction
-        terrainShader->set_uniform("clipPlaneNormal", clipPlaneNormal);
-        terrainShader->set_uniform("clipPlaneHeight", clipPlaneHeight);
-        terrainShader->set_uniform("waterHeight", waterHeight);
-        terrainShader->set_uniform("skyColor", skyColor);
-        terrainShader->set_uniform("lightPos", lightPos);
-
-        int i = 0;
-        for (auto it = terrainTextures.begin(); it != terrainTextures.end(); ++it) {
-            glActiveTexture(GL_TEXTURE0 + i);
-            (it->second)->bind();
-            terrainShader->set_uniform(it->first.c_str(), i);
-            ++i;
+        if (occlusion) {
+            PROFILE_SCOPE("occlusion");
+            occlusion->begin(projectionView);
+            for (const VisibleChunk *visible : drawn) {
+                const Chunk &chunk = *visible->chunk;
+                float size = chunkSizeAt(chunks->lod, chunk.key.level);
+                occlusion->addHeightGrid(chunk.key.x * size, chunk.key.y * size, size / chunkOccluderCells,
+                                         chunkOccluderCells, chunk.occluderHeights.data());
+            }
+            occlusion->finish();
+            std::vector<const VisibleChunk*> unoccluded;
+            for (const VisibleChunk *visible : drawn) {
+                Vec3 lo, hi;
+                chunkBox(chunks->lod, visible->chunk->key, visible->chunk->minHeight, visible->chunk->maxHeight, lo, hi);
+                if (occlusion->occluded(lo, hi)) cull.chunksCulledOcclusion++;
+                else unoccluded.push_back(visible);
+            }
+            drawn.swap(unoccluded);
         }
+        cull.chunksDrawn = (int)drawn.size();
+        passStats[pass] = cull;
+
+        terrainShader->bind();
+        material.bind();
+        glActiveTexture(GL_TEXTURE0 + terrainHorizonUnit); ///< every chunk binds its horizon map there
 
         // Draw terrain using triangle strips
-        terrainMesh->set_attributes(*terrainShader);
-        terrainMesh->set_mode(GL_TRIANGLE_STRIP);
         glEnable(GL_PRIMITIVE_RESTART);
-        glPrimitiveRestartIndex(indexRestart);
-        terrainMesh->draw();
+        glPrimitiveRestartIndex(chunkIndexRestart);
+        for (const VisibleChunk *visible : drawn) chunks->draw(*visible, chunkUniforms);
 
+        glActiveTexture(GL_TEXTURE0);
         terrainShader->unbind();
     }
 };
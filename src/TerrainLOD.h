@@ -0,0 +1,310 @@
+#ifndef TERRAINLOD_H
+#define TERRAINLOD_H
+
+#include <OpenGP/types.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "ChunkData.h"
+
+// quadtree level of detail for the terrain chunks
+//
+// every chunk has the same (quads + 1)^2 vertices, a chunk of level l just covers 2^l times more ground,
+// so the number of vertices we submit grows with log(view distance) instead of with the area in view.
+// A node is split while the camera is closer than rangeFactor times its size; with rangeFactor >= 1.5
+// two leaves that touch can differ by at most one level. While chunks stream in, a node whose children are not
+// built yet is drawn instead of them, and the finer chunks around it are drawn coarser too until no two drawn chunks
+// that touch differ by more than one level (see balanceDrawn). Where a leaf touches a coarser one, it stitches
+// that edge by snapping its odd edge vertices onto the even ones (which the coarse neighbour shares),
+// so seams are watertight without skirts. The snapped triangles become degenerate and the strip skips them.
+
+// edges of a chunk, used as bits of the stitch mask
+enum ChunkEdge {
+    EDGE_WEST = 1,  ///< i = 0
+    EDGE_EAST = 2,  ///< i = quads
+    EDGE_SOUTH = 4, ///< j = 0
+    EDGE_NORTH = 8  ///< j = quads
+};
+
+const int numStitchMasks = 16;
+
+struct LODSettings {
+    int quads = 64;
+    float spacing = 20.0f / 1024.0f; ///< spacing of level 0
+    int maxLevel = 4;
+    float viewRadius = 30.0f;
+    float rangeFactor = 2.0f;
+};
+
+// a leaf of the quadtree that will be drawn, with the edges it has to stitch to a coarser neighbour
+struct SelectedChunk {
+    ChunkKey key;
+    int stitchMask;
+};
+
+inline float chunkSizeAt(const LODSettings &settings, int level) {
+    return settings.quads * levelSpacing(settings.spacing, level);
+}
+
+// distance in the ground plane from a point to the square of a chunk
+inline float distanceToChunk(const LODSettings &settings, const ChunkKey &key, float px, float py) {
+    float size = chunkSizeAt(settings, key.level);
+    float dx = std::max(0.0f, std::max(key.x * size - px, px - (key.x + 1) * size));
+    float dy = std::max(0.0f, std::max(key.y * size - py, py - (key.y + 1) * size));
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+// world space bounding box of a chunk, the heights come from the built chunk
+inline void chunkBox(const LODSettings &settings, const ChunkKey &key, float minHeight, float maxHeight,
+                     OpenGP::Vec3 &lo, OpenGP::Vec3 &hi) {
+    float size = chunkSizeAt(settings, key.level);
+    lo = OpenGP::Vec3(key.x * size, key.y * size, minHeight);
+    hi = OpenGP::Vec3((key.x + 1) * size, (key.y + 1) * size, maxHeight);
+}
+
+// the strip indices of a chunk where the edges in stitchMask are stitched to a neighbour of the next coarser level
+// every variant is the base strip grid with some indices remapped, so they all have the same length
+inline std::vector<unsigned int> stitchedStripIndices(int quads, int stitchMask, unsigned int restart) {
+    int cols = quads + 1;
+    std::vector<unsigned int> indices = gridStripIndices(quads, restart);
+    for (unsigned int &k : indices) {
+        if (k == restart) continue;
+        int i = k % cols, j = k / cols;
+        // odd vertices on a stitched edge move to the previous even vertex along that edge
+        if ((stitchMask & EDGE_WEST) && i == 0 && (j & 1)) j -= 1;
+        else if ((stitchMask & EDGE_EAST) && i == quads && (j & 1)) j -= 1;
+        else if ((stitchMask & EDGE_SOUTH) && j == 0 && (i & 1)) i -= 1;
+        else if ((stitchMask & EDGE_NORTH) && j == quads && (i & 1)) i -= 1;
+        k = index(i, j, cols);
+    }
+    return indices;
+}
+
+// calls emit(a, b, c) for every non degenerate triangle of a strip list with primitive restart
+inline void forEachStripTriangle(const std::vector<unsigned int> &indices, unsigned int restart,
+                                 const std::function<void(unsigned int, unsigned int, unsigned int)> &emit) {
+    size_t stripStart = 0;
+    for (size_t k = 0; k < indices.size(); ++k) {
+        if (indices[k] == restart) {
+            stripStart = k + 1;
+            continue;
+        }
+        if (k < stripStart + 2) continue;
+        unsigned int a = indices[k - 2], b = indices[k - 1], c = indices[k];
+        if (a == b || b == c || a == c) continue;
+        emit(a, b, c);
+    }
+}
+
+inline int countStripTriangles(const std::vector<unsigned int> &indices, unsigned int restart) {
+    int count = 0;
+    forEachStripTriangle(indices, restart, [&](unsigned int, unsigned int, unsigned int) { ++count; });
+    return count;
+}
+
+inline int chunkFloorDiv(int a, int b) { return (a >= 0) ? a / b : -((-a + b - 1) / b); }
+
+// the chunk of level `level` that contains the chunk of the level of key at (x, y)
+inline ChunkKey ancestorAt(int level, int keyLevel, int x, int y) {
+    int scale = 1 << (level - keyLevel);
+    return ChunkKey{ level, chunkFloorDiv(x, scale), chunkFloorDiv(y, scale) };
+}
+
+// replaces drawn chunks by available ancestors until no two drawn chunks that touch differ by more than one level,
+// so that every seam can be stitched by the finer side. A chunk that touches one two or more levels coarser goes up
+// to the level just below it (or higher if that one is not built yet), along with everything drawn inside that
+// ancestor. Only when no ancestor is built at all does the chunk stay, and that seam may crack for a few frames.
+// Returns whether anything changed
+inline bool balanceDrawn(const LODSettings &settings, const std::function<bool(const ChunkKey&)> &isAvailable,
+                         std::unordered_set<ChunkKey, ChunkKeyHash> &drawn) {
+    const int dx[4] = { -1, 1, 0, 0 }, dy[4] = { 0, 0, -1, 1 };
+    bool changed = true, any = false;
+    while (changed) {
+        changed = false;
+        for (const ChunkKey &k : drawn) {
+            // the coarsest drawn neighbour across any edge
+            int coarsest = -1;
+            for (int e = 0; e < 4; ++e) {
+                for (int level = k.level + 2; level <= settings.maxLevel; ++level) {
+                    if (drawn.count(ancestorAt(level, k.level, k.x + dx[e], k.y + dy[e]))) {
+                        coarsest = std::max(coarsest, level);
+                        break;
+                    }
+                }
+            }
+            if (coarsest < 0) continue;
+
+            ChunkKey up = k;
+            bool found = false;
+            for (int level = coarsest - 1; level <= settings.maxLevel && !found; ++level) {
+                up = ancestorAt(level, k.level, k.x, k.y);
+                found = isAvailable(up);
+            }
+            if (!found) continue;
+
+            // everything drawn inside the ancestor goes, it takes their place
+            for (auto it = drawn.begin(); it != drawn.end();) {
+                if (it->level < up.level && ancestorAt(up.level, it->level, it->x, it->y) == up) it = drawn.erase(it);
+                else ++it;
+            }
+            drawn.insert(up);
+            changed = any = true;
+            break;
+        }
+    }
+    return any;
+}
+
+// walks the quadtree from the coarsest chunks around the camera
+//  wanted:   the ideal leaves for this camera, the ones that should be built
+//  selected: the leaves to draw. A node whose four children are not all available (isAvailable) is drawn
+//            itself instead, so streaming never opens holes, only temporarily coarser patches, with the chunks
+//            around such a patch coarsened as well so that the seams still differ by one level at most.
+inline void selectChunks(const LODSettings &settings, const OpenGP::Vec3 &cameraPos,
+                         const std::function<bool(const ChunkKey&)> &isAvailable,
+                         std::vector<ChunkKey> &wanted, std::vector<SelectedChunk> &selected) {
+    wanted.clear();
+    selected.clear();
+
+    float px = cameraPos.x(), py = cameraPos.y();
+    float rootSize = chunkSizeAt(settings, settings.maxLevel);
+    int x0 = (int)std::floor((px - settings.viewRadius) / rootSize), x1 = (int)std::floor((px + settings.viewRadius) / rootSize);
+    int y0 = (int)std::floor((py - settings.viewRadius) / rootSize), y1 = (int)std::floor((py + settings.viewRadius) / rootSize);
+
+    // (node, drawn so far) pairs, a node that is not available can still be wanted
+    std::vector<std::pair<ChunkKey, bool>> stack;
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            ChunkKey root = { settings.maxLevel, x, y };
+            if (distanceToChunk(settings, root, px, py) <= settings.viewRadius) stack.push_back(std::make_pair(root, false));
+        }
+    }
+
+    std::vector<SelectedChunk> drawn;
+    while (!stack.empty()) {
+        ChunkKey node = stack.back().first;
+        bool covered = stack.back().second;
+        stack.pop_back();
+
+        bool split = node.level > 0 &&
+            distanceToChunk(settings, node, px, py) < settings.rangeFactor * chunkSizeAt(settings, node.level);
+
+        ChunkKey children[4];
+        int numChildren = 0;
+        bool childrenAvailable = true;
+        if (split) {
+            for (int c = 0; c < 4; ++c) {
+                ChunkKey child = { node.level - 1, 2 * node.x + (c & 1), 2 * node.y + (c >> 1) };
+                if (distanceToChunk(settings, child, px, py) > settings.viewRadius) continue;
+                children[numChildren++] = child;
+                childrenAvailable = childrenAvailable && isAvailable(child);
+            }
+        }
+
+        if (!split) wanted.push_back(node);
+
+        // draw this node if the finer ones cannot take over yet and nothing above is drawn already
+        bool drawHere = !covered && (!split || !childrenAvailable) && isAvailable(node);
+        if (drawHere) drawn.push_back(SelectedChunk{ node, 0 });
+
+        for (int c = 0; c < numChildren; ++c) stack.push_back(std::make_pair(children[c], covered || drawHere));
+    }
+
+    std::unordered_set<ChunkKey, ChunkKeyHash> drawnSet;
+    for (auto &chunk : drawn) drawnSet.insert(chunk.key);
+    if (balanceDrawn(settings, isAvailable, drawnSet)) {
+        drawn.clear();
+        for (const ChunkKey &key : drawnSet) drawn.push_back(SelectedChunk{ key, 0 });
+    }
+
+    // stitch every edge that touches a coarser drawn chunk
+    for (auto &chunk : drawn) {
+        const ChunkKey &k = chunk.key;
+        // the coarser neighbour across each edge, the one that contains the next sample outside of it
+        ChunkKey west = { k.level + 1, chunkFloorDiv(k.x - 1, 2), chunkFloorDiv(k.y, 2) };
+        ChunkKey east = { k.level + 1, chunkFloorDiv(k.x + 1, 2), chunkFloorDiv(k.y, 2) };
+        ChunkKey south = { k.level + 1, chunkFloorDiv(k.x, 2), chunkFloorDiv(k.y - 1, 2) };
+        ChunkKey north = { k.level + 1, chunkFloorDiv(k.x, 2), chunkFloorDiv(k.y + 1, 2) };
+        int mask = 0;
+        if ((k.x & 1) == 0 && drawnSet.count(west)) mask |= EDGE_WEST;
+        if ((k.x & 1) == 1 && drawnSet.count(east)) mask |= EDGE_EAST;
+        if ((k.y & 1) == 0 && drawnSet.count(south)) mask |= EDGE_SOUTH;
+        if ((k.y & 1) == 1 && drawnSet.count(north)) mask |= EDGE_NORTH;
+        chunk.stitchMask = mask;
+    }
+
+    // front to back, so the depth test rejects as much as possible
+    std::sort(drawn.begin(), drawn.end(), [&](const SelectedChunk &a, const SelectedChunk &b) {
+        return distanceToChunk(settings, a.key, px, py) < distanceToChunk(settings, b.key, px, py);
+    });
+    selected = drawn;
+}
+
+// CPU check that a selection is watertight: every triangle edge lying on a chunk border has to be matched by
+// exactly the same edge on the other side, unless nothing is drawn there (the rim of the world).
+// Positions are compared as integer level 0 sample coordinates, the same way the chunks place their vertices.
+// Returns the number of unmatched border edges.
+inline int countSeamMismatches(const LODSettings &settings, const std::vector<SelectedChunk> &selected, unsigned int restart) {
+    typedef std::pair<long long, long long> GridPoint;
+    typedef std::pair<GridPoint, GridPoint> Segment;
+    const int quads = settings.quads, cols = quads + 1;
+
+    std::vector<std::vector<unsigned int>> variants(numStitchMasks);
+    for (int mask = 0; mask < numStitchMasks; ++mask) variants[mask] = stitchedStripIndices(quads, mask, restart);
+
+    std::unordered_set<ChunkKey, ChunkKeyHash> drawnSet;
+    for (auto &chunk : selected) drawnSet.insert(chunk.key);
+
+    // is the level 0 sample position (in half samples, to probe just outside a border) covered by a drawn chunk
+    auto covered = [&](long long hx, long long hy) {
+        for (int level = 0; level <= settings.maxLevel + 1; ++level) {
+            long long size = 2LL * quads << level;
+            ChunkKey key = { level, (int)std::floor((double)hx / size), (int)std::floor((double)hy / size) };
+            if (drawnSet.count(key)) return true;
+        }
+        return false;
+    };
+
+    std::map<Segment, int> borderEdges;
+    for (auto &chunk : selected) {
+        const ChunkKey &key = chunk.key;
+        auto toGrid = [&](unsigned int v) {
+            long long i = v % cols, j = v / cols;
+            return GridPoint((key.x * (long long)quads + i) << key.level, (key.y * (long long)quads + j) << key.level);
+        };
+        auto onBorder = [&](unsigned int a, unsigned int b) {
+            int ia = a % cols, ja = a / cols, ib = b % cols, jb = b / cols;
+            return (ia == ib && (ia == 0 || ia == quads)) || (ja == jb && (ja == 0 || ja == quads));
+        };
+        auto addEdge = [&](unsigned int a, unsigned int b) {
+            if (!onBorder(a, b)) return;
+            GridPoint pa = toGrid(a), pb = toGrid(b);
+            borderEdges[Segment(std::min(pa, pb), std::max(pa, pb))]++;
+        };
+        forEachStripTriangle(variants[chunk.stitchMask], restart, [&](unsigned int a, unsigned int b, unsigned int c) {
+            addEdge(a, b);
+            addEdge(b, c);
+            addEdge(c, a);
+        });
+    }
+
+    int mismatches = 0;
+    for (auto &edge : borderEdges) {
+        if (edge.second == 2) continue;
+        const GridPoint &a = edge.first.first, &b = edge.first.second;
+        // probe both sides of the edge midpoint, half a level 0 sample away
+        long long mx = a.first + b.first, my = a.second + b.second;
+        bool vertical = a.first == b.first;
+        bool sideA = vertical ? covered(mx - 1, my) : covered(mx, my - 1);
+        bool sideB = vertical ? covered(mx + 1, my) : covered(mx, my + 1);
+        if (sideA && sideB) ++mismatches;
+    }
+    return mismatches;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef TEXTUREARRAY_H
+#define TEXTUREARRAY_H
+
+#include "utility.h"
+
+// a GL_TEXTURE_2D_ARRAY, the layers share their size, format and mip chain and a shader picks one
+// by index, so several textures are bound as one (see TextureLoader::textureArray)
+class TextureArray {
+public:
+    GLenum internal_format = GL_RGBA8;
+    int width = 0, height = 0, layers = 0, levels = 0;
+
+private:
+    GLuint _id = 0;
+
+public:
+    TextureArray() {
+        glGenTextures(1, &_id);
+    }
+
+    TextureArray(const TextureArray&) = delete;
+    TextureArray &operator=(const TextureArray&) = delete;
+
+    ~TextureArray() {
+        glDeleteTextures(1, &_id);
+    }
+
+    void bind() const { glBindTexture(GL_TEXTURE_2D_ARRAY, _id); }
+    void unbind() const { glBindTexture(GL_TEXTURE_2D_ARRAY, 0); }
+
+    GLuint id() const { return _id; }
+};
+
+#endif
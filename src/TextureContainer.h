@@ -0,0 +1,88 @@
+#ifndef TEXTURECONTAINER_H
+#define TEXTURECONTAINER_H
+
+#include "BlockCompression.h"
+#include "ImageCache.h"
+
+#include <map>
+
+// one file holding every baked texture of the world (see bake/), memory mapped at runtime
+//
+//   ContainerHeader
+//   ContainerEntry[count]
+//   the levels of every entry back to back, level 0 first, each level a whole number of blocks
+//
+// the entries are named after the PNG they were baked from (without its directory), e.g. "grass.png"
+
+struct ContainerHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct ContainerEntry {
+    char name[64];
+    uint32_t format; ///< a BlockFormat
+    uint32_t width, height, levels;
+    uint64_t offset; ///< from the start of the file
+    uint64_t bytes;  ///< all the levels
+};
+
+static_assert(sizeof(ContainerHeader) == 16 && sizeof(ContainerEntry) == 96, "the container layout is fixed");
+
+const uint32_t containerVersion = 1;
+
+inline int containerLevelWidth(const ContainerEntry &entry, int level) { return std::max(1, (int)entry.width >> level); }
+inline int containerLevelHeight(const ContainerEntry &entry, int level) { return std::max(1, (int)entry.height >> level); }
+
+inline size_t containerLevelOffset(const ContainerEntry &entry, int level) {
+    size_t offset = 0;
+    for (int l = 0; l < level; ++l) {
+        offset += compressedSize((BlockFormat)entry.format, containerLevelWidth(entry, l), containerLevelHeight(entry, l));
+    }
+    return offset;
+}
+
+// the name an entry is stored under
+inline std::string containerName(const std::string &file) {
+    size_t slash = file.find_last_of("/\\");
+    return slash == std::string::npos ? file : file.substr(slash + 1);
+}
+
+class TextureContainer {
+private:
+    MappedFile file;
+    std::map<std::string, const ContainerEntry*> entries;
+
+public:
+    bool open(const std::string &path) {
+        if (!file.open(path) || file.size < sizeof(ContainerHeader)) return false;
+        const ContainerHeader *header = (const ContainerHeader*)file.data;
+        if (memcmp(header->magic, "VWTX", 4) != 0 || header->version != containerVersion ||
+            file.size < sizeof(ContainerHeader) + header->count * sizeof(ContainerEntry)) return false;
+
+        const ContainerEntry *list = (const ContainerEntry*)(file.data + sizeof(ContainerHeader));
+        for (uint32_t i = 0; i < header->count; ++i) {
+            const ContainerEntry &entry = list[i];
+            bool valid = (entry.format == BLOCK_BC1 || entry.format == BLOCK_BC3) && entry.levels > 0 &&
+                         entry.offset + entry.bytes <= file.size && containerLevelOffset(entry, entry.levels) == entry.bytes;
+            if (valid) entries[std::string(entry.name, strnlen(entry.name, sizeof(entry.name)))] = &entry;
+        }
+        return true;
+    }
+
+    // null if there is no such entry
+    const ContainerEntry* find(const std::string &name) const {
+        auto it = entries.find(name);
+        return it == entries.end() ? nullptr : it->second;
+    }
+
+    const unsigned char* level(const ContainerEntry &entry, int level) const {
+        return file.data + entry.offset + containerLevelOffset(entry, level);
+    }
+
+    size_t size() const { return entries.size(); }
+};
+
+#endif
@@ -0,0 +1,306 @@
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include "utility.h"
+#include "CompressedTexture.h"
+#include "ImageCache.h"
+#include "TextureArray.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <map>
+
+// loads every texture of the world at once
+//
+// Textures baked into the container (see bake/) are uploaded compressed straight from its mapping.
+// The other PNGs are decoded (or their cache entries mapped, see ImageCache.h) in parallel on worker threads, then
+// staged in a single pixel unpack buffer that the workers fill while it is mapped. The textures are created
+// from that buffer when their owners ask for them, and release() drops the staging memory once they all have.
+// If the buffer cannot be mapped, the textures are created from the loaded pixels in client memory instead.
+class TextureLoader {
+public:
+    struct Stats {
+        int loaded = 0;
+        int fromCache = 0;
+        int compressed = 0;    ///< from the baked container
+        double loadMs = 0.0;   ///< decoding or mapping, on the workers
+        double stageMs = 0.0;  ///< copying into the pixel buffer
+        double uploadMs = 0.0; ///< creating the textures from the pixel buffer
+        double totalMs() const { return loadMs + stageMs + uploadMs; }
+    };
+
+    Stats stats;
+
+private:
+    struct Entry {
+        TextureImage image;
+        size_t offset; ///< in the staging buffer, if there is one
+    };
+    std::map<std::string, Entry> entries;
+    GLuint staging = 0;
+    TextureContainer container;
+    bool useContainer = false;
+
+public:
+    // files with mipmaps get their full mip chain, the others only level 0
+    TextureLoader(const std::vector<std::string> &mipmapped, const std::vector<std::string> &single,
+                  const std::string &cacheDir = "texture_cache", const std::string &containerFile = "textures.vwtx",
+                  unsigned int numThreads = 0) {
+        useContainer = compressedTexturesSupported() && container.open(containerFile);
+
+        std::vector<std::pair<std::string, bool>> files;
+        for (const std::string &file : mipmapped) {
+            if (!baked(file)) files.push_back(std::make_pair(file, true));
+        }
+        for (const std::string &file : single) {
+            if (!baked(file)) files.push_back(std::make_pair(file, false));
+        }
+
+        ThreadPool pool(numThreads);
+        std::vector<TextureImage> images(files.size());
+        std::vector<char> ok(files.size());
+        auto start = std::chrono::steady_clock::now();
+        pool.parallelFor(0, (int)files.size(), 1, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) ok[i] = loadImage(files[i].first, cacheDir, files[i].second, images[i]);
+        });
+        stats.loadMs = msSince(start);
+
+        size_t total = 0;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (!ok[i]) continue;
+            Entry &entry = entries[files[i].first];
+            entry.image = std::move(images[i]);
+            entry.offset = total;
+            // keep every image aligned for the unpack alignment and for fast copies
+            total += (entry.image.bytes + 63) & ~(size_t)63;
+            stats.loaded++;
+            stats.fromCache += entry.image.fromCache ? 1 : 0;
+        }
+
+        // nothing to stage when the container had everything
+        if (total == 0) return;
+
+        start = std::chrono::steady_clock::now();
+        glGenBuffers(1, &staging);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, total, nullptr, GL_STREAM_DRAW);
+        unsigned char *mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total,
+                                                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!mapped) {
+            // the textures are then created from the decoded pixels or the cache mappings in client memory
+            std::cout << "textures: could not map the staging buffer, uploading from client memory" << std::endl;
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glDeleteBuffers(1, &staging);
+            staging = 0;
+            stats.stageMs = msSince(start);
+            return;
+        }
+        std::vector<Entry*> list;
+        for (auto &e : entries) list.push_back(&e.second);
+        pool.parallelFor(0, (int)list.size(), 1, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                memcpy(mapped + list[i]->offset, list[i]->image.pixels, list[i]->image.bytes);
+                // the pixels are in the buffer now, the decoded copy or the mapping can go
+                list[i]->image.decoded = std::vector<unsigned char>();
+                list[i]->image.mapped.reset();
+                list[i]->image.pixels = nullptr;
+            }
+        });
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        stats.stageMs = msSince(start);
+    }
+
+    ~TextureLoader() {
+        release();
+    }
+
+    // a 2D texture with the levels that were loaded, null if the file could not be loaded
+    std::unique_ptr<GenericTexture> texture(const std::string &file) {
+        if (const ContainerEntry *entry = baked(file)) {
+            auto start = std::chrono::steady_clock::now();
+            std::unique_ptr<GenericTexture> texture(new CompressedTexture(container, *entry));
+            stats.uploadMs += msSince(start);
+            stats.loaded++;
+            stats.compressed++;
+            return texture;
+        }
+
+        auto it = entries.find(file);
+        if (it == entries.end()) {
+            std::cout << "texture " << file << " was not loaded" << std::endl;
+            return nullptr;
+        }
+        auto start = std::chrono::steady_clock::now();
+        const TextureImage &image = it->second.image;
+        std::unique_ptr<RGBA8Texture> texture(new RGBA8Texture());
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+        texture->upload_raw(image.width, image.height, pixelOffset(it->second, 0));
+        texture->bind();
+        for (int l = 1; l < image.levels; ++l) {
+            glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8, image.levelWidth(l), image.levelHeight(l), 0, GL_RGBA,
+                         GL_UNSIGNED_BYTE, pixelOffset(it->second, l));
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels - 1);
+        texture->unbind();
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        stats.uploadMs += msSince(start);
+        return texture;
+    }
+
+    // one array with a layer per file, in order, null unless they all have the same format (either all baked in the
+    // container or all decoded) and all or none have a mip chain. Decoded layers of another size are resampled to
+    // the largest one, baked layers have to be baked at the same size (see `bake --size`)
+    std::unique_ptr<TextureArray> textureArray(const std::vector<std::string> &files) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<const ContainerEntry*> inContainer(files.size());
+        std::vector<const Entry*> decoded(files.size());
+        for (size_t i = 0; i < files.size(); ++i) {
+            inContainer[i] = baked(files[i]);
+            auto it = entries.find(files[i]);
+            if (it != entries.end()) decoded[i] = &it->second;
+            if (!inContainer[i] && !decoded[i]) {
+                std::cout << "texture " << files[i] << " was not loaded" << std::endl;
+                return nullptr;
+            }
+        }
+
+        std::unique_ptr<TextureArray> array(new TextureArray());
+        array->layers = (int)files.size();
+        if (inContainer[0]) {
+            const ContainerEntry &first = *inContainer[0];
+            for (const ContainerEntry *entry : inContainer) {
+                if (!entry || entry->format != first.format || entry->width != first.width ||
+                    entry->height != first.height || entry->levels != first.levels) return layerMismatch(files);
+            }
+            array->internal_format = compressedInternalFormat(first.format);
+            array->width = first.width;
+            array->height = first.height;
+            array->levels = first.levels;
+            array->bind();
+            for (int l = 0; l < array->levels; ++l) {
+                int w = containerLevelWidth(first, l), h = containerLevelHeight(first, l);
+                GLsizei bytes = (GLsizei)compressedSize((BlockFormat)first.format, w, h);
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, l, array->internal_format, w, h, array->layers, 0,
+                                       bytes * array->layers, nullptr);
+                for (int i = 0; i < array->layers; ++i) {
+                    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, i, w, h, 1, array->internal_format, bytes,
+                                              container.level(*inContainer[i], l));
+                }
+            }
+            stats.compressed += array->layers;
+        } else {
+            // the array takes the size of its largest layer, the smaller ones are resampled to it
+            const TextureImage *largest = &decoded[0]->image;
+            for (const Entry *entry : decoded) {
+                if (!entry) return layerMismatch(files);
+                if ((entry->image.levels > 1) != (largest->levels > 1)) return layerMismatch(files);
+                if (entry->image.width * entry->image.height > largest->width * largest->height) largest = &entry->image;
+            }
+            const TextureImage &first = *largest;
+            std::vector<TextureImage> resampled(files.size());
+            for (size_t i = 0; i < files.size(); ++i) {
+                const TextureImage &image = decoded[i]->image;
+                if (image.width == first.width && image.height == first.height) continue;
+                resampleImage(levelZero(*decoded[i]).data(), image.width, image.height, first.width, first.height,
+                              first.levels > 1, resampled[i]);
+            }
+            array->width = first.width;
+            array->height = first.height;
+            array->levels = first.levels;
+            array->bind();
+            for (int l = 0; l < array->levels; ++l) {
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, l, GL_RGBA8, first.levelWidth(l), first.levelHeight(l), array->layers,
+                             0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                for (int i = 0; i < array->layers; ++i) {
+                    // the resampled layers come from client memory, the others from the staging buffer
+                    const TextureImage &layer = resampled[i];
+                    const GLvoid *pixels = layer.pixels ? layer.pixels + layer.levelOffset(l) : pixelOffset(*decoded[i], l);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, layer.pixels ? 0 : staging);
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, i, first.levelWidth(l), first.levelHeight(l), 1,
+                                    GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+                }
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array->levels - 1);
+        array->unbind();
+        stats.loaded += array->layers;
+        stats.uploadMs += msSince(start);
+        return array;
+    }
+
+    // level 0 of one loaded file into the given target of the bound texture, e.g. a cubemap face
+    bool uploadFace(GLenum target, const std::string &file) {
+        if (const ContainerEntry *entry = baked(file)) {
+            auto start = std::chrono::steady_clock::now();
+            uploadCompressedFace(target, container, *entry);
+            stats.uploadMs += msSince(start);
+            stats.loaded++;
+            stats.compressed++;
+            return true;
+        }
+
+        auto it = entries.find(file);
+        if (it == entries.end()) {
+            std::cout << "texture " << file << " was not loaded" << std::endl;
+            return false;
+        }
+        auto start = std::chrono::steady_clock::now();
+        const TextureImage &image = it->second.image;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+        glTexImage2D(target, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixelOffset(it->second, 0));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        stats.uploadMs += msSince(start);
+        return true;
+    }
+
+    // frees the staging buffer, call once every texture has been created
+    void release() {
+        if (staging) glDeleteBuffers(1, &staging);
+        staging = 0;
+        entries.clear();
+    }
+
+    void printStats() const {
+        std::cout << "textures: " << stats.loaded << " loaded (" << stats.compressed << " baked, " << stats.fromCache << " from cache) in "
+                  << stats.totalMs() << " ms: load " << stats.loadMs << " ms, stage " << stats.stageMs
+                  << " ms, upload " << stats.uploadMs << " ms" << std::endl;
+    }
+
+private:
+    const ContainerEntry* baked(const std::string &file) const {
+        return useContainer ? container.find(containerName(file)) : nullptr;
+    }
+
+    static std::unique_ptr<TextureArray> layerMismatch(const std::vector<std::string> &files) {
+        std::cout << "texture array:";
+        for (const std::string &file : files) std::cout << " " << file;
+        std::cout << " differ in size, mip levels or format" << std::endl;
+        return nullptr;
+    }
+
+    // level 0 of a loaded image, read back from the staging buffer once the pixels are in there
+    std::vector<unsigned char> levelZero(const Entry &entry) const {
+        const TextureImage &image = entry.image;
+        size_t bytes = 4 * (size_t)image.width * image.height;
+        if (!staging) return std::vector<unsigned char>(image.pixels, image.pixels + bytes);
+        std::vector<unsigned char> pixels(bytes);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+        glGetBufferSubData(GL_PIXEL_UNPACK_BUFFER, entry.offset, bytes, pixels.data());
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return pixels;
+    }
+
+    // an offset into the staging buffer, or a pointer to the pixels when there is none bound
+    const GLvoid* pixelOffset(const Entry &entry, int level) const {
+        if (!staging) return entry.image.pixels + entry.image.levelOffset(level);
+        return (const GLvoid*)(entry.offset + entry.image.levelOffset(level));
+    }
+
+    static double msSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+#endif
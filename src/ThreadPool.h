@@ -0,0 +1,124 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a small fixed-size pool of worker threads
+// the terrain code uses it to split tiles into row ranges and to build tiles in the background
+class ThreadPool {
+public:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping = false;
+
+public:
+    // 0 threads means one per hardware thread
+    explicit ThreadPool(unsigned int numThreads = 0) {
+        if (numThreads == 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int i = 0; i < numThreads; ++i) {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool &operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto &worker : workers) worker.join();
+    }
+
+    int size() const { return (int)workers.size(); }
+
+    // queue a task, the future becomes ready once it has run
+    std::future<void> submit(std::function<void()> task) {
+        auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+        std::future<void> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back([packaged]() { (*packaged)(); });
+        }
+        available.notify_one();
+        return result;
+    }
+
+    // calls body(begin, end) on sub ranges of [begin, end) of at least grain items and waits for all of them
+    // the calling thread takes part in the work so that nested calls from a worker cannot deadlock the pool
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body) {
+        if (end <= begin) return;
+        grain = std::max(1, grain);
+        int numChunks = std::min((end - begin + grain - 1) / grain, 4 * (size() + 1));
+        if (numChunks <= 1) {
+            body(begin, end);
+            return;
+        }
+
+        // helpers that only get scheduled after everything is done must not touch our stack, so the
+        // bookkeeping is shared and we wait for the chunks to finish rather than for the helpers
+        struct State {
+            std::atomic<int> next, done;
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        auto state = std::make_shared<State>();
+        state->next = 0;
+        state->done = 0;
+
+        int chunkSize = (end - begin + numChunks - 1) / numChunks;
+        const std::function<void(int, int)> *bodyPtr = &body;
+        auto work = [state, bodyPtr, begin, end, chunkSize, numChunks]() {
+            for (int c = state->next++; c < numChunks; c = state->next++) {
+                int b = begin + c * chunkSize;
+                int e = std::min(end, b + chunkSize);
+                if (b < e) (*bodyPtr)(b, e);
+                if (++state->done == numChunks) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        int numHelpers = std::min(size(), numChunks - 1);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int i = 0; i < numHelpers; ++i) tasks.push_back(work);
+        }
+        available.notify_all();
+        work();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&]() { return state->done == numChunks; });
+    }
+
+private:
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+#endif
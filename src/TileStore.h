@@ -0,0 +1,243 @@
+#ifndef TILESTORE_H
+#define TILESTORE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "ChunkData.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+// the terrain chunks of a world kept on disk, so a region that was visited before, in this run or an earlier one,
+// is mapped from the page cache instead of generated again. Nothing in here touches OpenGL.
+//
+// A world is its HeightfieldParams (the seed among them), the grid of its chunks and a variant for the stages after
+// the noise (the erosion, see Erosion.h). All of it goes into a key that names the directory of the world under the
+// root, and every chunk is one file in there named after its ChunkKey:
+// a TileHeader with the bounds, then what buildChunk makes, the (quads + 1)^2 TerrainVertex (the heights and the
+// normals as they are drawn) and the occluder grid, then the horizon map of the chunk if it has one (see Horizon.h).
+// The vertices start 64 bytes in, so a mapped tile is uploaded straight from the mapping, and so is its horizon map.
+// The splat weights are not stored, terrain_fshader.glsl derives them per fragment from the height and the normal.
+//
+// New tiles are written by one background thread to a temporary file renamed into place, like the image cache, so a
+// reader never maps half a tile and a crash never leaves one behind. A file whose header does not match (another
+// version, another world) is ignored and written again. Other stages keep their own files next to the chunks through
+// map and writeAsync.
+
+struct TileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t world;           ///< terrainWorldKey
+    int32_t level, x, y;
+    int32_t quads;
+    int32_t heightBase;
+    float minHeight, maxHeight;
+    int32_t clampedHeights;
+    uint32_t vertexBytes, occluderBytes;
+    uint32_t horizonBytes, horizonKey; ///< 0 for a tile without a horizon map, the tiles from before them included
+};
+
+static_assert(sizeof(TileHeader) == 64, "the tile layout is fixed");
+
+const uint32_t tileStoreVersion = 2;
+
+// FNV-1a over everything the chunks of a world depend on, the format of the vertices included
+inline uint64_t terrainWorldKey(const HeightfieldParams &params, int quads, float spacing, uint64_t variant = 0) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](const void *data, size_t bytes) {
+        const unsigned char *p = (const unsigned char*)data;
+        for (size_t i = 0; i < bytes; ++i) hash = (hash ^ p[i]) * 0x100000001b3ull;
+    };
+    mix(&params.H, sizeof(params.H));
+    mix(&params.offset, sizeof(params.offset));
+    mix(&params.lacunarity, sizeof(params.lacunarity));
+    mix(&params.octaves, sizeof(params.octaves));
+    mix(&params.frequency, sizeof(params.frequency));
+    mix(&params.seed, sizeof(params.seed));
+    mix(&quads, sizeof(quads));
+    mix(&spacing, sizeof(spacing));
+    mix(&terrainHeightStep, sizeof(terrainHeightStep));
+    mix(&chunkOccluderCells, sizeof(chunkOccluderCells));
+    mix(&variant, sizeof(variant));
+    return hash;
+}
+
+struct TileStoreStats {
+    std::atomic<int> tilesRead, tilesMissed, tilesWritten, writeFailures;
+    std::atomic<long long> bytesRead, bytesWritten;
+
+    TileStoreStats() : tilesRead(0), tilesMissed(0), tilesWritten(0), writeFailures(0), bytesRead(0), bytesWritten(0) {}
+};
+
+class TileStore {
+public:
+    std::string directory; ///< of this world, under the root
+    int quads;
+    uint64_t world;
+    TileStoreStats stats;
+
+private:
+    // declared last so the queued writes are done before anything they touch is destroyed
+    ThreadPool writer;
+
+public:
+    // variant is 0 for the chunks straight from the noise
+    TileStore(const std::string &root, const HeightfieldParams &params, int _quads, float spacing, uint64_t variant = 0)
+        : quads(_quads), world(terrainWorldKey(params, _quads, spacing, variant)), writer(1) {
+        char name[64];
+        snprintf(name, sizeof(name), "seed%u-%016llx", (unsigned int)params.seed, (unsigned long long)world);
+        directory = root + "/" + name;
+        makeDirectory(root);
+        makeDirectory(directory);
+    }
+
+    std::string path(const ChunkKey &key) const {
+        char name[64];
+        snprintf(name, sizeof(name), "/%d_%d_%d.vwtt", key.level, key.x, key.y);
+        return directory + name;
+    }
+
+    // maps the tile of key into chunk when it is on disk, thread safe. The vertices stay in the mapping (see
+    // ChunkData::vertexData) and are faulted in here, so the page faults happen on the calling worker and not in
+    // the upload on the GL thread
+    bool read(const ChunkKey &key, ChunkData &chunk) {
+        int cols = quads + 1;
+        size_t vertexBytes = (size_t)cols * cols * sizeof(TerrainVertex);
+        size_t occluderBytes = (size_t)(chunkOccluderCells + 1) * (chunkOccluderCells + 1) * sizeof(float);
+
+        std::unique_ptr<MappedFile> mapped(new MappedFile());
+        TileHeader header;
+        if (!mapped->open(path(key)) || mapped->size < sizeof(header)) {
+            stats.tilesMissed++;
+            return false;
+        }
+        memcpy(&header, mapped->data, sizeof(header));
+        if (memcmp(header.magic, "VWTT", 4) != 0 || header.version != tileStoreVersion || header.world != world ||
+            header.level != key.level || header.x != key.x || header.y != key.y || header.quads != quads ||
+            header.vertexBytes != vertexBytes || header.occluderBytes != occluderBytes ||
+            header.horizonBytes % (4 * cols * cols) != 0 ||
+            mapped->size != sizeof(header) + vertexBytes + occluderBytes + header.horizonBytes) {
+            stats.tilesMissed++;
+            return false;
+        }
+
+        unsigned int touched = 0;
+        for (size_t offset = 0; offset < mapped->size; offset += 4096) touched += mapped->data[offset];
+        volatile unsigned int sink = touched;
+        (void)sink;
+
+        chunk.key = key;
+        chunk.heightBase = header.heightBase;
+        chunk.minHeight = header.minHeight;
+        chunk.maxHeight = header.maxHeight;
+        chunk.clampedHeights = header.clampedHeights;
+        chunk.vertices.clear();
+        chunk.occluderHeights.resize(occluderBytes / sizeof(float));
+        memcpy(chunk.occluderHeights.data(), mapped->data + sizeof(header) + vertexBytes, occluderBytes);
+        chunk.mappedVertices = (const TerrainVertex*)(mapped->data + sizeof(header));
+        chunk.mappedCount = (size_t)cols * cols;
+        chunk.horizons.clear();
+        chunk.horizonKey = header.horizonBytes ? header.horizonKey : 0;
+        chunk.mappedHorizons = header.horizonBytes ? mapped->data + sizeof(header) + vertexBytes + occluderBytes : nullptr;
+        chunk.mappedHorizonBytes = header.horizonBytes;
+        stats.bytesRead += (long long)mapped->size;
+        chunk.mapped = std::move(mapped);
+        stats.tilesRead++;
+        return true;
+    }
+
+    // queues a tile that was just built, it is copied so the chunk can go on to the upload straight away
+    void write(const ChunkData &chunk) {
+        TileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "VWTT", 4);
+        header.version = tileStoreVersion;
+        header.world = world;
+        header.level = chunk.key.level;
+        header.x = chunk.key.x;
+        header.y = chunk.key.y;
+        header.quads = quads;
+        header.heightBase = chunk.heightBase;
+        header.minHeight = chunk.minHeight;
+        header.maxHeight = chunk.maxHeight;
+        header.clampedHeights = chunk.clampedHeights;
+        header.vertexBytes = (uint32_t)(chunk.vertexCount() * sizeof(TerrainVertex));
+        header.occluderBytes = (uint32_t)(chunk.occluderHeights.size() * sizeof(float));
+        header.horizonBytes = (uint32_t)chunk.horizonBytes();
+        header.horizonKey = chunk.horizonKey;
+
+        auto bytes = std::make_shared<std::vector<unsigned char>>(sizeof(header) + header.vertexBytes +
+                                                                  header.occluderBytes + header.horizonBytes);
+        unsigned char *p = bytes->data();
+        memcpy(p, &header, sizeof(header));
+        memcpy(p + sizeof(header), chunk.vertexData(), header.vertexBytes);
+        memcpy(p + sizeof(header) + header.vertexBytes, chunk.occluderHeights.data(), header.occluderBytes);
+        if (header.horizonBytes) {
+            memcpy(p + sizeof(header) + header.vertexBytes + header.occluderBytes, chunk.horizonData(), header.horizonBytes);
+        }
+
+        queueWrite(path(chunk.key), bytes);
+    }
+
+    // any other file of the world, name is relative to its directory. Null when it is not there
+    std::unique_ptr<MappedFile> map(const std::string &name) {
+        std::unique_ptr<MappedFile> mapped(new MappedFile());
+        if (!mapped->open(directory + "/" + name)) return nullptr;
+        stats.bytesRead += (long long)mapped->size;
+        return mapped;
+    }
+
+    // queues the bytes of a file of the world, written like the tiles
+    void writeAsync(const std::string &name, std::shared_ptr<std::vector<unsigned char>> bytes) {
+        queueWrite(directory + "/" + name, bytes);
+    }
+
+    // waits for the writes queued so far
+    void flush() {
+        writer.submit([]() {}).wait();
+    }
+
+private:
+    void queueWrite(const std::string &file, std::shared_ptr<std::vector<unsigned char>> bytes) {
+        writer.submit([this, bytes, file]() {
+            if (writeFile(file, *bytes)) {
+                stats.tilesWritten++;
+                stats.bytesWritten += (long long)bytes->size();
+            } else {
+                stats.writeFailures++;
+            }
+        });
+    }
+
+    static void makeDirectory(const std::string &dir) {
+#ifdef _WIN32
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+    }
+
+    static bool writeFile(const std::string &file, const std::vector<unsigned char> &bytes) {
+        std::string temporary = file + ".tmp";
+        FILE *f = fopen(temporary.c_str(), "wb");
+        if (!f) return false;
+        bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+        ok = (fclose(f) == 0) && ok;
+        remove(file.c_str());
+        ok = ok && rename(temporary.c_str(), file.c_str()) == 0;
+        if (!ok) remove(temporary.c_str());
+        return ok;
+    }
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef UNIFORMBLOCKS_H
+#define UNIFORMBLOCKS_H
+
+#include "utility.h"
+
+#include <string>
+
+// Uniform buffers for everything the programs share. The camera of a pass and the constants of the world are
+// written once into buffers that every program reads, instead of being pushed through Shader::set_uniform by name
+// into each program on each draw.
+
+const char* const uniform_blocks =
+#include "uniform_blocks.glsl"
+;
+
+// binding points of GL_UNIFORM_BUFFER
+enum UniformBinding {
+    CAMERA_BINDING = 0,
+    MATERIAL_BINDING = 1
+};
+
+// std140 mirrors of the blocks in uniform_blocks.glsl
+struct CameraBlock {
+    float V[16];
+    float P[16];
+    float viewPos[3];
+    float time;
+    float clipPlaneNormal[3];
+    float clipPlaneHeight;
+};
+
+struct MaterialBlock {
+    float skyColor[3];
+    float waterHeight;
+    float lightPos[3];
+    float padding;
+};
+
+static_assert(sizeof(CameraBlock) == 160 && sizeof(MaterialBlock) == 32, "the blocks follow the std140 layout");
+
+// the blocks go right after the #version line of a shader
+inline std::string withUniformBlocks(const char *source) {
+    std::string code = source;
+    size_t version = code.find("#version");
+    size_t line = version == std::string::npos ? 0 : code.find('\n', version) + 1;
+    return code.substr(0, line) + uniform_blocks + code.substr(line);
+}
+
+// points the blocks a program uses at their buffers, call once after linking
+inline void bindUniformBlocks(Shader &shader) {
+    shader.bind_uniform_block("Camera", CAMERA_BINDING);
+    shader.bind_uniform_block("Material", MATERIAL_BINDING);
+}
+
+// the buffers behind the blocks: one camera slot per pass of the frame, and the material
+class FrameUniforms {
+private:
+    GLuint cameraBuffer = 0, materialBuffer = 0;
+    GLsizeiptr slotSize = 0;
+    int passes;
+
+public:
+    explicit FrameUniforms(int _passes) : passes(_passes) {
+        // every slot starts at a multiple of the offset alignment so that it can be bound as a range
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        slotSize = ((GLsizeiptr)sizeof(CameraBlock) + alignment - 1) / alignment * alignment;
+
+        glGenBuffers(1, &cameraBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, slotSize * passes, nullptr, GL_DYNAMIC_DRAW);
+
+        glGenBuffers(1, &materialBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(MaterialBlock), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BINDING, materialBuffer);
+    }
+
+    FrameUniforms(const FrameUniforms&) = delete;
+    FrameUniforms &operator=(const FrameUniforms&) = delete;
+
+    ~FrameUniforms() {
+        glDeleteBuffers(1, &cameraBuffer);
+        glDeleteBuffers(1, &materialBuffer);
+    }
+
+    void setMaterial(const Vec3 &skyColor, const Vec3 &lightPos, float waterHeight) {
+        MaterialBlock block;
+        copy(skyColor, block.skyColor);
+        copy(lightPos, block.lightPos);
+        block.waterHeight = waterHeight;
+        block.padding = 0.0f;
+        glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // writes the camera of a pass into its slot and binds it, the draws after this see that camera
+    void setPass(int pass, const Mat4x4 &view, const Mat4x4 &projection, const Vec3 &viewPos, float time,
+                 const Vec3 &clipPlaneNormal, float clipPlaneHeight) {
+        assert(pass >= 0 && pass < passes);
+        CameraBlock block;
+        memcpy(block.V, view.data(), sizeof(block.V));
+        memcpy(block.P, projection.data(), sizeof(block.P));
+        copy(viewPos, block.viewPos);
+        block.time = time;
+        copy(clipPlaneNormal, block.clipPlaneNormal);
+        block.clipPlaneHeight = clipPlaneHeight;
+        glBindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, pass * slotSize, sizeof(block), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BINDING, cameraBuffer, pass * slotSize, sizeof(block));
+    }
+
+private:
+    static void copy(const Vec3 &v, float *out) {
+        out[0] = v.x();
+        out[1] = v.y();
+        out[2] = v.z();
+    }
+};
+
+#endif
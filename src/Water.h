@@ -3,12 +3,16 @@
 
 #include "utility.h"
 #include "Camera.h"
+#include "Ocean.h"
+#include "ShaderCache.h"
+#include "TextureLoader.h"
+#include "UniformBlocks.h"
 
-const char* water_vshader =
+const char* const water_vshader =
 #include "water_vshader.glsl"
 ;
 
-const char* water_fshader =
+const char* const water_fshader =
 #include "water_fshader.glsl"
 ;
 
@@ -19,115 +23,133 @@ public:
 
     Mat4x4 M = Mat4x4::Identity(); // the model is an identity => we displace manually
 
-    std::unique_ptr<Framebuffer> reflectionFBO;
-    std::unique_ptr<Framebuffer> refractionFBO;
-    std::unique_ptr<RGBA8Texture> reflectionTexture;
-    std::unique_ptr<RGBA8Texture> refractionTexture;
-    std::unique_ptr<D16Texture> reflectionDepthTexture;
-    std::unique_ptr<D16Texture> refractionDepthTexture;
+    // the reflection and the refraction are drawn by passes of the render graph of World, into its textures
+    // (see RenderGraph.h), make them slightly smaller so that the rendering is faster
+    // these are the sizes at scale 1, WaterQuality scales them to the frame time (see WaterQuality.h)
+    const int reflectionBaseWidth = 640, reflectionBaseHeight = 360;
+    const int refractionBaseWidth = 320, refractionBaseHeight = 180;
+    int reflectionWidth = reflectionBaseWidth, reflectionHeight = reflectionBaseHeight;
+    int refractionWidth = refractionBaseWidth, refractionHeight = refractionBaseHeight;
 
-    // make the FBO slightly smaller so that the rendering is faster
-    int reflectionWidth = 640, reflectionHeight = 360;
-    int refractionWidth = 320, refractionHeight = 180;
+    // the projection * view of the (mirrored) camera the reflection texture was rendered with, the water projects
+    // its surface with it to sample the reflection, so a reflection from an earlier frame still lines up
+    Mat4x4 reflectionProjectionView = Mat4x4::Identity();
+    GLint reflectionProjectionViewLocation = -1;
 
     // water.png texture
-    std::unique_ptr<RGBA8Texture> waterTexture;
+    std::unique_ptr<GenericTexture> waterTexture;
 
-public:
-    Water(float size_grid_x, float size_grid_y, float waterHeight) {
-        waterShader = std::unique_ptr<Shader>(new Shader());
-        waterShader->verbose = true;
-        waterShader->add_vshader_from_source(water_vshader);
-        waterShader->add_fshader_from_source(water_fshader);
-        waterShader->link();
-
-        waterMesh = std::unique_ptr<GPUMesh>(new GPUMesh());
-        std::vector<Vec3> points;
-        std::vector<unsigned int> indices = {0, 2, 1, 2, 3, 1};
-        std::vector<Vec2> texCoords;
+    // the waves, their maps displace the grid and give the water its normals
+    std::unique_ptr<Ocean> ocean;
 
-        // values so that the corners are (x, y) (-x, y), (x, -y), (-x, -y)
-        // we translate the water height in the shader itself... so we need a z=0 quad...
-        // we dont need the water quad to cover the whole space, we can just cover 3/4 of it...
-        float x = (3.0/4.0 * size_grid_x) / 2.0;
-        float y = (3.0/4.0 * size_grid_y) / 2.0;
-        points.push_back(Vec3(-x, -y, waterHeight)); texCoords.push_back(Vec2(0, 0));
-        points.push_back(Vec3(-x,  y, waterHeight)); texCoords.push_back(Vec2(0, 1));
-        points.push_back(Vec3( x, -y, waterHeight)); texCoords.push_back(Vec2(1, 0));
-        points.push_back(Vec3( x,  y, waterHeight)); texCoords.push_back(Vec2(1, 1));
+    // the grid follows the camera, gridResolution vertices on a side over gridExtent on either side of it,
+    // spaced gridFine apart at the camera and further apart towards the edge
+    const int gridResolution = 128;
+    const float gridFine = 0.25f; ///< of the average spacing
+    float gridExtent = 0.0f;
+    float gridSnap = 0.0f;        ///< the spacing at the camera
 
-        waterMesh->set_vbo<Vec3>("vposition", points);
-        waterMesh->set_triangles(indices);
-        waterMesh->set_vtexcoord(texCoords);
-
-        // create and load up textures to reflection FBO 
-        reflectionFBO = std::unique_ptr<Framebuffer>(new Framebuffer());
-        // create and attach the reflection Texture
-        reflectionTexture = std::unique_ptr<RGBA8Texture>((new RGBA8Texture()));
-        reflectionTexture->allocate(reflectionWidth, reflectionHeight);
-        // set up how to interpolate the textures
-        glActiveTexture(GL_TEXTURE0);
-        reflectionTexture->bind();
-        // required as no mipmap
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-        reflectionFBO->attach_color_texture(*reflectionTexture);
-        // create and attach the depth texture
-        reflectionDepthTexture = std::unique_ptr<D16Texture>((new D16Texture()));
-        reflectionDepthTexture->allocate(reflectionWidth, reflectionHeight);
-        reflectionFBO->attach_depth_texture(*reflectionDepthTexture);
-
-        // create and loadup textures to refraction FBO
-        refractionFBO = std::unique_ptr<Framebuffer>(new Framebuffer());
-        // create and attach the refraction Texture
-        refractionTexture = std::unique_ptr<RGBA8Texture>((new RGBA8Texture()));
-        refractionTexture->allocate(refractionWidth, refractionHeight);
-        glActiveTexture(GL_TEXTURE1);
-        refractionTexture->bind();
-        // required as no mipmap
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-        refractionFBO->attach_color_texture(*refractionTexture);
-        // create and attach the depth texture
-        refractionDepthTexture = std::unique_ptr<D16Texture>((new D16Texture()));
-        refractionDepthTexture->allocate(refractionWidth, refractionHeight);
-        refractionFBO->attach_depth_texture(*refractionDepthTexture);
+public:
+    // the program was requested as "water" (see ShaderCache.h)
+    Water(float size_grid_x, float size_grid_y, float waterHeight, TextureLoader &textures, ShaderCache &shaders) {
+        waterShader = shaders.take("water");
 
+        // the water does not need to cover the whole space, 3/4 of the terrain around the camera is enough
+        gridExtent = (3.0/4.0 * std::max(size_grid_x, size_grid_y)) / 2.0;
+        buildGrid(waterHeight);
+        ocean = std::unique_ptr<Ocean>(new Ocean());
 
         // load water texture from water.png
-        std::string name = "water.png";
-        loadTexture(waterTexture, name.c_str());
+        waterTexture = textures.texture("water.png");
         waterTexture->bind();
-        glGenerateMipmap(GL_TEXTURE_2D);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        // the camera and the time come from the Camera block (see UniformBlocks.h), the rest never changes
+        waterShader->bind();
+        waterShader->set_uniform("M", M);
+        waterShader->set_uniform("reflectionTexture", 0);
+        waterShader->set_uniform("refractionTexture", 1);
+        waterShader->set_uniform("waterTexture", 2);
+        waterShader->set_uniform("displacementMap", 3);
+        waterShader->set_uniform("normalMap", 4);
+        waterShader->set_uniform("patchSize", ocean->params().patchSize);
+        waterShader->set_uniform("gridExtent", gridExtent);
+        waterShader->set_uniform("gridSnap", gridSnap);
+        reflectionProjectionViewLocation = waterShader->uniform_location("reflectionProjectionView");
+        // the vertex array keeps the attributes
+        waterMesh->set_attributes(*waterShader);
+        waterShader->unbind();
     }
 
 
-    void draw(Camera camera, float time) {
+    // another simulation, for another size of the maps
+    void setOcean(const OceanParams &params) {
+        ocean = std::unique_ptr<Ocean>(new Ocean(params));
         waterShader->bind();
+        waterShader->set_uniform("patchSize", params.patchSize);
+        waterShader->unbind();
+    }
 
-        waterShader->set_uniform("M", M);
-        waterShader->set_uniform("V", camera.viewMatrix());
-        waterShader->set_uniform("P", camera.projectionMatrix());
-        waterShader->set_uniform("viewPos", camera.cameraPos);
-        waterShader->set_uniform("time", time);
+    // the sizes of the reflection and the refraction at scales of the base sizes, World resizes the textures of
+    // its render graph to them. Returns true if the reflection changed size, its content is gone then
+    bool setScale(float reflectionScale, float refractionScale) {
+        int w = std::max(1, (int)(reflectionScale * reflectionBaseWidth)), h = std::max(1, (int)(reflectionScale * reflectionBaseHeight));
+        bool reflectionResized = w != reflectionWidth || h != reflectionHeight;
+        reflectionWidth = w;
+        reflectionHeight = h;
+        refractionWidth = std::max(1, (int)(refractionScale * refractionBaseWidth));
+        refractionHeight = std::max(1, (int)(refractionScale * refractionBaseHeight));
+        return reflectionResized;
+    }
 
-        glActiveTexture(GL_TEXTURE0);
-        reflectionTexture->bind();
-        waterShader->set_uniform("reflectionTexture", 0);
+private:
+    // the z of the vertices is the water height, the shader moves the grid to the camera and displaces it
+    void buildGrid(float waterHeight) {
+        waterMesh = std::unique_ptr<GPUMesh>(new GPUMesh());
+        std::vector<Vec3> points;
+        std::vector<Vec2> texCoords;
+        std::vector<unsigned int> indices;
+
+        // t in [-1, 1] to an offset whose spacing grows linearly from the camera to the edge
+        auto offset = [&](float t) { return gridExtent * (gridFine * t + (1.0f - gridFine) * t * std::abs(t)); };
+        gridSnap = gridExtent * gridFine * 2.0f / (gridResolution - 1);
+        for (int j = 0; j < gridResolution; ++j) {
+            for (int i = 0; i < gridResolution; ++i) {
+                float u = (float)i / (gridResolution - 1), v = (float)j / (gridResolution - 1);
+                points.push_back(Vec3(offset(2.0f * u - 1.0f), offset(2.0f * v - 1.0f), waterHeight));
+                // water.png stretches over the grid like it did over the quad
+                texCoords.push_back(Vec2(u, v));
+            }
+        }
+        for (int j = 0; j + 1 < gridResolution; ++j) {
+            for (int i = 0; i + 1 < gridResolution; ++i) {
+                unsigned int a = j * gridResolution + i, b = a + 1, c = a + gridResolution, d = c + 1;
+                indices.insert(indices.end(), { a, b, c, b, d, c });
+            }
+        }
 
-        glActiveTexture(GL_TEXTURE1);
-        refractionTexture->bind();
-        waterShader->set_uniform("refractionTexture", 1);
+        waterMesh->set_vbo<Vec3>("vposition", points);
+        waterMesh->set_triangles(indices);
+        waterMesh->set_vtexcoord(texCoords);
+    }
+
+public:
+
+    void draw(GenericTexture &reflection, GenericTexture &refraction) {
+        waterShader->bind();
+        waterShader->set_uniform(reflectionProjectionViewLocation, reflectionProjectionView);
 
+        glActiveTexture(GL_TEXTURE0);
+        reflection.bind();
+        glActiveTexture(GL_TEXTURE1);
+        refraction.bind();
         glActiveTexture(GL_TEXTURE2);
         waterTexture->bind();
-        waterShader->set_uniform("waterTexture", 2);
+        ocean->bind(3);
 
-        waterMesh->set_attributes(*waterShader);
         waterMesh->draw();
 
         waterShader->unbind();
@@ -0,0 +1,110 @@
+#ifndef WATERQUALITY_H
+#define WATERQUALITY_H
+
+#include "utility.h"
+#include "Camera.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The reflection and the refraction are two extra passes over the scene, and the water shader offsets both of them
+// along the normals of the ocean waves (see water_fshader.glsl), which hides a lower resolution, so they are the
+// first thing to give up when a frame takes too long. WaterQuality follows the frame times the profiler resolves
+// and walks a ladder of FBO sizes and reflection refresh rates to stay under a target. Between two renders of the
+// reflection the water reprojects the old one with the camera it was rendered with (see
+// Water::reflectionProjectionView).
+
+// one step of the ladder
+struct WaterQualityLevel {
+    float reflectionScale;  ///< of Water::reflectionBaseWidth/Height
+    float refractionScale;  ///< of Water::refractionBaseWidth/Height
+    int reflectionInterval; ///< frames between two renders of the reflection while the camera moves
+};
+
+// from the best to the cheapest: the refraction shrinks first (it is seen through the reflection), then the
+// reflection, then the reflection is refreshed less often
+const WaterQualityLevel waterQualityLevels[] = {
+    { 1.5f,   1.5f,   1 },
+    { 1.0f,   1.0f,   1 }, // the sizes the FBOs always had
+    { 1.0f,   0.75f,  1 },
+    { 0.75f,  0.5f,   1 },
+    { 0.75f,  0.5f,   2 },
+    { 0.5f,   0.5f,   2 },
+    { 0.5f,   0.5f,   3 },
+    { 0.375f, 0.375f, 4 },
+};
+const int numWaterQualityLevels = sizeof(waterQualityLevels) / sizeof(waterQualityLevels[0]);
+const int defaultWaterQualityLevel = 1;
+
+class WaterQuality {
+public:
+    double targetFrameMs = 0.0; ///< 0 disables the controller: default level, the reflection rendered every frame
+    double smoothing = 0.1;     ///< weight of a new frame in the average frame time
+    double lowerAbove = 1.05;   ///< of the target, the average above this goes one level down
+    double raiseBelow = 0.7;    ///< of the target, the average below this goes one level up
+    int settleFrames = 30;      ///< frames between two changes, the profiler is two frames behind
+
+    // a camera that moved less than this since the last render of the reflection reuses it
+    float stillDistance = 0.02f;
+    float stillAngle = 0.01f;   ///< radians
+    int maxReuseFrames = 8;     ///< the clouds move, even a still camera gets a new reflection this often
+
+    int level = defaultWaterQualityLevel;
+    double frameMs = -1.0;      ///< the average, -1 before the first resolved frame
+    int reflectionAge = 0;      ///< frames since the reflection was rendered
+
+private:
+    bool seenFrame = false, reflectionRendered = false;
+    unsigned int lastFrame = 0;
+    int sinceChange = 0;
+    Vec3 renderedPos = Vec3::Zero(), renderedFront = Vec3::Zero();
+    float renderedFov = 0.0f;
+
+public:
+    bool enabled() const { return targetFrameMs > 0.0; }
+
+    const WaterQualityLevel &current() const { return waterQualityLevels[level]; }
+
+    // takes the latest frame the profiler resolved, call once per frame before drawing
+    // the frame time is the larger of the CPU and the GPU time, whichever limits the frame rate
+    // returns true when the level changed
+    bool update(const Profiler &profiler) {
+        if (!enabled() || profiler.numFrames() == 0) return false;
+        const ProfileFrame &f = profiler.frame(0);
+        if (seenFrame && f.index == lastFrame) return false;
+        seenFrame = true;
+        lastFrame = f.index;
+
+        double ms = std::max(f.cpuMs, f.gpuMs);
+        frameMs = frameMs < 0.0 ? ms : frameMs + smoothing * (ms - frameMs);
+        if (++sinceChange < settleFrames) return false;
+
+        int next = level;
+        if (frameMs > lowerAbove * targetFrameMs) next = std::min(level + 1, numWaterQualityLevels - 1);
+        else if (frameMs < raiseBelow * targetFrameMs) next = std::max(level - 1, 0);
+        if (next == level) return false;
+        level = next;
+        sinceChange = 0;
+        return true;
+    }
+
+    // whether the reflection has to be rendered this frame, call once per frame with the main camera
+    // invalidated is set when the reflection texture lost its content, e.g. after a resize
+    bool refreshReflection(const Camera &camera, bool invalidated) {
+        float turned = std::acos(std::min(1.0f, camera.cameraFront.normalized().dot(renderedFront)));
+        bool still = (camera.cameraPos - renderedPos).norm() < stillDistance && turned < stillAngle &&
+                     camera.fov == renderedFov;
+        int wait = still ? maxReuseFrames : current().reflectionInterval;
+        if (enabled() && !invalidated && reflectionRendered && ++reflectionAge < wait) return false;
+
+        reflectionRendered = true;
+        reflectionAge = 0;
+        renderedPos = camera.cameraPos;
+        renderedFront = camera.cameraFront.normalized();
+        renderedFov = camera.fov;
+        return true;
+    }
+};
+
+#endif
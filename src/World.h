@@ -0,0 +1,330 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "utility.h"
+#include "Terrain.h"
+#include "Scatter.h"
+#include "Skybox.h"
+#include "Camera.h"
+#include "Water.h"
+#include "Occlusion.h"
+#include "Profiler.h"
+#include "RenderGraph.h"
+#include "ShaderCache.h"
+#include "TextureLoader.h"
+#include "UniformBlocks.h"
+#include "WaterQuality.h"
+
+// everything that is drawn in a frame, shared by the window in main.cpp and the headless harness
+// needs a current GL context when it is constructed
+class World {
+public:
+    int width, height;
+
+    float waterHeight = 0.5f;
+    Vec3 skyColor = Vec3(0.6, 0.7, 0.8);
+    Vec3 lightPos = Vec3(30.0f, 30.0f, 30.0f);
+    float size_grid_x = 20, size_grid_y = 20; // make grid bigger [-10, 10] instead of [-1, 1] to hide rendering distance.
+
+    // declared first so that the programs compile while the textures load
+    ShaderCache shaders;
+
+    // declared before everything that takes its textures from it
+    TextureLoader textures;
+
+    // the camera of every pass and the constants above, shared by all the programs (see UniformBlocks.h)
+    enum Pass { REFLECTION_PASS, REFRACTION_PASS, MAIN_PASS, NUM_PASSES };
+    FrameUniforms uniforms;
+
+    Skybox skybox;
+    Water water;
+    Terrain terrain;
+    Scatter scatter;
+    Camera camera;
+
+    // clipping plane => required when shading reflection and refraction FBO
+    Vec3 clipPlaneNormal = Vec3(0, 0, -1);
+    float clipPlaneHeight = 1000;
+    Vec3 reflectionClipPlaneNormal = Vec3(0, 0, 1);
+    float reflectionClipPlaneHeight = -waterHeight;
+    Vec3 refractionClipPlaneNormal = Vec3(0, 0, -1);
+    float refractionClipPlaneHeight = waterHeight;
+
+    // wait for the terrain chunks in view every frame, for reproducible images
+    bool blockingStreaming = false;
+
+    // the main pass skips the chunks and the scatter tiles hidden behind the terrain (see Occlusion.h), the
+    // reflection and the refraction cannot use it
+    bool occlusionCulling = true;
+    OcclusionBuffer occlusion;
+
+    // the terrain chunks and the scatter instances stream through it (see UploadRing.h), null uploads them straight
+    // from their data
+    std::unique_ptr<UploadRing> uploads;
+    GLsizeiptr uploadBudget = 4 << 20; ///< bytes per frame
+
+    // the sizes and the refresh rate of the water FBOs, off (the default sizes, every frame) until it gets a target
+    WaterQuality waterQuality;
+
+    // the passes of the frame and their textures (see RenderGraph.h), the reflection keeps its texture across frames
+    // for WaterQuality, the refraction and both depth buffers are transient
+    RenderGraph graph;
+    int reflectionColor, reflectionDepth, refractionColor, refractionDepth;
+    int reflectionPass, refractionPass, mainPass;
+
+public:
+    // programs are cached in shaderCacheDir across runs, empty compiles them every time
+    // the terrain is the one of terrainParams (see HeightfieldGenerator.h) eroded with erosionParams (see Erosion.h),
+    // its chunks are kept in tileStoreDir across runs and mapped from there, empty builds them every time (see TileStore.h)
+    // and they are shadowed with the horizon maps of horizonParams (see Horizon.h)
+    World(int _width, int _height, const std::string &shaderCacheDir = "shader_cache",
+          const HeightfieldParams &terrainParams = HeightfieldParams(), const std::string &tileStoreDir = "tile_store",
+          const ErosionParams &erosionParams = ErosionParams(), const HorizonParams &horizonParams = HorizonParams())
+        : width(_width), height(_height),
+          shaders(shaderCacheDir, { { "skybox", skybox_vshader, skybox_fshader },
+                                    { "clouds", cloud_vshader, cloud_fshader },
+                                    { "water", water_vshader, water_fshader },
+                                    { "terrain", terrain_vshader, terrain_fshader },
+                                    { "scatter", scatter_vshader, scatter_fshader },
+                                    { "impostor", impostor_vshader, impostor_fshader } }),
+          textures({ "grass.png", "rock.png", "sand.png", "snow.png", "water.png", "cloud.png" },
+                   { "miramar_ft.png", "miramar_bk.png", "miramar_dn.png", "miramar_up.png", "miramar_rt.png", "miramar_lf.png" }),
+          uniforms(NUM_PASSES),
+          skybox(textures, shaders),
+          water(size_grid_x, size_grid_y, waterHeight, textures, shaders),
+          terrain(size_grid_x, textures, shaders, terrainParams, tileStoreDir, erosionParams, horizonParams),
+          scatter(waterHeight, shaders, terrainParams, terrain.erosion),
+          camera(_width, _height),
+          graph(uniforms, _width, _height) {
+        uniforms.setMaterial(skyColor, lightPos, waterHeight);
+        buildGraph();
+
+        // every texture has been created, the staging memory can go
+        textures.release();
+        textures.printStats();
+        shaders.printStats();
+        graph.compile();
+        graph.printStats();
+        setUploadRing(true);
+
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);     // Make skybox seamless
+        glEnable(GL_DEPTH_TEST);     // enable depth test for skybox and so on
+        glEnable(GL_CLIP_DISTANCE0); // enables the first clipping plane in the program => shaders can now use gl_ClipDistance[0]
+    }
+
+    // off uploads straight from the data like before the ring, persistent false forces the glBufferSubData fallback
+    // of the ring; call it between frames
+    void setUploadRing(bool enabled, bool persistent = true) {
+        uploads = enabled ? std::unique_ptr<UploadRing>(new UploadRing(uploadBudget, persistent)) : nullptr;
+        terrain.chunks->uploads = uploads.get();
+        scatter.uploads = uploads.get();
+    }
+
+    // draws one frame into the default framebuffer, every pass is a profiler scope (see Profiler.h)
+    void drawFrame(float time) {
+        // may wait for the GPU to be done with the uploads of three frames ago, the stall counters say how long
+        if (uploads) uploads->begin_frame();
+        {
+            // stream in the terrain chunks around the camera once, all three passes draw the same chunks
+            PROFILE_SCOPE("update");
+            terrain.update(camera, blockingStreaming);
+            scatter.update(camera, blockingStreaming);
+            reportTerrain();
+        }
+        {
+            // one cloud map for the skybox of the reflection and of the main pass (see Clouds.h)
+            PROFILE_SCOPE("clouds");
+            skybox.clouds.update(time);
+            profiler().counter("cloud rows rendered", skybox.clouds.rowsRendered);
+        }
+        {
+            // uploads the waves a worker finished and starts the next step, never waits unless the images must be reproducible
+            PROFILE_SCOPE("ocean");
+            water.ocean->update(time, blockingStreaming);
+            reportOcean();
+        }
+
+        bool reflectionInvalidated = false;
+        if (waterQuality.update(profiler()) || firstFrame) {
+            const WaterQualityLevel &level = waterQuality.current();
+            reflectionInvalidated = water.setScale(level.reflectionScale, level.refractionScale);
+            graph.resize(reflectionColor, water.reflectionWidth, water.reflectionHeight);
+            graph.resize(reflectionDepth, water.reflectionWidth, water.reflectionHeight);
+            graph.resize(refractionColor, water.refractionWidth, water.refractionHeight);
+            graph.resize(refractionDepth, water.refractionWidth, water.refractionHeight);
+            firstFrame = false;
+        }
+        bool renderReflection = waterQuality.refreshReflection(camera, reflectionInvalidated);
+        reportWaterQuality(renderReflection);
+
+        // skipped, the water reprojects the last reflection with the camera it was rendered with
+        graph.pass(reflectionPass).enabled = renderReflection;
+        graph.execute(camera, time);
+        reportCulling();
+        if (uploads) {
+            uploads->end_frame();
+            reportUploads();
+        }
+    }
+
+private:
+    bool firstFrame = true;
+
+    // the decisions of the water quality controller, next to the scopes of the frame
+    void reportWaterQuality(bool renderReflection) {
+        Profiler &profile = profiler();
+        profile.counter("water level", waterQuality.level);
+        profile.counter("water reflection width", water.reflectionWidth);
+        profile.counter("water refraction width", water.refractionWidth);
+        profile.counter("water reflection interval", waterQuality.current().reflectionInterval);
+        profile.counter("water reflection rendered", renderReflection ? 1.0 : 0.0);
+        if (waterQuality.frameMs >= 0.0) profile.counter("water average frame ms", waterQuality.frameMs);
+    }
+
+    // how far behind the frames the ocean simulation is
+    void reportOcean() {
+        Profiler &profile = profiler();
+        const OceanStats &stats = water.ocean->stats;
+        profile.counter("ocean step ms", stats.stepMs);
+        profile.counter("ocean uploads", stats.uploads);
+        profile.counter("ocean busy frames", stats.busyFrames);
+        profile.counter("ocean ring full frames", stats.ringFullFrames);
+        profile.counter("ocean upload bytes", (double)stats.uploadBytes);
+    }
+
+    // what each pass drew of the terrain and what the occlusion buffer hid of it, the reflection keeps the numbers
+    // of the last frame it was rendered
+    void reportCulling() {
+        Profiler &profile = profiler();
+        const CullStats &reflection = terrain.passStats[TERRAIN_PASS_REFLECTION];
+        const CullStats &refraction = terrain.passStats[TERRAIN_PASS_REFRACTION];
+        const CullStats &main = terrain.passStats[TERRAIN_PASS_MAIN];
+        profile.counter("terrain chunks drawn reflection", reflection.chunksDrawn);
+        profile.counter("terrain chunks drawn refraction", refraction.chunksDrawn);
+        profile.counter("terrain chunks drawn main", main.chunksDrawn);
+        profile.counter("terrain chunks culled occlusion reflection", reflection.chunksCulledOcclusion);
+        profile.counter("terrain chunks culled occlusion refraction", refraction.chunksCulledOcclusion);
+        profile.counter("terrain chunks culled occlusion main", main.chunksCulledOcclusion);
+        profile.counter("occlusion triangles", occlusion.trianglesRasterized);
+    }
+
+    // what the terrain streaming keeps on the GPU, see TerrainVertex and Horizon.h for the layouts
+    void reportTerrain() {
+        Profiler &profile = profiler();
+        const ChunkStats &stats = terrain.chunks->stats;
+        profile.counter("terrain chunks resident", stats.tilesResident);
+        profile.counter("terrain vertex bytes", (double)(stats.residentBytes - stats.horizonBytes));
+        profile.counter("terrain horizon bytes", (double)stats.horizonBytes);
+        profile.counter("terrain index bytes", (double)stats.indexBytes);
+        profile.counter("terrain upload bytes", (double)stats.uploadBytes);
+        profile.counter("terrain chunks uploaded", stats.tilesUploaded);
+        profile.counter("terrain chunks from store", stats.tilesFromStore);
+        if (terrain.erosion) profile.counter("erosion tiles eroded", terrain.erosion->stats.tilesEroded.load());
+    }
+
+    // what went through the upload ring this frame, the stalls since the start
+    void reportUploads() {
+        Profiler &profile = profiler();
+        const UploadRingStats &stats = uploads->stats;
+        profile.counter("upload ring bytes", (double)stats.frame_bytes);
+        profile.counter("upload ring copies", stats.frame_copies);
+        profile.counter("upload ring refused", stats.frame_refused);
+        profile.counter("upload ring stalls", stats.stalls);
+        profile.counter("upload ring stall ms", stats.stall_ms);
+    }
+
+    // what the scatter streamed and culled for the main pass
+    void reportScatter() {
+        Profiler &profile = profiler();
+        const ScatterStats &stats = scatter.field->stats;
+        profile.counter("scatter instances resident", (double)stats.instancesResident);
+        profile.counter("scatter meshes drawn", (double)stats.drawn(SCATTER_MESH));
+        profile.counter("scatter impostors drawn", (double)stats.drawn(SCATTER_IMPOSTOR));
+        profile.counter("scatter tiles visible", stats.tilesVisible);
+        profile.counter("scatter tiles culled frustum", stats.tilesCulledFrustum);
+        profile.counter("scatter tiles culled distance", stats.tilesCulledDistance);
+        profile.counter("scatter tiles culled occlusion", stats.tilesCulledOcclusion);
+        profile.counter("scatter tiles building", stats.tilesBuilding);
+        profile.counter("scatter upload bytes", (double)scatter.uploadBytes);
+    }
+
+    // the three passes of a frame, every pass is a profiler scope (see Profiler.h)
+    void buildGraph() {
+        reflectionColor = graph.createTexture("reflection", GRAPH_RGBA8, water.reflectionWidth, water.reflectionHeight, true);
+        reflectionDepth = graph.createTexture("reflection depth", GRAPH_DEPTH16, water.reflectionWidth, water.reflectionHeight);
+        refractionColor = graph.createTexture("refraction", GRAPH_RGBA8, water.refractionWidth, water.refractionHeight);
+        refractionDepth = graph.createTexture("refraction depth", GRAPH_DEPTH16, water.refractionWidth, water.refractionHeight);
+
+        // for reflection, we draw the whole scene on the FBO from a camera that is position below the current eye position and pointing upwards
+        // essentially we get angle of incidence = angle of reflection
+        // to get the reflection, the camera needs to move down and point upwards => move by current distance * 2 down and flip
+        reflectionPass = graph.addPass("reflection");
+        RenderPass &reflection = graph.pass(reflectionPass);
+        reflection.view.uniformSlot = REFLECTION_PASS;
+        reflection.view.mirrored = true;
+        reflection.view.mirrorHeight = waterHeight;
+        reflection.view.clipPlaneNormal = reflectionClipPlaneNormal;
+        reflection.view.clipPlaneHeight = reflectionClipPlaneHeight;
+        reflection.color = reflectionColor;
+        reflection.depth = reflectionDepth;
+        reflection.execute = [this](const PassContext &pass) {
+            water.reflectionProjectionView = pass.projectionView;
+            skybox.draw();
+            terrain.draw(pass.projectionView, pass.view.clipPlaneNormal, pass.view.clipPlaneHeight,
+                         TERRAIN_PASS_REFLECTION);
+        };
+
+        // for refraction, we draw the scene below the water height => we will blend this with
+        // the reflection texture to create a water effect
+        refractionPass = graph.addPass("refraction");
+        RenderPass &refraction = graph.pass(refractionPass);
+        refraction.view.uniformSlot = REFRACTION_PASS;
+        refraction.view.clipPlaneNormal = refractionClipPlaneNormal;
+        refraction.view.clipPlaneHeight = refractionClipPlaneHeight;
+        refraction.color = refractionColor;
+        refraction.depth = refractionDepth;
+        refraction.execute = [this](const PassContext &pass) {
+            terrain.draw(pass.projectionView, pass.view.clipPlaneNormal, pass.view.clipPlaneHeight,
+                         TERRAIN_PASS_REFRACTION);
+        };
+
+        // actual drawing
+        mainPass = graph.addPass("main");
+        RenderPass &main = graph.pass(mainPass);
+        main.view.uniformSlot = MAIN_PASS;
+        main.view.clipPlaneNormal = clipPlaneNormal;
+        main.view.clipPlaneHeight = clipPlaneHeight;
+        main.reads = { reflectionColor, refractionColor };
+        main.color = graphBackbuffer;
+        main.depth = graphBackbuffer;
+        main.execute = [this](const PassContext &pass) {
+            const Vec3 &normal = pass.view.clipPlaneNormal;
+            float height = pass.view.clipPlaneHeight;
+            // the occluders are under the ground, a camera that is not above it would see them (see Occlusion.h)
+            const Vec3 &eye = pass.camera.cameraPos;
+            bool aboveGround = eye.z() - terrain.ground->height(eye.x(), eye.y()) > pass.camera.nearPlane;
+            OcclusionBuffer *occluders = occlusionCulling && aboveGround ? &occlusion : nullptr;
+            if (!occluders) occlusion.trianglesRasterized = 0;
+            {
+                PROFILE_SCOPE("terrain");
+                terrain.draw(pass.projectionView, normal, height, TERRAIN_PASS_MAIN, occluders);
+            }
+            {
+                // only in the main pass, the water distorts its reflection too much for grass and rocks to tell
+                PROFILE_SCOPE("scatter");
+                scatter.draw(pass.projectionView, pass.camera.cameraPos, normal, height, occluders);
+                reportScatter();
+            }
+            {
+                PROFILE_SCOPE("skybox");
+                skybox.draw();
+            }
+            {
+                PROFILE_SCOPE("water");
+                water.draw(graph.texture(reflectionColor), graph.texture(refractionColor));
+            }
+        };
+    }
+};
+
+#endif
@@ -0,0 +1,25 @@
+// the one translation unit of the virtualworld library (see CMakeLists.txt): the LodePNG implementation, and every
+// CPU side header compiled on its own, so that none of them needs GL or defines something twice once several
+// translation units include it
+
+#define OPENGP_IMPLEMENT_LODEPNG_IN_THIS_FILE
+#include <OpenGP/util/implementations.h>
+
+#include "BlockCompression.h"
+#include "Camera.h"
+#include "ChunkData.h"
+#include "Erosion.h"
+#include "Frustum.h"
+#include "HeightPyramid.h"
+#include "HeightfieldGenerator.h"
+#include "Horizon.h"
+#include "ImageCache.h"
+#include "MappedFile.h"
+#include "Occlusion.h"
+#include "OceanSimulation.h"
+#include "ScatterData.h"
+#include "Simulation.h"
+#include "TerrainLOD.h"
+#include "TextureContainer.h"
+#include "ThreadPool.h"
+#include "TileStore.h"
@@ -0,0 +1,11 @@
+R"(
+#version 330 core
+// one triangle over the whole cloud map, the vertices come from gl_VertexID
+
+void main() {
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(2.0 * corner - 1.0, 0.0, 1.0);
+    // GL_CLIP_DISTANCE0 is on for the whole frame
+    gl_ClipDistance[0] = 1.0;
+}
+)"
@@ -0,0 +1,60 @@
+R"(
+#version 330 core
+
+// viewPos, skyColor and lightPos come from the Camera and Material blocks (see uniform_blocks.glsl)
+
+// the order of ScatterKind
+const int GRASS = 0, TREE = 1, ROCK = 2;
+uniform int kind;
+
+in vec2 local;
+in vec3 fragPos;
+in vec3 right;
+in vec3 toCamera;
+in vec3 distanceFromCamera;
+
+out vec4 FragColor;
+
+// the outline of the cone of treeModel() in Scatter.h from the side, with the across position on the cone
+// (-1 to 1) in across
+bool insideCone(float r0, float z0, float z1, out float across) {
+    float r = r0 * (z1 - local.y) / (z1 - z0);
+    across = local.x / max(r, 1e-4);
+    return local.y >= z0 && local.y <= z1 && abs(local.x) <= r;
+}
+
+void main() {
+    vec3 col;
+    vec3 n;
+    float across;
+    if (kind == TREE) {
+        // the billboard of the tree model: the cones over the trunk
+        if (insideCone(0.28, 0.55, 1.0, across) || insideCone(0.40, 0.25, 0.75, across)) {
+            col = mix(vec3(0.08, 0.20, 0.07), vec3(0.18, 0.38, 0.12), clamp((local.y - 0.25) / 0.75, 0.0, 1.0));
+            n = normalize(across * right + sqrt(max(0.0, 1.0 - across * across)) * toCamera + vec3(0.0, 0.0, 0.8));
+        } else if (abs(local.x) <= 0.05 && local.y <= 0.35) {
+            col = vec3(0.25, 0.17, 0.10);
+            n = toCamera;
+        } else {
+            discard;
+        }
+    } else {
+        // an ellipse for the rock model
+        vec2 e = vec2(local.x / 0.45, (local.y - 0.05) / 0.38);
+        float r2 = dot(e, e);
+        if (r2 > 1.0) discard;
+        col = vec3(0.48, 0.46, 0.43);
+        n = normalize(e.x * right + sqrt(1.0 - r2) * toCamera + vec3(0.0, 0.0, e.y));
+    }
+
+    vec3 lightDir = normalize(lightPos - fragPos);
+    float diffuse = max(0.0, dot(n, lightDir));
+    col = 0.15 * skyColor + (0.45 + 0.55 * diffuse) * col;
+
+    // the fog of terrain_fshader.glsl
+    float density = 0.1;
+    float gradient = 1.5;
+    float visibility = clamp(exp(-pow(length(distanceFromCamera) * density, gradient)), 0.0, 1.0);
+    FragColor = vec4(mix(skyColor, col, visibility), 1.0);
+}
+)"
@@ -0,0 +1,37 @@
+R"(
+#version 330 core
+
+// a quad from (-1, 0) to (1, 1) in x and z, turned around z to face the camera (see Scatter.h)
+in vec3 vposition;
+
+// one per instance, every component in its own buffer (see ScatterBatch)
+in float ix;
+in float iy;
+in float iz;
+in float iyaw;
+in float iscale;
+
+// the radius, the bottom and the top of the model of the kind at scale 1
+uniform vec3 extent;
+
+out vec2 local; // where in the model the fragment is, in its units
+out vec3 fragPos;
+out vec3 right;
+out vec3 toCamera;
+out vec3 distanceFromCamera;
+
+void main() {
+    vec3 base = vec3(ix, iy, iz);
+    vec2 facing = viewPos.xy - base.xy;
+    facing = length(facing) > 0.0 ? normalize(facing) : vec2(0.0, 1.0);
+    right = vec3(-facing.y, facing.x, 0.0);
+    toCamera = vec3(facing, 0.0);
+
+    local = vec2(vposition.x * extent.x, mix(extent.y, extent.z, vposition.z));
+    fragPos = base + iscale * (local.x * right + vec3(0.0, 0.0, local.y));
+
+    gl_Position = P*V*vec4(fragPos, 1.0f);
+    distanceFromCamera = fragPos - viewPos;
+    gl_ClipDistance[0] = dot(vec4(clipPlaneNormal, clipPlaneHeight), vec4(fragPos, 1.0));
+}
+)"
@@ -1,46 +0,0 @@
-#pragma once
-#include <OpenGP/GL/Application.h>
-#include <OpenGP/external/LodePNG/lodepng.cpp>
-
-using namespace OpenGP;
-void loadTexture(std::unique_ptr<RGBA8Texture> &texture, const char *filename) {
-    // Used snippet from https://raw.githubusercontent.com/lvandeve/lodepng/master/examples/example_decode.cpp
-    std::vector<unsigned char> image; //the raw pixels
-    unsigned width, height;
-    //decode
-    unsigned error = lodepng::decode(image, width, height, filename);
-    //if there's an error, display it
-    if(error) std::cout << "cool - decoder error " << error << ": " << lodepng_error_text(error) << std::endl;
-    //the pixels are now in the vector "image", 4 bytes per pixel, ordered RGBARGBA..., use it as texture, draw it, ...
-
-    // unfortunately they are upside down...lets fix that
-    unsigned char* row = new unsigned char[4*width];
-    for(int i = 0; i < int(height)/2; ++i) {
-        memcpy(row, &image[4*i*width], 4*width*sizeof(unsigned char));
-        memcpy(&image[4*i*width], &image[image.size() - 4*(i+1)*width], 4*width*sizeof(unsigned char));
-        memcpy(&image[image.size() - 4*(i+1)*width], row, 4*width*sizeof(unsigned char));
-    }
-    delete row;
-
-    texture = std::unique_ptr<RGBA8Texture>(new RGBA8Texture());
-    texture->upload_raw(width, height, &image[0]);
-}
-
-void loadTexture(std::vector<unsigned char> &image, const char *filename) {
-    // Used snippet from https://raw.githubusercontent.com/lvandeve/lodepng/master/examples/example_decode.cpp
-    unsigned width, height;
-    //decode
-    unsigned error = lodepng::decode(image, width, height, filename);
-    //if there's an error, display it
-    if(error) std::cout << "decoder error " << error << ": " << lodepng_error_text(error) << std::endl;
-    //the pixels are now in the vector "image", 4 bytes per pixel, ordered RGBARGBA..., use it as texture, draw it, ...
-
-    // unfortunately they are upside down...lets fix that
-    unsigned char* row = new unsigned char[4*width];
-    for(int i = 0; i < int(height)/2; ++i) {
-        memcpy(row, &image[4*i*width], 4*width*sizeof(unsigned char));
-        memcpy(&image[4*i*width], &image[image.size() - 4*(i+1)*width], 4*width*sizeof(unsigned char));
-        memcpy(&image[image.size() - 4*(i+1)*width], row, 4*width*sizeof(unsigned char));
-    }
-    delete row;
-}
\ No newline at end of file
@@ -1,9 +1,14 @@
 
+// ImGui is compiled in this file, for the profiler overlay
+#define OPENGP_IMPLEMENT_IMGUI_IN_THIS_FILE
+#include <OpenGP/util/implementations.h>
+
 #include "utility.h"
-#include "Terrain.h"
-#include "Skybox.h"
-#include "Camera.h"
-#include "Water.h"
+#include "World.h"
+#include "ProfilerOverlay.h"
+
+#include <fstream>
+#include <map>
 
 using namespace OpenGP;
 const int width=1280, height=720;
@@ -12,64 +17,39 @@ int main(int, char**){
 
     Application app;
 
-    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);     // Make skybox seamless
-    glEnable(GL_DEPTH_TEST);     // enable depth test for skybox and so on
-    glEnable(GL_CLIP_DISTANCE0); // enables the first clipping plane in the program => shaders can now use gl_ClipDistance[0]
-
-    float waterHeight = 0.5f;
-    Vec3 skyColor = Vec3(0.6, 0.7, 0.8);
-    Vec3 lightPos = Vec3(30.0f, 30.0f, 30.0f);
-    float size_grid_x = 20, size_grid_y = 20; // make grid bigger [-10, 10] instead of [-1, 1] to hide rendering distance.
-
+    // the skybox, water and terrain, and the passes that draw them (see World.h)
+    World world(width, height);
+    Camera &camera = world.camera;
+    // scale the water FBOs down (and refresh the reflection less often) when a frame takes longer than at 60 Hz
+    world.waterQuality.targetFrameMs = 1000.0 / 60.0;
 
-    Skybox skybox(skyColor);
-    Water water(size_grid_x, size_grid_y, waterHeight);
-    Terrain terrain(size_grid_x, size_grid_y, waterHeight, skyColor, lightPos);
-    Camera camera(width, height);
-
-    // clipping plane => required when shading reflection and refraction FBO
-    Vec3 clipPlaneNormal = Vec3(0, 0, -1);
-    float clipPlaneHeight = 1000;
-    Vec3 reflectionClipPlaneNormal = Vec3(0, 0, 1);
-    float reflectionClipPlaneHeight = -waterHeight;
-    Vec3 refractionClipPlaneNormal = Vec3(0, 0, -1);
-    float refractionClipPlaneHeight = waterHeight;
+    // the camera moves on the simulation thread at a fixed timestep, the window only passes the input on
+    // and every frame draws the camera it interpolates (see Simulation.h)
+    Simulation simulation(camera.state());
+    // the camera cannot fly through the mountains
+    simulation.motion.groundHeight = [&world](float x, float y) { return world.terrain.ground->height(x, y); };
+    simulation.start();
 
+    // P shows the profiler, T writes the frames it holds to profile_trace.json for chrome://tracing
+    ImguiRenderer imgui;
+    bool showProfiler = false;
 
     // Display callback
     Window& window = app.create_window([&](Window&){
-        float time = glfwGetTime();
-
-        // for reflection, we draw the whole scene on the FBO from a camera that is position below the current eye position and pointing upwards
-        // essentially we get angle of incidence = angle of reflection
-        // to get the reflection, the camera needs to move down and point upwards => move by current distance * 2 down and flip
-        // this draws the reflection into the texture
-        float distance = 2 * (camera.cameraPos.z() - waterHeight);
-        camera.cameraPos.z() -= distance;
-        camera.invertPitch();
-        water.reflectionFBO->bind();
-            glViewport(0, 0, water.reflectionWidth, water.reflectionHeight);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            skybox.draw(camera, time);
-            terrain.draw(camera, reflectionClipPlaneNormal, reflectionClipPlaneHeight);
-        water.reflectionFBO->unbind();
-        camera.cameraPos.z() += distance;
-        camera.invertPitch();
-
-        // for refraction, we draw the scene below the water height => we will blend this with 
-        // the reflection texture to create a water effect
-        water.refractionFBO->bind();
-            glViewport(0, 0, water.refractionWidth, water.refractionHeight);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            terrain.draw(camera, refractionClipPlaneNormal, refractionClipPlaneHeight);
-        water.refractionFBO->unbind();
-
-        // actual drawing
-        glViewport(0, 0, width, height);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        terrain.draw(camera, clipPlaneNormal, clipPlaneHeight);
-        skybox.draw(camera, time);
-        water.draw(camera, time);
+        profiler().beginFrame();
+        camera.setState(simulation.view());
+        profiler().counter("simulation tick ms", simulation.averageStepMs());
+        world.drawFrame(glfwGetTime());
+        if (showProfiler) {
+            PROFILE_SCOPE("overlay");
+            imgui.begin_frame(width, height);
+            drawProfilerWindow(profiler());
+            imgui.end_frame();
+            // the overlay leaves blending on and the depth test off
+            glDisable(GL_BLEND);
+            glEnable(GL_DEPTH_TEST);
+        }
+        profiler().endFrame();
     });
     window.set_title("3D-Virtual-World");
     window.set_size(width, height);
@@ -77,12 +57,26 @@ int main(int, char**){
     Vec2 mouse(0,0);
     window.add_listener<MouseMoveEvent>([&](const MouseMoveEvent &m){
         Vec2 changeInMousePosition = m.position - mouse;
-        camera.updateCameraAngles(changeInMousePosition);
+        simulation.addLook(changeInMousePosition.x(), changeInMousePosition.y());
         mouse = m.position;
     });
 
+    // WASD moves, up and down zoom, right and left change the speed
+    const std::map<int, uint32_t> simulationKeys = {
+        { GLFW_KEY_W, SIM_KEY_FORWARD }, { GLFW_KEY_A, SIM_KEY_LEFT }, { GLFW_KEY_S, SIM_KEY_BACK }, { GLFW_KEY_D, SIM_KEY_RIGHT },
+        { GLFW_KEY_UP, SIM_KEY_ZOOM_IN }, { GLFW_KEY_DOWN, SIM_KEY_ZOOM_OUT },
+        { GLFW_KEY_RIGHT, SIM_KEY_FASTER }, { GLFW_KEY_LEFT, SIM_KEY_SLOWER }
+    };
     window.add_listener<KeyEvent>([&](const KeyEvent &k){
-        camera.updateCamera(k);
+        // held keys move the camera, key repeats change nothing
+        auto found = simulationKeys.find(k.key);
+        if (found != simulationKeys.end()) simulation.setKey(found->second, !k.released);
+
+        if (k.key == GLFW_KEY_P && !k.released) showProfiler = !showProfiler;
+        if (k.key == GLFW_KEY_T && !k.released) {
+            std::ofstream trace("profile_trace.json");
+            profiler().writeChromeTrace(trace);
+        }
     });
 
     return app.run();
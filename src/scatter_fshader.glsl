@@ -0,0 +1,26 @@
+R"(
+#version 330 core
+
+// viewPos, skyColor and lightPos come from the Camera and Material blocks (see uniform_blocks.glsl)
+
+in vec3 fragPos;
+in vec3 normal;
+in vec3 color;
+in vec3 distanceFromCamera;
+
+out vec4 FragColor;
+
+void main() {
+    // the blades are seen from both sides
+    vec3 n = gl_FrontFacing ? normal : -normal;
+    vec3 lightDir = normalize(lightPos - fragPos);
+    float diffuse = max(0.0, dot(n, lightDir));
+    vec3 col = 0.15 * skyColor + (0.45 + 0.55 * diffuse) * color;
+
+    // the fog of terrain_fshader.glsl, so that everything fades into the sky at the same distance
+    float density = 0.1;
+    float gradient = 1.5;
+    float visibility = clamp(exp(-pow(length(distanceFromCamera) * density, gradient)), 0.0, 1.0);
+    FragColor = vec4(mix(skyColor, col, visibility), 1.0);
+}
+)"
@@ -0,0 +1,46 @@
+R"(
+#version 330 core
+
+// the model, z up with the ground at 0 (see Scatter.h)
+in vec3 vposition;
+in vec3 vnormal;
+in vec3 vcolor;
+
+// one per instance, every component in its own buffer (see ScatterBatch)
+in float ix;
+in float iy;
+in float iz;
+in float iyaw;
+in float iscale;
+
+// the camera and the clip plane come from the Camera block (see uniform_blocks.glsl)
+uniform float fadeDistance; // 0 when the kind does not fade out
+
+out vec3 fragPos;
+out vec3 normal;
+out vec3 color;
+out vec3 distanceFromCamera;
+
+void main() {
+    vec3 base = vec3(ix, iy, iz);
+    float scale = iscale;
+
+    // shrink into the ground over the last tenth of the range, so the edge of the band does not pop
+    if (fadeDistance > 0.0) {
+        float distance = length(base.xy - viewPos.xy);
+        scale *= clamp((fadeDistance - distance) / (0.1 * fadeDistance), 0.0, 1.0);
+    }
+
+    float c = cos(iyaw), s = sin(iyaw);
+    mat2 rotation = mat2(c, s, -s, c);
+    fragPos = base + scale * vec3(rotation * vposition.xy, vposition.z);
+    normal = normalize(vec3(rotation * vnormal.xy, vnormal.z));
+    color = vcolor;
+
+    gl_Position = P*V*vec4(fragPos, 1.0f);
+    distanceFromCamera = fragPos - viewPos;
+
+    // the same clip plane as the terrain, for the water passes
+    gl_ClipDistance[0] = dot(vec4(clipPlaneNormal, clipPlaneHeight), vec4(fragPos, 1.0));
+}
+)"
@@ -3,12 +3,11 @@ R"(
 in vec3 vposition;
 out vec3 texCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+// V and P come from the Camera block
 
 void main() {
     // the skybox unfortunately is not infinite. We make it big enough that we never cross it 
-    vec4 pos = projection * view * vec4(1000*vposition, 1.0f);
+    vec4 pos = P * V * vec4(1000*vposition, 1.0f);
 
     // Having z equal w will always result in a depth of 1.0f which cannot be culled because of glDepthFunc(GL_LEQUAL);
     gl_Position = vec4(pos.x, pos.y, pos.w, pos.w);
@@ -1,25 +1,36 @@
 R"(
 #version 330 core
 
-uniform sampler2D grass;
-uniform sampler2D rock;
-uniform sampler2D sand;
-uniform sampler2D snow;
+// one layer per material, see terrainLayers in Terrain.h
+uniform sampler2DArray layers;
+const int GRASS = 0, ROCK = 1, SAND = 2, SNOW = 3;
 
-uniform vec3 viewPos;
-uniform float waterHeight;
-uniform vec3 skyColor;
-uniform vec3 lightPos;
+// the horizon map of the chunk (see Horizon.h): the sine of the elevation of the horizon in 8 directions
+// counterclockwise from +x, the first 4 in layer 0 and the others in layer 1
+uniform sampler2DArray horizons;
+
+// viewPos, waterHeight, skyColor and lightPos come from the Camera and Material blocks (see uniform_blocks.glsl)
 
 in vec2 uv;
 in vec3 fragPos;
 in float height;
 in vec3 normal;
 in float slope; 
+in float wetness;
+in vec2 horizonUV;
 in vec3 distanceFromCamera;
 
 out vec4 color;
 
+// The blend is linear in the texture colours, so it is worked out on weights instead: a vec4 holds how much of
+// grass, rock, sand and snow (the layers in that order) go into the colour, and every layer is sampled exactly
+// once at the end instead of again for every level.
+vec4 layer(int index) {
+    vec4 weights = vec4(0.0f);
+    weights[index] = 1.0f;
+    return weights;
+}
+
 // prevent lines between two levels by blending several levels together
 vec4 mixBetweenLevels(vec4 col_middle, float height, vec4 col_lower, float height_lower, vec4 col_higher, float height_higher) {
     float halfDistance = (height_higher - height_lower) / 2.0f;
@@ -35,13 +46,13 @@ vec4 mixBetweenLevels(vec4 col_middle, float height, vec4 col_lower, float heigh
 }
 
 // mix with grass or snow based on level so that grass/snow appears deposited on the surface
-vec4 mixWithGrassAndSnow(sampler2D base, vec2 uv, float height, float slope) {
+vec4 mixWithGrassAndSnow(int base, float height, float slope) {
     float mixWithGrassLevel = 1.6f;
     float mixWithSnowLevel = mixWithGrassLevel + 1.6f;
 
-    vec4 with_grass = mix(texture(base, uv), texture(grass, uv), slope);
-    vec4 with_snow = mix(texture(base, uv), texture(snow, uv), slope);
-    vec4 col = texture(base, uv);
+    vec4 with_grass = mix(layer(base), layer(GRASS), slope);
+    vec4 with_snow = mix(layer(base), layer(SNOW), slope);
+    vec4 col = layer(base);
 
     // we have to mix between levels here again as otherwise we get a line here also...
     return mixBetweenLevels(col, height, with_grass, mixWithGrassLevel,  with_snow, mixWithSnowLevel);
@@ -64,33 +75,42 @@ void main() {
     float rockLevel = grassLevel + 1.6f;       // rock with some grass or snow
     float snowLevel = rockLevel + 0.8f;        // pure snow
 
-    vec4 col;
+    vec4 weights;
 
-    vec4 pureSnowCol = texture(snow, uv);
-    vec4 rockCol = mixWithGrassAndSnow(rock, uv, height, slope/10.0f);
-    vec4 grassCol = mixWithGrassAndSnow(grass, uv, height, slope);
-    vec4 sandCol = mixWithGrassAndSnow(sand, uv, height, slope);
-    vec4 pureSandCol = texture(sand, uv);
+    vec4 pureSnow = layer(SNOW);
+    vec4 rock = mixWithGrassAndSnow(ROCK, height, slope/10.0f);
+    vec4 grass = mixWithGrassAndSnow(GRASS, height, slope);
+    vec4 sand = mixWithGrassAndSnow(SAND, height, slope);
+    vec4 pureSand = layer(SAND);
 
     // Blinn-Phong constants are placed here so we can update them at each level
     float ka = 0.05f, kd = 0.15f, ks = 0.45f, p = 0.8f;
     
     if (height > snowLevel) {
-        col = pureSnowCol;
+        weights = pureSnow;
     } else if (height >= grassLevel && height <= snowLevel) {
         // rock but blend with grass below and snow above
-        col = mixBetweenLevels(rockCol, height, grassCol, grassLevel, pureSnowCol, snowLevel);
+        weights = mixBetweenLevels(rock, height, grass, grassLevel, pureSnow, snowLevel);
     } else if (height >= sandLevel && height <= rockLevel) {
         // texture with grass but blend with rock above and blend with sand below
-        col = mixBetweenLevels(grassCol, height, sandCol, sandLevel, rockCol, rockLevel);
+        weights = mixBetweenLevels(grass, height, sand, sandLevel, rock, rockLevel);
     } else if (height >= pureSandLevel && height <= grassLevel) {
         // texture with sand but blend with grass above and blend with pureSand below
-        col = mixBetweenLevels(sandCol, height, pureSandCol, pureSandLevel, grassCol, grassLevel);
+        weights = mixBetweenLevels(sand, height, pureSand, pureSandLevel, grass, grassLevel);
     } else { 
         // height <= pureSandLevel
-        col = pureSandCol;
+        weights = pureSand;
     }
 
+    // where the water ran (see Erosion.h) it washed the cover off: down to the rock on the hills, to the sand
+    // towards the shore, and it is still damp so it is darker
+    vec4 washed = mix(pureSand, layer(ROCK), clamp((height - sandLevel) / (grassLevel - sandLevel), 0.0f, 1.0f));
+    weights = mix(weights, washed, 0.6f * wetness);
+
+    vec4 col = weights.x * texture(layers, vec3(uv, GRASS)) + weights.y * texture(layers, vec3(uv, ROCK)) +
+               weights.z * texture(layers, vec3(uv, SAND)) + weights.w * texture(layers, vec3(uv, SNOW));
+    col *= 1.0f - 0.3f * wetness;
+
     // Blinn-Phong calculation
     vec3 lightDir = normalize(lightPos - fragPos);
     float diffuse = kd * max(0.0f, dot(normal, lightDir));
@@ -99,8 +119,20 @@ void main() {
     vec3 halfway = normalize(lightDir + viewDirection);
     float specular = ks * max(0.0f, pow(dot(normal, halfway), p));
 
+    // the sun is behind the hills when it is under the horizon in its direction, the edge is softened for the
+    // penumbra; the sky is lit by the part of it over the horizons, cosine weighted that is 1 - sin^2 of each
+    vec4 horizonsA = texture(horizons, vec3(horizonUV, 0)), horizonsB = texture(horizons, vec3(horizonUV, 1));
+    float horizon[8] = float[8](horizonsA.x, horizonsA.y, horizonsA.z, horizonsA.w,
+                                horizonsB.x, horizonsB.y, horizonsB.z, horizonsB.w);
+    float azimuth = mod(atan(lightDir.y, lightDir.x) / (3.14159265f / 4.0f) + 8.0f, 8.0f);
+    int d = int(azimuth);
+    float sunHorizon = mix(horizon[d % 8], horizon[(d + 1) % 8], azimuth - float(d));
+    float sun = smoothstep(sunHorizon - 0.04f, sunHorizon + 0.04f, lightDir.z);
+    float sky = 1.0f - (dot(horizonsA, horizonsA) + dot(horizonsB, horizonsB)) / 8.0f;
+    float lit = (1.0f - 0.6f * (1.0f - sun)) * (1.0f - 0.5f * (1.0f - sky));
+
     // I use the skyColor as the ambient color to make the fog look better.
-    col = ka*vec4(skyColor, 1.0f) + diffuse*col + specular*col;
+    col = ka*sky*vec4(skyColor, 1.0f) + lit*diffuse*col + lit*specular*col;
 
     // visibility calculation => add fog so that we can hide 'render distance'  
     // we mix the color with the skycolor based on the distance from the camera
@@ -1,96 +1,42 @@
 R"(
 #version 330 core
 
-in vec3 vposition;
+// chunks are built on the CPU (see HeightfieldGenerator.h), a vertex only stores its height, its normal and its
+// wetness (TerrainVertex in ChunkData.h), the locations are the ones ChunkManager points the chunk buffers at
+layout(location = 0) in float vheight;  // steps of heightStep above heightBase
+layout(location = 1) in vec2 vnormal;   // hemi-octahedral, times 127
+layout(location = 2) in float vwetness; // how much water the erosion ran over it, in [0, 1] (see Erosion.h)
 
+// the camera and the clip plane come from the Camera block (see uniform_blocks.glsl)
 uniform mat4 M;
-uniform mat4 V;
-uniform mat4 P;
-uniform vec3 viewPos; // camera position, we translate the grid using it...
 
-// clip plane
-uniform vec3 clipPlaneNormal;
-uniform float clipPlaneHeight;
+// the chunk being drawn: its first sample on the grid of its level, the spacing of that grid and its lowest height
+uniform ivec2 chunkOrigin;
+uniform int chunkCols;
+uniform float chunkSpacing;
+uniform int heightBase;
+uniform float heightStep;
 
 out vec2 uv;
 out vec3 fragPos;
 out vec3 normal;
 out float height;
 out float slope;
+out float wetness;
+out vec2 horizonUV;
 out vec3 distanceFromCamera;
 
 
-float Perlin2D( vec2 P ) {
-    //  https://github.com/BrianSharpe/Wombat/blob/master/Perlin2D.glsl
-
-    // establish our grid cell and unit position
-    vec2 Pi = floor(P);
-    vec4 Pf_Pfmin1 = P.xyxy - vec4( Pi, Pi + 1.0 );
-
-    // calculate the hash
-    vec4 Pt = vec4( Pi.xy, Pi.xy + 1.0 );
-    Pt = Pt - floor(Pt * ( 1.0 / 71.0 )) * 71.0;
-    Pt += vec2( 26.0, 161.0 ).xyxy;
-    Pt *= Pt;
-    Pt = Pt.xzxz * Pt.yyww;
-    vec4 hash_x = fract( Pt * ( 1.0 / 951.135664 ) );
-    vec4 hash_y = fract( Pt * ( 1.0 / 642.949883 ) );
-
-    // calculate the gradient results
-    vec4 grad_x = hash_x - 0.49999;
-    vec4 grad_y = hash_y - 0.49999;
-    vec4 grad_results = inversesqrt( grad_x * grad_x + grad_y * grad_y ) * ( grad_x * Pf_Pfmin1.xzxz + grad_y * Pf_Pfmin1.yyww );
-
-    // Classic Perlin Interpolation
-    grad_results *= 1.4142135623730950488016887242097;  // scale things to a strict -1.0->1.0 range  *= 1.0/sqrt(0.5)
-    vec2 blend = Pf_Pfmin1.xy * Pf_Pfmin1.xy * Pf_Pfmin1.xy * (Pf_Pfmin1.xy * (Pf_Pfmin1.xy * 6.0 - 15.0) + 10.0);
-    vec4 blend2 = vec4( blend, vec2( 1.0 - blend ) );
-    return dot( grad_results, blend2.zxzx * blend2.wwyy );
-}
-
-// adapted from texturing and modeling a procedural approach
-float hybridMultiFractal(vec2 point) {
-    // set up
-    float H = 0.25;
-    float offset =  0.7;
-    float lacunarity = 2;
-    float octaves = 8;
-    float frequency = 0.55;// 0.45; //0.7;
-
-    float value = 1.0;
-    float signal = 0.0;
-    float rmd = 0.0;
-    float pwHL = pow(lacunarity, -H);
-    float pwr = pwHL;
-    float weight = 0.;
-
-    // get zeroth octave of function
-    value = pwr*(Perlin2D(point * frequency)+offset);
-    weight = value;
-    point *= lacunarity;
-    pwr *= pwHL;
-
-    // start from 1 and start weighing the signals
-    for (int i=1; i<octaves; i++) {
-        weight = weight > 1.0f ? 1.0f : weight;
-
-        signal = pwr*(Perlin2D(point * frequency)+offset);
-        
-        value += weight*signal;
-        weight *= signal;
-        pwr *= pwHL;
-        point *= lacunarity;
-    }
-
-    return value;
-}
-
 void main() {
 
-    vec3 position = vposition + (vec3(viewPos.x, viewPos.y, 0)); // displace the position so that we get an infinite world
+    // the vertex is the index into the (quads + 1)^2 grid of the chunk, the same expression as buildChunk places
+    // the samples with, so the vertices on the edge of two chunks land on exactly the same spot
+    ivec2 local = ivec2(gl_VertexID % chunkCols, gl_VertexID / chunkCols);
+    ivec2 sample = chunkOrigin + local;
+    vec3 position = vec3(vec2(sample) * chunkSpacing, float(heightBase + int(vheight)) * heightStep);
 
-    // we texture based on the perturbed position now so that the texturing scale with the infinite world
-    // we get the tex coordinate from the perturbed position normalised in [0, 1], so we bring to 0 to f_width 
+    // we texture based on the world position so that the texturing scales with the infinite world
+    // we get the tex coordinate from the position normalised in [0, 1], so we bring to 0 to f_width 
     // and we divide by f_width
     uv = (position.xy + 20/2) / 20; 
 
@@ -99,24 +45,19 @@ void main() {
     int num_tiles = 40; 
     uv = (uv * num_tiles); // make opengl repeat the texture so we get higher resolution 
     
-    // Calculate height
-    float h = hybridMultiFractal(position.xy);
-    height = h;
-
-    // find the normal by finding two vectors on the plane next to the point and cross producting them
-    vec3 A = vec3(position.x + 1.0f, position.y       , hybridMultiFractal(position.xy + (1, 0))    );
-    vec3 B = vec3(position.x - 1.0f, position.y       , hybridMultiFractal(position.xy + (-1, 0))   );
-    vec3 C = vec3(position.x       , position.y + 1.0f, hybridMultiFractal(position.xy + (0, 1))    );
-    vec3 D = vec3(position.x       , position.y - 1.0f, hybridMultiFractal(position.xy + (0, -1))   );
-    vec3 n = normalize( cross(A - B , C - D) );
-    normal = n;
+    height = position.z;
+    vec2 n = max(vnormal / 127.0, -1.0);
+    normal = normalize(vec3(n, 1.0 - abs(n.x) - abs(n.y)));
 
     // the up vector is (0, 0, 1) so the dot of the top and the normal vector is normal.z
     // we take acos to get the actual gradient
     slope = acos(normal.z);
+    wetness = vwetness;
+
+    // the horizon map of the chunk has a texel on every vertex (see Horizon.h)
+    horizonUV = (vec2(local) + 0.5) / float(chunkCols);
 
-    // give new disturbed position
-    fragPos = position.xyz + vec3(0,0,h);
+    fragPos = position;
     gl_Position = P*V*M*vec4(fragPos, 1.0f);
 
     // set distance from camera to scale the visibility
@@ -0,0 +1,20 @@
+R"(
+// shared by every program, inserted after the #version line (see UniformBlocks.h, the layouts have to match)
+
+// the camera of the pass being drawn, written once per pass
+layout(std140) uniform Camera {
+    mat4 V;
+    mat4 P;
+    vec3 viewPos;
+    float time;
+    vec3 clipPlaneNormal;
+    float clipPlaneHeight;
+};
+
+// constants of the world, written once
+layout(std140) uniform Material {
+    vec3 skyColor;
+    float waterHeight;
+    vec3 lightPos;
+};
+)"
@@ -6,11 +6,19 @@
 using namespace OpenGP;
 
 #include <climits>
+#include <cstring>
 #include <math.h>
 #include <iostream>
 
-#include "loadTexture.h"
-
-const unsigned indexRestart = UINT_MAX;
+// whether the context has an extension, from the list of a core profile
+inline bool hasGLExtension(const char *name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0) return true;
+    }
+    return false;
+}
 
 #endif
\ No newline at end of file
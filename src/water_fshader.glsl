@@ -5,40 +5,17 @@ out vec4 FragColor;
 in vec4 clipSpaceCoordinates;
 in vec2 uv;
 in vec3 toCameraPos;
+in vec4 reflectionClipCoordinates;
+in vec3 worldPos;
+in vec2 waveUV;
+in float waveFade;
 
 uniform sampler2D reflectionTexture;
 uniform sampler2D refractionTexture;
 uniform sampler2D waterTexture;
-uniform float time;
-
-float Perlin2D( vec2 P ) {
-    //  https://github.com/BrianSharpe/Wombat/blob/master/Perlin2D.glsl
-
-    // establish our grid cell and unit position
-    vec2 Pi = floor(P);
-    vec4 Pf_Pfmin1 = P.xyxy - vec4( Pi, Pi + 1.0 );
-
-    // calculate the hash
-    vec4 Pt = vec4( Pi.xy, Pi.xy + 1.0 );
-    Pt = Pt - floor(Pt * ( 1.0 / 71.0 )) * 71.0;
-    Pt += vec2( 26.0, 161.0 ).xyxy;
-    Pt *= Pt;
-    Pt = Pt.xzxz * Pt.yyww;
-    vec4 hash_x = fract( Pt * ( 1.0 / 951.135664 ) );
-    vec4 hash_y = fract( Pt * ( 1.0 / 642.949883 ) );
-
-    // calculate the gradient results
-    vec4 grad_x = hash_x - 0.49999;
-    vec4 grad_y = hash_y - 0.49999;
-    vec4 grad_results = inversesqrt( grad_x * grad_x + grad_y * grad_y ) * ( grad_x * Pf_Pfmin1.xzxz + grad_y * Pf_Pfmin1.yyww );
-
-    // Classic Perlin Interpolation
-    grad_results *= 1.4142135623730950488016887242097;  // scale things to a strict -1.0->1.0 range  *= 1.0/sqrt(0.5)
-    vec2 blend = Pf_Pfmin1.xy * Pf_Pfmin1.xy * Pf_Pfmin1.xy * (Pf_Pfmin1.xy * (Pf_Pfmin1.xy * 6.0 - 15.0) + 10.0);
-    vec4 blend2 = vec4( blend, vec2( 1.0 - blend ) );
-    return dot( grad_results, blend2.zxzx * blend2.wwyy );
-}
-
+// the normals of the ocean simulation with the foam in alpha (see Ocean.h)
+uniform sampler2D normalMap;
+// time, viewPos and lightPos come from the uniform blocks
 
 void main() {  
 
@@ -54,19 +31,25 @@ void main() {
     // now we change the [-1, 1] coodinates to [0, 1] so that we can use it to sample the texture
     vec2 ndc_uv = ndc / 2.0 + 0.5;
     
-    // we invert the coordinates to sample for the reflection
-    vec2 reflectionUV = vec2(ndc_uv.x, 1.0-ndc_uv.y);   // need to change y as inverted (opengl coordinate system problems)
+    // the reflection is sampled where the mirrored camera saw the surface, for a reflection rendered this frame
+    // that is the screen position with y inverted, for an older one it reprojects it
+    vec2 reflectionUV = reflectionClipCoordinates.xy/reflectionClipCoordinates.w / 2.0 + 0.5;
     vec2 refractionUV = vec2(ndc_uv.x, ndc_uv.y); // no need to change y
 
-    vec4 reflectColor = texture(reflectionTexture, vec2(
-        reflectionUV.x + 0.02*Perlin2D(vec2(reflectionUV.x, time/2)), 
-        reflectionUV.y + 0.02*Perlin2D(vec2(time/2, reflectionUV.y))
-    ));
-    
-    vec4 refractColor = texture(refractionTexture, refractionUV);
+    // the waves bend the reflection and, less, the refraction
+    vec4 wave = texture(normalMap, waveUV);
+    vec3 normal = normalize(mix(vec3(0.0, 0.0, 1.0), 2.0 * wave.xyz - 1.0, waveFade));
+    vec4 reflectColor = texture(reflectionTexture, reflectionUV + 0.25 * normal.xy);
+    vec4 refractColor = texture(refractionTexture, refractionUV + 0.1 * normal.xy);
 
     FragColor = mix(reflectColor, refractColor, /*0.3*/ 0.6); // more reflection, the smaller the number
     FragColor = mix(FragColor, waterColor, 0.2); // add displacement based on the layered periodic coordinates
     FragColor = mix(FragColor, vec4(0.0, 0.1, 0.2, 1.0), 0.2); // add a bluish color
+
+    // the sun on the waves and the foam on the crests that fold over
+    vec3 toLight = normalize(lightPos - worldPos), toCamera = normalize(viewPos - worldPos);
+    float glint = pow(max(dot(reflect(-toLight, normal), toCamera), 0.0), 64.0);
+    FragColor += vec4(vec3(0.4 * glint), 0.0);
+    FragColor = mix(FragColor, vec4(0.9, 0.95, 1.0, 1.0), 0.5 * wave.a * waveFade);
 }
 )"
\ No newline at end of file
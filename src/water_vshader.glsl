@@ -7,20 +7,40 @@ in vec2 vtexcoord;
 out vec4 clipSpaceCoordinates;
 out vec2 uv;
 out vec3 toCameraPos;
+out vec4 reflectionClipCoordinates;
+out vec3 worldPos;
+out vec2 waveUV;
+out float waveFade;
 
+// V, P and viewPos (the camera position, we translate the grid using it...) come from the Camera block
 uniform mat4 M;
-uniform mat4 V;
-uniform mat4 P;
-uniform vec3 viewPos; // camera position, we translate the grid using it...
+// the camera the reflection texture was rendered with, it can be from an earlier frame (see WaterQuality.h)
+uniform mat4 reflectionProjectionView;
+
+// the ocean maps tile over patchSize (see Ocean.h), the grid is gridExtent around the camera
+uniform sampler2D displacementMap;
+uniform float patchSize;
+uniform float gridExtent;
+// the finest spacing of the grid, it follows the camera in these steps so that its vertices do not slide over the waves
+uniform float gridSnap;
 
 
 void main() {
+    vec3 surface = vposition + vec3(floor(viewPos.xy / gridSnap) * gridSnap, 0);
+    // the cells get larger away from the camera, the waves fade out before they are larger than the waves
+    waveFade = 1.0 - smoothstep(0.4, 1.0, length(vposition.xy) / gridExtent);
+    waveUV = surface.xy / patchSize;
+    vec3 displacement = textureLod(displacementMap, waveUV, 0.0).xyz * waveFade;
+
     // Set gl_Position
-    vec4 position = P*V*M*vec4(vposition + (vec3(viewPos.x, viewPos.y, 0)), 1.0f);
+    vec4 worldPosition = M*vec4(surface + displacement, 1.0f);
+    vec4 position = P*V*worldPosition;
+    reflectionClipCoordinates = reflectionProjectionView*worldPosition;
 
     clipSpaceCoordinates = position;
     gl_Position = position;
     uv = vtexcoord;
     toCameraPos = viewPos - position.xyz;
+    worldPos = worldPosition.xyz;
 }
-)"
\ No newline at end of file
+)"
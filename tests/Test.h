@@ -0,0 +1,58 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// the same kind of registry as bench/Bench.h: every test_<group>.cpp file adds its tests to its group, `tests` runs
+// all of them and `tests <group>` one group, which is how ctest runs them. A failed check prints where it is and
+// makes the test fail, tests exits with 1 when any test failed
+struct Test {
+    std::string group, name;
+    std::function<void()> run;
+};
+
+inline std::vector<Test> &tests() {
+    static std::vector<Test> registry;
+    return registry;
+}
+
+struct TestRegistrar {
+    TestRegistrar(const char *group, const char *name, std::function<void()> run) {
+        tests().push_back(Test{ group, name, run });
+    }
+};
+
+#define TEST(group, name) \
+    static void group##_##name(); \
+    static TestRegistrar group##_##name##_registrar(#group, #name, group##_##name); \
+    static void group##_##name()
+
+inline int &checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline bool checkTrue(bool ok, const char *expression, const char *file, int line) {
+    if (!ok) {
+        ++checkFailures();
+        std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+    }
+    return ok;
+}
+
+// for counts of bad samples and the like, prints the value it got
+template <typename A, typename B>
+inline bool checkEqual(const A &actual, const B &expected, const char *expression, const char *file, int line) {
+    if (actual == expected) return true;
+    ++checkFailures();
+    std::cerr << file << ":" << line << ": check failed: " << expression << " is " << actual << ", expected " << expected << std::endl;
+    return false;
+}
+
+#define CHECK(expression) checkTrue((expression), #expression, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected) checkEqual((actual), (expected), #actual, __FILE__, __LINE__)
+
+#endif
@@ -0,0 +1,18 @@
+#include "Test.h"
+
+int main(int argc, char** argv) {
+    std::string group = argc > 1 ? argv[1] : "";
+    int run = 0, failed = 0;
+    for (auto &test : tests()) {
+        if (!group.empty() && test.group != group) continue;
+        int before = checkFailures();
+        test.run();
+        bool ok = checkFailures() == before;
+        std::cout << (ok ? "ok   " : "FAIL ") << test.group << "." << test.name << std::endl;
+        ++run;
+        if (!ok) ++failed;
+    }
+    std::cout << run - failed << " of " << run << " tests passed" << std::endl;
+    // an unknown group runs nothing, which is a failure too
+    return failed || !run ? 1 : 0;
+}
@@ -0,0 +1,29 @@
+#include "Test.h"
+
+#include <random>
+
+#include "Camera.h"
+#include "Matrices.h"
+
+// the view and projection matrices of Camera for random angles, positions and fields of view are the written out
+// matrices of bench/Matrices.h
+TEST(camera, matrices_match_reference) {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    Camera camera(1920, 1080);
+    int mismatches = 0;
+    for (int k = 0; k < 1024; ++k) {
+        CameraState state;
+        state.position = OpenGP::Vec3(100.0f * unit(random) - 50.0f, 100.0f * unit(random) - 50.0f, 4.0f * unit(random));
+        state.yaw = 2.0f * (float)M_PI * unit(random);
+        state.pitch = 2.8f * unit(random) - 1.4f;
+        state.fov = 40.0f + 60.0f * unit(random);
+        camera.setState(state);
+        OpenGP::Mat4x4 view = lookAtMatrix(camera.cameraPos, camera.cameraPos + camera.cameraFront, camera.cameraUp);
+        OpenGP::Mat4x4 projection = perspectiveMatrix(camera.fov, camera.aspectRatio, camera.nearPlane, camera.farPlane);
+        if (!camera.viewMatrix().isApprox(view, 1e-5f) || !camera.projectionMatrix().isApprox(projection, 1e-5f)) {
+            ++mismatches;
+        }
+    }
+    CHECK_EQUAL(mismatches, 0);
+}
@@ -0,0 +1,36 @@
+#include "Test.h"
+
+#include "ChunkData.h"
+#include "TerrainLOD.h"
+
+// the quantized heights of a chunk stay inside its bounds, and vertices on the edge of two chunks decode to the
+// same height in both, or cracks would open between them
+TEST(chunks, quantized_edges_meet) {
+    HeightfieldGenerator generator;
+    LODSettings settings; // the ones of Terrain
+    const int quads = settings.quads, cols = quads + 1;
+
+    int outOfBounds = 0, edgeMismatches = 0;
+    for (int level = 0; level <= 4; ++level) {
+        for (int y = -2; y < 2; ++y) {
+            for (int x = -2; x < 2; ++x) {
+                ChunkData chunk, east, north;
+                buildChunk(generator, ChunkKey{ level, x, y }, quads, settings.spacing, chunk);
+                buildChunk(generator, ChunkKey{ level, x + 1, y }, quads, settings.spacing, east);
+                buildChunk(generator, ChunkKey{ level, x, y + 1 }, quads, settings.spacing, north);
+                for (int k = 0; k < cols * cols; ++k) {
+                    float h = decodeHeight(chunk.heightBase, chunk.vertices[k].height);
+                    outOfBounds += h < chunk.minHeight || h > chunk.maxHeight;
+                }
+                for (int s = 0; s < cols; ++s) {
+                    const TerrainVertex &a = chunk.vertices[index(quads, s, cols)], &b = east.vertices[index(0, s, cols)];
+                    const TerrainVertex &c = chunk.vertices[index(s, quads, cols)], &d = north.vertices[index(s, 0, cols)];
+                    edgeMismatches += decodeHeight(chunk.heightBase, a.height) != decodeHeight(east.heightBase, b.height);
+                    edgeMismatches += decodeHeight(chunk.heightBase, c.height) != decodeHeight(north.heightBase, d.height);
+                }
+            }
+        }
+    }
+    CHECK_EQUAL(outOfBounds, 0);
+    CHECK_EQUAL(edgeMismatches, 0);
+}
@@ -0,0 +1,51 @@
+#include "Test.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "BlockCompression.h"
+#include "TextureContainer.h"
+
+// flat colours and sizes that are not a multiple of the block size have to come back (nearly) exact
+TEST(compression, flat_colours_roundtrip) {
+    int sizes[][2] = { { 4, 4 }, { 5, 3 }, { 1, 1 }, { 13, 9 } };
+    for (auto &size : sizes) {
+        int w = size[0], h = size[1];
+        std::vector<unsigned char> rgba(4 * w * h);
+        for (int i = 0; i < w * h; ++i) {
+            rgba[4 * i + 0] = 200;
+            rgba[4 * i + 1] = 100;
+            rgba[4 * i + 2] = 50;
+            rgba[4 * i + 3] = 255;
+        }
+        for (BlockFormat format : { BLOCK_BC1, BLOCK_BC3 }) {
+            std::vector<unsigned char> blocks(compressedSize(format, w, h)), decoded(rgba.size());
+            compressImage(rgba.data(), w, h, format, blocks.data());
+            decompressImage(blocks.data(), w, h, format, decoded.data());
+            // 5:6:5 endpoints, a flat colour is off by at most the quantization step
+            int wrong = 0;
+            for (size_t k = 0; k < rgba.size(); ++k) wrong += std::abs((int)rgba[k] - decoded[k]) > 8;
+            CHECK_EQUAL(wrong, 0);
+        }
+    }
+}
+
+// an opaque image is BC1, one with a real alpha channel BC3
+TEST(compression, block_format_follows_alpha) {
+    std::vector<unsigned char> opaque(4 * 16, 255), transparent(4 * 16, 255);
+    transparent[3] = 0;
+    CHECK(chooseBlockFormat(opaque.data(), 16) == BLOCK_BC1);
+    CHECK(chooseBlockFormat(transparent.data(), 16) == BLOCK_BC3);
+}
+
+// the mip chain of a container entry ends at 1x1 and adds up to the entry
+TEST(compression, container_mip_chain) {
+    ContainerEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.format = BLOCK_BC1;
+    entry.width = 512;
+    entry.height = 256;
+    entry.levels = 10;
+    CHECK(containerLevelWidth(entry, 9) == 1 && containerLevelHeight(entry, 9) == 1);
+    CHECK(containerLevelOffset(entry, 1) == compressedSize(BLOCK_BC1, 512, 256));
+}
@@ -0,0 +1,42 @@
+#include "Test.h"
+
+#include "Frustum.h"
+#include "Matrices.h"
+#include "TerrainLOD.h"
+
+// camera at the origin looking down +x, z up
+TEST(culling, frustum) {
+    using OpenGP::Vec3;
+    Frustum frustum(perspectiveMatrix(45.0f, 1.0f, 0.1f, 100.0f) * lookAtMatrix(Vec3(0, 0, 0), Vec3(1, 0, 0), Vec3(0, 0, 1)));
+    CHECK(frustum.intersects(Vec3(4, -1, -1), Vec3(6, 1, 1)));         // straight ahead
+    CHECK(!frustum.intersects(Vec3(-6, -1, -1), Vec3(-4, 1, 1)));      // behind
+    CHECK(!frustum.intersects(Vec3(4, 10, -1), Vec3(6, 12, 1)));       // far to the left
+    CHECK(!frustum.intersects(Vec3(4, -1, 10), Vec3(6, 1, 12)));       // far above
+    CHECK(!frustum.intersects(Vec3(200, -1, -1), Vec3(210, 1, 1)));    // past the far plane
+    CHECK(frustum.intersects(Vec3(-1, -1, -1), Vec3(1, 1, 1)));        // contains the camera
+    CHECK(frustum.intersects(Vec3(5, 1.5f, -1), Vec3(6, 3, 1)));       // straddles the left plane
+}
+
+// the water planes of main.cpp with the water at 0.5
+TEST(culling, water_planes) {
+    using OpenGP::Vec3;
+    float waterHeight = 0.5f;
+    CullPlane reflection = clipPlane(Vec3(0, 0, 1), -waterHeight);  // keeps what is above the water
+    CullPlane refraction = clipPlane(Vec3(0, 0, -1), waterHeight);  // keeps what is under the water
+    CHECK(reflection.maxDistance(Vec3(0, 0, -2), Vec3(1, 1, 0.2f)) < 0);   // under water, no reflection
+    CHECK(refraction.maxDistance(Vec3(0, 0, -2), Vec3(1, 1, 0.2f)) >= 0);
+    CHECK(refraction.maxDistance(Vec3(0, 0, 0.8f), Vec3(1, 1, 3)) < 0);    // above water, no refraction
+    CHECK(reflection.maxDistance(Vec3(0, 0, 0.8f), Vec3(1, 1, 3)) >= 0);
+    CHECK(reflection.maxDistance(Vec3(0, 0, 0), Vec3(1, 1, 1)) >= 0);      // crosses the water, drawn by both
+    CHECK(refraction.maxDistance(Vec3(0, 0, 0), Vec3(1, 1, 1)) >= 0);
+}
+
+// chunk boxes tile the ground plane exactly
+TEST(culling, chunk_boxes) {
+    using OpenGP::Vec3;
+    LODSettings settings;
+    Vec3 lo, hi, lo2, hi2;
+    chunkBox(settings, ChunkKey{ 2, -3, 5 }, -1.0f, 2.0f, lo, hi);
+    chunkBox(settings, ChunkKey{ 2, -2, 5 }, -1.0f, 2.0f, lo2, hi2);
+    CHECK(hi.x() == lo2.x() && lo.y() == lo2.y() && lo.z() == -1.0f && hi.z() == 2.0f);
+}
@@ -0,0 +1,123 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "ChunkData.h"
+#include "Erosion.h"
+#include "TerrainLOD.h"
+#include "TileStore.h"
+
+static bool sameTile(const ErosionTile &a, const ErosionTile &b) {
+    return a.size == b.size && a.delta == b.delta && a.wetness == b.wetness;
+}
+
+// the eroded world made on 1, 4 and every thread (the caller and pools of 0, 3 and N - 1 workers, so the tiles come
+// out in different orders on different threads) has to be the same bit for bit, and stay within maxChange
+TEST(erosion, same_on_every_thread_count) {
+    LODSettings lod;
+    HeightfieldParams params;
+    ErosionParams erosion;
+    unsigned int hardware = std::max(2u, std::thread::hardware_concurrency());
+    unsigned int workers[3] = { 0, 3, hardware - 1 };
+    const int x0 = -300, y0 = -300, cols = 600; // level 0 samples, a few tiles each way
+    std::vector<float> grids[3], wetness[3];
+    for (int run = 0; run < 3; ++run) {
+        ErosionField field(params, erosion, lod.spacing);
+        std::unique_ptr<ThreadPool> pool(workers[run] ? new ThreadPool(workers[run]) : nullptr);
+        field.prepare(x0 * lod.spacing, y0 * lod.spacing, (x0 + cols) * lod.spacing, (y0 + cols) * lod.spacing, pool.get());
+        int prepared = field.stats.tilesEroded;
+        grids[run].assign(cols * cols, 0.0f);
+        wetness[run].assign(cols * cols, 0.0f);
+        field.apply(x0, y0, cols, cols, lod.spacing, grids[run].data(), wetness[run].data());
+        CHECK_EQUAL(field.stats.tilesEroded, prepared); // prepare made every tile the grid needs
+    }
+    for (int run = 1; run < 3; ++run) {
+        CHECK(memcmp(grids[run].data(), grids[0].data(), grids[0].size() * sizeof(float)) == 0);
+        CHECK(memcmp(wetness[run].data(), wetness[0].data(), wetness[0].size() * sizeof(float)) == 0);
+    }
+    float maxChange = 0.0f;
+    for (float d : grids[0]) maxChange = std::max(maxChange, std::abs(d));
+    CHECK(maxChange > 0.0f && maxChange <= erosion.maxChange);
+}
+
+// chunks of the eroded world meet: neighbours of a level along their edges, and every level with the one under it
+// on the samples they share
+TEST(erosion, chunks_meet) {
+    LODSettings lod;
+    HeightfieldParams params;
+    HeightfieldGenerator generator(nullptr, params);
+    ErosionField field(params, ErosionParams(), lod.spacing);
+    auto built = [&](ChunkKey key) {
+        std::unique_ptr<ChunkData> chunk(new ChunkData());
+        buildChunk(generator, field, key, lod.quads, lod.spacing, *chunk);
+        return chunk;
+    };
+    const int quads = lod.quads, cols = quads + 1;
+    auto heightAt = [&](const ChunkData &chunk, int i, int j) {
+        return decodeHeight(chunk.heightBase, chunk.vertices[index(i, j, cols)].height);
+    };
+    for (int level = 0; level < 3; ++level) {
+        std::unique_ptr<ChunkData> chunk = built(ChunkKey{ level, -1, 0 });
+        std::unique_ptr<ChunkData> east = built(ChunkKey{ level, 0, 0 });
+        std::unique_ptr<ChunkData> north = built(ChunkKey{ level, -1, 1 });
+        int edgeMismatches = 0;
+        for (int s = 0; s <= quads; ++s) {
+            edgeMismatches += heightAt(*chunk, quads, s) != heightAt(*east, 0, s);
+            edgeMismatches += chunk->vertices[index(quads, s, cols)].wetness != east->vertices[index(0, s, cols)].wetness;
+            edgeMismatches += heightAt(*chunk, s, quads) != heightAt(*north, s, 0);
+        }
+        CHECK_EQUAL(edgeMismatches, 0);
+
+        // sample k of the parent lands on sample 2k of the child in its corner
+        std::unique_ptr<ChunkData> parent = built(ChunkKey{ level + 1, -1, 0 });
+        int levelMismatches = 0;
+        for (int j = 0; j <= quads / 2; ++j) {
+            for (int i = 0; i <= quads / 2; ++i) {
+                levelMismatches += heightAt(*parent, i + quads / 2, j) != heightAt(*chunk, 2 * i, 2 * j);
+            }
+        }
+        CHECK_EQUAL(levelMismatches, 0);
+    }
+}
+
+// eroded tiles go through the tile store and come back the same
+TEST(erosion, tile_store_roundtrip) {
+    LODSettings lod;
+    HeightfieldParams params;
+    ErosionParams erosion;
+    auto store = std::make_shared<TileStore>("erosion_tile_store", params, lod.quads, lod.spacing, erosionKey(erosion));
+    {
+        ErosionField writer(params, erosion, lod.spacing, store);
+        std::shared_ptr<const ErosionTile> made = writer.tile(5, -3);
+        store->flush();
+        ErosionField reader(params, erosion, lod.spacing, store);
+        std::shared_ptr<const ErosionTile> read = reader.tile(5, -3);
+        CHECK(reader.stats.tilesFromStore == 1 && reader.stats.tilesEroded == 0 && sameTile(*made, *read));
+    }
+    CHECK_EQUAL(store->stats.writeFailures, 0);
+    remove((store->directory + "/erosion_5_-3.vwte").c_str());
+#ifndef _WIN32
+    rmdir(store->directory.c_str());
+    rmdir("erosion_tile_store");
+#endif
+}
+
+// another seed is another eroded world
+TEST(erosion, seed_changes_tiles) {
+    LODSettings lod;
+    HeightfieldParams params, other;
+    other.seed = 42;
+    ErosionParams erosion;
+    ErosionTile original, seeded;
+    float spacing = lod.spacing * erosion.spacingFactor;
+    erodeTile(HeightfieldGenerator(nullptr, params), erosion, spacing, 0, 0, original);
+    erodeTile(HeightfieldGenerator(nullptr, other), erosion, spacing, 0, 0, seeded);
+    CHECK(!sameTile(original, seeded));
+}
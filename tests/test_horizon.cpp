@@ -0,0 +1,124 @@
+#include "Test.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "ChunkData.h"
+#include "Erosion.h"
+#include "Horizon.h"
+#include "TerrainLOD.h"
+#include "TileStore.h"
+
+namespace {
+
+struct HorizonWorld {
+    LODSettings lod;
+    HeightfieldParams params;
+    HeightfieldGenerator generator;
+    ErosionParams erosionParams;
+    ErosionField erosion;
+    HorizonParams horizons;
+
+    HorizonWorld() : generator(nullptr, params), erosion(params, erosionParams, lod.spacing) {}
+
+    std::unique_ptr<ChunkData> baked(ChunkKey key) {
+        std::unique_ptr<ChunkData> chunk(new ChunkData());
+        buildChunk(generator, erosion, key, lod.quads, lod.spacing, *chunk);
+        bakeHorizons(generator, &erosion, horizons, lod.quads, lod.spacing, *chunk);
+        return chunk;
+    }
+
+    unsigned char texel(const ChunkData &chunk, int i, int j, int d) const {
+        int cols = lod.quads + 1;
+        return chunk.horizons[((d / 4) * cols * cols + index(i, j, cols)) * 4 + d % 4];
+    }
+};
+
+} // namespace
+
+// neighbouring chunks agree on the texels of their shared edges
+TEST(horizon, edges_meet) {
+    HorizonWorld world;
+    const int quads = world.lod.quads, cols = quads + 1;
+    for (int level = 0; level < 3; ++level) {
+        std::unique_ptr<ChunkData> chunk = world.baked(ChunkKey{ level, -1, 0 });
+        std::unique_ptr<ChunkData> east = world.baked(ChunkKey{ level, 0, 0 });
+        std::unique_ptr<ChunkData> north = world.baked(ChunkKey{ level, -1, 1 });
+        CHECK_EQUAL(chunk->horizons.size(), (size_t)world.horizons.directions * cols * cols);
+        int mismatches = 0;
+        for (int s = 0; s <= quads; ++s) {
+            for (int d = 0; d < world.horizons.directions; ++d) {
+                mismatches += world.texel(*chunk, quads, s, d) != world.texel(*east, 0, s, d);
+                mismatches += world.texel(*chunk, s, quads, d) != world.texel(*north, s, 0, d);
+            }
+        }
+        CHECK_EQUAL(mismatches, 0);
+    }
+}
+
+// the baked horizons stay close to the ones found by marching every sample of level 0 along each direction as far
+// as the coarsest grid reaches, for a grid of vertices of a level 0 chunk
+TEST(horizon, close_to_march) {
+    HorizonWorld world;
+    const LODSettings &lod = world.lod;
+    const int quads = lod.quads;
+    std::unique_ptr<ChunkData> chunk = world.baked(ChunkKey{ 0, 0, 0 });
+    const float reach = (float)(world.horizons.steps * quads) * lod.spacing;
+    double sumError = 0.0;
+    int samples = 0;
+    for (int j = 0; j <= quads; j += 8) {
+        for (int i = 0; i <= quads; i += 8) {
+            float x = (float)i * lod.spacing, y = (float)j * lod.spacing;
+            for (int d = 0; d < world.horizons.directions; ++d) {
+                int dx, dy;
+                horizon::direction(d, world.horizons.directions, dx, dy);
+                float length = std::sqrt((float)(dx * dx + dy * dy));
+                std::vector<float> xs(1, x), ys(1, y);
+                for (float t = lod.spacing; t <= reach; t += lod.spacing) {
+                    xs.push_back(x + t * dx / length);
+                    ys.push_back(y + t * dy / length);
+                }
+                std::vector<float> hs(xs.size());
+                world.generator.heights(xs.data(), ys.data(), hs.data(), (int)xs.size());
+                world.erosion.applyPoints(xs.data(), ys.data(), hs.data(), (int)xs.size());
+                float best = 0.0f;
+                for (size_t k = 1; k < hs.size(); ++k) best = std::max(best, (hs[k] - hs[0]) / ((float)k * lod.spacing));
+                float expected = best / std::sqrt(1.0f + best * best);
+                sumError += std::abs(world.texel(*chunk, i, j, d) / 255.0f - expected);
+                ++samples;
+            }
+        }
+    }
+    CHECK(sumError / samples < 0.03);
+}
+
+// a map goes through the tile store and comes back the same, and a tile written without one has none
+TEST(horizon, tile_store_roundtrip) {
+    HorizonWorld world;
+    const LODSettings &lod = world.lod;
+    std::unique_ptr<ChunkData> chunk = world.baked(ChunkKey{ 0, 0, 0 });
+    TileStore store("horizon_tile_store", world.params, lod.quads, lod.spacing, erosionKey(world.erosionParams));
+    store.write(*chunk);
+    ChunkData plain;
+    buildChunk(world.generator, world.erosion, ChunkKey{ 0, 1, 0 }, lod.quads, lod.spacing, plain);
+    store.write(plain);
+    store.flush();
+    ChunkData read;
+    CHECK(store.read(chunk->key, read) && read.horizonKey == horizonKey(world.horizons) &&
+          read.horizonBytes() == chunk->horizons.size() &&
+          memcmp(read.horizonData(), chunk->horizons.data(), chunk->horizons.size()) == 0);
+    CHECK(store.read(plain.key, read) && read.horizonKey == 0 && read.horizonBytes() == 0);
+    CHECK_EQUAL(store.stats.writeFailures, 0);
+    remove(store.path(chunk->key).c_str());
+    remove(store.path(plain.key).c_str());
+#ifndef _WIN32
+    rmdir(store.directory.c_str());
+    rmdir("horizon_tile_store");
+#endif
+}
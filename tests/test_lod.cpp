@@ -0,0 +1,47 @@
+#include "Test.h"
+
+#include <climits>
+
+#include "TerrainLOD.h"
+
+// the stitched seams are watertight at every view distance with every chunk built
+TEST(lod, seams_watertight) {
+    LODSettings settings;
+    settings.maxLevel = 6;
+    auto everything = [](const ChunkKey&) { return true; };
+    std::vector<ChunkKey> wanted;
+    std::vector<SelectedChunk> selected;
+    for (float radius : { 10.0f, 20.0f, 40.0f, 80.0f }) {
+        settings.viewRadius = radius;
+        selectChunks(settings, OpenGP::Vec3(3.7f, -12.2f, 3.0f), everything, wanted, selected);
+        CHECK(!selected.empty());
+        CHECK_EQUAL(countSeamMismatches(settings, selected, UINT_MAX), 0);
+    }
+}
+
+// the seams while chunks stream in: some wanted leaves are not built yet, so their parents are drawn instead and the
+// chunks around them have to follow. Each wanted level 1 leaf missing in turn, then a fifth of the chunks below
+// level 2 missing
+TEST(lod, seams_watertight_while_streaming) {
+    LODSettings settings;
+    settings.maxLevel = 6;
+    OpenGP::Vec3 camera(3.7f, -12.2f, 3.0f);
+    std::vector<ChunkKey> wanted, leaves;
+    std::vector<SelectedChunk> selected;
+    selectChunks(settings, camera, [](const ChunkKey&) { return true; }, wanted, selected);
+    for (const ChunkKey &key : wanted) {
+        if (key.level == 1) leaves.push_back(key);
+    }
+    CHECK(!leaves.empty());
+
+    int mismatches = 0;
+    for (const ChunkKey &missing : leaves) {
+        selectChunks(settings, camera, [&](const ChunkKey &key) { return !(key == missing); }, wanted, selected);
+        mismatches += countSeamMismatches(settings, selected, UINT_MAX);
+    }
+    CHECK_EQUAL(mismatches, 0);
+
+    auto fifthMissing = [](const ChunkKey &key) { return key.level >= 2 || ChunkKeyHash()(key) % 5 != 0; };
+    selectChunks(settings, camera, fifthMissing, wanted, selected);
+    CHECK_EQUAL(countSeamMismatches(settings, selected, UINT_MAX), 0);
+}
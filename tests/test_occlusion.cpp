@@ -0,0 +1,45 @@
+#include "Test.h"
+
+#include <cmath>
+
+#include "Matrices.h"
+#include "Occlusion.h"
+
+// camera at the origin looking down +x, z up, a wall at x = 5 from y = -1 to 1 and z = -1 to 1
+TEST(occlusion, wall) {
+    using OpenGP::Vec3;
+    OcclusionBuffer buffer(64, 64);
+    buffer.begin(perspectiveMatrix(45.0f, 1.0f, 0.1f, 100.0f) * lookAtMatrix(Vec3(0, 0, 0), Vec3(1, 0, 0), Vec3(0, 0, 1)));
+    buffer.addTriangle(Vec3(5, -1, -1), Vec3(5, 1, -1), Vec3(5, 1, 1));
+    buffer.addTriangle(Vec3(5, -1, -1), Vec3(5, 1, 1), Vec3(5, -1, 1));
+    buffer.finish();
+    CHECK(std::abs(buffer.depthAt(32, 32) - 5.0f) < 1e-3f);               // the view depth of the wall
+    CHECK(buffer.occluded(Vec3(8, -0.5f, -0.5f), Vec3(9, 0.5f, 0.5f)));     // behind it
+    CHECK(!buffer.occluded(Vec3(3, -0.5f, -0.5f), Vec3(4, 0.5f, 0.5f)));    // in front of it
+    CHECK(!buffer.occluded(Vec3(4.5f, -0.5f, -0.5f), Vec3(8, 0.5f, 0.5f))); // through it
+    CHECK(!buffer.occluded(Vec3(20, 3, -0.5f), Vec3(21, 5, 0.5f)));         // behind it but sticking out at the side
+    CHECK(!buffer.occluded(Vec3(-1, -0.5f, -0.5f), Vec3(8, 0.5f, 0.5f)));   // reaches behind the camera
+    CHECK(!buffer.occluded(Vec3(8, 60, -0.5f), Vec3(9, 61, 0.5f)));         // off the buffer
+}
+
+// a floor that reaches behind the camera is clipped at the near plane and still hides what is under it
+TEST(occlusion, floor_clipped_at_near_plane) {
+    using OpenGP::Vec3;
+    OcclusionBuffer buffer(64, 64);
+    buffer.begin(perspectiveMatrix(45.0f, 1.0f, 0.1f, 100.0f) * lookAtMatrix(Vec3(0, 0, 0), Vec3(1, 0, -0.5f), Vec3(0, 0, 1)));
+    buffer.addTriangle(Vec3(-10, -50, -1), Vec3(50, -50, -1), Vec3(50, 50, -1));
+    buffer.addTriangle(Vec3(-10, -50, -1), Vec3(50, 50, -1), Vec3(-10, 50, -1));
+    buffer.finish();
+    CHECK(buffer.occluded(Vec3(4, -0.5f, -3), Vec3(5, 0.5f, -2)));
+    CHECK(!buffer.occluded(Vec3(4, -0.5f, -1.5f), Vec3(5, 0.5f, -0.5f))); // sticks out of the floor
+}
+
+// an empty buffer hides nothing
+TEST(occlusion, empty) {
+    using OpenGP::Vec3;
+    OcclusionBuffer buffer(64, 64);
+    buffer.begin(perspectiveMatrix(45.0f, 1.0f, 0.1f, 100.0f) * lookAtMatrix(Vec3(0, 0, 0), Vec3(1, 0, 0), Vec3(0, 0, 1)));
+    buffer.finish();
+    CHECK(!buffer.occluded(Vec3(50, -0.5f, -0.5f), Vec3(51, 0.5f, 0.5f)));
+    CHECK(buffer.coverage() == 0.0f);
+}
@@ -0,0 +1,74 @@
+#include "Test.h"
+
+#include <cmath>
+#include <random>
+
+#include "OceanSimulation.h"
+
+// the vectorized, threaded 2D FFT against a direct double precision DFT of the same random field
+TEST(ocean, fft_matches_dft) {
+    const int n = 64;
+    ThreadPool pool(3);
+    ocean::FFTPlan plan(n);
+    std::vector<float> re(n * n), im(n * n), outRe(n * n), outIm(n * n);
+    std::mt19937 rng(99);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    for (int i = 0; i < n * n; ++i) {
+        re[i] = value(rng);
+        im[i] = value(rng);
+    }
+    std::vector<float> inRe = re, inIm = im;
+    ocean::inverseFFT2D(plan, re.data(), im.data(), outRe.data(), outIm.data(), &pool);
+
+    // the direct sum is separable, along u first
+    std::vector<double> rowRe(n * n, 0.0), rowIm(n * n, 0.0);
+    for (int r = 0; r < n; ++r) {
+        for (int v = 0; v < n; ++v) {
+            for (int u = 0; u < n; ++u) {
+                double angle = 2.0 * M_PI * ((u * r) % n) / n, c = std::cos(angle), s = std::sin(angle);
+                rowRe[r * n + v] += inRe[u * n + v] * c - inIm[u * n + v] * s;
+                rowIm[r * n + v] += inRe[u * n + v] * s + inIm[u * n + v] * c;
+            }
+        }
+    }
+    int wrong = 0;
+    for (int r = 0; r < n; ++r) {
+        for (int c = 0; c < n; ++c) {
+            double sumRe = 0.0, sumIm = 0.0;
+            for (int v = 0; v < n; ++v) {
+                double angle = 2.0 * M_PI * ((v * c) % n) / n, co = std::cos(angle), s = std::sin(angle);
+                sumRe += rowRe[r * n + v] * co - rowIm[r * n + v] * s;
+                sumIm += rowRe[r * n + v] * s + rowIm[r * n + v] * co;
+            }
+            // the result is transposed
+            double error = std::max(std::abs(sumRe - outRe[c * n + r]), std::abs(sumIm - outIm[c * n + r]));
+            if (error > 1e-3) ++wrong;
+        }
+    }
+    CHECK_EQUAL(wrong, 0);
+}
+
+// the maps have to tile, and the spectrum has to give the waves the height they were asked for
+TEST(ocean, maps) {
+    OceanParams params;
+    params.size = 128;
+    OceanSimulation simulation(params);
+    std::vector<float> displacement(3 * params.size * params.size);
+    std::vector<unsigned char> normals(4 * params.size * params.size);
+    for (float time : { 0.0f, 3.5f, 17.0f }) {
+        simulation.step(time, displacement.data(), normals.data());
+        // within a factor of two, it is a random field
+        float ratio = simulation.rmsHeight() / params.waveHeight;
+        CHECK(ratio >= 0.5f && ratio <= 2.0f);
+        int notFinite = 0;
+        for (float d : displacement) notFinite += !std::isfinite(d);
+        CHECK_EQUAL(notFinite, 0);
+    }
+
+    // the waves repeat after loopSeconds
+    std::vector<float> looped(displacement.size());
+    simulation.step(17.0f + params.loopSeconds, looped.data(), normals.data());
+    float drift = 0.0f;
+    for (size_t i = 0; i < looped.size(); ++i) drift = std::max(drift, std::abs(looped[i] - displacement[i]));
+    CHECK(drift <= 1e-2f * params.waveHeight);
+}
@@ -0,0 +1,54 @@
+#include "Test.h"
+
+#include <cmath>
+#include <random>
+
+#include "Rays.h"
+
+// the pyramid has to find the surface where it is: straight down onto known heights, hit points on the surface,
+// nothing earlier than the brute force march finds, and the same answers in a batch
+TEST(raycast, straight_down) {
+    HeightPyramid pyramid(raySpacing);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+    int wrong = 0;
+    for (int k = 0; k < 256; ++k) {
+        float x = position(rng), y = position(rng);
+        Ray down = { OpenGP::Vec3(x, y, 10.0f), OpenGP::Vec3(0.0f, 0.0f, -1.0f), 100.0f };
+        RayHit hit = pyramid.raycast(down);
+        wrong += !hit.hit || std::abs(hit.distance - (10.0f - pyramid.height(x, y))) > 1e-3f;
+    }
+    CHECK_EQUAL(wrong, 0);
+}
+
+TEST(raycast, camera_rays) {
+    HeightPyramid pyramid(raySpacing);
+    std::vector<Ray> rays = cameraRays(pyramid, 512, 11);
+    std::vector<RayHit> hits(rays.size());
+    pyramid.raycast(rays.data(), hits.data(), (int)rays.size());
+    int hitCount = 0, batchDiffers = 0, offSurface = 0, pastMarch = 0;
+    for (size_t k = 0; k < rays.size(); ++k) {
+        RayHit single = pyramid.raycast(rays[k]);
+        batchDiffers += single.hit != hits[k].hit || single.distance != hits[k].distance;
+        if (!hits[k].hit) continue;
+        ++hitCount;
+        const OpenGP::Vec3 &p = hits[k].position;
+        offSurface += std::abs(p.z() - pyramid.height(p.x(), p.y())) > 1e-3f;
+
+        // the march can step over a thin ridge and hit later, but never earlier
+        RayHit marched = marchRay(pyramid, rays[k], 0.5f * raySpacing);
+        pastMarch += marched.hit && marched.distance < hits[k].distance - 1e-3f;
+    }
+    CHECK(hitCount > 0);
+    CHECK_EQUAL(batchDiffers, 0);
+    CHECK_EQUAL(offSurface, 0);
+    CHECK_EQUAL(pastMarch, 0);
+}
+
+// a camera over a mountain cannot see through it
+TEST(raycast, line_of_sight) {
+    HeightPyramid pyramid(raySpacing);
+    OpenGP::Vec3 a(0.0f, 0.0f, pyramid.height(0.0f, 0.0f) + 50.0f);
+    CHECK(pyramid.lineOfSight(a, a - OpenGP::Vec3(0.0f, 0.0f, 10.0f)));
+    CHECK(!pyramid.lineOfSight(a, OpenGP::Vec3(0.0f, 0.0f, pyramid.height(0.0f, 0.0f) - 1.0f)));
+}
@@ -0,0 +1,72 @@
+#include "Test.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "ScatterData.h"
+
+static const float scatterWater = 0.5f; // World::waterHeight
+
+static bool sameTile(const ScatterTile &a, const ScatterTile &b) {
+    auto same = [](const std::vector<float> &u, const std::vector<float> &v) {
+        return u.size() == v.size() && (u.empty() || std::memcmp(u.data(), v.data(), u.size() * sizeof(float)) == 0);
+    };
+    return same(a.x, b.x) && same(a.y, b.y) && same(a.z, b.z) && same(a.yaw, b.yaw) && same(a.scale, b.scale);
+}
+
+// the placement has to be a function of the tile alone and has to stay in the bands of the terrain shader: the
+// same instances whichever thread builds a tile and in whatever order, every instance in its height and slope band
+// (with the feather) and inside the bounds of its tile
+TEST(scatter, placement) {
+    ScatterSettings settings(scatterWater);
+    HeightfieldGenerator generator;
+
+    std::vector<ScatterKey> keys;
+    for (int kind = 0; kind < NUM_SCATTER_KINDS; ++kind) {
+        for (int y = -3; y < 3; ++y) {
+            for (int x = -3; x < 3; ++x) keys.push_back(ScatterKey{ kind, x, y });
+        }
+    }
+
+    std::vector<ScatterTile> inOrder(keys.size()), onPool(keys.size());
+    for (size_t k = 0; k < keys.size(); ++k) buildScatterTile(generator, settings, keys[k], inOrder[k]);
+    ThreadPool pool(4);
+    pool.parallelFor(0, (int)keys.size(), 1, [&](int begin, int end) {
+        for (int k = end - 1; k >= begin; --k) buildScatterTile(generator, settings, keys[k], onPool[k]);
+    });
+
+    size_t instances = 0;
+    int differ = 0, outOfBand = 0, offSurface = 0, outOfTile = 0;
+    for (size_t k = 0; k < keys.size(); ++k) {
+        const ScatterTile &tile = inOrder[k];
+        const ScatterRule &rule = settings.rules[tile.key.kind];
+        differ += !sameTile(tile, onPool[k]);
+        instances += tile.size();
+        for (size_t i = 0; i < tile.size(); ++i) {
+            float x = tile.x[i], y = tile.y[i], h = tile.z[i], s = settings.normalStep;
+            float slope = scatterSlope(generator.height(x - s, y), generator.height(x + s, y),
+                                       generator.height(x, y - s), generator.height(x, y + s), s);
+            outOfBand += h < rule.lowLevel - rule.heightFeather || h > rule.highLevel + rule.heightFeather;
+            outOfBand += slope < rule.minSlope - rule.slopeFeather || slope > rule.maxSlope + rule.slopeFeather;
+            offSurface += std::abs(h - generator.height(x, y)) > 1e-4f;
+            outOfTile += x < tile.lo.x() || x > tile.hi.x() || y < tile.lo.y() || y > tile.hi.y() ||
+                         h < tile.lo.z() || h > tile.hi.z();
+        }
+    }
+    CHECK(instances > 0);
+    CHECK_EQUAL(differ, 0);
+    CHECK_EQUAL(outOfBand, 0);
+    CHECK_EQUAL(offSurface, 0);
+    CHECK_EQUAL(outOfTile, 0);
+}
+
+// the same field after flying away and back
+TEST(scatter, field_comes_back) {
+    ScatterField field(ScatterSettings(scatterWater), 2);
+    OpenGP::Vec3 home(2.0f, -3.0f, 1.0f), away(60.0f, 60.0f, 1.0f);
+    field.update(home, true);
+    size_t before = field.stats.instancesResident;
+    field.update(away, true);
+    field.update(home, true);
+    CHECK_EQUAL(field.stats.instancesResident, before);
+}
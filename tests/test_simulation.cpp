@@ -0,0 +1,93 @@
+#include "Test.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include "Simulation.h"
+
+static bool sameState(const CameraState &a, const CameraState &b) {
+    return std::memcmp(a.position.data(), b.position.data(), 3 * sizeof(float)) == 0 &&
+           a.yaw == b.yaw && a.pitch == b.pitch && a.fov == b.fov && a.speed == b.speed;
+}
+
+// a writer that fills both halves of a slot, a reader that must always see matching halves in order: the triple
+// buffer never hands out a torn or an older value
+TEST(simulation, triple_buffer) {
+    struct Pair { uint64_t a, b; };
+    TripleBuffer<Pair> buffer;
+    const uint64_t count = 200000;
+    std::thread writer([&]() {
+        for (uint64_t n = 1; n <= count; ++n) {
+            Pair &slot = buffer.writeSlot();
+            slot.a = n;
+            slot.b = 2 * n + 1;
+            buffer.publish();
+        }
+    });
+    uint64_t last = 0;
+    int torn = 0, older = 0;
+    while (last < count) {
+        if (!buffer.update()) continue;
+        const Pair &p = buffer.read();
+        torn += p.b != 2 * p.a + 1;
+        older += p.a <= last;
+        last = p.a;
+    }
+    writer.join();
+    CHECK_EQUAL(torn, 0);
+    CHECK_EQUAL(older, 0);
+}
+
+// the simulation has to be a function of its input alone: a run on the thread, with random keys and mouse motion
+// arriving whenever this thread gets to it, ends where the replay of its recorded ticks ends, bit for bit
+TEST(simulation, replay_matches_run) {
+    CameraState start;
+    Simulation simulation(start, 1.0 / 240.0);
+    simulation.motion.groundHeight = [](float x, float y) { return 0.2f * std::sin(x) * std::cos(y); };
+    simulation.record = true;
+    simulation.start();
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> key(0, 7), wait(0, 3000);
+    std::uniform_real_distribution<float> look(-20.0f, 20.0f);
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(400);
+    while (std::chrono::steady_clock::now() < until) {
+        simulation.setKey(1u << key(rng), rng() % 2 == 0);
+        simulation.addLook(look(rng), look(rng));
+        simulation.view();
+        std::this_thread::sleep_for(std::chrono::microseconds(wait(rng)));
+    }
+    simulation.stop();
+
+    CameraState replayed = Simulation::replay(simulation.motion, start, simulation.recording, simulation.tickSeconds);
+    CHECK(sameState(replayed, simulation.simulated()));
+    CHECK(sameState(replayed, Simulation::replay(simulation.motion, start, simulation.recording, simulation.tickSeconds)));
+    CHECK(simulation.recording.size() >= 60);
+}
+
+// one second of W at 30, 60 and 240 Hz covers the same ground
+TEST(simulation, distance_independent_of_tick_rate) {
+    CameraState start;
+    CameraMotion flat;
+    TickInput forward;
+    forward.keys = SIM_KEY_FORWARD;
+    const int rates[] = { 30, 60, 240 };
+    for (int rate : rates) {
+        CameraState moved = Simulation::replay(flat, start, std::vector<TickInput>(rate, forward), 1.0 / rate);
+        CHECK(std::abs((moved.position - start.position).norm() - start.speed) <= 1e-4f);
+    }
+}
+
+// five seconds of walking down into the ground stop at the clearance
+TEST(simulation, ground_clamp) {
+    CameraMotion ground;
+    ground.groundHeight = [](float, float) { return 1.0f; };
+    TickInput forward;
+    forward.keys = SIM_KEY_FORWARD;
+    CameraState low;
+    low.pitch = -1.0f;
+    low = Simulation::replay(ground, low, std::vector<TickInput>(600, forward), 1.0 / 120.0);
+    CHECK(std::abs(low.position.z() - (1.0f + ground.groundClearance)) <= 1e-5f);
+}
@@ -0,0 +1,24 @@
+#include "Test.h"
+
+#include <cstdio>
+
+#include "ImageCache.h"
+
+// the cache has to give back exactly what the decoder produced
+TEST(textures, cache_roundtrip) {
+    std::string cacheDir = "textures_cache";
+    std::string file = std::string(VIRTUALWORLD_TEXTURE_DIR) + "/snow.png";
+    TextureImage decoded, cached;
+    if (!CHECK(decodeImage(file, true, decoded)) || !CHECK(writeImageCache(cacheDir, decoded, true)) ||
+        !CHECK(readImageCache(cacheDir, file, true, cached))) {
+        return;
+    }
+    CHECK_EQUAL(cached.bytes, decoded.bytes);
+    CHECK_EQUAL(cached.levels, decoded.levels);
+    if (cached.bytes == decoded.bytes) {
+        int mismatches = 0;
+        for (size_t k = 0; k < decoded.bytes; ++k) mismatches += decoded.pixels[k] != cached.pixels[k];
+        CHECK_EQUAL(mismatches, 0);
+    }
+    remove(imageCachePath(cacheDir, file, true).c_str());
+}
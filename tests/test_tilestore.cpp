@@ -0,0 +1,73 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "ChunkData.h"
+#include "TerrainLOD.h"
+#include "TileStore.h"
+
+namespace {
+
+bool sameChunk(const ChunkData &a, const ChunkData &b) {
+    return a.key == b.key && a.heightBase == b.heightBase && a.minHeight == b.minHeight && a.maxHeight == b.maxHeight &&
+           a.clampedHeights == b.clampedHeights && a.vertexCount() == b.vertexCount() &&
+           memcmp(a.vertexData(), b.vertexData(), a.vertexCount() * sizeof(TerrainVertex)) == 0 &&
+           a.occluderHeights == b.occluderHeights;
+}
+
+void removeStore(const TileStore &store, const std::vector<ChunkKey> &keys) {
+    for (const ChunkKey &key : keys) remove(store.path(key).c_str());
+#ifndef _WIN32
+    rmdir(store.directory.c_str());
+    rmdir(store.directory.substr(0, store.directory.rfind('/')).c_str());
+#endif
+}
+
+} // namespace
+
+// a tile comes back as it was built, from the mapping, other seeds are other worlds and a damaged tile is not used
+TEST(tilestore, roundtrip) {
+    LODSettings lod; // the ones of Terrain
+    HeightfieldParams params, other;
+    other.seed = 42;
+    TileStore store("tilestore_tile_store", params, lod.quads, lod.spacing);
+    TileStore otherStore("tilestore_tile_store", other, lod.quads, lod.spacing);
+    CHECK(store.directory != otherStore.directory);
+
+    std::vector<ChunkKey> keys = { { 0, 0, 0 }, { 2, -1, 3 } };
+    HeightfieldGenerator generator(nullptr, params);
+    for (const ChunkKey &key : keys) {
+        ChunkData built, read;
+        CHECK(!store.read(key, read));
+        buildChunk(generator, key, lod.quads, lod.spacing, built);
+        store.write(built);
+        store.flush();
+        CHECK(store.read(key, read) && read.mapped && sameChunk(built, read));
+    }
+
+    // another seed is another world: other heights, and the tiles of the first one are not seen
+    ChunkData seeded, read;
+    buildChunk(HeightfieldGenerator(nullptr, other), keys[0], lod.quads, lod.spacing, seeded);
+    CHECK(!otherStore.read(keys[0], read));
+    ChunkData original;
+    buildChunk(generator, keys[0], lod.quads, lod.spacing, original);
+    CHECK(memcmp(seeded.vertexData(), original.vertexData(), seeded.vertexCount() * sizeof(TerrainVertex)) != 0);
+
+    // a truncated tile is not used
+    std::string file = store.path(keys[1]);
+    FILE *f = fopen(file.c_str(), "wb");
+    if (f) {
+        fwrite("VWTT", 1, 4, f);
+        fclose(f);
+    }
+    CHECK(!store.read(keys[1], read));
+
+    CHECK_EQUAL(store.stats.writeFailures, 0);
+    removeStore(store, keys);
+    removeStore(otherStore, keys);
+}